@@ -0,0 +1,48 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Filtered packet capture on netif ports.
+ *
+ * A port filter is compiled into a few mask-and-compare words over the
+ * L3/L4 headers. Packets are matched in place right after RX and before
+ * TX, and only matched (and sampled) ones are snapshotted, the first
+ * snaplen bytes copied to the lcore's ring in shared memory. Ports without
+ * a filter pay for one flag test.
+ */
+#ifndef __DPVS_CAPTURE_H__
+#define __DPVS_CAPTURE_H__
+#include "conf/common.h"
+#include "conf/capture.h"
+#include "dpdk.h"
+#include "netif.h"
+
+void capture_pkts(struct netif_port *dev, struct rte_mbuf **mbufs,
+                  uint16_t nb, uint8_t dir);
+
+static inline void netif_capture(struct netif_port *dev,
+                                 struct rte_mbuf **mbufs,
+                                 uint16_t nb, uint8_t dir)
+{
+    if (unlikely(dev->flag & NETIF_PORT_FLAG_CAPTURE))
+        capture_pkts(dev, mbufs, nb, dir);
+}
+
+int capture_init(void);
+int capture_term(void);
+
+#endif /* __DPVS_CAPTURE_H__ */
@@ -39,8 +39,10 @@ struct dp_vs_blklst_conf {
 
     /* for set */
     union inet_addr     blklst;
+    uint8_t             plen;   /* prefix length, 32/128 for a host address */
 };
 
+/* SET takes one or more confs, GET returns the array */
 struct dp_vs_blklst_conf_array {
     int                 naddr;
     struct dp_vs_blklst_conf   blklsts[0];
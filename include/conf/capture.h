@@ -0,0 +1,131 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Packet capture, shared by dpvs and its reader (dpip capture).
+ *
+ * Snapshots of matched packets are written to a file in /dev/shm, which
+ * holds one single-producer/single-consumer ring per lcore. An lcore only
+ * moves ring.head and the reader only moves ring.tail, both free running.
+ */
+#ifndef __DPVS_CAPTURE_CONF_H__
+#define __DPVS_CAPTURE_CONF_H__
+
+#include <stdint.h>
+#include <net/if.h>
+#include "conf/inet.h"
+#include "conf/sockopts.h"
+
+#define CAPTURE_SHM_PATH        "/dev/shm/dpvs_capture"
+#define CAPTURE_SHM_MAGIC       0x44504350  /* "DPCP" */
+#define CAPTURE_SHM_VERSION     1
+
+#define CAPTURE_RING_SLOTS      2048        /* power of 2 */
+#define CAPTURE_SLOT_SIZE       256
+#define CAPTURE_SNAPLEN_DEF     128
+#define CAPTURE_SNAPLEN_MAX     (CAPTURE_SLOT_SIZE - sizeof(struct capture_rec))
+
+enum {
+    CAPTURE_DIR_RX  = 0x1,
+    CAPTURE_DIR_TX  = 0x2,
+};
+
+/* filter of one port, zero fields are wildcards */
+struct capture_conf {
+    char                ifname[IFNAMSIZ];
+    uint8_t             dir;        /* CAPTURE_DIR_XXX */
+    uint8_t             af;
+    uint8_t             proto;
+    uint8_t             splen;
+    uint8_t             dplen;
+    union inet_addr     saddr;
+    union inet_addr     daddr;
+    uint16_t            sport;      /* network order */
+    uint16_t            dport;      /* network order */
+    uint32_t            sample;     /* capture one of every @sample matches */
+    uint32_t            snaplen;
+
+    /* get only */
+    uint64_t            matched;
+    uint64_t            captured;
+    uint64_t            dropped;    /* ring full */
+};
+
+struct capture_conf_array {
+    int                 nconf;
+    struct capture_conf confs[0];
+};
+
+/* shared memory layout */
+struct capture_rec {
+    uint64_t            tsc;
+    uint32_t            len;        /* length on the wire */
+    uint16_t            caplen;
+    uint16_t            port;
+    uint8_t             dir;
+    uint8_t             pad[7];
+    uint8_t             data[0];
+};
+
+struct capture_ring {
+    uint32_t            head;       /* written by the lcore */
+    uint8_t             pad0[60];
+    uint32_t            tail;       /* written by the reader */
+    uint8_t             pad1[60];
+    uint8_t             slots[0];
+};
+
+struct capture_shm {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            nrings;
+    uint32_t            nslots;
+    uint32_t            slot_size;
+    uint32_t            pad;
+    /* wall clock of capture_rec.tsc: ns_base + (tsc - tsc_base) / tsc_hz */
+    uint64_t            tsc_hz;
+    uint64_t            tsc_base;
+    uint64_t            ns_base;
+    uint8_t             pad1[16];
+    uint8_t             rings[0];
+};
+
+static inline size_t capture_ring_size(const struct capture_shm *shm)
+{
+    return sizeof(struct capture_ring) + (size_t)shm->nslots * shm->slot_size;
+}
+
+static inline size_t capture_shm_size(const struct capture_shm *shm)
+{
+    return sizeof(struct capture_shm) + shm->nrings * capture_ring_size(shm);
+}
+
+static inline struct capture_ring *capture_ring_get(struct capture_shm *shm,
+                                                    uint32_t idx)
+{
+    return (struct capture_ring *)(shm->rings + idx * capture_ring_size(shm));
+}
+
+static inline struct capture_rec *capture_slot(const struct capture_shm *shm,
+                                               struct capture_ring *ring,
+                                               uint32_t pos)
+{
+    return (struct capture_rec *)(ring->slots +
+            (size_t)(pos & (shm->nslots - 1)) * shm->slot_size);
+}
+
+#endif /* __DPVS_CAPTURE_CONF_H__ */
@@ -51,6 +51,7 @@
 #define IP_VS_CONN_F_IN_TIMER           0x1000        /* timer attached */
 #define IP_VS_CONN_F_REDIRECT_HASHED    0x2000        /* hashed in redirect table */
 #define IP_VS_CONN_F_NOFASTXMIT         0x4000        /* do not fastxmit */
+#define IP_VS_CONN_F_SYNCED             0x8000        /* installed by session sync */
 
 /* How many connections returned at most for one sockopt ctrl msg.
  * Decrease it for saving memory, increase it for better performace.
@@ -100,16 +101,43 @@ struct ip_vs_conn_entry {
 };
 typedef struct ip_vs_conn_entry ipvs_conn_entry_t;
 
+/*
+ * Server side filter of conn listing, all conditions must be met.
+ * A zero af, port or proto and an empty state match anything.
+ */
+struct ip_vs_conn_filter {
+    uint16_t            proto;
+    uint8_t             vaf;
+    uint8_t             daf;
+    uint8_t             caf;
+    uint8_t             cplen;      /* client prefix length */
+    uint16_t            vport;
+    uint16_t            dport;
+    union inet_addr     vaddr;
+    union inet_addr     daddr;
+    union inet_addr     caddr;
+    char                state[16];
+};
+
+/*
+ * Conns are listed page by page, the server keeps no state between pages.
+ * Pass back the curcid, cursor and skip of the last reply to continue.
+ */
 struct ip_vs_conn_req {
     uint32_t flag;
-    uint32_t whence;
+    uint32_t whence;        /* lcore to continue with */
+    uint32_t cursor;        /* conn table slot to continue with */
+    uint32_t skip;          /* tuples of the slot already visited */
     ipvs_sockpair_t sockpair;
+    struct ip_vs_conn_filter filter;
 };
 
 struct ip_vs_conn_array {
     uint32_t nconns;
     uint32_t resl;
     uint8_t curcid;
+    uint32_t cursor;
+    uint32_t skip;
     ipvs_conn_entry_t array[0];
 } __attribute__((__packed__));
 
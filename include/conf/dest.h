@@ -54,6 +54,10 @@ struct dp_vs_dest_conf {
     /* thresholds for active connections */
     uint32_t           max_conn;    /* upper threshold */
     uint32_t           min_conn;    /* lower threshold */
+
+    /* rate limits, 0 for unlimited */
+    uint32_t           max_cps;     /* new connections per second */
+    uint64_t           max_bps;     /* bytes per second, both directions */
 };
 
 struct dp_vs_dest_entry {
@@ -70,6 +74,10 @@ struct dp_vs_dest_entry {
     uint32_t        inactconns;   /* inactive connections */
     uint32_t        persistconns; /* persistent connections */
 
+    uint32_t        max_cps;      /* connections rate limit */
+    uint64_t        max_bps;      /* bytes rate limit */
+    uint64_t        limit_drops;  /* new connections refused by the limits */
+
     /* statistics */
     struct dp_vs_stats stats;
 };
@@ -106,6 +114,9 @@ struct dp_vs_dest_user {
 
     uint32_t        max_conn;
     uint32_t        min_conn;
+
+    uint32_t        max_cps;
+    uint64_t        max_bps;
 };
 
 #endif /* __DPVS_DEST_CONF_H__ */
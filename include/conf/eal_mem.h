@@ -32,6 +32,7 @@ enum {
     SOCKOPT_GET_EAL_MEM_ZONE,
     SOCKOPT_GET_EAL_MEM_RING,
     SOCKOPT_GET_EAL_MEM_POOL,
+    SOCKOPT_GET_EAL_MEM_CONN,
 };
 
 typedef struct eal_mem_seg_ret_s {
@@ -97,4 +98,16 @@ typedef struct eal_all_mem_ring_ret_s {
     eal_mem_ring_ret_t ring_info[0];
 } eal_all_mem_ring_ret_t;
 
+/* memory of sessions, pools summed over numa sockets */
+typedef struct eal_mem_conn_ret_s {
+    uint32_t conn_size;             /* sizeof dp_vs_conn */
+    uint32_t conn_elt_size;         /* with mempool overhead */
+    uint32_t conn_pool_size;
+    uint32_t conn_pool_used;
+    uint32_t synproxy_size;         /* sizeof dp_vs_conn_synproxy */
+    uint32_t synproxy_elt_size;
+    uint32_t synproxy_pool_size;
+    uint32_t synproxy_pool_used;
+} eal_mem_conn_ret_t;
+
 #endif
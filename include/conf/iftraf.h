@@ -39,8 +39,8 @@ struct iftraf_param {
     uint16_t sport;
     uint16_t dport;
 
-    uint32_t total_recv;
-    uint32_t total_sent;
+    uint64_t total_recv;
+    uint64_t total_sent;
 
 } __attribute__((__packed__));
 
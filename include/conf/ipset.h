@@ -27,6 +27,7 @@
 struct dp_vs_ipset_conf {
 	int af;
 	union inet_addr    addr;
+	uint8_t plen;   /* 0 for a host address */
 };
 
 struct dp_vs_multi_ipset_conf {
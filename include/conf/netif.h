@@ -68,6 +68,12 @@ typedef struct netif_lcore_stats_get
     uint64_t opackets;
     uint64_t obytes;
     uint64_t dropped; // software packet drop
+    /* timer wheel of the lcore */
+    uint64_t timer_expired;
+    uint64_t timer_cascaded;
+    uint64_t timer_deferred;    // ticks running out of expire budget
+    uint32_t timer_backlog;     // age of pending due timers, in ticks
+    uint32_t timer_max_latency; // in ticks
 } netif_lcore_stats_get_t;
 
 struct port_id_name
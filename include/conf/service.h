@@ -121,9 +121,18 @@ struct dp_vs_getinfo {
     unsigned int size;
     unsigned int num_services;
     unsigned int num_lcores;
+    struct dp_vs_stats stats;   /* sum of all lcores */
 };
 
 #define MAX_ARG_LEN    (sizeof(struct dp_vs_service_user) +    \
                          sizeof(struct dp_vs_dest_user))
 
+/*
+ * ADDDEST/EDITDEST/DELDEST take a dp_vs_service_user followed by one or
+ * more dp_vs_dest_user, so that a batch of dests is set in one request.
+ * A batch is applied entirely or not at all.
+ */
+#define DP_VS_SVCDEST_LEN(ndests)   (sizeof(struct dp_vs_service_user) + \
+                                     (ndests) * sizeof(struct dp_vs_dest_user))
+
 #endif /* __DPVS_SVC_CONF_H__ */
@@ -138,6 +138,12 @@ enum {
     SOCKOPT_SET_IFTRAF_ADD  = 6400,
     SOCKOPT_SET_IFTRAF_DEL,
     SOCKOPT_GET_IFTRAF_SHOW = 6400,
+
+    /* capture */
+    SOCKOPT_SET_CAPTURE_ADD   = 6500,
+    SOCKOPT_SET_CAPTURE_DEL,
+    SOCKOPT_SET_CAPTURE_FLUSH,
+    SOCKOPT_GET_CAPTURE_SHOW  = 6500,
 };
 
 #endif /* __DPVS_SOCKOPTS_CONF_H__ */
@@ -41,14 +41,25 @@ typedef enum {
 /**
  * scheduler section
  */
+
+/* htb options, rates in bps, burst sizes and limit in bytes */
+struct tc_htb_qopt {
+    struct tc_ratespec  rate;           /* guaranteed rate */
+    struct tc_ratespec  ceil;           /* upmost rate, borrowing from parent */
+    uint32_t            buffer;         /* burst of rate */
+    uint32_t            cbuffer;        /* burst of ceil */
+    uint32_t            limit;          /* backlog */
+};
+
 struct tc_qsch_param {
     lcoreid_t       cid;
     tc_handle_t     handle;
     tc_handle_t     where;              /* TC_H_ROOT | TC_H_INGRESS | parent */
-    char            kind[TCNAMESIZ];    /* qsch type: bfifo, tbf, ... */
+    char            kind[TCNAMESIZ];    /* qsch type: bfifo, tbf, htb, ... */
 
     union {
         struct tc_tbf_qopt tbf;
+        struct tc_htb_qopt htb;
         struct tc_fifo_qopt fifo;
         struct tc_prio_qopt prio;       /* pfifo_fast ... */
     } qopt;
@@ -37,8 +37,10 @@ struct dp_vs_whtlst_conf {
 
     /* for set */
     union inet_addr     whtlst;
+    uint8_t             plen;   /* prefix length, 32/128 for a host address */
 };
 
+/* SET takes one or more confs, GET returns the array */
 struct dp_vs_whtlst_conf_array {
     int                 naddr;
     struct dp_vs_whtlst_conf   whtlsts[0];
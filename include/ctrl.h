@@ -192,26 +192,22 @@ int msg_dump(const struct dpvs_msg *msg, char *buf, int len);
 #define MSG_TYPE_ROUTE_ADD                  6
 #define MSG_TYPE_ROUTE_DEL                  7
 #define MSG_TYPE_NETIF_LCORE_STATS          8
-#define MSG_TYPE_BLKLST_ADD                 9
-#define MSG_TYPE_BLKLST_DEL                 10
+#define MSG_TYPE_ACL_SYNC                   9
 #define MSG_TYPE_STATS_GET                  11
 #define MSG_TYPE_CONN_GET                   14
 #define MSG_TYPE_CONN_GET_ALL               15
 #define MSG_TYPE_IPV6_STATS                 16
 #define MSG_TYPE_ROUTE6                     17
 #define MSG_TYPE_NEIGH_GET                  18
-#define MSG_TYPE_IPSET_ADD                  19
-#define MSG_TYPE_IPSET_DEL                  20
-#define MSG_TYPE_IPSET_FLUSH                21
+#define MSG_TYPE_IPSET_SYNC                 19
 #define MSG_TYPE_IFA_GET                    22
 #define MSG_TYPE_IFA_SET                    23
 #define MSG_TYPE_IFA_SYNC                   24
-#define MSG_TYPE_WHTLST_ADD                 25
-#define MSG_TYPE_WHTLST_DEL                 26
 #define MSG_TYPE_TC_QSCH_GET                27
 #define MSG_TYPE_TC_QSCH_SET                28
 #define MSG_TYPE_TC_CLS_GET                 29
 #define MSG_TYPE_TC_CLS_SET                 30
+#define MSG_TYPE_CAPTURE_SYNC               31
 #define MSG_TYPE_IPVS_RANGE_START           100
 
 /* for svc per_core, refer to service.h*/
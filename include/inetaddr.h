@@ -110,6 +110,10 @@ struct inet_ifaddr *inet_addr_ifa_get(int af, const struct netif_port *dev,
 struct inet_ifaddr *inet_addr_ifa_get_expired(int af, const struct netif_port *dev,
                                               union inet_addr *addr);
 void inet_addr_ifa_put(struct inet_ifaddr *ifa);
+/* as inet_addr_ifa_get() but no reference is taken, so the ifa is only
+ * valid until this lcore handles its next control message. */
+struct inet_ifaddr *inet_addr_ifa_peek(int af, const struct netif_port *dev,
+                                       const union inet_addr *addr);
 
 bool inet_chk_mcast_addr(int af, struct netif_port *dev,
                         const union inet_addr *group,
@@ -40,14 +40,19 @@ struct ipset_addr {
 struct ipset_entry {
         struct list_head list;
         struct ipset_addr daddr;
+        uint8_t plen;
 };
 
 int ipset_init(void);
-int ipset_add(int af, union inet_addr *dest);
-int ipset_del(int af, union inet_addr *dest);
+int ipset_add(int af, union inet_addr *dest, uint8_t plen);
+int ipset_del(int af, union inet_addr *dest, uint8_t plen);
 int ipset_term(void);
 
-struct ipset_entry *ipset_addr_lookup(int af, union inet_addr *dest);
+/* lockless, callable on any lcore */
+bool ipset_addr_lookup(int af, const union inet_addr *dest);
+
+void ipset_keyword_value_init(void);
+void install_ipset_keywords(void);
 
 #ifdef CONFIG_DPVS_IPSET_DEBUG
 int ipset_list(void);
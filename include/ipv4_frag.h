@@ -23,8 +23,10 @@
 int ipv4_frag_init(void);
 int ipv4_frag_term(void);
 int ipv4_reassamble(struct rte_mbuf *mbuf);
+int ipv6_reassamble(struct rte_mbuf *mbuf);
 int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
           int (*output)(struct rte_mbuf *));
+int ip_frag_l4_cksum(struct rte_mbuf *mbuf);
 
 void ip4_frag_keyword_value_init(void);
 void install_ip4_frag_keywords(void);
@@ -27,6 +27,7 @@
 
 #include <netinet/ip6.h>
 #include "rte_mbuf.h"
+#include "mbuf.h"
 #include "linux_ipv6.h"
 #include "flow.h"
 
@@ -47,6 +48,15 @@ static inline bool ip6_is_frag(struct ip6_hdr *ip6h)
     return (ip6h->ip6_nxt == IPPROTO_FRAGMENT);
 }
 
+/*
+ * only a datagram that came unfragmented gets Packet Too Big, a reassembled
+ * one is fragmented again on output, see ip6_output_fin().
+ */
+static inline bool ip6_pkt_too_big(const struct rte_mbuf *mbuf, uint32_t mtu)
+{
+    return mbuf->pkt_len > mtu && !mbuf_frag_size(mbuf);
+}
+
 enum {
     INET6_PROTO_F_NONE      = 0x01,
     INET6_PROTO_F_FINAL     = 0x02,
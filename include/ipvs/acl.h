@@ -0,0 +1,86 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Per-VIP client address ACL, the engine of both whitelist and blacklist.
+ *
+ * An ACL list maps a VIP (af, proto, vaddr, vport) to a set of client
+ * prefixes. Rules are kept on master for config and dump. Each VIP's set
+ * is compiled into an immutable open addressing table keyed by (prefix,
+ * plen), and the VIPs into another one, which is published to all lcores
+ * by a pointer swap. Old tables are freed once every slave has passed its
+ * msg loop.
+ *
+ * A match probes the table once for each distinct prefix length of the
+ * VIP, so its cost doesn't grow with the number of rules.
+ */
+#ifndef __DPVS_ACL_H__
+#define __DPVS_ACL_H__
+#include "conf/common.h"
+#include "list.h"
+#include "inet.h"
+
+struct dp_vs_acl;
+struct dp_vs_acl_tbl;
+
+struct dp_vs_acl_list {
+    const char                      *name;
+    /* packet path view, NULL if the list is empty */
+    struct dp_vs_acl_tbl * volatile tbl;
+
+    /* master only */
+    struct list_head                *vips;
+    struct list_head                *rules;
+    struct list_head                gc;     /* unreferenced, but maybe in use */
+    uint32_t                        nvips;
+    uint32_t                        nrules;
+};
+
+struct dp_vs_acl_rule {
+    int                 af;
+    uint8_t             proto;
+    uint16_t            vport;
+    union inet_addr     vaddr;
+    union inet_addr     addr;
+    uint8_t             plen;   /* 32/128 for a host address */
+};
+
+typedef int (*dp_vs_acl_walk_cb_t)(const struct dp_vs_acl_rule *rule, void *arg);
+
+/* NULL if the VIP has no rules */
+const struct dp_vs_acl *dp_vs_acl_get(const struct dp_vs_acl_list *list,
+                                      int af, uint8_t proto,
+                                      const union inet_addr *vaddr,
+                                      uint16_t vport);
+bool dp_vs_acl_match(const struct dp_vs_acl *acl, const union inet_addr *addr);
+
+/* control plane, master lcore only */
+int dp_vs_acl_update(struct dp_vs_acl_list *list, bool add,
+                     struct dp_vs_acl_rule *rules, int nrules);
+int dp_vs_acl_flush_vip(struct dp_vs_acl_list *list, int af, uint8_t proto,
+                        const union inet_addr *vaddr, uint16_t vport);
+int dp_vs_acl_flush(struct dp_vs_acl_list *list);
+int dp_vs_acl_walk(const struct dp_vs_acl_list *list,
+                   dp_vs_acl_walk_cb_t cb, void *arg);
+
+int dp_vs_acl_list_init(struct dp_vs_acl_list *list, const char *name);
+void dp_vs_acl_list_term(struct dp_vs_acl_list *list);
+
+int dp_vs_acl_init(void);
+int dp_vs_acl_term(void);
+
+#endif /* __DPVS_ACL_H__ */
@@ -21,17 +21,8 @@
 #include "ipvs/service.h"
 #include "timer.h"
 
-struct blklst_entry {
-    struct list_head    list;
-    int af;
-    uint8_t             proto;
-    uint16_t            vport;
-    union inet_addr     vaddr;
-    union inet_addr     blklst;
-};
-
-struct blklst_entry *dp_vs_blklst_lookup(int af, uint8_t proto, const union inet_addr *vaddr,
-                                         uint16_t vport, const union inet_addr *blklst);
+bool dp_vs_blklst_filtered(int af, uint8_t proto, const union inet_addr *vaddr,
+                           uint16_t vport, const union inet_addr *blklst);
 void dp_vs_blklst_flush(struct dp_vs_service *svc);
 
 int dp_vs_blklst_init(void);
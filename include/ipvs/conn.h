@@ -19,11 +19,13 @@
 #define __DPVS_CONN_H__
 #include <arpa/inet.h>
 #include "conf/common.h"
+#include "conf/eal_mem.h"
 #include "list.h"
 #include "dpdk.h"
 #include "timer.h"
 #include "inet.h"
 #include "ipv4.h"
+#include "neigh.h"
 #include "ipvs/conn.h"
 #include "ipvs/proto.h"
 #include "ipvs/service.h"
@@ -49,6 +51,7 @@ enum {
 #define DPVS_CONN_F_IN_TIMER                IP_VS_CONN_F_IN_TIMER
 #define DPVS_CONN_F_REDIRECT_HASHED         IP_VS_CONN_F_REDIRECT_HASHED
 #define DPVS_CONN_F_NOFASTXMIT              IP_VS_CONN_F_NOFASTXMIT
+#define DPVS_CONN_F_SYNCED                  IP_VS_CONN_F_SYNCED
 
 struct dp_vs_conn_param {
     int                 af;
@@ -72,35 +75,61 @@ struct conn_tuple_hash {
     union inet_addr     daddr;  /* pkt's dest addr */
     uint16_t            sport;
     uint16_t            dport;
-} __rte_cache_aligned;
+};
 
 struct dp_vs_conn_stats {
     rte_atomic64_t      inpkts;
     rte_atomic64_t      inbytes;
     rte_atomic64_t      outpkts;
     rte_atomic64_t      outbytes;
-} __rte_cache_aligned;
+};
+
+/* synproxy part of a conn, see ipvs/synproxy.h */
+struct dp_vs_conn_synproxy {
+    struct dp_vs_seq syn_proxy_seq;     /* seq used in synproxy */
+    struct list_head ack_mbuf;          /* ack mbuf saved in step2 */
+    uint32_t ack_num;                   /* ack mbuf number stored */
+    struct rte_mbuf *syn_mbuf;          /* saved rs syn packet for retransmition */
+    rte_atomic32_t syn_retry_max;       /* syn retransmition max packets */
+
+    /* add for stopping ack storm */
+    uint32_t last_seq;                  /* seq of the last ack packet */
+    uint32_t last_ack_seq;              /* ack seq of the last ack packet */
+    rte_atomic32_t dup_ack_cnt;         /* count of repeated ack packets */
+};
 
 struct dp_vs_proto;
 
+/*
+ * members touched per packet come first, the rest after them. state of
+ * some conns only is kept out of line: synproxy is allocated for synproxy
+ * conns, redirect for conns of the modes needing it, and the statistics
+ * are built with CONFIG_DPVS_IPVS_STATS_DEBUG only.
+ */
 struct dp_vs_conn {
+    struct conn_tuple_hash  tuplehash[DPVS_CONN_DIR_MAX];
     int                     af;
     uint8_t                 proto;
-    union inet_addr         caddr;  /* Client address */
-    union inet_addr         vaddr;  /* Virtual address */
-    union inet_addr         laddr;  /* director Local address */
-    union inet_addr         daddr;  /* Destination (RS) address */
+    lcoreid_t               lcore;
+    bool                    outwall;    /* flag for gfwip */
+
+    /* flags and state transition */
+    volatile uint16_t       flags;
+    volatile uint16_t       state;
+    volatile uint16_t       old_state;  /* old state, state transitions trigger
+                                           persistence and sync, see ipvs/sync.h */
     uint16_t                cport;
     uint16_t                vport;
     uint16_t                lport;
     uint16_t                dport;
+    union inet_addr         caddr;  /* Client address */
+    union inet_addr         vaddr;  /* Virtual address */
+    union inet_addr         laddr;  /* director Local address */
+    union inet_addr         daddr;  /* Destination (RS) address */
 
-    struct rte_mempool      *connpool;
-    struct conn_tuple_hash  tuplehash[DPVS_CONN_DIR_MAX];
     rte_atomic32_t          refcnt;
-    struct dpvs_timer       timer;
-    struct timeval          timeout;
-    lcoreid_t               lcore;
+    dpvs_tick_t             last_seen;  /* tick of the last packet */
+    dpvs_tick_t             expires;    /* tick the armed timer fires at */
     struct dp_vs_dest       *dest;  /* real server */
     void                    *prot_data;  /* protocol specific data */
 
@@ -108,10 +137,6 @@ struct dp_vs_conn {
     struct dp_vs_laddr      *local; /* local address */
     struct dp_vs_seq        fnat_seq;
 
-    /* save last SEQ/ACK from RS for RST when conn expire*/
-    uint32_t                rs_end_seq;
-    uint32_t                rs_end_ack;
-
     int (*packet_xmit)(struct dp_vs_proto *prot,
                         struct dp_vs_conn *conn,
                         struct rte_mbuf *mbuf);
@@ -119,49 +144,38 @@ struct dp_vs_conn {
                         struct dp_vs_conn *conn,
                         struct rte_mbuf *mbuf);
 
-    /* L2 fast xmit */
-    struct rte_ether_addr   in_smac;
-    struct rte_ether_addr   in_dmac;
-    struct rte_ether_addr   out_smac;
-    struct rte_ether_addr   out_dmac;
+    /* nexthops held for L2 fast xmit and neighbour confirm, see neigh_hold() */
+    struct neighbour_entry  *in_nh;     /* inside to rs */
+    struct neighbour_entry  *out_nh;    /* outside to client */
+    uint32_t                in_nh_gen;
+    uint32_t                out_nh_gen;
 
-    /* route for neigbour */
-    struct netif_port       *in_dev;    /* inside to rs*/
-    struct netif_port       *out_dev;   /* outside to client*/
-    union inet_addr         in_nexthop;  /* to rs*/
-    union inet_addr         out_nexthop; /* to client*/
+    /* DPVS_CONN_F_SYNPROXY conns only, not templates */
+    struct dp_vs_conn_synproxy *synproxy;
 
-    /* statistics */
-    struct dp_vs_conn_stats stats;
+    /* connection redirect in fnat/snat/nat modes */
+    struct dp_vs_redirect  *redirect;
 
-    /* synproxy related members */
-    struct dp_vs_seq syn_proxy_seq;     /* seq used in synproxy */
-    struct list_head ack_mbuf;          /* ack mbuf saved in step2 */
-    uint32_t ack_num;                   /* ack mbuf number stored */
-    struct rte_mbuf *syn_mbuf;          /* saved rs syn packet for retransmition */
-    rte_atomic32_t syn_retry_max;       /* syn retransmition max packets */
+    /* members below are off the packet path */
+    struct rte_mempool      *connpool;
+    struct dpvs_timer       timer;
+    struct timeval          timeout;
 
-    /* add for stopping ack storm */
-    uint32_t last_seq;                  /* seq of the last ack packet */
-    uint32_t last_ack_seq;              /* ack seq of the last ack packet */
-    rte_atomic32_t dup_ack_cnt;         /* count of repeated ack packets */
+    /* save last SEQ/ACK from RS for RST when conn expire*/
+    uint32_t                rs_end_seq;
+    uint32_t                rs_end_ack;
 
-    /* flags and state transition */
-    volatile uint16_t       flags;
-    volatile uint16_t       state;
-    volatile uint16_t       old_state;  /* old state, to be used for state transition
-                                           triggered synchronization */
     /* controll members */
     struct dp_vs_conn *control;         /* master who controlls me */
     rte_atomic32_t n_control;           /* number of connections controlled by me*/
-    uint64_t ctime;                     /* create time */
-
-    /* connection redirect in fnat/snat/nat modes */
-    struct dp_vs_redirect  *redirect;
 
-    /* flag for gfwip */
-    bool outwall;
+    /* record slot in the persistence image, 0 if none */
+    uint32_t persist_slot;
 
+#ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
+    uint64_t ctime;                     /* create time */
+    struct dp_vs_conn_stats stats;
+#endif
 } __rte_cache_aligned;
 
 /* for syn-proxy to save all ack packet in conn before rs's syn-ack arrives */
@@ -338,6 +352,40 @@ dp_vs_conn_clear_redirect_hashed(struct dp_vs_conn *conn)
     conn->flags &= ~DPVS_CONN_F_REDIRECT_HASHED;
 }
 
+/*
+ * nexthop of the direction to rs (@in) or to client. a nexthop whose
+ * neighbour is gone is put here, and held again by the xmit slow path.
+ */
+static inline struct neighbour_entry *
+dp_vs_conn_nexthop(struct dp_vs_conn *conn, bool in)
+{
+    struct neighbour_entry **nh = in ? &conn->in_nh : &conn->out_nh;
+    uint32_t gen = in ? conn->in_nh_gen : conn->out_nh_gen;
+
+    if (unlikely(*nh && !neigh_held_valid(*nh, gen))) {
+        neigh_put(*nh);
+        *nh = NULL;
+    }
+
+    return *nh;
+}
+
+/* device of the nexthop, NULL if not known without a route lookup */
+static inline struct netif_port *
+dp_vs_conn_nexthop_dev(const struct dp_vs_conn *conn, bool in)
+{
+    const struct neighbour_entry *nh = in ? conn->in_nh : conn->out_nh;
+
+    return nh ? nh->port : NULL;
+}
+
+/* seq offset synproxy made on the server side, 0 without synproxy */
+static inline uint32_t
+dp_vs_conn_synproxy_delta(const struct dp_vs_conn *conn)
+{
+    return conn->synproxy ? conn->synproxy->syn_proxy_seq.delta : 0;
+}
+
 uint32_t dp_vs_conn_hashkey(int af,
     const union inet_addr *saddr, uint16_t sport,
     const union inet_addr *daddr, uint16_t dport,
@@ -345,6 +393,9 @@ uint32_t dp_vs_conn_hashkey(int af,
 int dp_vs_conn_pool_size(void);
 int dp_vs_conn_pool_cache_size(void);
 
+/* memory of sessions, for dpip eal-mem show conn */
+void dp_vs_conn_mem_info(eal_mem_conn_ret_t *info);
+
 extern bool dp_vs_redirect_disable;
 
 #endif /* __DPVS_CONN_H__ */
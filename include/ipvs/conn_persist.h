@@ -0,0 +1,124 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Connections surviving a restart of dpvs.
+ *
+ * dp_vs_conn{} is made of pointers into the process (dest, laddr, devices,
+ * timers, mempool), so it can't outlive the process. Instead each worker
+ * keeps an image of its conns, with stable identifiers only, in its own
+ * section of a named file on hugetlbfs (conn:persist_file). A record is
+ * written when the conn gets established and on its state changes, and it's
+ * dropped when the conn expires, never touched on the packet path otherwise.
+ *
+ * A new dpvs maps the file again and, if the header matches (version, layout
+ * and worker lcores, which decide the lports of each lcore), takes over the
+ * records as pending. A conn lookup miss on a worker with pending records
+ * looks into its section, and a hit is rebuilt into a conn, binding dest,
+ * laddr and lport again by address once the service is configured. The
+ * lport of a pending FNAT record is held in the sa_pool of its laddr as soon
+ * as the laddr is added, so no new conn takes it meanwhile. Devices and
+ * nexthops are resolved by the xmit path as for a new conn. A pending
+ * record not hit within its timeout is dropped and its lport given back.
+ */
+#ifndef __DPVS_CONN_PERSIST_H__
+#define __DPVS_CONN_PERSIST_H__
+#include "conf/common.h"
+#include "dpdk.h"
+#include "inet.h"
+#include "ipvs/ipvs.h"
+
+struct dp_vs_conn;
+struct inet_ifaddr;
+
+enum {
+    CONN_PERSIST_FREE       = 0,
+    CONN_PERSIST_LIVE,              /* owned by a conn */
+    CONN_PERSIST_PENDING,           /* left by the previous dpvs */
+};
+
+/*
+ * image of a conn, also the decoded form of a session sync record.
+ * in tuple <caddr:cport -> vaddr:vport>, out tuple <daddr:dport -> laddr:lport>
+ */
+struct conn_persist_rec {
+    uint32_t                next[2];    /* index chains, see conn_persist_link() */
+    uint8_t                 status;     /* CONN_PERSIST_XXX */
+    uint8_t                 af;
+    uint8_t                 daf;        /* af of dest and the out tuple */
+    uint8_t                 proto;
+    uint8_t                 fwdmode;
+    uint8_t                 outwall;
+    uint16_t                flags;
+    uint16_t                state;
+    uint16_t                cport;
+    uint16_t                vport;
+    uint16_t                lport;
+    uint16_t                dport;
+    uint16_t                reserved;   /* lport held, pending records only */
+    uint32_t                timeout;    /* sec */
+    union inet_addr         caddr;
+    union inet_addr         vaddr;
+    union inet_addr         laddr;
+    union inet_addr         daddr;
+    struct dp_vs_seq        fnat_seq;
+    struct dp_vs_seq        syn_proxy_seq;
+    uint32_t                rs_end_seq;
+    uint32_t                rs_end_ack;
+    uint64_t                expire;     /* cycles, pending records only */
+};
+
+extern bool dp_vs_conn_persist_enable;
+
+RTE_DECLARE_PER_LCORE(uint32_t, dp_vs_conn_persist_pending);
+
+/* pending records on this lcore, conn lookup misses look for them */
+static inline bool dp_vs_conn_persist_pending(void)
+{
+    return RTE_PER_LCORE(dp_vs_conn_persist_pending) != 0;
+}
+
+/* established conns only, the others are cheap to set up again.
+ * they're also the conns of session sync, see ipvs/sync.h. */
+bool dp_vs_conn_persistable(struct dp_vs_conn *conn);
+
+/* write the record of @conn, called on its state changes */
+void dp_vs_conn_persist_save(struct dp_vs_conn *conn);
+/* drop the record of @conn, called when it expires */
+void dp_vs_conn_persist_drop(struct dp_vs_conn *conn);
+
+/* pending record of the tuple, and the conn direction of the tuple */
+const struct conn_persist_rec *
+dp_vs_conn_persist_lookup(int af, uint16_t proto,
+                          const union inet_addr *saddr,
+                          const union inet_addr *daddr,
+                          uint16_t sport, uint16_t dport,
+                          uint32_t *slot, int *dir);
+/* the pending record @slot is rebuilt into @conn */
+void dp_vs_conn_persist_claim(struct dp_vs_conn *conn, uint32_t slot);
+
+/* hold the lports of the pending FNAT records on @ifa in its sa_pool, so
+ * that no new conn takes one before its record is restored. called when
+ * @ifa is added with a sa_pool on this lcore, or an expired one reused. */
+void dp_vs_conn_persist_reserve(struct inet_ifaddr *ifa);
+
+int dp_vs_conn_persist_init(void);
+int dp_vs_conn_persist_term(void);
+
+void install_conn_persist_keywords(void);
+
+#endif /* __DPVS_CONN_PERSIST_H__ */
@@ -0,0 +1,208 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Per-lcore connection (flow) table.
+ *
+ * A bucketized cuckoo hash: every tuple has a primary and an alternative
+ * bucket, each bucket is exactly one cache line holding the 16-bit
+ * signatures and tuple pointers of up to DPVS_CONN_TBL_BKT_ENTRIES tuples.
+ * A lookup touches at most two bucket lines and only dereferences the
+ * conn_tuple_hash (and thus the dp_vs_conn) on a signature hit.
+ *
+ * Tuples that cannot be placed after a bounded cuckoo displacement are
+ * spilled to small overflow chains (linked by conn_tuple_hash.list), so an
+ * insertion never fails. The buckets record the number of spilled tuples,
+ * the chains are only walked when that count is non-zero.
+ */
+#ifndef __DPVS_CONN_TBL_H__
+#define __DPVS_CONN_TBL_H__
+#include "conf/common.h"
+#include "list.h"
+#include "dpdk.h"
+#include "inet.h"
+#include "ipvs/conn.h"
+
+#define DPVS_CONN_TBL_BKT_ENTRIES   6
+#define DPVS_CONN_TBL_MAX_KICKS     8
+
+struct dp_vs_conn_bucket {
+    uint16_t                sig[DPVS_CONN_TBL_BKT_ENTRIES];
+    uint16_t                ovf_cnt;    /* spilled tuples owned by this bucket */
+    uint16_t                padding;
+    struct conn_tuple_hash  *tuph[DPVS_CONN_TBL_BKT_ENTRIES];
+} __rte_cache_aligned;
+
+struct dp_vs_conn_tbl {
+    uint32_t                bkt_mask;
+    uint32_t                ovf_mask;
+    uint32_t                nbuckets;
+    uint32_t                novf;
+
+    /* statistics */
+    uint32_t                count;      /* tuples in buckets */
+    uint32_t                ovf_count;  /* tuples in overflow chains */
+    uint32_t                ovf_gen;    /* bumped on overflow removal */
+
+    struct dp_vs_conn_bucket *buckets;
+    struct list_head        *ovf_tbl;
+} __rte_cache_aligned;
+
+/*
+ * walk callback, it's allowed to remove the visited tuple (and its peer)
+ * from the table. tuples in overflow chains surviving a removal may be
+ * visited more than once.
+ */
+typedef int (*dp_vs_conn_tbl_walk_cb_t)(struct conn_tuple_hash *t, void *arg);
+
+struct dp_vs_conn_tbl *dp_vs_conn_tbl_create(uint32_t nbuckets, uint32_t novf,
+                                             int socket_id);
+void dp_vs_conn_tbl_destroy(struct dp_vs_conn_tbl *tbl);
+
+int dp_vs_conn_tbl_add(struct dp_vs_conn_tbl *tbl,
+                       struct conn_tuple_hash *t, uint32_t hash);
+int dp_vs_conn_tbl_del(struct dp_vs_conn_tbl *tbl,
+                       struct conn_tuple_hash *t, uint32_t hash);
+
+/*
+ * walk at most @nslots slots (bucket lines and overflow chains) from @cursor,
+ * return the cursor to continue with, or dp_vs_conn_tbl_slots() if done.
+ */
+uint32_t dp_vs_conn_tbl_walk(struct dp_vs_conn_tbl *tbl, uint32_t cursor,
+                             uint32_t nslots, dp_vs_conn_tbl_walk_cb_t cb,
+                             void *arg);
+
+static inline uint32_t dp_vs_conn_tbl_slots(const struct dp_vs_conn_tbl *tbl)
+{
+    return tbl->nbuckets + tbl->novf;
+}
+
+static inline uint16_t conn_tbl_sig(uint32_t hash)
+{
+    return (uint16_t)(hash >> 16);
+}
+
+/* the alternative of the alternative is the primary bucket */
+static inline uint32_t conn_tbl_alt_bkt(const struct dp_vs_conn_tbl *tbl,
+                                        uint32_t bkt, uint16_t sig)
+{
+    return (bkt ^ ((uint32_t)sig * 0x9e37u)) & tbl->bkt_mask;
+}
+
+static inline uint32_t conn_tbl_ovf_idx(const struct dp_vs_conn_tbl *tbl,
+                                        uint32_t bkt1, uint32_t bkt2)
+{
+    return RTE_MIN(bkt1, bkt2) & tbl->ovf_mask;
+}
+
+static inline bool conn_tuple_match(const struct conn_tuple_hash *t,
+                                    int af, uint16_t proto,
+                                    const union inet_addr *saddr,
+                                    const union inet_addr *daddr,
+                                    uint16_t sport, uint16_t dport)
+{
+    if (t->sport != sport || t->dport != dport
+            || t->proto != proto || t->af != af)
+        return false;
+
+    if (af == AF_INET)
+        return t->saddr.in.s_addr == saddr->in.s_addr
+            && t->daddr.in.s_addr == daddr->in.s_addr;
+
+    return memcmp(&t->saddr.in6, &saddr->in6, sizeof(struct in6_addr)) == 0
+        && memcmp(&t->daddr.in6, &daddr->in6, sizeof(struct in6_addr)) == 0;
+}
+
+static inline void dp_vs_conn_tbl_prefetch(const struct dp_vs_conn_tbl *tbl,
+                                           uint32_t hash)
+{
+    uint32_t bkt = hash & tbl->bkt_mask;
+
+    rte_prefetch0(&tbl->buckets[bkt]);
+    rte_prefetch0(&tbl->buckets[conn_tbl_alt_bkt(tbl, bkt, conn_tbl_sig(hash))]);
+}
+
+/* call it after buckets are prefetched */
+static inline void dp_vs_conn_tbl_prefetch_tuple(const struct dp_vs_conn_tbl *tbl,
+                                                 uint32_t hash)
+{
+    int i;
+    uint16_t sig = conn_tbl_sig(hash);
+    const struct dp_vs_conn_bucket *b = &tbl->buckets[hash & tbl->bkt_mask];
+
+    for (i = 0; i < DPVS_CONN_TBL_BKT_ENTRIES; i++) {
+        if (b->sig[i] == sig && b->tuph[i]) {
+            rte_prefetch0(b->tuph[i]);
+            return;
+        }
+    }
+}
+
+static inline struct conn_tuple_hash *
+__conn_tbl_bkt_lookup(const struct dp_vs_conn_bucket *b, uint16_t sig,
+                      int af, uint16_t proto,
+                      const union inet_addr *saddr,
+                      const union inet_addr *daddr,
+                      uint16_t sport, uint16_t dport)
+{
+    int i;
+
+    for (i = 0; i < DPVS_CONN_TBL_BKT_ENTRIES; i++) {
+        if (b->sig[i] == sig && b->tuph[i]
+                && conn_tuple_match(b->tuph[i], af, proto,
+                                    saddr, daddr, sport, dport))
+            return b->tuph[i];
+    }
+
+    return NULL;
+}
+
+/* @hash must be dp_vs_conn_hashkey() of the tuple with a full 32-bit mask */
+static inline struct conn_tuple_hash *
+dp_vs_conn_tbl_lookup(const struct dp_vs_conn_tbl *tbl, uint32_t hash,
+                      int af, uint16_t proto,
+                      const union inet_addr *saddr,
+                      const union inet_addr *daddr,
+                      uint16_t sport, uint16_t dport)
+{
+    uint16_t sig = conn_tbl_sig(hash);
+    uint32_t prim = hash & tbl->bkt_mask;
+    uint32_t alt = conn_tbl_alt_bkt(tbl, prim, sig);
+    const struct dp_vs_conn_bucket *b1 = &tbl->buckets[prim];
+    const struct dp_vs_conn_bucket *b2 = &tbl->buckets[alt];
+    struct conn_tuple_hash *t;
+
+    t = __conn_tbl_bkt_lookup(b1, sig, af, proto, saddr, daddr, sport, dport);
+    if (t)
+        return t;
+
+    t = __conn_tbl_bkt_lookup(b2, sig, af, proto, saddr, daddr, sport, dport);
+    if (t)
+        return t;
+
+    if (likely((b1->ovf_cnt | b2->ovf_cnt) == 0))
+        return NULL;
+
+    list_for_each_entry(t, &tbl->ovf_tbl[conn_tbl_ovf_idx(tbl, prim, alt)], list) {
+        if (conn_tuple_match(t, af, proto, saddr, daddr, sport, dport))
+            return t;
+    }
+
+    return NULL;
+}
+
+#endif /* __DPVS_CONN_TBL_H__ */
@@ -25,6 +25,22 @@
 #include "list.h"
 #include "dpdk.h"
 
+/*
+ * token buckets of the lcore's share of the dest rate limits.
+ * tokens are kept scaled by US_PER_S, with one second of burst.
+ */
+struct dp_vs_dest_limit {
+    uint32_t            max_cps;    /* configured, 0 for unlimited */
+    uint64_t            max_bps;    /* configured, 0 for unlimited */
+    uint32_t            nshares;    /* the lcore owns 1/nshares, 0 for none */
+    uint32_t            credit;     /* of svc limit_proportion, in percent */
+    int64_t             conn_tokens;
+    int64_t             byte_tokens;
+    uint64_t            last_bytes;
+    uint64_t            last_cycles;
+    uint64_t            drops;
+};
+
 struct dp_vs_dest {
     struct list_head    n_list;     /* for the dests in the service */
 
@@ -43,6 +59,7 @@ struct dp_vs_dest {
 
     rte_atomic32_t      refcnt;     /* reference counter */
     struct dp_vs_stats  stats;      /* Use per-cpu statistics for destination server */
+    struct dp_vs_estimator est;
 
     enum dpvs_fwd_mode  fwdmode;
 
@@ -60,7 +77,8 @@ struct dp_vs_dest {
     struct dp_vs_service *svc;      /* service it belongs to */
     union inet_addr     vaddr;      /* virtual IP address */
     unsigned            conn_timeout; /* conn timeout copied from svc*/
-    unsigned            limit_proportion; /* limit copied from svc*/
+
+    struct dp_vs_dest_limit limit;  /* checked on connection scheduling only */
 } __rte_cache_aligned;
 
 static inline bool
@@ -122,6 +140,9 @@ int dp_vs_dest_del(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest);
 int dp_vs_dest_get_entries(const struct dp_vs_service *svc,
                            struct dp_vs_get_dests *uptr);
 
+/* consume a connection token, return true if the dest is over its limits */
+bool dp_vs_dest_limited(struct dp_vs_dest *dest);
+
 int dp_vs_dest_init(void);
 
 int dp_vs_dest_term(void);
@@ -0,0 +1,63 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * IP fragments of IPVS traffic.
+ *
+ * RSS can't hash fragments by ports, which are only in the first fragment,
+ * so fragments of a datagram may reach any lcore. Each fragment to a VIP or
+ * an FNAT local address is steered by a hash of (saddr, daddr, id) to one
+ * reassembly lcore over the redirect rings and reassembled there. Other
+ * fragments are left to the IPv4/IPv6 layer. The datagram then goes down the IPVS path
+ * as a whole, which hands it to the conn owner by the redirect table.
+ * An IPv6 datagram leaves in fragments again, no larger than the ones it
+ * came in or the route MTU if smaller, and never triggers Packet Too Big.
+ */
+#ifndef __DPVS_IPVS_FRAG_H__
+#define __DPVS_IPVS_FRAG_H__
+#include "conf/common.h"
+#include "dpdk.h"
+#include "ipv4.h"
+#include "ipv6.h"
+
+extern bool dp_vs_frag_enable;
+
+static inline bool dp_vs_is_frag(int af, struct rte_mbuf *mbuf)
+{
+    if (af == AF_INET)
+        return ip4_is_frag(ip4_hdr(mbuf));
+    return ip6_is_frag(ip6_hdr(mbuf));
+}
+
+/*
+ * if a fragment is IPVS traffic, i.e. to a VIP or to a local address of
+ * FNAT. others are left to the IPv4/IPv6 layer as they are.
+ */
+bool dp_vs_frag_match(int af, struct rte_mbuf *mbuf);
+
+/*
+ * steer or reassemble a fragment, return INET_ACCEPT with @mbuf holding the
+ * whole datagram, or a verdict that the fragment has been consumed.
+ */
+int dp_vs_frag_in(int af, struct rte_mbuf *mbuf);
+
+int dp_vs_frag_init(void);
+int dp_vs_frag_term(void);
+
+void install_frag_keywords(void);
+
+#endif /* __DPVS_IPVS_FRAG_H__ */
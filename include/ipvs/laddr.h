@@ -22,6 +22,8 @@
 #include "ipvs/service.h"
 
 int dp_vs_laddr_bind(struct dp_vs_conn *conn, struct dp_vs_service *svc);
+int dp_vs_laddr_rebind(struct dp_vs_conn *conn, struct dp_vs_service *svc,
+                       bool held);
 int dp_vs_laddr_unbind(struct dp_vs_conn *conn);
 
 int dp_vs_laddr_add(struct dp_vs_service *svc, int af, const union inet_addr *addr,
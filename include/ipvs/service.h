@@ -78,8 +78,10 @@ struct dp_vs_service {
 
     struct dp_vs_scheduler  *scheduler;
     void                *sched_data;
+    bool                sched_batch;    /* in dp_vs_dests_set() */
 
     struct dp_vs_stats  stats;
+    struct dp_vs_estimator est;
 
     /* FNAT only */
     struct list_head    laddr_list; /* local address (LIP) pool */
@@ -109,6 +111,11 @@ void dp_vs_service_bind(struct dp_vs_dest *dest, struct dp_vs_service *svc);
 
 void dp_vs_service_unbind(struct dp_vs_dest *dest);
 
+typedef int (*dp_vs_service_walk_cb_t)(struct dp_vs_service *svc, void *arg);
+
+/* walk all services of lcore @cid, only call it on lcore @cid */
+int dp_vs_service_walk(lcoreid_t cid, dp_vs_service_walk_cb_t cb, void *arg);
+
 void dp_vs_service_put(struct dp_vs_service *svc);
 
 struct dp_vs_service *dp_vs_vip_lookup(int af, uint16_t protocol,
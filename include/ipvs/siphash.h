@@ -34,10 +34,29 @@
 #include <linux/types.h>
 #include <rte_byteorder.h>
 
+typedef struct {
+    uint64_t key[2];
+} siphash_key_t;
+
 typedef struct {
     unsigned long key[2];
 } hsiphash_key_t;
 
+/* SipHash-2-4 */
+uint64_t siphash_1u64(const uint64_t a, const siphash_key_t *key);
+uint64_t siphash_2u64(const uint64_t a, const uint64_t b,
+        const siphash_key_t *key);
+uint64_t siphash_1u32(const uint32_t a, const siphash_key_t *key);
+uint64_t siphash_3u32(const uint32_t a, const uint32_t b, const uint32_t c,
+        const siphash_key_t *key);
+uint64_t __siphash_aligned(const void *data, size_t len,
+        const siphash_key_t *key);
+
+/* SipHash-2-4 of SIPHASH_LANES messages at once, see siphash_lanes() */
+#define SIPHASH_LANES   8
+void siphash_lanes(const uint64_t *msg, unsigned int nwords,
+        const siphash_key_t *key, uint64_t *out);
+
 uint32_t __hsiphash_aligned(const void *data, size_t len,
         const hsiphash_key_t *key);
 
@@ -21,6 +21,25 @@
 #include <stdint.h>
 #include "dpdk.h"
 #include "conf/stats.h"
+
+/*
+ * rate estimator, like linux ip_vs_est.
+ * cps/pps are kept scaled by 2^10, bps by 2^5.
+ */
+struct dp_vs_estimator {
+    uint64_t            last_conns;
+    uint64_t            last_inpkts;
+    uint64_t            last_outpkts;
+    uint64_t            last_inbytes;
+    uint64_t            last_outbytes;
+
+    uint64_t            cps;
+    uint64_t            inpps;
+    uint64_t            outpps;
+    uint64_t            inbps;
+    uint64_t            outbps;
+};
+
 #include "ipvs/service.h"
 
 struct dp_vs_conn;
@@ -74,6 +93,7 @@ enum  dp_vs_estats_type {
     CONN_SCHED_UNREACH,
     SYNPROXY_NO_DEST,
     CONN_EXCEEDED,
+    DEST_LIMIT_DROP,
     DP_VS_EXT_STAT_LAST
 };
 
@@ -90,6 +110,9 @@ int dp_vs_stats_in(struct dp_vs_conn *conn, struct rte_mbuf *mbuf);
 int dp_vs_stats_out(struct dp_vs_conn *conn, struct rte_mbuf *mbuf);
 void dp_vs_stats_conn(struct dp_vs_conn *conn);
 
+/* sum of all lcores, including the estimated rates */
+void dp_vs_stats_global_get(struct dp_vs_stats *stats);
+
 void dp_vs_estats_inc(enum dp_vs_estats_type field);
 void dp_vs_estats_clear(void);
 uint64_t dp_vs_estats_get(enum dp_vs_estats_type field);
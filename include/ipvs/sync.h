@@ -0,0 +1,109 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * Session sync between dpvs nodes, so that a backup taking over the VIPs
+ * keeps the established conns of the master.
+ *
+ * A worker encodes the conns it owns into its own sync buffer when they get
+ * established or change state, once per timeout while they're alive, and
+ * when they expire. A full buffer, or one older than sync:flush_interval,
+ * is queued to the master lcore, which sends buffers in bursts as UDP
+ * datagrams (multicast or to a peer) on a kernel socket, off the data path.
+ *
+ * The master lcore of the backup receives datagrams in bursts and hands each
+ * to the worker named in its header, which decodes the conns and installs,
+ * refreshes or expires them. Nodes must run the same worker lcores, as the
+ * lports of FNAT conns are partitioned by worker. Synced conns outlive the
+ * refresh interval by half a timeout, and die by timeout on the backup
+ * unless traffic comes to them.
+ */
+#ifndef __DPVS_SYNC_H__
+#define __DPVS_SYNC_H__
+#include "conf/common.h"
+#include "ipvs/conn.h"
+#include "ipvs/conn_persist.h"
+
+#define DP_VS_SYNC_VERSION          1
+#define DP_VS_SYNC_PORT_DEF         8848
+#define DP_VS_SYNC_MCAST_DEF        "224.0.0.81"
+/* UDP payload of a 1500 bytes MTU */
+#define DP_VS_SYNC_MESG_MAX         1472
+
+enum {
+    DP_VS_SYNC_MODE_OFF     = 0,
+    DP_VS_SYNC_MODE_MASTER  = 0x1,      /* send */
+    DP_VS_SYNC_MODE_BACKUP  = 0x2,      /* receive */
+    DP_VS_SYNC_MODE_BOTH    = DP_VS_SYNC_MODE_MASTER | DP_VS_SYNC_MODE_BACKUP,
+};
+
+enum {
+    DP_VS_SYNC_CONN_SET     = 1,        /* new, state change or refresh */
+    DP_VS_SYNC_CONN_DEL,                /* expired */
+};
+
+/*
+ * wire format, multi-byte fields in network order.
+ *
+ * a datagram carries conns of one worker, the header is followed by @nconns
+ * dp_vs_sync_conn records, each followed by its addresses: caddr and vaddr
+ * of @af, daddr and laddr of @daf, 4 or 16 bytes each, then fnat_seq for
+ * FNAT conns and syn_proxy_seq for synproxy conns, both of TCP only.
+ * records are multiples of 4 bytes.
+ */
+struct dp_vs_sync_mesg {
+    uint8_t                 version;
+    uint8_t                 syncid;
+    uint8_t                 lcore;      /* worker owning the conns */
+    uint8_t                 nconns;
+    uint16_t                size;       /* of the datagram */
+    uint16_t                pad;
+};
+
+struct dp_vs_sync_conn {
+    uint8_t                 type;       /* DP_VS_SYNC_CONN_XXX */
+    uint8_t                 af;
+    uint8_t                 daf;
+    uint8_t                 proto;
+    uint8_t                 fwdmode;
+    uint8_t                 size;       /* of the record */
+    uint16_t                flags;
+    uint16_t                state;
+    uint16_t                cport;
+    uint16_t                vport;
+    uint16_t                lport;
+    uint16_t                dport;
+    uint8_t                 outwall;
+    uint8_t                 pad;
+    uint32_t                timeout;    /* sec */
+};
+
+extern bool dp_vs_sync_send_enable;
+
+/* queue a DP_VS_SYNC_CONN_XXX event of @conn, skipped unless persistable */
+void dp_vs_sync_conn(struct dp_vs_conn *conn, int type);
+
+/* install, refresh or expire (@del) the conn of a decoded record */
+int dp_vs_conn_sync_recv(const struct conn_persist_rec *rec, bool del);
+
+int dp_vs_sync_init(void);
+int dp_vs_sync_term(void);
+
+void ipvs_sync_keyword_value_init(void);
+void install_ipvs_sync_keywords(void);
+
+#endif /* __DPVS_SYNC_H__ */
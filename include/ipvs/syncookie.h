@@ -0,0 +1,58 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * SYN cookie engine of synproxy.
+ *
+ * The cookie keeps the layout of the kernel's syncookies:
+ *   H0(saddr, daddr, ports) + sseq + (count << 24)
+ *      + ((H1(saddr, daddr, ports, count) + data) % 2^24)
+ * where count increases every minute and data carries the MSS index and
+ * TCP options. H0 and H1 are SipHash-2-4 under two secret keys. Cookies
+ * of a burst of SYNs are generated together, SIPHASH_LANES hashes a time.
+ */
+#ifndef __DPVS_SYNCOOKIE_H__
+#define __DPVS_SYNCOOKIE_H__
+#include "conf/common.h"
+#include "conf/inet.h"
+
+#define DP_VS_SYNCOOKIE_BURST   32
+
+struct dp_vs_syncookie_tuple {
+    union inet_addr     saddr;
+    union inet_addr     daddr;
+    uint16_t            sport;  /* network order */
+    uint16_t            dport;  /* network order */
+    uint32_t            sseq;   /* host order */
+    uint32_t            data;   /* no more than 24 bits */
+};
+
+/* generate cookies of @n (no more than DP_VS_SYNCOOKIE_BURST) SYNs of @af */
+void dp_vs_syncookie_gen_burst(int af, const struct dp_vs_syncookie_tuple *tuples,
+                               unsigned int n, uint32_t count, uint32_t *cookies);
+
+/*
+ * return the data of a cookie generated within @maxdiff counts before
+ * @count, or (uint32_t)-1. A forged cookie returns garbage data which the
+ * caller must check.
+ */
+uint32_t dp_vs_syncookie_check(int af, const struct dp_vs_syncookie_tuple *tuple,
+                               uint32_t cookie, uint32_t count, uint32_t maxdiff);
+
+void dp_vs_syncookie_init(void);
+
+#endif /* __DPVS_SYNCOOKIE_H__ */
@@ -58,9 +58,12 @@ typedef union {
 
 typedef void * mbuf_userdata_field_route_t;
 
+typedef uint16_t mbuf_userdata_field_frag_t;
+
 typedef enum {
     MBUF_FIELD_PROTO = 0,
     MBUF_FIELD_ROUTE,
+    MBUF_FIELD_FRAG,
 } mbuf_usedata_field_t;
 
 /**
@@ -155,6 +158,28 @@ static inline void mbuf_userdata_reset(struct rte_mbuf *m)
     memset((void *)m->dynfield1, 0, sizeof(m->dynfield1));
 }
 
+/*
+ * A datagram reassembled from fragments carries the size of its largest
+ * fragment, so that it's fragmented again on the way out. The size is only
+ * valid with mbuf_frag_flag set in ol_flags, which PMD RX and mbuf alloc
+ * clear while the redirect rings keep it.
+ */
+extern uint64_t mbuf_frag_flag;
+
+static inline void mbuf_set_frag_size(struct rte_mbuf *m, uint16_t size)
+{
+    MBUF_USERDATA(m, mbuf_userdata_field_frag_t, MBUF_FIELD_FRAG) = size;
+    m->ol_flags |= mbuf_frag_flag;
+}
+
+/* the largest fragment size of a reassembled datagram, 0 for others */
+static inline uint16_t mbuf_frag_size(const struct rte_mbuf *m)
+{
+    if (likely(!(m->ol_flags & mbuf_frag_flag)))
+        return 0;
+    return MBUF_USERDATA_CONST(m, mbuf_userdata_field_frag_t, MBUF_FIELD_FRAG);
+}
+
 int mbuf_init(void);
 
 #endif /* __DP_VS_MBUF_H__ */
@@ -44,6 +44,7 @@
 #include "timer.h"
 #include "netif.h"
 #include "linux_ipv6.h"
+#include "conf/neigh.h"
 
 #define RTE_LOGTYPE_NEIGHBOUR RTE_LOGTYPE_USER2
 #define NEIGH_TAB_BITS 8
@@ -61,6 +62,8 @@ struct neighbour_entry {
     uint32_t            que_num;
     uint32_t            state;
     uint32_t            ts;
+    uint32_t            refcnt;     /* holders, see neigh_hold() */
+    uint32_t            gen;        /* changed once removed */
     uint8_t             flag;
 } __rte_cache_aligned;
 
@@ -115,6 +118,37 @@ int neigh_resolve_input(struct rte_mbuf *mbuf, struct netif_port *port);
 
 void neigh_confirm(int af, union inet_addr *nexthop, struct netif_port *port);
 
+/*
+ * a resolved entry can be held by flows as their nexthop, e.g. ipvs conns,
+ * which then build the L2 header from it themselves rather than going
+ * through route and neigh_output() for each packet. the entry is per-lcore,
+ * hold and put it on the lcore of the flow.
+ *
+ * the MAC of a held entry is updated in place by ARP/NDISC. once the entry
+ * is removed (expired or deleted), its generation changes and the memory is
+ * kept until the last neigh_put(): the holder compares the generation it got
+ * from neigh_hold() and has to hold the nexthop again on a mismatch.
+ */
+struct neighbour_entry *neigh_hold(int af, const union inet_addr *nexthop,
+                                   struct netif_port *port, uint32_t *gen);
+void neigh_put(struct neighbour_entry *neighbour);
+/* neigh_confirm() of a held entry, without lookup */
+void neigh_confirm_held(struct neighbour_entry *neighbour, uint32_t gen);
+
+static inline bool neigh_held_valid(const struct neighbour_entry *neighbour,
+                                    uint32_t gen)
+{
+    return neighbour->gen == gen;
+}
+
+/* L2 header can be built by the holder, except in PROBE state in which
+ * neigh_output() has to be used to send the probe */
+static inline bool neigh_held_reachable(const struct neighbour_entry *neighbour)
+{
+    return neighbour->state == DPVS_NUD_S_REACHABLE ||
+           neighbour->state == DPVS_NUD_S_DELAY;
+}
+
 int neigh_sync_core(const void *param, bool add_del, enum param_kind kind);
 
 static inline void ipv6_mac_mult(const struct in6_addr *mult_target,
@@ -46,6 +46,7 @@ enum {
     NETIF_PORT_FLAG_TC_EGRESS               = (0x1<<10),
     NETIF_PORT_FLAG_TC_INGRESS              = (0x1<<11),
     NETIF_PORT_FLAG_NO_ARP                  = (0x1<<12),
+    NETIF_PORT_FLAG_CAPTURE                 = (0x1<<13),
 };
 
 /* max tx/rx queue number for each nic */
@@ -54,6 +55,8 @@ enum {
 #define NETIF_MAX_PORTS             4096
 /* maximum pkt number at a single burst */
 #define NETIF_MAX_PKT_BURST         32
+/* packets whose data is prefetched ahead of the one being handled */
+#define NETIF_PKT_PREFETCH_OFFSET   3
 /* maximum bonding slave number */
 #define NETIF_MAX_BOND_SLAVES       32
 /* maximum number of hw addr */
@@ -277,6 +280,22 @@ int netif_rcv_mbuf(struct netif_port *dev, lcoreid_t cid,
 int netif_register_pkt(struct pkt_type *pt);
 int netif_unregister_pkt(struct pkt_type *pt);
 
+/*
+ * a module may prepare for a whole RX burst before its packets are
+ * delivered one by one, e.g., prefetch its lookups. @prepare may touch the
+ * packet data of NETIF_PKT_PREFETCH_OFFSET packets ahead, which netif has
+ * prefetched, and prefetches the later ones the same distance ahead.
+ * @select tells the packet being delivered, NETIF_MAX_PKT_BURST after the
+ * burst. one module only, registered before the lcores start.
+ */
+struct netif_burst_ops {
+    void (*prepare)(struct rte_mbuf **mbufs, uint16_t count);
+    void (*select)(uint16_t idx);
+};
+
+int netif_register_burst_ops(const struct netif_burst_ops *ops);
+int netif_unregister_burst_ops(const struct netif_burst_ops *ops);
+
 /**************************** port API ******************************/
 struct netif_port* netif_port_get(portid_t id);
 /* port_conf can be NULL for default port configure */
@@ -38,8 +38,11 @@ struct route_entry {
     struct in_addr src;
     struct netif_port *port;
     rte_atomic32_t refcnt;
+    uint32_t lpm_idx;   /* FIB index of net route, see route.c */
 };
 
+#define ROUTE_LPM_IDX_NONE      UINT32_MAX
+
 struct route_entry *route4_local(uint32_t src, struct netif_port *port);
 
 struct route_entry *route_out_local_lookup(uint32_t dest);
@@ -61,6 +64,9 @@ int route_term(void);
 
 int route_flush(void);
 
+void route_keyword_value_init(void);
+void install_route_keywords(void);
+
 static inline void route4_put(struct route_entry *route)
 {
     if(route){
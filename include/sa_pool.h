@@ -47,41 +47,36 @@
 #define MAX_PORT            65536
 #define MAX_SA_FLOW         4
 
+/* a port bitmap has (MAX_PORT >> flow shift) bits, one for each port
+ * of the lcore, and a summary of its full 64-bit words. */
+#define SA_BITMAP_WORDS     (MAX_PORT / 64)
+#define SA_SUMMARY_WORDS    (SA_BITMAP_WORDS / 64)
+
 struct sa_pool_stats {
     uint32_t used_cnt;
     uint32_t free_cnt;
     uint32_t miss_cnt;
 };
 
-/**
- * if really need to to save memory, we can;
- * 1. use hlist_head
- * 2. use uint8_t flag
- * 3. remove sa_entry.addr, and get IP from sa_pool->ifa
- * 4. to __packed__ sa_entry.
- * 5. create sa_entry_pool only if pool_hash hit.
- *    since when dest (like RS) num may small.
+/*
+ * ports of one laddr toward one destination <ip, port>. a 5-tuple stays
+ * unique as long as the port is unique toward the dest, so each dest can
+ * use all the ports of the lcore.
+ *
+ * released ports are kept in TIME_WAIT for two generations, the older
+ * one is made free when the newer one is older than port_reuse_delay, so
+ * a port isn't reused toward the same dest while the RS may still hold it.
  */
-
-/* socket address (sa) is <ip, port> pair. */
-struct sa_entry {
-    struct list_head        list;       /* node of sa_pool. */
-    uint32_t                flags;      /* SA_F_XXX */
-    union inet_addr         addr;
-    __be16                  port;
-};
-
-struct sa_entry_pool {
-    struct sa_entry         *sa_entries;
-    struct list_head        used_enties;
-    struct list_head        free_enties;
-    /* another way is use total_used/free_cnt in sa_pool,
-     * so that we need not travels the hash to get stats.
-     * we use cnt here, since we may need per-pool stats. */
-    uint16_t                used_cnt;
-    uint16_t                free_cnt;
-    uint32_t                miss_cnt;
-    uint16_t                shift;
+struct sa_bitmap {
+    struct list_head        list;       /* node of dest hash or free list */
+    union inet_addr         daddr;
+    __be16                  dport;
+    uint32_t                used_cnt;
+    uint32_t                tw_cnt[2];  /* newer, older generation */
+    uint64_t                tw_stamp;   /* cycles the newer one starts */
+    uint64_t                full[SA_SUMMARY_WORDS];
+    uint64_t                *bits;      /* used, in TIME_WAIT or not ours */
+    uint64_t                *tw[2];     /* in TIME_WAIT */
 };
 
 /* no lock needed because inet_ifaddr.sa_pool
@@ -93,11 +88,28 @@ struct sa_pool {
     uint16_t                    high;       /* max port */
     rte_atomic32_t              refcnt;
 
-    /* hashed pools by dest's <ip/port>. if no dest provided,
-     * just use first pool. it's not need create/destroy pool
-     * for each dest, that'll be too complicated. */
-    struct sa_entry_pool        *pool_hash;
-    uint8_t                     pool_hash_sz;
+    /* port = (index << shift) | base */
+    uint16_t                    shift;
+    uint16_t                    base;
+    uint32_t                    nbits;
+    uint32_t                    nwords;
+    uint32_t                    nports;     /* ports of [low, high] */
+
+    /* ports without dest, or toward dests beyond the per-dest bitmaps.
+     * a port is never taken from both @shared and a dest's bitmap toward
+     * the same dest, each excludes the other. */
+    struct sa_bitmap            shared;
+    /* per-dest bitmaps, hashed by dest's <ip/port> */
+    struct sa_bitmap            *dests;
+    uint32_t                    dest_num;
+    struct list_head            *dest_hash;
+    uint32_t                    dest_hash_mask;
+    struct list_head            dest_free;
+    /* initial bitmap, ports out of [low, high] are set */
+    uint64_t                    *init_bits;
+    uint64_t                    init_full[SA_SUMMARY_WORDS];
+
+    uint32_t                    miss_cnt;
     uint32_t                    flags;      /* SA_POOL_F_XXX */
 
     int                         flow_num;
@@ -122,9 +134,23 @@ int sa_release(const struct netif_port *dev,
                const struct sockaddr_storage *daddr,
                const struct sockaddr_storage *saddr);
 
+/**
+ * take the given <@saddr, sport> toward @daddr, e.g., the lport of a conn
+ * restored after restart. it's released by sa_release() as a fetched one.
+ */
+int sa_claim(const struct netif_port *dev,
+             const struct sockaddr_storage *daddr,
+             const struct sockaddr_storage *saddr);
+
 int get_sa_pool_stats(const struct inet_ifaddr *ifa,
                        struct sa_pool_stats *stats);
 
+/* free ports of this lcore on @saddr toward <@daddr, @dport>,
+ * 0 if @saddr has no sa_pool. */
+uint32_t sa_pool_free_ports(int af, struct netif_port *dev,
+                            const union inet_addr *saddr,
+                            const union inet_addr *daddr, __be16 dport);
+
 /* config file */
 void install_sa_pool_keywords(void);
 
@@ -43,6 +43,42 @@ struct tc_cls_match_copt {
 
 struct tc_cls;
 
+enum {
+    TC_CLS_KEY_F_PARSED     = 0x01,
+    TC_CLS_KEY_F_PORTS      = 0x02,     /* TCP/UDP ports are set */
+    TC_CLS_KEY_F_ERR_L3     = 0x04,     /* truncated IP header */
+    TC_CLS_KEY_F_ERR_EXTHDR = 0x08,     /* bad IPv6 extension headers */
+    TC_CLS_KEY_F_ERR_L4     = 0x10,     /* truncated TCP/UDP header */
+};
+
+/*
+ * fields of a packet the compiled classifiers look at, parsed once per
+ * packet by the first Qsch having any, and kept over reclassifying.
+ */
+struct tc_cls_key {
+    uint8_t                 flags;      /* TC_CLS_KEY_F_XXX */
+    uint8_t                 af;         /* after 802.1q tags, 0 for non-IP */
+    uint8_t                 proto;      /* IPPROTO_XXX */
+    portid_t                port;       /* mbuf->port */
+    __be16                  pkt_type;   /* as tc_cls.pkt_type is matched */
+    uint16_t                sport;      /* host order */
+    uint16_t                dport;
+    union inet_addr         saddr;
+    union inet_addr         daddr;
+};
+
+/* a classifier compiled, see tc_cls_ops.compile */
+struct tc_cls_rule {
+    __be16                  pkt_type;   /* of the classifier */
+    int                     af;         /* AF_UNSPEC for any */
+    uint8_t                 proto;      /* 0 for any */
+    int                     port;       /* iif of ingress, oif of egress,
+                                           -1 for any */
+    struct inet_addr_range  srange;     /* zero max_addr/max_port for any */
+    struct inet_addr_range  drange;
+    struct tc_cls_result    result;
+};
+
 struct tc_cls_ops {
     char                    name[TCNAMESIZ];
     uint32_t                priv_size;
@@ -50,6 +86,9 @@ struct tc_cls_ops {
     int                     (*classify)(struct tc_cls *cls,
                                         struct rte_mbuf *mbuf,
                                         struct tc_cls_result *result);
+    /* optional, a Qsch with all classifiers compiled skips classify() */
+    int                     (*compile)(struct tc_cls *cls,
+                                       struct tc_cls_rule *rule);
 
     int                     (*init)(struct tc_cls *cls, const void *arg);
     void                    (*destroy)(struct tc_cls *cls);
@@ -87,6 +126,18 @@ struct tc_cls *tc_cls_lookup(struct Qsch *sch, tc_handle_t handle);
 
 tc_handle_t cls_alloc_handle(struct Qsch *sch);
 
+/*
+ * compiled classifiers of a Qsch, see cls_prog.c.
+ * built on the lcore owning the Qsch whenever its classifiers change.
+ */
+void tc_cls_prog_build(struct Qsch *sch);
+
+/* next matched classifier from @*pos by priority, @*pos is moved past it.
+ * returns TC_ACT_OK, TC_ACT_SHOT or TC_ACT_RECLASSIFY (no more) */
+int tc_cls_prog_classify(const struct tc_cls_prog *prog,
+                         struct rte_mbuf *mbuf, struct tc_cls_key *key,
+                         uint32_t *pos, struct tc_cls_result *result);
+
 #endif /* __DPVS__ */
 
 #endif /* __DPVS_TC_CLS_H__ */
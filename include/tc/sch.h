@@ -77,6 +77,7 @@ struct Qsch {
 
     struct list_head        cls_list;   /* classifiers */
     int                     cls_cnt;
+    struct tc_cls_prog      *cls_prog;  /* cls_list compiled, or NULL */
     struct hlist_node       hlist;      /* netif_tc.qsch_hash node */
     struct list_head        list_node;  /* qsch_head list node */
     struct netif_tc         *tc;
@@ -246,8 +247,11 @@ struct Qsch *qsch_lookup_noref(const struct netif_tc *tc, tc_handle_t handle);
 void qsch_do_sched(struct Qsch *sch);
 tc_handle_t sch_alloc_handle(struct netif_tc *tc);
 
+void tc_cls_prog_free(struct tc_cls_prog *prog);
+
 static inline void sch_free(struct Qsch *sch)
 {
+    tc_cls_prog_free(sch->cls_prog);
     rte_free(sch);
 }
 
@@ -82,6 +82,7 @@ struct netif_tc {
 
 struct Qsch_ops;
 struct tc_cls_ops;
+struct tc_cls_prog;
 
 int tc_init(void);
 int tc_term(void);
@@ -19,6 +19,7 @@
 #define __DPVS_TIMER_H__
 #include <sys/time.h>
 #include "list.h"
+#include "conf/common.h"
 
 /*
  * __NOTE__
@@ -35,6 +36,9 @@ typedef int (*dpvs_timer_cb_t)(void *arg);
 
 typedef uint32_t dpvs_tick_t;
 
+/* number of timers the wheels should be sized for, in all lcores */
+typedef uint32_t (*dpvs_timer_size_cb_t)(void);
+
 /* it's internal struct, user should never modify it directly. */
 struct dpvs_timer {
 #ifdef CONFIG_TIMER_DEBUG
@@ -53,12 +57,24 @@ struct dpvs_timer {
     dpvs_tick_t         delay;
 };
 
+struct dpvs_timer_stats {
+    uint64_t            expired;        /* timers fired */
+    uint64_t            cascaded;       /* timers moved to lower wheels */
+    uint64_t            deferred;       /* ticks leaving due timers to next ticks */
+    uint32_t            backlog;        /* age of oldest due timers, in ticks */
+    uint32_t            max_latency;    /* max lateness of due timers, in ticks */
+};
+
 dpvs_tick_t timeval_to_ticks(const struct timeval *tv);
 void ticks_to_timeval(const dpvs_tick_t ticks, struct timeval *tv);
 
 int dpvs_timer_init(void);
 int dpvs_timer_term(void);
 
+/* the module holding most timers, i.e., the conns, tells how many it may
+ * hold. it's registered before dpvs_timer_init() and called by it. */
+void dpvs_timer_size_register(dpvs_timer_size_cb_t cb);
+
 /**
  * if @global is 'true' it's system wide timer, or it's per-lcore.
  * for per-lcore module pls set global to 'false'otherwise
@@ -73,6 +89,9 @@ int dpvs_timer_term(void);
 int dpvs_time_now(struct timeval *now, bool global);
 int dpvs_time_now_nolock(struct timeval *now, bool global);
 
+/* ticks elapsed since the timer started, it's cheap and lockless */
+dpvs_tick_t dpvs_timer_ticks(bool global);
+
 /* schedule one-shot timer expire at "time_now" + @delay */
 int dpvs_timer_sched(struct dpvs_timer *timer, struct timeval *delay,
                      dpvs_timer_cb_t handler, void *arg, bool global);
@@ -107,6 +126,8 @@ int dpvs_timer_update_nolock(struct dpvs_timer *timer,
 
 void dpvs_time_rand_delay(struct timeval *tv, long delay_us);
 
+int dpvs_timer_stats_get(lcoreid_t cid, struct dpvs_timer_stats *stats);
+
 /* config file */
 int dpvs_timer_sched_interval_get(void);
 void timer_keyword_value_init(void);
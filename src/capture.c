@@ -0,0 +1,657 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "list.h"
+#include "ctrl.h"
+#include "netif.h"
+#include "capture.h"
+
+#define RTE_LOGTYPE_CAPTURE     RTE_LOGTYPE_USER1
+
+/* proto 1 + saddr 4 + daddr 4 + ports 1 */
+#define CAPTURE_MAX_INSNS       10
+
+enum {
+    CAPTURE_PROG_IPV4 = 0,
+    CAPTURE_PROG_IPV6,
+    CAPTURE_PROG_MAX,
+};
+
+/* match if (32 bits at base + off) & mask == val, all in network order */
+struct capture_insn {
+    uint8_t             l4;
+    uint8_t             off;
+    uint32_t            mask;
+    uint32_t            val;
+};
+
+struct capture_prog {
+    bool                valid;      /* false: never match this af */
+    bool                l4;         /* some insn looks at L4 header */
+    uint8_t             ninsns;
+    struct capture_insn insns[CAPTURE_MAX_INSNS];
+};
+
+struct capture_stats {
+    uint64_t            matched;
+    uint64_t            captured;
+    uint64_t            dropped;
+    uint32_t            sample_cnt;
+} __rte_cache_aligned;
+
+/*
+ * immutable once published but for the per-lcore stats, freed through
+ * capture_gc, which relies on gc being the first member.
+ */
+struct capture_filter {
+    struct list_head    gc;
+    struct capture_conf conf;
+    bool                any;        /* match non-IP packets too */
+    struct capture_prog progs[CAPTURE_PROG_MAX];
+    struct capture_stats stats[DPVS_MAX_LCORE];
+};
+
+static struct capture_filter * volatile capture_filters[NETIF_MAX_PORTS];
+static struct list_head capture_gc_list = LIST_HEAD_INIT(capture_gc_list);
+static struct capture_shm *capture_shm;
+
+/*
+ * packet path
+ */
+static inline bool capture_prog_run(const struct capture_prog *prog,
+                                    const uint8_t *l3, const uint8_t *l4)
+{
+    int i;
+    uint32_t word;
+    const struct capture_insn *insn;
+
+    for (i = 0; i < prog->ninsns; i++) {
+        insn = &prog->insns[i];
+        memcpy(&word, (insn->l4 ? l4 : l3) + insn->off, sizeof(word));
+        if ((word & insn->mask) != insn->val)
+            return false;
+    }
+
+    return true;
+}
+
+static bool capture_match(const struct capture_filter *filter,
+                          const struct rte_mbuf *mbuf)
+{
+    uint16_t type;
+    const uint8_t *data, *end, *l3, *l4 = NULL;
+    const struct rte_ipv4_hdr *iph;
+    const struct capture_prog *prog;
+
+    /* look at the first segment only, where the headers should be */
+    data = rte_pktmbuf_mtod(mbuf, const uint8_t *);
+    end = data + mbuf->data_len;
+
+    l3 = data + sizeof(struct rte_ether_hdr);
+    if (unlikely(l3 > end))
+        return false;
+    type = ((const struct rte_ether_hdr *)data)->ether_type;
+    if (type == htons(RTE_ETHER_TYPE_VLAN)) {
+        if (unlikely(l3 + sizeof(struct rte_vlan_hdr) > end))
+            return false;
+        type = ((const struct rte_vlan_hdr *)l3)->eth_proto;
+        l3 += sizeof(struct rte_vlan_hdr);
+    }
+
+    if (type == htons(RTE_ETHER_TYPE_IPV4)) {
+        prog = &filter->progs[CAPTURE_PROG_IPV4];
+        if (!prog->valid || l3 + sizeof(struct rte_ipv4_hdr) > end)
+            return false;
+        if (prog->l4) {
+            iph = (const struct rte_ipv4_hdr *)l3;
+            /* no ports in non-first fragments */
+            if (iph->fragment_offset & htons(RTE_IPV4_HDR_OFFSET_MASK))
+                return false;
+            l4 = l3 + ((iph->version_ihl & RTE_IPV4_HDR_IHL_MASK)
+                       * RTE_IPV4_IHL_MULTIPLIER);
+        }
+    } else if (type == htons(RTE_ETHER_TYPE_IPV6)) {
+        prog = &filter->progs[CAPTURE_PROG_IPV6];
+        if (!prog->valid || l3 + sizeof(struct rte_ipv6_hdr) > end)
+            return false;
+        /* extension headers are not walked */
+        if (prog->l4)
+            l4 = l3 + sizeof(struct rte_ipv6_hdr);
+    } else {
+        return filter->any;
+    }
+
+    if (l4 && l4 + sizeof(uint32_t) > end)
+        return false;
+
+    return capture_prog_run(prog, l3, l4);
+}
+
+static void capture_snapshot(struct capture_filter *filter,
+                             struct capture_stats *stats, lcoreid_t cid,
+                             struct rte_mbuf *mbuf, uint8_t dir)
+{
+    uint32_t head, caplen;
+    const void *data;
+    struct capture_ring *ring;
+    struct capture_rec *rec;
+
+    ring = capture_ring_get(capture_shm, cid);
+    head = ring->head;
+    if (unlikely(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)
+                 >= capture_shm->nslots)) {
+        stats->dropped++;
+        return;
+    }
+
+    caplen = RTE_MIN(mbuf->pkt_len, filter->conf.snaplen);
+    rec = capture_slot(capture_shm, ring, head);
+    rec->tsc = rte_rdtsc();
+    rec->len = mbuf->pkt_len;
+    rec->caplen = caplen;
+    rec->port = mbuf->port;
+    rec->dir = dir;
+
+    /* a pointer into the mbuf if the first caplen bytes are contiguous */
+    data = rte_pktmbuf_read(mbuf, 0, caplen, rec->data);
+    if (data != rec->data)
+        rte_memcpy(rec->data, data, caplen);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    stats->captured++;
+}
+
+void capture_pkts(struct netif_port *dev, struct rte_mbuf **mbufs,
+                  uint16_t nb, uint8_t dir)
+{
+    uint16_t i;
+    lcoreid_t cid = rte_lcore_id();
+    struct capture_filter *filter;
+    struct capture_stats *stats;
+
+    filter = capture_filters[dev->id];
+    if (!filter || !(filter->conf.dir & dir) || cid >= DPVS_MAX_LCORE)
+        return;
+    stats = &filter->stats[cid];
+
+    for (i = 0; i < nb; i++) {
+        if (!capture_match(filter, mbufs[i]))
+            continue;
+        stats->matched++;
+
+        if (filter->conf.sample > 1) {
+            if (++stats->sample_cnt < filter->conf.sample)
+                continue;
+            stats->sample_cnt = 0;
+        }
+        capture_snapshot(filter, stats, cid, mbufs[i], dir);
+    }
+}
+
+/*
+ * control plane
+ */
+static void capture_insn_add(struct capture_prog *prog, bool l4, uint8_t off,
+                             const uint8_t mask[4], const uint8_t val[4])
+{
+    struct capture_insn *insn;
+
+    if (!(mask[0] | mask[1] | mask[2] | mask[3]))
+        return;
+
+    assert(prog->ninsns < CAPTURE_MAX_INSNS);
+    insn = &prog->insns[prog->ninsns++];
+    insn->l4 = l4;
+    insn->off = off;
+    memcpy(&insn->mask, mask, sizeof(insn->mask));
+    memcpy(&insn->val, val, sizeof(insn->val));
+    insn->val &= insn->mask;
+    if (l4)
+        prog->l4 = true;
+}
+
+static void capture_prefix_add(struct capture_prog *prog, uint8_t off,
+                               const uint8_t *addr, uint8_t alen, uint8_t plen)
+{
+    int i, j, bits;
+    uint8_t mask[4];
+
+    for (i = 0; i < alen; i += 4) {
+        for (j = 0; j < 4; j++) {
+            bits = plen - (i + j) * 8;
+            if (bits >= 8)
+                mask[j] = 0xff;
+            else if (bits <= 0)
+                mask[j] = 0;
+            else
+                mask[j] = (uint8_t)(0xff << (8 - bits));
+        }
+        capture_insn_add(prog, false, off + i, mask, addr + i);
+    }
+}
+
+static void capture_prog_compile(struct capture_prog *prog, int af,
+                                 const struct capture_conf *conf)
+{
+    uint8_t mask[4] = { 0 }, val[4] = { 0 };
+
+    memset(prog, 0, sizeof(*prog));
+    prog->valid = true;
+
+    if (af == AF_INET) {
+        if (conf->proto) {
+            mask[1] = 0xff;     /* ttl, proto, check */
+            val[1] = conf->proto;
+            capture_insn_add(prog, false, 8, mask, val);
+        }
+        capture_prefix_add(prog, offsetof(struct rte_ipv4_hdr, src_addr),
+                           (const uint8_t *)&conf->saddr.in, 4, conf->splen);
+        capture_prefix_add(prog, offsetof(struct rte_ipv4_hdr, dst_addr),
+                           (const uint8_t *)&conf->daddr.in, 4, conf->dplen);
+    } else {
+        if (conf->proto) {
+            mask[2] = 0xff;     /* payload_len, proto, hop_limits */
+            val[2] = conf->proto;
+            capture_insn_add(prog, false, 4, mask, val);
+        }
+        capture_prefix_add(prog, offsetof(struct rte_ipv6_hdr, src_addr),
+                           (const uint8_t *)&conf->saddr.in6, 16, conf->splen);
+        capture_prefix_add(prog, offsetof(struct rte_ipv6_hdr, dst_addr),
+                           (const uint8_t *)&conf->daddr.in6, 16, conf->dplen);
+    }
+
+    /* sport and dport are the first two 16-bit words of TCP/UDP/SCTP */
+    memset(mask, 0, sizeof(mask));
+    if (conf->sport)
+        mask[0] = mask[1] = 0xff;
+    if (conf->dport)
+        mask[2] = mask[3] = 0xff;
+    memcpy(&val[0], &conf->sport, sizeof(uint16_t));
+    memcpy(&val[2], &conf->dport, sizeof(uint16_t));
+    capture_insn_add(prog, true, 0, mask, val);
+}
+
+static int capture_conf_check(struct capture_conf *conf)
+{
+    uint8_t maxlen;
+
+    if (!conf->dir)
+        conf->dir = CAPTURE_DIR_RX | CAPTURE_DIR_TX;
+    if (conf->dir & ~(CAPTURE_DIR_RX | CAPTURE_DIR_TX))
+        return EDPVS_INVAL;
+
+    if (!conf->snaplen)
+        conf->snaplen = CAPTURE_SNAPLEN_DEF;
+    if (conf->snaplen > CAPTURE_SNAPLEN_MAX)
+        conf->snaplen = CAPTURE_SNAPLEN_MAX;
+
+    if (conf->af == AF_INET)
+        maxlen = 32;
+    else if (conf->af == AF_INET6)
+        maxlen = 128;
+    else if (conf->af == AF_UNSPEC)
+        maxlen = 0;     /* no address without af */
+    else
+        return EDPVS_NOTSUPP;
+    if (conf->splen > maxlen || conf->dplen > maxlen)
+        return EDPVS_INVAL;
+
+    if ((conf->sport || conf->dport) && conf->proto != IPPROTO_TCP
+            && conf->proto != IPPROTO_UDP && conf->proto != IPPROTO_SCTP)
+        return EDPVS_INVAL;
+
+    return EDPVS_OK;
+}
+
+static int capture_sync(void)
+{
+    int err;
+    struct dpvs_msg *msg;
+
+    msg = msg_make(MSG_TYPE_CAPTURE_SYNC, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), 0, NULL);
+    if (!msg)
+        return EDPVS_NOMEM;
+
+    err = multicast_msg_send(msg, 0, NULL);
+    msg_destroy(&msg);
+
+    return err;
+}
+
+/* free the unpublished filters after no slave may be looking at them */
+static void capture_gc(void)
+{
+    struct list_head *pos, *n;
+
+    if (list_empty(&capture_gc_list))
+        return;
+
+    if (capture_sync() != EDPVS_OK) {
+        RTE_LOG(WARNING, CAPTURE, "%s: slaves not synchronized, "
+                "defer freeing old filters\n", __func__);
+        return;
+    }
+
+    list_for_each_safe(pos, n, &capture_gc_list) {
+        list_del(pos);
+        rte_free(pos);
+    }
+}
+
+static int capture_shm_map(void)
+{
+    int fd;
+    size_t size;
+    struct timespec ts;
+    struct capture_shm hdr = {
+        .magic      = CAPTURE_SHM_MAGIC,
+        .version    = CAPTURE_SHM_VERSION,
+        .nrings     = DPVS_MAX_LCORE,
+        .nslots     = CAPTURE_RING_SLOTS,
+        .slot_size  = CAPTURE_SLOT_SIZE,
+    };
+
+    if (capture_shm)
+        return EDPVS_OK;
+
+    fd = open(CAPTURE_SHM_PATH, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        RTE_LOG(ERR, CAPTURE, "%s: fail to open %s -- %s\n",
+                __func__, CAPTURE_SHM_PATH, strerror(errno));
+        return EDPVS_IO;
+    }
+
+    /* tmpfs pages are allocated as the rings are written */
+    size = capture_shm_size(&hdr);
+    if (ftruncate(fd, size) < 0) {
+        RTE_LOG(ERR, CAPTURE, "%s: fail to size %s -- %s\n",
+                __func__, CAPTURE_SHM_PATH, strerror(errno));
+        close(fd);
+        unlink(CAPTURE_SHM_PATH);
+        return EDPVS_IO;
+    }
+
+    capture_shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (capture_shm == MAP_FAILED) {
+        capture_shm = NULL;
+        unlink(CAPTURE_SHM_PATH);
+        return EDPVS_NOMEM;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr.tsc_base = rte_rdtsc();
+    hdr.tsc_hz = rte_get_tsc_hz();
+    hdr.ns_base = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    memcpy(capture_shm, &hdr, sizeof(hdr));
+
+    RTE_LOG(INFO, CAPTURE, "%s: capture rings mapped at %s\n",
+            __func__, CAPTURE_SHM_PATH);
+    return EDPVS_OK;
+}
+
+static void capture_shm_unmap(void)
+{
+    if (!capture_shm)
+        return;
+
+    munmap(capture_shm, capture_shm_size(capture_shm));
+    unlink(CAPTURE_SHM_PATH);
+    capture_shm = NULL;
+}
+
+static void capture_filter_publish(struct netif_port *dev,
+                                   struct capture_filter *filter)
+{
+    struct capture_filter *old = capture_filters[dev->id];
+
+    if (!filter)
+        dev->flag &= ~NETIF_PORT_FLAG_CAPTURE;
+    rte_wmb();
+    capture_filters[dev->id] = filter;
+    rte_wmb();
+    if (filter)
+        dev->flag |= NETIF_PORT_FLAG_CAPTURE;
+
+    if (old)
+        list_add_tail(&old->gc, &capture_gc_list);
+}
+
+static int capture_add(const struct capture_conf *cf)
+{
+    int err;
+    struct netif_port *dev;
+    struct capture_filter *filter;
+    struct capture_conf conf = *cf;
+
+    dev = netif_port_get_by_name(conf.ifname);
+    if (!dev)
+        return EDPVS_NOTEXIST;
+
+    err = capture_conf_check(&conf);
+    if (err != EDPVS_OK)
+        return err;
+
+    err = capture_shm_map();
+    if (err != EDPVS_OK)
+        return err;
+
+    filter = rte_zmalloc("capture_filter", sizeof(*filter), RTE_CACHE_LINE_SIZE);
+    if (!filter)
+        return EDPVS_NOMEM;
+
+    filter->conf = conf;
+    filter->any = !conf.af && !conf.proto;
+    if (conf.af != AF_INET6)
+        capture_prog_compile(&filter->progs[CAPTURE_PROG_IPV4], AF_INET, &conf);
+    if (conf.af != AF_INET)
+        capture_prog_compile(&filter->progs[CAPTURE_PROG_IPV6], AF_INET6, &conf);
+
+    capture_filter_publish(dev, filter);
+    capture_gc();
+
+    RTE_LOG(INFO, CAPTURE, "%s: capture on %s, dir 0x%x, sample %u, snaplen %u\n",
+            __func__, dev->name, conf.dir, conf.sample, conf.snaplen);
+    return EDPVS_OK;
+}
+
+static int capture_del(const struct capture_conf *conf)
+{
+    struct netif_port *dev;
+
+    dev = netif_port_get_by_name(conf->ifname);
+    if (!dev)
+        return EDPVS_NOTEXIST;
+    if (!capture_filters[dev->id])
+        return EDPVS_NOTEXIST;
+
+    capture_filter_publish(dev, NULL);
+    capture_gc();
+
+    return EDPVS_OK;
+}
+
+static int capture_flush(void)
+{
+    portid_t id;
+    struct netif_port *dev;
+
+    for (id = 0; id < NETIF_MAX_PORTS; id++) {
+        if (!capture_filters[id])
+            continue;
+        dev = netif_port_get(id);
+        if (dev) {
+            capture_filter_publish(dev, NULL);
+        } else {
+            list_add_tail(&capture_filters[id]->gc, &capture_gc_list);
+            capture_filters[id] = NULL;
+        }
+    }
+    capture_gc();
+
+    return EDPVS_OK;
+}
+
+static void capture_conf_fill(const struct capture_filter *filter,
+                              const char *ifname, struct capture_conf *conf)
+{
+    int i;
+
+    *conf = filter->conf;
+    snprintf(conf->ifname, sizeof(conf->ifname), "%s", ifname);
+    for (i = 0; i < DPVS_MAX_LCORE; i++) {
+        conf->matched  += filter->stats[i].matched;
+        conf->captured += filter->stats[i].captured;
+        conf->dropped  += filter->stats[i].dropped;
+    }
+}
+
+static int capture_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
+{
+    switch (opt) {
+    case SOCKOPT_SET_CAPTURE_ADD:
+        if (!conf || size < sizeof(struct capture_conf))
+            return EDPVS_INVAL;
+        return capture_add(conf);
+    case SOCKOPT_SET_CAPTURE_DEL:
+        if (!conf || size < sizeof(struct capture_conf))
+            return EDPVS_INVAL;
+        return capture_del(conf);
+    case SOCKOPT_SET_CAPTURE_FLUSH:
+        return capture_flush();
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+static int capture_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
+                               void **out, size_t *outsize)
+{
+    portid_t id, first = 0, last = NETIF_MAX_PORTS - 1;
+    int nconf = 0;
+    struct netif_port *dev;
+    struct capture_conf_array *array;
+    const struct capture_conf *cf = conf;
+
+    if (!out || !outsize)
+        return EDPVS_INVAL;
+
+    if (cf && size >= sizeof(*cf) && strlen(cf->ifname)) {
+        dev = netif_port_get_by_name(cf->ifname);
+        if (!dev)
+            return EDPVS_NOTEXIST;
+        first = last = dev->id;
+    }
+
+    for (id = first; id <= last; id++) {
+        if (capture_filters[id])
+            nconf++;
+    }
+
+    *outsize = sizeof(*array) + nconf * sizeof(struct capture_conf);
+    *out = rte_calloc(NULL, 1, *outsize, RTE_CACHE_LINE_SIZE);
+    if (!(*out))
+        return EDPVS_NOMEM;
+    array = *out;
+
+    for (id = first; id <= last && array->nconf < nconf; id++) {
+        if (!capture_filters[id])
+            continue;
+        dev = netif_port_get(id);
+        capture_conf_fill(capture_filters[id], dev ? dev->name : "",
+                          &array->confs[array->nconf++]);
+    }
+
+    return EDPVS_OK;
+}
+
+static struct dpvs_sockopts capture_sockopts = {
+    .version        = SOCKOPT_VERSION,
+    .set_opt_min    = SOCKOPT_SET_CAPTURE_ADD,
+    .set_opt_max    = SOCKOPT_SET_CAPTURE_FLUSH,
+    .set            = capture_sockopt_set,
+    .get_opt_min    = SOCKOPT_GET_CAPTURE_SHOW,
+    .get_opt_max    = SOCKOPT_GET_CAPTURE_SHOW,
+    .get            = capture_sockopt_get,
+};
+
+static int capture_sync_msg_cb(struct dpvs_msg *msg)
+{
+    /* nothing to do, slaves only need to pass here */
+    return EDPVS_OK;
+}
+
+static void capture_msg_type_init(struct dpvs_msg_type *msg_type)
+{
+    memset(msg_type, 0, sizeof(struct dpvs_msg_type));
+    msg_type->type   = MSG_TYPE_CAPTURE_SYNC;
+    msg_type->mode   = DPVS_MSG_MULTICAST;
+    msg_type->prio   = MSG_PRIO_NORM;
+    msg_type->cid    = rte_lcore_id();
+    msg_type->unicast_msg_cb = capture_sync_msg_cb;
+}
+
+int capture_init(void)
+{
+    int err;
+    struct dpvs_msg_type msg_type;
+
+    capture_msg_type_init(&msg_type);
+    err = msg_type_mc_register(&msg_type);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, CAPTURE, "%s: fail to register sync msg.\n", __func__);
+        return err;
+    }
+
+    err = sockopt_register(&capture_sockopts);
+    if (err != EDPVS_OK) {
+        msg_type_mc_unregister(&msg_type);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+int capture_term(void)
+{
+    int err;
+    struct dpvs_msg_type msg_type;
+
+    err = sockopt_unregister(&capture_sockopts);
+    if (err != EDPVS_OK)
+        return err;
+
+    capture_flush();
+    if (list_empty(&capture_gc_list))
+        capture_shm_unmap();
+
+    capture_msg_type_init(&msg_type);
+    err = msg_type_mc_unregister(&msg_type);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, CAPTURE, "%s: fail to unregister sync msg.\n", __func__);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
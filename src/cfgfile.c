@@ -26,6 +26,8 @@
 #include "neigh.h"
 #include "ipv4.h"
 #include "ipv4_frag.h"
+#include "route.h"
+#include "ipset.h"
 #include "ipv6.h"
 #include "ctrl.h"
 #include "sa_pool.h"
@@ -33,6 +35,7 @@
 #include "ipvs/proto_tcp.h"
 #include "ipvs/proto_udp.h"
 #include "ipvs/synproxy.h"
+#include "ipvs/sync.h"
 #include "scheduler.h"
 
 typedef void (*sighandler_t)(int);
@@ -47,12 +50,15 @@ static void keyword_value_init(void)
 
     ipv4_keyword_value_init();
     ip4_frag_keyword_value_init();
+    route_keyword_value_init();
+    ipset_keyword_value_init();
 
     control_keyword_value_init();
     ipvs_conn_keyword_value_init();
     udp_keyword_value_init();
     tcp_keyword_value_init();
     synproxy_keyword_value_init();
+    ipvs_sync_keyword_value_init();
 
     ipv6_keyword_value_init();
 }
@@ -70,6 +76,8 @@ static vector_t install_keywords(void)
 
     install_ipv4_keywords();
     install_ip4_frag_keywords();
+    install_route_keywords();
+    install_ipset_keywords();
 
     install_control_keywords();
 
@@ -88,6 +96,9 @@ static vector_t install_keywords(void)
     install_proto_udp_keywords();
     install_sublevel_end();
 
+    install_keyword("sync", NULL, KW_TYPE_NORMAL);
+    install_ipvs_sync_keywords();
+
     install_ipv6_keywords();
 
     return g_keywords;
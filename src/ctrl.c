@@ -16,6 +16,7 @@
  *
  */
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <fcntl.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -1253,123 +1254,247 @@ int sockopt_unregister(struct dpvs_sockopts *sockopts)
     return EDPVS_NOTEXIST;
 }
 
-static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg **pmsg)
+/*
+ * sockopt clients are served by an epoll loop on master lcore. the listening
+ * socket and all client sockets are nonblocking, so a slow or stalled client
+ * never blocks the master. a client may keep its connection open and issue
+ * requests back to back, replies are sent in request order.
+ */
+#define SOCKOPT_CLT_MAX         256
+#define SOCKOPT_EVENTS_MAX      64
+#define SOCKOPT_REQS_PER_LOOP   64
+#define SOCKOPT_MSG_LEN_MAX     (64UL << 20)
+
+struct sockopt_clt {
+    struct list_head            list;
+    int                         fd;
+    uint32_t                    events;     /* EPOLLIN or EPOLLOUT */
+
+    /* request being received */
+    struct dpvs_sock_msg        rx_hdr;
+    size_t                      rx_off;
+    struct dpvs_sock_msg        *rx_msg;
+
+    /* reply being sent */
+    struct dpvs_sock_msg_reply  tx_hdr;
+    void                        *tx_data;
+    size_t                      tx_len;     /* header and data */
+    size_t                      tx_off;
+};
+
+static int sockopt_epfd = -1;
+static struct list_head sockopt_clt_list;
+static int sockopt_clt_num;
+static bool sockopt_srv_armed;
+
+/*
+ * the listening socket stays readable while clients are at the limit,
+ * stop polling it until a client is gone, or the epoll loop would spin.
+ */
+static void sockopt_srv_arm(bool armed)
 {
-    struct dpvs_sock_msg msg_hdr;
-    struct dpvs_sock_msg *msg;
-    int len, res;
+    struct epoll_event ev;
 
-    if (unlikely(!pmsg))
-        return EDPVS_INVAL;
-    *pmsg = NULL;
+    if (sockopt_srv_armed == armed)
+        return;
 
-    len = sizeof(msg_hdr);
-    memset(&msg_hdr, 0, len);
-    res = readn(clt_fd, &msg_hdr, len);
-    if (sizeof(msg_hdr) != res) {
-        RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg header recv fail -- %d/%d recieved\n",
-                __func__, res, len);
-        return EDPVS_IO;
+    ev.events = armed ? EPOLLIN : 0;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(sockopt_epfd, EPOLL_CTL_MOD, srv_fd, &ev) < 0) {
+        RTE_LOG(WARNING, MSGMGR, "%s: Fail to %s server socket\n",
+                __func__, armed ? "arm" : "disarm");
+        return;
     }
+    sockopt_srv_armed = armed;
+}
 
-    *pmsg = rte_malloc("sockopt_msg",
-            sizeof(struct dpvs_sock_msg) + msg_hdr.len, RTE_CACHE_LINE_SIZE);
-    if (unlikely(NULL == *pmsg)) {
-        RTE_LOG(ERR, MSGMGR, "%s: no memory\n", __func__);
-        return EDPVS_NOMEM;
-    }
+static void sockopt_clt_close(struct sockopt_clt *clt)
+{
+    epoll_ctl(sockopt_epfd, EPOLL_CTL_DEL, clt->fd, NULL);
+    close(clt->fd);
+
+    list_del(&clt->list);
+    sockopt_clt_num--;
+    sockopt_srv_arm(true);
+
+    if (clt->rx_msg)
+        rte_free(clt->rx_msg);
+    if (clt->tx_data)
+        rte_free(clt->tx_data);
+    rte_free(clt);
+}
 
-    msg = *pmsg;
-    msg->version = msg_hdr.version;
-    msg->id = msg_hdr.id;
-    msg->type = msg_hdr.type;
-    msg->len = msg_hdr.len;
-
-    if (msg_hdr.len > 0) {
-        res = readn(clt_fd, msg->data, msg->len);
-        if (res != msg->len) {
-            RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg body recv fail -- "
-                    "%d/%d recieved\n", __func__, res, (int)msg->len);
-            rte_free(msg);
-            *pmsg = NULL;
-            return EDPVS_IO;
-        }
-    }
+static int sockopt_clt_set_events(struct sockopt_clt *clt, uint32_t events)
+{
+    struct epoll_event ev;
 
+    if (clt->events == events)
+        return EDPVS_OK;
+
+    ev.events = events;
+    ev.data.ptr = clt;
+    if (epoll_ctl(sockopt_epfd, EPOLL_CTL_MOD, clt->fd, &ev) < 0)
+        return EDPVS_IO;
+
+    clt->events = events;
     return EDPVS_OK;
 }
 
-/* free recieved msg */
-static inline void sockopt_msg_free(struct dpvs_sock_msg *msg)
+static void sockopt_accept(void)
 {
-    rte_free(msg);
+    int clt_fd, flags;
+    struct sockopt_clt *clt;
+    struct epoll_event ev;
+
+    while (sockopt_clt_num < SOCKOPT_CLT_MAX) {
+        /* Note: srv_fd is nonblock */
+        clt_fd = accept(srv_fd, NULL, NULL);
+        if (clt_fd < 0) {
+            if (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)
+                RTE_LOG(WARNING, MSGMGR, "%s: Fail to accept client request\n", __func__);
+            return;
+        }
+
+        flags = fcntl(clt_fd, F_GETFL, 0);
+        if (flags == -1 || fcntl(clt_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            RTE_LOG(WARNING, MSGMGR, "%s: Fail to set client socket NONBLOCK\n", __func__);
+            close(clt_fd);
+            continue;
+        }
+
+        clt = rte_zmalloc("sockopt_clt", sizeof(*clt), 0);
+        if (unlikely(!clt)) {
+            RTE_LOG(ERR, MSGMGR, "%s: no memory\n", __func__);
+            close(clt_fd);
+            return;
+        }
+        clt->fd = clt_fd;
+        clt->events = EPOLLIN;
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = clt;
+        if (epoll_ctl(sockopt_epfd, EPOLL_CTL_ADD, clt_fd, &ev) < 0) {
+            RTE_LOG(WARNING, MSGMGR, "%s: Fail to add client socket to epoll\n", __func__);
+            close(clt_fd);
+            rte_free(clt);
+            continue;
+        }
+
+        list_add_tail(&clt->list, &sockopt_clt_list);
+        sockopt_clt_num++;
+    }
+
+    if (sockopt_clt_num >= SOCKOPT_CLT_MAX)
+        sockopt_srv_arm(false);
 }
 
-/* Note:
- * 1. data is created by user using rte_malloc, rte_zmalloc, etc.
- * 2. msg data not sent when errcode is set in reply header */
-static int sockopt_msg_send(int clt_fd,
-        const struct dpvs_sock_msg_reply *hdr,
-        const char *data, int data_len)
+/*
+ * read as much of the pending request as available.
+ * returns EDPVS_OK if a whole request is in clt->rx_msg, EDPVS_INPROGRESS if
+ * more data are expected, or an error if the client should be closed.
+ */
+static int sockopt_msg_recv(struct sockopt_clt *clt)
 {
-    int len, res;
-
-    len = sizeof(struct dpvs_sock_msg_reply);
-    res = sendn(clt_fd, hdr, len, MSG_NOSIGNAL);
-    if (len != res) {
-        RTE_LOG(WARNING, MSGMGR, "[%s:msg#%d] sockopt reply msg header send error"
-                " -- %d/%d sent\n", __func__, hdr->id, res, len);
-        return EDPVS_IO;
+    ssize_t res;
+    size_t hlen = sizeof(struct dpvs_sock_msg);
+
+    while (clt->rx_off < hlen) {
+        res = recv(clt->fd, (char *)&clt->rx_hdr + clt->rx_off,
+                   hlen - clt->rx_off, 0);
+        if (res == 0)
+            return EDPVS_IO;    /* peer closed */
+        if (res < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return EDPVS_INPROGRESS;
+            return EDPVS_IO;
+        }
+        clt->rx_off += res;
     }
 
-    if (hdr->errcode) {
-        RTE_LOG(DEBUG, MSGMGR, "[%s:msg#%d] errcode set in sockopt msg reply: %s\n",
-                __func__, hdr->id, dpvs_strerror(hdr->errcode));
-        return hdr->errcode;
+    if (!clt->rx_msg) {
+        if (unlikely(clt->rx_hdr.len > SOCKOPT_MSG_LEN_MAX)) {
+            RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg too long -- %zu\n",
+                    __func__, clt->rx_hdr.len);
+            return EDPVS_INVAL;
+        }
+
+        clt->rx_msg = rte_malloc("sockopt_msg", hlen + clt->rx_hdr.len,
+                                 RTE_CACHE_LINE_SIZE);
+        if (unlikely(!clt->rx_msg)) {
+            RTE_LOG(ERR, MSGMGR, "%s: no memory\n", __func__);
+            return EDPVS_NOMEM;
+        }
+        clt->rx_msg->version = clt->rx_hdr.version;
+        clt->rx_msg->id = clt->rx_hdr.id;
+        clt->rx_msg->type = clt->rx_hdr.type;
+        clt->rx_msg->len = clt->rx_hdr.len;
     }
 
-    if (data_len) {
-        res = sendn(clt_fd, data, data_len, MSG_NOSIGNAL);
-        if (data_len != res) {
-            RTE_LOG(WARNING, MSGMGR, "[%s:msg#%d] sockopt reply msg body send error"
-                    " -- %d/%d sent\n", __func__, hdr->id, res, data_len);
+    while (clt->rx_off < hlen + clt->rx_msg->len) {
+        res = recv(clt->fd, clt->rx_msg->data + (clt->rx_off - hlen),
+                   hlen + clt->rx_msg->len - clt->rx_off, 0);
+        if (res == 0) {
+            RTE_LOG(WARNING, MSGMGR, "%s: sockopt msg body recv fail -- "
+                    "%zu/%zu recieved\n", __func__, clt->rx_off - hlen,
+                    clt->rx_msg->len);
             return EDPVS_IO;
         }
+        if (res < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return EDPVS_INPROGRESS;
+            return EDPVS_IO;
+        }
+        clt->rx_off += res;
     }
 
     return EDPVS_OK;
 }
 
-static int sockopt_ctl(__rte_unused void *arg)
+/*
+ * send as much of the pending reply as the socket accepts.
+ * returns EDPVS_OK if the reply is sent out, EDPVS_INPROGRESS if the socket
+ * is full, or an error if the client should be closed.
+ */
+static int sockopt_msg_send(struct sockopt_clt *clt)
 {
-    int clt_fd;
-    int ret;
-    socklen_t clt_len;
-    struct sockaddr_un clt_addr;
-    struct dpvs_sockopts *skopt;
-    struct dpvs_sock_msg *msg;
-    struct dpvs_sock_msg_reply reply_hdr;
-    void *reply_data = NULL;
-    size_t reply_data_len = 0;
-
-    memset(&clt_addr, 0, sizeof(struct sockaddr_un));
-    clt_len = sizeof(clt_addr);
+    ssize_t res;
+    size_t hlen = sizeof(struct dpvs_sock_msg_reply);
 
-    /* Note: srv_fd is nonblock */
-    clt_fd = accept(srv_fd, (struct sockaddr*)&clt_addr, &clt_len);
-    if (clt_fd < 0) {
-        if (EWOULDBLOCK != errno) {
-            RTE_LOG(WARNING, MSGMGR, "%s: Fail to accept client request\n", __func__);
+    while (clt->tx_off < clt->tx_len) {
+        if (clt->tx_off < hlen)
+            res = send(clt->fd, (char *)&clt->tx_hdr + clt->tx_off,
+                       hlen - clt->tx_off, MSG_NOSIGNAL);
+        else
+            res = send(clt->fd, (char *)clt->tx_data + (clt->tx_off - hlen),
+                       clt->tx_len - clt->tx_off, MSG_NOSIGNAL);
+        if (res < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return EDPVS_INPROGRESS;
+            RTE_LOG(WARNING, MSGMGR, "[%s:msg#%d] sockopt reply msg send error"
+                    " -- %zu/%zu sent\n", __func__, clt->tx_hdr.id,
+                    clt->tx_off, clt->tx_len);
+            return EDPVS_IO;
         }
-        return EDPVS_IO;
+        clt->tx_off += res;
     }
 
-    /* Note: clt_fd is block */
-    ret = sockopt_msg_recv(clt_fd, &msg);
-    if (unlikely(EDPVS_OK != ret)) {
-        close(clt_fd);
-        return ret;
+    if (clt->tx_data) {
+        rte_free(clt->tx_data);
+        clt->tx_data = NULL;
     }
+    clt->tx_len = clt->tx_off = 0;
+
+    return EDPVS_OK;
+}
+
+/* run the received request and queue its reply */
+static void sockopt_msg_process(struct sockopt_clt *clt)
+{
+    int ret = EDPVS_NOTSUPP;
+    struct dpvs_sockopts *skopt;
+    struct dpvs_sock_msg *msg = clt->rx_msg;
+    void *reply_data = NULL;
+    size_t reply_data_len = 0;
 
     skopt = sockopts_get(msg);
     if (skopt) {
@@ -1377,39 +1502,98 @@ static int sockopt_ctl(__rte_unused void *arg)
             ret = skopt->get(msg->id, msg->data, msg->len, &reply_data, &reply_data_len);
         else if (msg->type == SOCKOPT_SET)
             ret = skopt->set(msg->id, msg->data, msg->len);
-        if (ret < 0) {
-            /* assume that reply_data is freed by user when callback fails */
-            reply_data = NULL;
-            reply_data_len = 0;
+    }
+    if (ret < 0) {
+        /* assume that reply_data is freed by user when callback fails */
+        reply_data = NULL;
+        reply_data_len = 0;
 #ifdef CONFIG_MSG_DEBUG
-            RTE_LOG(INFO, MSGMGR, "%s: socket msg<type=%s, id=%d> callback failed\n",
-                    __func__, msg->type == SOCKOPT_GET ? "GET" : "SET", msg->id);
+        RTE_LOG(INFO, MSGMGR, "%s: socket msg<type=%s, id=%d> callback failed\n",
+                __func__, msg->type == SOCKOPT_GET ? "GET" : "SET", msg->id);
 #endif
-        }
+    }
 
-        memset(&reply_hdr, 0, sizeof(reply_hdr));
-        reply_hdr.version = SOCKOPT_VERSION;
-        reply_hdr.id = msg->id;
-        reply_hdr.type = msg->type;
-        reply_hdr.errcode = ret;
-        strncpy(reply_hdr.errstr, dpvs_strerror(ret), SOCKOPT_ERRSTR_LEN - 1);
-        reply_hdr.len = reply_data_len;
+    /* msg data not sent when errcode is set in reply header */
+    memset(&clt->tx_hdr, 0, sizeof(clt->tx_hdr));
+    clt->tx_hdr.version = SOCKOPT_VERSION;
+    clt->tx_hdr.id = msg->id;
+    clt->tx_hdr.type = msg->type;
+    clt->tx_hdr.errcode = ret;
+    strncpy(clt->tx_hdr.errstr, dpvs_strerror(ret), SOCKOPT_ERRSTR_LEN - 1);
+    clt->tx_hdr.len = reply_data_len;
 
-        /* send response */
-        ret = sockopt_msg_send(clt_fd, &reply_hdr, reply_data, reply_data_len);
+    clt->tx_data = reply_data;
+    clt->tx_len = sizeof(clt->tx_hdr) + reply_data_len;
+    clt->tx_off = 0;
 
-        if (reply_data)
-            rte_free(reply_data);
+    rte_free(clt->rx_msg);
+    clt->rx_msg = NULL;
+    clt->rx_off = 0;
+}
 
-        if (EDPVS_OK != ret) {
-            sockopt_msg_free(msg);
-            close(clt_fd);
-            return ret;
+/*
+ * serve one client until it has nothing more to say, its socket is full,
+ * or the per-loop request budget is used up. requests left in the socket
+ * are picked up next loop since epoll is level triggered.
+ */
+static int sockopt_clt_serve(struct sockopt_clt *clt, int *budget)
+{
+    int ret;
+
+    for (;;) {
+        if (clt->tx_len) {
+            ret = sockopt_msg_send(clt);
+            if (ret == EDPVS_INPROGRESS)
+                return sockopt_clt_set_events(clt, EPOLLOUT);
+            if (ret != EDPVS_OK)
+                return ret;
         }
+
+        /* don't read next request before the reply is out */
+        ret = sockopt_clt_set_events(clt, EPOLLIN);
+        if (ret != EDPVS_OK)
+            return ret;
+
+        if (*budget <= 0)
+            return EDPVS_OK;
+
+        ret = sockopt_msg_recv(clt);
+        if (ret == EDPVS_INPROGRESS)
+            return EDPVS_OK;
+        if (ret != EDPVS_OK)
+            return ret;
+
+        sockopt_msg_process(clt);
+        (*budget)--;
     }
+}
 
-    sockopt_msg_free(msg);
-    close(clt_fd);
+static int sockopt_ctl(__rte_unused void *arg)
+{
+    int i, nev, budget = SOCKOPT_REQS_PER_LOOP;
+    struct epoll_event events[SOCKOPT_EVENTS_MAX];
+    struct sockopt_clt *clt;
+
+    nev = epoll_wait(sockopt_epfd, events, SOCKOPT_EVENTS_MAX, 0);
+    if (nev <= 0)
+        return nev < 0 && errno != EINTR ? EDPVS_IO : EDPVS_OK;
+
+    for (i = 0; i < nev; i++) {
+        clt = events[i].data.ptr;
+        if (!clt) {
+            sockopt_accept();
+            continue;
+        }
+
+        if (events[i].events & EPOLLERR) {
+            sockopt_clt_close(clt);
+            continue;
+        }
+
+        /* on EPOLLHUP, recv() returns the data left and then 0 */
+        if (sockopt_clt_serve(clt, &budget) != EDPVS_OK)
+            sockopt_clt_close(clt);
+    }
 
     return EDPVS_OK;
 }
@@ -1428,10 +1612,12 @@ static struct dpvs_lcore_job sockopt_job = {
 static inline int sockopt_init(void)
 {
     struct sockaddr_un srv_addr;
+    struct epoll_event ev;
     int srv_fd_flags = 0;
     int err;
 
     INIT_LIST_HEAD(&sockopt_list);
+    INIT_LIST_HEAD(&sockopt_clt_list);
 
     memset(ipc_unix_domain, 0, sizeof(ipc_unix_domain));
     strncpy(ipc_unix_domain, UNIX_DOMAIN_DEF, sizeof(ipc_unix_domain) - 1);
@@ -1461,15 +1647,36 @@ static inline int sockopt_init(void)
         return EDPVS_IO;
     }
 
-    if (-1 == listen(srv_fd, 1)) {
+    if (-1 == listen(srv_fd, SOMAXCONN)) {
         RTE_LOG(ERR, MSGMGR, "%s: Server socket listen failed\n", __func__);
         close(srv_fd);
         unlink(ipc_unix_domain);
         return EDPVS_IO;
     }
 
+    sockopt_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (sockopt_epfd < 0) {
+        RTE_LOG(ERR, MSGMGR, "%s: Fail to create epoll instance\n", __func__);
+        close(srv_fd);
+        unlink(ipc_unix_domain);
+        return EDPVS_IO;
+    }
+
+    /* the listening socket is the only one without client context */
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (-1 == epoll_ctl(sockopt_epfd, EPOLL_CTL_ADD, srv_fd, &ev)) {
+        RTE_LOG(ERR, MSGMGR, "%s: Fail to add server socket to epoll\n", __func__);
+        close(sockopt_epfd);
+        close(srv_fd);
+        unlink(ipc_unix_domain);
+        return EDPVS_IO;
+    }
+    sockopt_srv_armed = true;
+
     if ((err = dpvs_lcore_job_register(&sockopt_job, LCORE_ROLE_MASTER)) != EDPVS_OK) {
         RTE_LOG(ERR, MSGMGR, "%s: Fail to register sockopt_job into master\n", __func__);
+        close(sockopt_epfd);
         close(srv_fd);
         unlink(ipc_unix_domain);
         return err;
@@ -1480,9 +1687,17 @@ static inline int sockopt_init(void)
 
 static inline int sockopt_term(void)
 {
+    struct sockopt_clt *clt, *next;
+
+    dpvs_lcore_job_unregister(&sockopt_job, LCORE_ROLE_MASTER);
+
+    list_for_each_entry_safe(clt, next, &sockopt_clt_list, list)
+        sockopt_clt_close(clt);
+
+    close(sockopt_epfd);
+    sockopt_epfd = -1;
     close(srv_fd);
     unlink(ipc_unix_domain);
-    dpvs_lcore_job_unregister(&sockopt_job, LCORE_ROLE_MASTER);
 
     return EDPVS_OK;
 }
@@ -24,6 +24,7 @@
 #include "conf/eal_mem.h"
 #include "eal_mem.h"
 #include "ctrl.h"
+#include "ipvs/conn.h"
 
 #if RTE_VERSION >= RTE_VERSION_NUM(18, 11, 0, 0)
 #define MAX_SEGMENT_NUM         (512)
@@ -230,6 +231,7 @@ static int dp_vs_eal_mem_get(sockoptid_t opt, const void *user, size_t len,
     eal_all_mem_zone_ret_t *all_eal_mem_zone_ret = NULL;
     eal_all_mem_pool_ret_t *all_eal_mem_pool_ret = NULL;
     eal_all_mem_ring_ret_t *all_eal_mem_ring_ret = NULL;
+    eal_mem_conn_ret_t *eal_mem_conn_ret = NULL;
     int size = 0;
     int ret = EDPVS_OK;
 
@@ -313,6 +315,17 @@ static int dp_vs_eal_mem_get(sockoptid_t opt, const void *user, size_t len,
                     all_eal_mem_pool_ret->mempool_num * sizeof(eal_mem_pool_ret_t);
             break;
 
+        case SOCKOPT_GET_EAL_MEM_CONN:
+            eal_mem_conn_ret = rte_zmalloc("mem_conn", sizeof(*eal_mem_conn_ret), 0);
+            if (unlikely(!eal_mem_conn_ret)) {
+                ret = EDPVS_NOMEM;
+                return ret;
+            }
+            dp_vs_conn_mem_info(eal_mem_conn_ret);
+            *out = eal_mem_conn_ret;
+            *outlen = sizeof(*eal_mem_conn_ret);
+            break;
+
         default:
             ret = EDPVS_INVAL;
             break;
@@ -327,7 +340,7 @@ static struct dpvs_sockopts eal_mem_sockopts = {
     .set_opt_max    = SOCKOPT_SET_EAL_MEM_NONE,
     .set            = NULL,
     .get_opt_min    = SOCKOPT_GET_EAL_MEM_SEG,
-    .get_opt_max    = SOCKOPT_GET_EAL_MEM_POOL,
+    .get_opt_max    = SOCKOPT_GET_EAL_MEM_CONN,
     .get            = dp_vs_eal_mem_get,
 };
 
@@ -16,8 +16,25 @@
  *
  */
 
+/*
+ * Top talkers of netif ports.
+ *
+ * Each lcore accounts every TCP/UDP packet in place into its own fixed-size
+ * sketches, one keyed by flow and one by (port, peer address). A sketch is
+ * a set-associative space-saving table: a key hashes to a bucket of a few
+ * ways, and a miss takes over the way with the least count, inheriting the
+ * count as its error. Heavy keys stay, light ones churn, and an update
+ * touches one bucket and one entry, allocates nothing and shares nothing
+ * with other lcores.
+ *
+ * Each lcore has two sketch sets, selected by iftraf_epoch. Every tick the
+ * master merges and clears the set retired in the previous tick, which no
+ * lcore writes any more, into its sliding-window tables, then flips epoch.
+ */
+
 #include <stdio.h>
 #include <string.h>
+#include <rte_jhash.h>
 #include "inet.h"
 #include "ipv4.h"
 #include "ipv6.h"
@@ -33,9 +50,6 @@
 
 #define IFTRAF_TOPN 20
 
-#define IFTRAF_RING_SIZE  1024
-#define IFTRAF_INTERVAL   1024
-
 #define IFTRAF_PKT_DIR_IN 0
 #define IFTRAF_PKT_DIR_OUT 1
 
@@ -47,11 +61,18 @@
 #define IFTRAF_IFTBL_SIZE          (1 << IFTRAF_IFTBL_BITS)
 #define IFTRAF_IFTBL_MASK          (IFTRAF_IFTBL_SIZE - 1)
 
-#define IFTRAF_HISTORY_LENGTH  30
-#define IFTRAF_TIME_INTERVAL 0x100000
+/* sliding window of IFTRAF_HISTORY_LENGTH ticks */
+#define IFTRAF_HISTORY_LENGTH  20
+#define IFTRAF_TICK_MS         1000
+
+/* per-lcore sketches */
+#define IFTRAF_SK_WAYS          4
+#define IFTRAF_SK_FLOW_BUCKETS  1024
+#define IFTRAF_SK_HOST_BUCKETS  256
 
 static int history_pos = 0;
-static int iftraf_ticket = 0;
+static uint64_t iftraf_tick_cycles;
+static uint64_t iftraf_tick_stamp;
 bool iftraf_disable = true;
 
 typedef struct sorted_list_node_tag {
@@ -71,14 +92,6 @@ sorted_list_type sorted_list[NETIF_MAX_PORTS];
 static struct list_head *iftraf_tbl;
 static struct list_head *iftraf_iftbl;
 
-static struct rte_ring *iftraf_ring[DPVS_MAX_LCORE];
-
-#define this_inpkts_count   (RTE_PER_LCORE(inpkts_count))
-#define this_outpkts_count  (RTE_PER_LCORE(outpkts_count))
-
-static RTE_DEFINE_PER_LCORE(uint32_t, inpkts_count);
-static RTE_DEFINE_PER_LCORE(uint32_t, outpkts_count);
-
 static uint32_t iftraf_tlb_rnd; /* hash random */
 
 typedef enum {
@@ -86,20 +99,44 @@ typedef enum {
     HASH_STATUS_KEY_NOT_FOUND
 } hash_status_enum;
 
-struct iftraf_pkt {
-    uint8_t af;
-    uint8_t proto;
-    uint8_t dir;
-    lcoreid_t cid;
-    uint32_t pkt_len;
+/* saddr/sport is the peer, daddr/dport the local side, in both directions */
+struct iftraf_key {
     union inet_addr saddr;
     union inet_addr daddr;
-    uint16_t src_port;
-    uint16_t dst_port;
-    portid_t  devid;
-    char ifname[IFNAMSIZ];
+    uint16_t sport;
+    uint16_t dport;
+    portid_t devid;
+    uint8_t af;
+    uint8_t proto;
+};
+
+#define IFTRAF_KEY_WORDS    (sizeof(struct iftraf_key) / sizeof(uint32_t))
+
+struct iftraf_sk_entry {
+    struct iftraf_key key;
+    uint64_t recv;
+    uint64_t sent;
+} __rte_cache_aligned;
+
+struct iftraf_sk_bucket {
+    uint32_t sig[IFTRAF_SK_WAYS];       /* 0 for an empty way */
+    uint64_t count[IFTRAF_SK_WAYS];     /* own bytes + inherited error */
 } __rte_cache_aligned;
 
+struct iftraf_sketch {
+    uint32_t mask;
+    struct iftraf_sk_bucket *buckets;
+    struct iftraf_sk_entry *entries;    /* IFTRAF_SK_WAYS per bucket */
+};
+
+struct iftraf_lcore {
+    struct iftraf_sketch flows[2];
+    struct iftraf_sketch hosts[2];
+} __rte_cache_aligned;
+
+static struct iftraf_lcore iftraf_lcores[DPVS_MAX_LCORE];
+static volatile uint32_t iftraf_epoch;
+
 struct iftraf_entry {
     struct list_head list;
 
@@ -114,68 +151,50 @@ struct iftraf_entry {
     uint16_t sport;
     uint16_t dport;
 
-    uint32_t recv[IFTRAF_HISTORY_LENGTH];
-    uint32_t sent[IFTRAF_HISTORY_LENGTH];
+    uint64_t recv[IFTRAF_HISTORY_LENGTH];
+    uint64_t sent[IFTRAF_HISTORY_LENGTH];
 
-    uint32_t total_recv;
-    uint32_t total_sent;
+    uint64_t total_recv;
+    uint64_t total_sent;
     int last_write;
 
 } __rte_cache_aligned;
 
+static inline uint32_t iftraf_key_hash(const struct iftraf_key *key)
+{
+    return rte_jhash_32b((const uint32_t *)key, IFTRAF_KEY_WORDS, iftraf_tlb_rnd);
+}
 
-static inline uint32_t iftraf_tlb_hashkey(int af,
-    const union inet_addr *saddr, uint16_t sport,
-    const union inet_addr *daddr, uint16_t dport)
+static inline uint32_t iftraf_tlb_hashkey(const struct iftraf_key *key)
 {
-    switch (af) {
-    case AF_INET:
-        return rte_jhash_3words((uint32_t)saddr->in.s_addr,
-                (uint32_t)daddr->in.s_addr,
-                ((uint32_t)sport) << 16 | (uint32_t)dport,
-                iftraf_tlb_rnd) & IFTRAF_TBL_MASK;
-
-    case AF_INET6:
-        {
-            uint32_t vect[9];
-
-            vect[0] = ((uint32_t)sport) << 16 | (uint32_t)dport;
-            memcpy(&vect[1], &saddr->in6, 16);
-            memcpy(&vect[5], &daddr->in6, 16);
-
-            return rte_jhash_32b(vect, 9, iftraf_tlb_rnd) & IFTRAF_TBL_MASK;
-        }
+    return iftraf_key_hash(key) & IFTRAF_TBL_MASK;
+}
 
-    default:
-        RTE_LOG(DEBUG, IFTRAF, "%s: hashing unsupported protocol %d\n", __func__, af);
-        return 0;
-    }
+static inline bool iftraf_entry_match(const struct iftraf_entry *entry,
+                                      const struct iftraf_key *key)
+{
+    return entry->sport == key->sport && entry->dport == key->dport
+        && inet_addr_equal(key->af, &entry->saddr, &key->saddr)
+        && inet_addr_equal(key->af, &entry->daddr, &key->daddr)
+        && entry->proto == key->proto
+        && entry->af == key->af;
 }
 
-static hash_status_enum iftraf_entry_get(uint32_t hash, struct iftraf_pkt *param, struct iftraf_entry **out_entry)
+static hash_status_enum iftraf_entry_get(uint32_t hash, const struct iftraf_key *key,
+                                         struct iftraf_entry **out_entry)
 {
     struct iftraf_entry *entry;
 
     list_for_each_entry(entry, &iftraf_tbl[hash], list) {
-        if (entry->sport == param->src_port && entry->dport == param->dst_port
-            && inet_addr_equal(param->af, &entry->saddr, &param->saddr)
-            && inet_addr_equal(param->af, &entry->daddr, &param->daddr)
-            && entry->proto == param->proto
-            && entry->af == param->af) {
-            /* hit */
+        if (iftraf_entry_match(entry, key)) {
             *out_entry = entry;
-            RTE_LOG(DEBUG, IFTRAF,
-                "%s: [hit]\n", __func__);
             return HASH_STATUS_OK;
         }
     }
-    RTE_LOG(DEBUG, IFTRAF,
-        "%s: [not found]\n", __func__);
 
     return HASH_STATUS_KEY_NOT_FOUND;
 }
 
-
 static void history_rotate(void)
 {
     uint32_t hash = 0;
@@ -186,14 +205,9 @@ static void history_rotate(void)
     for(hash = 0; hash < IFTRAF_TBL_SIZE; hash++) {
 
         list_for_each_entry_safe(entry, nxt, &iftraf_tbl[hash], list) {
-            /* no data in the last 20s */
+            /* no data in the whole window */
             if (entry->last_write == history_pos) {
                 list_del(&entry->list);
-                if (entry->af == AF_INET) {
-                    RTE_LOG(DEBUG, IFTRAF,
-                        "%s:[v4] [history_pos : %d, cid:%d, proto:%u, src:%08X, dst:%08X, sp:%u, dp:%u]\n",
-                        __func__, history_pos, entry->cid, entry->proto, entry->saddr.in.s_addr, entry->daddr.in.s_addr, entry->sport, entry->dport);
-                }
                 rte_free(entry);
             } else {
                 entry->total_recv -= entry->recv[history_pos];
@@ -208,14 +222,9 @@ static void history_rotate(void)
 
         list_for_each_entry_safe(ifentry, ifnxt, &iftraf_iftbl[hash], list) {
 
-            /* no data in the last 20s */
+            /* no data in the whole window */
             if (ifentry->last_write == history_pos) {
                 list_del(&ifentry->list);
-                if (ifentry->af == AF_INET) {
-                    RTE_LOG(DEBUG, IFTRAF,
-                        "%s:[v4] [history_pos : %d, cid:%d, proto:%u, src:%08X, dst:%08X, sp:%u, dp:%u]\n",
-                        __func__, history_pos, ifentry->cid, ifentry->proto, ifentry->saddr.in.s_addr, entry->daddr.in.s_addr, entry->sport, entry->dport);
-                }
                 rte_free(ifentry);
             } else {
                 ifentry->total_recv -= ifentry->recv[history_pos];
@@ -252,7 +261,7 @@ static void insert_top_list(struct iftraf_entry *entry, sorted_list_type *p_iftr
     if (p_iftraf_sorted_list->sorted_list_num == IFTRAF_TOPN && p_iftraf_sorted_list->compare(p->next->data, entry)) {
         struct iftraf_entry *firstentry = (struct iftraf_entry *)p->next->data;
         RTE_LOG(DEBUG, IFTRAF,
-            "%s: no need to insert[%u: %u, %u: %u]\n",
+            "%s: no need to insert[%lu: %lu, %lu: %lu]\n",
              __func__, firstentry->total_recv, firstentry->total_sent, entry->total_recv, entry->total_sent);
 
         return;
@@ -273,7 +282,7 @@ static void insert_top_list(struct iftraf_entry *entry, sorted_list_type *p_iftr
     node->data = entry;
     p->next = node;
     RTE_LOG(DEBUG, IFTRAF,
-        "%s: [insert list]cid : %d, sp : %u, dp : %u, recv : %u, sent : %u\n",
+        "%s: [insert list]cid : %d, sp : %u, dp : %u, recv : %lu, sent : %lu\n",
         __func__, entry->cid, ntohs(entry->sport), ntohs(entry->dport), entry->total_recv, entry->total_sent);
     if(p_iftraf_sorted_list->sorted_list_num < IFTRAF_TOPN)
         p_iftraf_sorted_list->sorted_list_num++;
@@ -284,7 +293,7 @@ static void insert_top_list(struct iftraf_entry *entry, sorted_list_type *p_iftr
 
         data = (struct iftraf_entry *)first->data;
         RTE_LOG(DEBUG, IFTRAF,
-            "%s: [free first entry]cid : %d, sp : %u, dp : %u, recv : %u, sent : %u\n",
+            "%s: [free first entry]cid : %d, sp : %u, dp : %u, recv : %lu, sent : %lu\n",
              __func__, data->cid, ntohs(data->sport), ntohs(data->dport), data->total_recv, data->total_sent);
         p->next = first->next;
 
@@ -448,7 +457,7 @@ int iftraf_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
         }
 
         RTE_LOG(DEBUG, IFTRAF,
-            "%s: off : %u, cid : %d, proto: %u, total_recv: %u,  total_sent : %u\n",
+            "%s: off : %u, cid : %d, proto: %u, total_recv: %lu,  total_sent : %lu\n",
             __func__, off, entry->cid, entry->proto, array->iftraf[off].total_recv, array->iftraf[off].total_sent);
 
         rte_free(node);
@@ -460,68 +469,60 @@ int iftraf_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
     return EDPVS_OK;
 }
 
-static void inline iftraf_tlb_add(struct iftraf_pkt *param)
+static struct iftraf_entry *iftraf_entry_new(lcoreid_t cid, const struct iftraf_key *key)
 {
-    uint32_t hash;
-    struct iftraf_entry *entry = NULL;
-
-    hash = iftraf_tlb_hashkey(param->af, &param->saddr, param->src_port, &param->daddr,
-               param->dst_port);
-
-    if (iftraf_entry_get(hash, param, &entry) == HASH_STATUS_KEY_NOT_FOUND) {
+    struct iftraf_entry *entry;
+    struct netif_port *dev;
 
-        entry = rte_zmalloc(NULL, sizeof(struct iftraf_entry), RTE_CACHE_LINE_SIZE);
-        if (entry == NULL) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: no memory\n", __func__);
-            return;
-        }
+    entry = rte_zmalloc(NULL, sizeof(struct iftraf_entry), RTE_CACHE_LINE_SIZE);
+    if (entry == NULL) {
+        RTE_LOG(ERR, IFTRAF,
+            "%s: no memory\n", __func__);
+        return NULL;
+    }
 
-        memset(entry, 0, sizeof(struct iftraf_entry));
-        entry->af = param->af;
-        entry->cid = param->cid;
-        entry->devid = param->devid;
-        entry->proto = param->proto;
-        iftraf_addr_cpy(param->af, &entry->saddr, &param->saddr);
-        iftraf_addr_cpy(param->af, &entry->daddr, &param->daddr);
-        entry->sport = param->src_port;
-        entry->dport = param->dst_port;
-        strcpy(entry->ifname, param->ifname);
+    entry->af = key->af;
+    entry->cid = cid;
+    entry->devid = key->devid;
+    entry->proto = key->proto;
+    iftraf_addr_cpy(key->af, &entry->saddr, &key->saddr);
+    iftraf_addr_cpy(key->af, &entry->daddr, &key->daddr);
+    entry->sport = key->sport;
+    entry->dport = key->dport;
 
-        list_add(&entry->list, &iftraf_tbl[hash]);
-    }
+    dev = netif_port_get(key->devid);
+    if (dev)
+        snprintf(entry->ifname, sizeof(entry->ifname), "%s", dev->name);
 
-    if (param->af == AF_INET) {
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s:[v4] dequeue iftraf_ring[cid:%d, proto:%u, src:%08X, dst:%08X, sp:%u, dp:%u, len:%u]\n",
-            __func__, entry->cid, entry->proto, entry->saddr.in.s_addr,
-            entry->daddr.in.s_addr, ntohs(entry->sport), ntohs(entry->dport), param->pkt_len);
-    } else {
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s:[v6] dequeue iftraf_ring[cid:%d, dir:%d, proto:%u, src:%08X %08X %08X %08X, dst:%08X %08X %08X %08X, sp:%u, dp:%u, len:%u]\n",
-            __func__, entry->cid, param->dir, entry->proto,
-            entry->saddr.in6.s6_addr32[0], entry->saddr.in6.s6_addr32[1],
-            entry->saddr.in6.s6_addr32[2], entry->saddr.in6.s6_addr32[3],
-            entry->daddr.in6.s6_addr32[0],entry->daddr.in6.s6_addr32[1],
-            entry->daddr.in6.s6_addr32[2],entry->daddr.in6.s6_addr32[3],
-            ntohs(entry->sport), ntohs(entry->dport), param->pkt_len);
-    }
+    return entry;
+}
 
-    /* Update record */
+static inline void iftraf_entry_account(struct iftraf_entry *entry,
+                                        uint64_t recv, uint64_t sent)
+{
     entry->last_write = history_pos;
-    if (param->dir == IFTRAF_PKT_DIR_IN) {
-        entry->recv[history_pos] += param->pkt_len;
-        entry->total_recv += param->pkt_len;
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: history_pos: %d, recv : %u, total_recv : %u\n", __func__, history_pos, entry->recv[history_pos], entry->total_recv);
+    entry->recv[history_pos] += recv;
+    entry->total_recv += recv;
+    entry->sent[history_pos] += sent;
+    entry->total_sent += sent;
+}
 
-    } else {
-        entry->sent[history_pos] += param->pkt_len;
-        entry->total_sent += param->pkt_len;
+static void iftraf_tlb_add(lcoreid_t cid, const struct iftraf_key *key,
+                           uint64_t recv, uint64_t sent)
+{
+    uint32_t hash;
+    struct iftraf_entry *entry = NULL;
 
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: history_pos: %d: sent : %u, total_sent: %u\n", __func__, history_pos, entry->sent[history_pos], entry->total_sent);
+    hash = iftraf_tlb_hashkey(key);
+
+    if (iftraf_entry_get(hash, key, &entry) == HASH_STATUS_KEY_NOT_FOUND) {
+        entry = iftraf_entry_new(cid, key);
+        if (!entry)
+            return;
+        list_add(&entry->list, &iftraf_tbl[hash]);
     }
+
+    iftraf_entry_account(entry, recv, sent);
 }
 
 static inline unsigned iftraf_byif_hashkey(int af,
@@ -541,279 +542,252 @@ static inline unsigned iftraf_byif_hashkey(int af,
         & IFTRAF_IFTBL_MASK;
 }
 
-static hash_status_enum iftraf_ifentry_get(uint32_t hash, struct iftraf_pkt *param, struct iftraf_entry **out_entry)
+static hash_status_enum iftraf_ifentry_get(uint32_t hash, const struct iftraf_key *key,
+                                           struct iftraf_entry **out_entry)
 {
     struct iftraf_entry *entry;
 
     list_for_each_entry(entry, &iftraf_iftbl[hash], list) {
-        if (inet_addr_equal(param->af, &entry->saddr, &param->saddr)
-            && entry->devid == param->devid
-            && entry->af == param->af) {
-            /* hit */
+        if (inet_addr_equal(key->af, &entry->saddr, &key->saddr)
+            && entry->devid == key->devid
+            && entry->af == key->af) {
             *out_entry = entry;
-            RTE_LOG(DEBUG, IFTRAF,
-                "%s: [hit]\n", __func__);
             return HASH_STATUS_OK;
         }
     }
-    RTE_LOG(DEBUG, IFTRAF,
-        "%s: [not found]\n", __func__);
 
     return HASH_STATUS_KEY_NOT_FOUND;
 }
 
-static void inline iftraf_iftlb_add(struct iftraf_pkt *param)
+static void iftraf_iftlb_add(lcoreid_t cid, const struct iftraf_key *key,
+                             uint64_t recv, uint64_t sent)
 {
     uint32_t hash;
     struct iftraf_entry *entry = NULL;
 
-    hash = iftraf_byif_hashkey(param->af, &param->saddr, param->devid);
-
-    if (iftraf_ifentry_get(hash, param, &entry) == HASH_STATUS_KEY_NOT_FOUND) {
+    hash = iftraf_byif_hashkey(key->af, &key->saddr, key->devid);
 
-        entry = rte_zmalloc(NULL, sizeof(struct iftraf_entry), RTE_CACHE_LINE_SIZE);
-        if (entry == NULL) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: no memory\n", __func__);
+    if (iftraf_ifentry_get(hash, key, &entry) == HASH_STATUS_KEY_NOT_FOUND) {
+        entry = iftraf_entry_new(cid, key);
+        if (!entry)
             return;
-        }
-
-        memset(entry, 0, sizeof(struct iftraf_entry));
-        entry->af = param->af;
-        entry->cid = param->cid;
-        entry->devid = param->devid;
-        entry->proto = 0;//param->proto;
-        iftraf_addr_cpy(param->af, &entry->saddr, &param->saddr);
-        iftraf_addr_cpy(param->af, &entry->daddr, &param->daddr);
-        entry->sport = 0;//param->src_port;
-        entry->dport = 0;//param->dst_port;
-        strcpy(entry->ifname, param->ifname);
-
         list_add(&entry->list, &iftraf_iftbl[hash]);
     }
 
-    if (param->af == AF_INET) {
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s:[v4] dequeue iftraf_ring[cid:%d, proto:%u, devid:%u, ifname:%s,src:%08X, dst:%08X, sp:%u, dp:%u, len:%u]\n",
-            __func__, entry->cid, entry->proto, entry->devid, entry->ifname, entry->saddr.in.s_addr,
-            entry->daddr.in.s_addr, ntohs(entry->sport), ntohs(entry->dport), param->pkt_len);
-    } else {
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s:[v6] dequeue iftraf_ring[cid:%d, dir:%d, proto:%u, devid:%u,  src:%08X %08X %08X %08X, dst:%08X %08X %08X %08X, sp:%u, dp:%u, len:%u]\n",
-            __func__, entry->cid, param->dir, entry->proto, entry->devid,
-            entry->saddr.in6.s6_addr32[0], entry->saddr.in6.s6_addr32[1],
-            entry->saddr.in6.s6_addr32[2], entry->saddr.in6.s6_addr32[3],
-            entry->daddr.in6.s6_addr32[0],entry->daddr.in6.s6_addr32[1],
-            entry->daddr.in6.s6_addr32[2],entry->daddr.in6.s6_addr32[3],
-            ntohs(entry->sport), ntohs(entry->dport), param->pkt_len);
+    iftraf_entry_account(entry, recv, sent);
+}
+
+/*
+ * sketches
+ */
+static int iftraf_sketch_alloc(struct iftraf_sketch *sk, uint32_t nbuckets,
+                               int socket)
+{
+    sk->buckets = rte_zmalloc_socket("iftraf_sk_bucket",
+                                     sizeof(struct iftraf_sk_bucket) * nbuckets,
+                                     RTE_CACHE_LINE_SIZE, socket);
+    sk->entries = rte_zmalloc_socket("iftraf_sk_entry",
+                                     sizeof(struct iftraf_sk_entry) * nbuckets
+                                     * IFTRAF_SK_WAYS,
+                                     RTE_CACHE_LINE_SIZE, socket);
+    if (!sk->buckets || !sk->entries) {
+        rte_free(sk->buckets);
+        rte_free(sk->entries);
+        sk->buckets = NULL;
+        sk->entries = NULL;
+        return EDPVS_NOMEM;
     }
+    sk->mask = nbuckets - 1;
 
-    /* Update record */
-    entry->last_write = history_pos;
-    if (param->dir == IFTRAF_PKT_DIR_IN) {
-        entry->recv[history_pos] += param->pkt_len;
-        entry->total_recv += param->pkt_len;
-        RTE_LOG(DEBUG, IFTRAF,
-        "%s: history_pos: %d, recv : %u, total_recv : %u\n", __func__, history_pos, entry->recv[history_pos], entry->total_recv);
+    return EDPVS_OK;
+}
 
-    } else {
-        entry->sent[history_pos] += param->pkt_len;
-        entry->total_sent += param->pkt_len;
+static void iftraf_sketch_free(struct iftraf_sketch *sk)
+{
+    rte_free(sk->buckets);
+    rte_free(sk->entries);
+    memset(sk, 0, sizeof(*sk));
+}
 
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: history_pos: %d: sent : %u, total_sent: %u\n", __func__, history_pos, entry->sent[history_pos], entry->total_sent);
+static void iftraf_sketch_clear(struct iftraf_sketch *sk)
+{
+    if (sk->buckets)
+        memset(sk->buckets, 0, sizeof(struct iftraf_sk_bucket) * (sk->mask + 1));
+}
+
+static inline void iftraf_sketch_update(struct iftraf_sketch *sk,
+                                        const struct iftraf_key *key,
+                                        uint32_t len, uint8_t dir)
+{
+    int i, victim = 0;
+    uint32_t hash, sig;
+    struct iftraf_sk_bucket *bucket;
+    struct iftraf_sk_entry *entry;
+
+    hash = iftraf_key_hash(key);
+    sig = hash | 0x1;
+    bucket = &sk->buckets[hash & sk->mask];
+    entry = &sk->entries[(hash & sk->mask) * IFTRAF_SK_WAYS];
+
+    for (i = 0; i < IFTRAF_SK_WAYS; i++) {
+        if (bucket->sig[i] == sig &&
+                !memcmp(&entry[i].key, key, sizeof(*key)))
+            goto hit;
+        if (bucket->count[i] < bucket->count[victim])
+            victim = i;
     }
+
+    /* take over the least counted way, whose count is kept as error */
+    i = victim;
+    bucket->sig[i] = sig;
+    entry[i].key = *key;
+    entry[i].recv = 0;
+    entry[i].sent = 0;
+
+hit:
+    bucket->count[i] += len;
+    if (dir == IFTRAF_PKT_DIR_IN)
+        entry[i].recv += len;
+    else
+        entry[i].sent += len;
 }
 
+typedef void (*iftraf_merge_cb_t)(lcoreid_t cid, const struct iftraf_key *key,
+                                  uint64_t recv, uint64_t sent);
 
-static void iftraf_process_ring(void *dummy)
+static void iftraf_sketch_merge(lcoreid_t cid, struct iftraf_sketch *sk,
+                                iftraf_merge_cb_t cb)
 {
+    uint32_t b;
     int i;
-    uint16_t nb_rb;
-    lcoreid_t cid;
-    struct iftraf_pkt *param;
-    struct iftraf_pkt *params[NETIF_MAX_PKT_BURST];
+    struct iftraf_sk_entry *entry;
 
-    if (likely(iftraf_disable)) {
+    if (!sk->buckets)
         return;
-    }
 
-    iftraf_ticket++;
-    if(iftraf_ticket % IFTRAF_TIME_INTERVAL == 0) {
-        history_rotate();
-        iftraf_ticket = 0;
+    for (b = 0; b <= sk->mask; b++) {
+        for (i = 0; i < IFTRAF_SK_WAYS; i++) {
+            if (!sk->buckets[b].sig[i])
+                continue;
+            entry = &sk->entries[b * IFTRAF_SK_WAYS + i];
+            if (entry->recv || entry->sent)
+                cb(cid, &entry->key, entry->recv, entry->sent);
+        }
     }
 
-    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
-        if (!rte_lcore_is_enabled(cid)) {
-            continue;
-        }
+    iftraf_sketch_clear(sk);
+}
 
-        nb_rb = rte_ring_dequeue_burst(iftraf_ring[cid], (void **)params,
-                    NETIF_MAX_PKT_BURST, NULL);
+static void iftraf_tick(void *dummy)
+{
+    uint64_t now;
+    uint32_t retired;
+    lcoreid_t cid;
 
-        if (nb_rb > 0) {
-            for (i = 0; i < nb_rb; i++) {
-                param = params[i];
+    if (likely(iftraf_disable)) {
+        return;
+    }
 
-                /* insert into iftraf table */
-                iftraf_tlb_add(param);
+    now = rte_get_timer_cycles();
+    if (now - iftraf_tick_stamp < iftraf_tick_cycles)
+        return;
+    iftraf_tick_stamp = now;
 
-                /* insert into iftraf table by if && source ip */
-                iftraf_iftlb_add(param);
-           }
-        }
+    history_rotate();
+
+    /* the set retired by the last tick, which no lcore is writing */
+    retired = (iftraf_epoch + 1) & 0x1;
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        iftraf_sketch_merge(cid, &iftraf_lcores[cid].flows[retired], iftraf_tlb_add);
+        iftraf_sketch_merge(cid, &iftraf_lcores[cid].hosts[retired], iftraf_iftlb_add);
     }
+
+    rte_wmb();
+    iftraf_epoch++;
 }
 
-static int iftraf_pkt_deliver(int af, struct rte_mbuf *mbuf, struct netif_port *dev, uint8_t dir)
+static int iftraf_pkt_account(int af, struct rte_mbuf *mbuf, struct netif_port *dev, uint8_t dir)
 {
-    int ret;
-    struct iftraf_pkt *pkt;
+    uint32_t epoch;
     __be16 _ports[2], *ports;
     lcoreid_t cid = rte_lcore_id();
-    portid_t devid;
+    struct iftraf_lcore *lc;
+    struct iftraf_key key;
+
+    if (unlikely(cid >= DPVS_MAX_LCORE))
+        return EDPVS_INVAL;
+    lc = &iftraf_lcores[cid];
+    epoch = iftraf_epoch & 0x1;
+    if (unlikely(!lc->flows[epoch].buckets))
+        return EDPVS_NOTEXIST;
+
+    memset(&key, 0, sizeof(key));
+    key.af = af;
 
     if (af == AF_INET) {
         struct rte_ipv4_hdr *ip4h = ip4_hdr(mbuf);
 
-        if (unlikely(ip4h->next_proto_id != IPPROTO_TCP &&
-            ip4h->next_proto_id != IPPROTO_UDP)) {
-            RTE_LOG(DEBUG, IFTRAF,
-                "%s: unspported proto[core: %d, proto: %d]\n",
-                __func__, cid, ip4h->next_proto_id);
+        key.proto = ip4h->next_proto_id;
+        if (unlikely(key.proto != IPPROTO_TCP && key.proto != IPPROTO_UDP))
             return EDPVS_NOPROT;
-        }
 
         ports = mbuf_header_pointer(mbuf, ip4_hdrlen(mbuf), sizeof(_ports), _ports);
-        if (!ports) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: invalid pkt[%d, %d]\n",
-                __func__, cid, dir);
+        if (!ports)
             return EDPVS_INVPKT;
-        }
-
-        pkt = rte_zmalloc("iftraf_inpkt", sizeof(struct iftraf_pkt), RTE_CACHE_LINE_SIZE);
-        if (pkt == NULL) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: no memory[%d, %d]\n",
-                __func__, cid, dir);
-            return EDPVS_NOMEM;
-        }
-
-        if (dev->type == PORT_TYPE_VLAN) {
-            struct vlan_dev_priv *vlan = netif_priv(dev);
-            struct netif_port *real_dev = vlan->real_dev;
-            RTE_LOG(DEBUG, IFTRAF, "%s: id = %u, ifname = %s, type=%d\n",
-                __func__, real_dev->id,real_dev->name,real_dev->type);
-            devid = real_dev->id;
-            strcpy(pkt->ifname, real_dev->name);
-        } else {
-            devid = mbuf->port;
-            strcpy(pkt->ifname, dev->name);
-        }
 
-        pkt->devid = devid;
-        pkt->af = AF_INET;
-        pkt->cid = cid;
-        pkt->dir = dir;
-        pkt->proto = ip4h->next_proto_id;
         if (dir == IFTRAF_PKT_DIR_IN) {
-            pkt->saddr.in.s_addr = ip4h->src_addr;
-            pkt->daddr.in.s_addr = ip4h->dst_addr;
-            pkt->src_port = ports[0];
-            pkt->dst_port = ports[1];
+            key.saddr.in.s_addr = ip4h->src_addr;
+            key.daddr.in.s_addr = ip4h->dst_addr;
         } else {
-            pkt->saddr.in.s_addr = ip4h->dst_addr;
-            pkt->daddr.in.s_addr = ip4h->src_addr;
-            pkt->src_port = ports[1];
-            pkt->dst_port = ports[0];
+            key.saddr.in.s_addr = ip4h->dst_addr;
+            key.daddr.in.s_addr = ip4h->src_addr;
         }
-
-        pkt->pkt_len = mbuf->pkt_len;
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s:[v4] enqueued to iftraf_ring[cid:%d, dir:%d, devid:%u, ifname:%s, proto:%u, src:%08X, dst:%08X, sp:%u, dp:%u, len:%u]\n",
-            __func__, cid, dir, pkt->devid, pkt->ifname, pkt->proto, ip4h->src_addr, ip4h->dst_addr, ntohs(pkt->src_port), ntohs(pkt->dst_port), pkt->pkt_len);
-
     } else if (af == AF_INET6) {
         struct ip6_hdr *ip6h = ip6_hdr(mbuf);
-        uint8_t ip6nxt = ip6h->ip6_nxt;
 
-        if (unlikely(ip6nxt != IPPROTO_TCP &&
-            ip6nxt != IPPROTO_UDP)) {
-            RTE_LOG(DEBUG, IFTRAF,
-                "%s: unspported proto[core: %d, proto: %d]\n",
-                __func__, cid, ip6nxt);
+        key.proto = ip6h->ip6_nxt;
+        if (unlikely(key.proto != IPPROTO_TCP && key.proto != IPPROTO_UDP))
             return EDPVS_NOPROT;
-        }
 
         ports = mbuf_header_pointer(mbuf, ip6_hdrlen(mbuf), sizeof(_ports), _ports);
-        if (!ports) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: invalid pkt[%d, %d]\n",
-                __func__, cid, dir);
+        if (!ports)
             return EDPVS_INVPKT;
-        }
 
-        pkt = rte_zmalloc("iftraf_inpkt", sizeof(struct iftraf_pkt), RTE_CACHE_LINE_SIZE);
-        if (pkt == NULL) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: no memory[%d, %d]\n",
-                __func__, cid, dir);
-            return EDPVS_NOMEM;
-        }
-
-        if (dev->type == PORT_TYPE_VLAN) {
-            struct vlan_dev_priv *vlan = netif_priv(dev);
-            struct netif_port *real_dev = vlan->real_dev;
-            RTE_LOG(DEBUG, IFTRAF, "%s: id = %u, ifname = %s, type=%d\n",
-                __func__, real_dev->id,real_dev->name,real_dev->type);
-            devid = real_dev->id;
-            strcpy(pkt->ifname, real_dev->name);
-        } else {
-            devid = mbuf->port;
-            strcpy(pkt->ifname, dev->name);
-        }
-
-        pkt->af = AF_INET6;
-        pkt->devid = devid;
-        pkt->cid = cid;
-        pkt->dir = dir;
-        pkt->proto = ip6nxt;
         if (dir == IFTRAF_PKT_DIR_IN) {
-            pkt->saddr.in6 = ip6h->ip6_src;
-            pkt->daddr.in6 = ip6h->ip6_dst;
-            pkt->src_port = ports[0];
-            pkt->dst_port = ports[1];
+            key.saddr.in6 = ip6h->ip6_src;
+            key.daddr.in6 = ip6h->ip6_dst;
         } else {
-            pkt->saddr.in6 = ip6h->ip6_dst;
-            pkt->daddr.in6 = ip6h->ip6_src;
-            pkt->src_port = ports[1];
-            pkt->dst_port = ports[0];
+            key.saddr.in6 = ip6h->ip6_dst;
+            key.daddr.in6 = ip6h->ip6_src;
         }
-        pkt->pkt_len = mbuf->pkt_len;
-
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s:[v6] enqueued to iftraf_ring[cid:%d, dir:%d, devid:%u,  proto:%u, src:%08X %08X %08X %08X, dst:%08X %08X %08X %08X, sp:%u, dp:%u, len:%u]\n",
-            __func__, cid, dir, pkt->devid, pkt->proto,
-            pkt->saddr.in6.s6_addr32[0], pkt->saddr.in6.s6_addr32[1],
-            pkt->saddr.in6.s6_addr32[2], pkt->saddr.in6.s6_addr32[3],
-            pkt->daddr.in6.s6_addr32[0],pkt->daddr.in6.s6_addr32[1],
-            pkt->daddr.in6.s6_addr32[2],pkt->daddr.in6.s6_addr32[3],
-            ntohs(pkt->src_port), ntohs(pkt->dst_port), pkt->pkt_len);
     } else {
         return EDPVS_INVPKT;
     }
 
-    ret = rte_ring_enqueue(iftraf_ring[cid], pkt);
-    if (ret < 0) {
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: failed to enqueue iftraf_ring[%d]\n",
-            __func__, cid);
-        rte_free(pkt);
-        return EDPVS_DROP;
+    if (dir == IFTRAF_PKT_DIR_IN) {
+        key.sport = ports[0];
+        key.dport = ports[1];
+    } else {
+        key.sport = ports[1];
+        key.dport = ports[0];
+    }
+
+    if (dev->type == PORT_TYPE_VLAN) {
+        struct vlan_dev_priv *vlan = netif_priv(dev);
+        key.devid = vlan->real_dev->id;
+    } else {
+        key.devid = dev->id;
     }
 
+    iftraf_sketch_update(&lc->flows[epoch], &key, mbuf->pkt_len, dir);
+
+    /* by port and peer address */
+    memset(&key.daddr, 0, sizeof(key.daddr));
+    key.sport = 0;
+    key.dport = 0;
+    key.proto = 0;
+    iftraf_sketch_update(&lc->hosts[epoch], &key, mbuf->pkt_len, dir);
+
     return EDPVS_OK;
 }
 
@@ -823,10 +797,7 @@ int iftraf_pkt_in(int af, struct rte_mbuf *mbuf, struct netif_port *dev)
         return EDPVS_OK;
     }
 
-    this_inpkts_count++;
-    if (this_inpkts_count % IFTRAF_INTERVAL == 0) {
-        iftraf_pkt_deliver(af, mbuf, dev, IFTRAF_PKT_DIR_IN);
-    }
+    iftraf_pkt_account(af, mbuf, dev, IFTRAF_PKT_DIR_IN);
 
     return EDPVS_OK;
 }
@@ -837,55 +808,61 @@ int iftraf_pkt_out(int af, struct rte_mbuf *mbuf, struct netif_port *dev)
         return EDPVS_OK;
     }
 
-    this_outpkts_count++;
-    if (this_outpkts_count % IFTRAF_INTERVAL == 0) {
-        iftraf_pkt_deliver(af, mbuf, dev, IFTRAF_PKT_DIR_OUT);
-    }
+    iftraf_pkt_account(af, mbuf, dev, IFTRAF_PKT_DIR_OUT);
 
     return EDPVS_OK;
 }
 
-
 /*
- * master core allocates iftraf rings with the other lcores espectively.
+ * sketches are allocated on first enable and kept until term, an lcore may
+ * still be updating one right after iftraf is disabled.
  */
-static int iftraf_ring_create(void)
+static int iftraf_sketches_alloc(void)
 {
-    char name_buf[RTE_RING_NAMESIZE];
-    int socket_id;
-    lcoreid_t cid, ccid;
-
-    socket_id = rte_socket_id();
+    int i, err, socket;
+    lcoreid_t cid;
+    struct iftraf_lcore *lc;
 
     for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
-        if (!rte_lcore_is_enabled(cid)) {
+        if (!rte_lcore_is_enabled(cid))
+            continue;
+        lc = &iftraf_lcores[cid];
+        if (lc->flows[0].buckets)
             continue;
+
+        socket = rte_lcore_to_socket_id(cid);
+        for (i = 0; i < 2; i++) {
+            err = iftraf_sketch_alloc(&lc->flows[i], IFTRAF_SK_FLOW_BUCKETS, socket);
+            if (err != EDPVS_OK)
+                goto errout;
+            err = iftraf_sketch_alloc(&lc->hosts[i], IFTRAF_SK_HOST_BUCKETS, socket);
+            if (err != EDPVS_OK)
+                goto errout;
         }
+    }
 
-        snprintf(name_buf, RTE_RING_NAMESIZE,
-            "iftraf_ring[%d]", cid);
+    return EDPVS_OK;
 
-        iftraf_ring[cid] =
-            rte_ring_create(name_buf, IFTRAF_RING_SIZE, socket_id,
-                            RING_F_SP_ENQ | RING_F_SC_DEQ);
+errout:
+    RTE_LOG(ERR, IFTRAF, "%s: no memory for sketches of lcore %d\n", __func__, cid);
+    for (i = 0; i < 2; i++) {
+        iftraf_sketch_free(&lc->flows[i]);
+        iftraf_sketch_free(&lc->hosts[i]);
+    }
+    return err;
+}
 
-        if (!iftraf_ring[cid]) {
-            RTE_LOG(ERR, IFTRAF,
-                "%s: failed to create iftraf_ring[%d]\n",
-                 __func__, cid);
-            for (ccid = 0; ccid < cid; ccid++) {
-                if (iftraf_ring[ccid])
-                    rte_ring_free(iftraf_ring[ccid]);
-            }
-            return EDPVS_NOMEM;
-        }
+static void iftraf_sketches_free(void)
+{
+    int i;
+    lcoreid_t cid;
 
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: success to create iftraf_ring[%d]\n",
-            __func__, cid);
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        for (i = 0; i < 2; i++) {
+            iftraf_sketch_free(&iftraf_lcores[cid].flows[i]);
+            iftraf_sketch_free(&iftraf_lcores[cid].hosts[i]);
+        }
     }
-
-    return EDPVS_OK;
 }
 
 static int iftraf_enable_func(void)
@@ -898,11 +875,18 @@ static int iftraf_enable_func(void)
         return EDPVS_OK;
     }
 
-    err = iftraf_ring_create();
+    err = iftraf_sketches_alloc();
     if (err != EDPVS_OK) {
         return err;
     }
 
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        for (i = 0; i < 2; i++) {
+            iftraf_sketch_clear(&iftraf_lcores[cid].flows[i]);
+            iftraf_sketch_clear(&iftraf_lcores[cid].hosts[i]);
+        }
+    }
+
     iftraf_tbl = rte_malloc(NULL, sizeof(struct list_head) * IFTRAF_TBL_SIZE,
                     RTE_CACHE_LINE_SIZE);
 
@@ -910,7 +894,7 @@ static int iftraf_enable_func(void)
         RTE_LOG(ERR, IFTRAF,
             "%s: rte_malloc null\n",
             __func__);
-        goto tbl_fail;
+        return EDPVS_NOMEM;
     }
 
     for (i = 0; i < IFTRAF_TBL_SIZE; i++)
@@ -923,68 +907,31 @@ static int iftraf_enable_func(void)
         RTE_LOG(ERR, IFTRAF,
             "%s: rte_malloc null\n",
             __func__);
-        goto iftbl_fail;
+        rte_free(iftraf_tbl);
+        iftraf_tbl = NULL;
+        return EDPVS_NOMEM;
     }
 
     for (i = 0; i < IFTRAF_IFTBL_SIZE; i++)
         INIT_LIST_HEAD(&iftraf_iftbl[i]);
 
+    iftraf_tick_stamp = rte_get_timer_cycles();
+    rte_wmb();
     iftraf_disable = false;
     RTE_LOG(INFO, IFTRAF,
         "%s: %s\n", __func__, "iftraf enabled");
 
     return EDPVS_OK;
-
-iftbl_fail:
-    if (iftraf_tbl)
-        rte_free(iftraf_tbl);
-
-tbl_fail:
-    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
-        if (!rte_lcore_is_enabled(cid)) {
-            continue;
-        }
-        if (iftraf_ring[cid])
-            rte_ring_free(iftraf_ring[cid]);
-        }
-
-    return EDPVS_NOMEM;
 }
 
 static void iftraf_variable_reset(void)
 {
     history_pos = 0;
-    this_inpkts_count = 0;
-    this_outpkts_count = 0;
 }
 
-static void iftraf_ring_free(void)
-{
-    lcoreid_t cid;
-
-    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
-        if (!rte_lcore_is_enabled(cid)) {
-             continue;
-        }
-        if (iftraf_ring[cid]) {
-            rte_ring_free(iftraf_ring[cid]);
-        }
-
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: iftraf_ring free[%d]\n",
-            __func__, cid);
-    }
-}
-
-
 static int iftraf_disable_func(void)
 {
     uint32_t hash;
-    int i;
-    uint16_t nb_rb;
-    lcoreid_t cid;
-    struct iftraf_pkt *param;
-    struct iftraf_pkt *params[NETIF_MAX_PKT_BURST];
     struct iftraf_entry *entry, *nxt;
     int count = 0;
 
@@ -994,37 +941,6 @@ static int iftraf_disable_func(void)
 
     iftraf_disable = true;
 
-    /* dequeue iftraf ring and free elements */
-    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
-        if (!rte_lcore_is_enabled(cid)) {
-            continue;
-        }
-
-        nb_rb = rte_ring_dequeue_burst(iftraf_ring[cid], (void **)params,
-                    NETIF_MAX_PKT_BURST, NULL);
-
-        while (nb_rb > 0) {
-            count += nb_rb;
-            for (i = 0; i < nb_rb; i++) {
-                param = params[i];
-                rte_free(param);
-            }
-
-            nb_rb = rte_ring_dequeue_burst(iftraf_ring[cid], (void **)params,
-                        NETIF_MAX_PKT_BURST, NULL);
-        }
-
-        RTE_LOG(DEBUG, IFTRAF,
-            "%s: iftraf ring[%d] free [%d] pkts\n",
-            __func__, cid, count);
-
-        count = 0;
-
-    }
-
-    /* free iftraf ring */
-    iftraf_ring_free();
-
     /* free tlb */
     if (iftraf_tbl) {
         count = 0;
@@ -1042,6 +958,7 @@ static int iftraf_disable_func(void)
             __func__, count);
 
         rte_free(iftraf_tbl);
+        iftraf_tbl = NULL;
     }
 
     /* free tlb */
@@ -1061,6 +978,7 @@ static int iftraf_disable_func(void)
             __func__, count);
 
         rte_free(iftraf_iftbl);
+        iftraf_iftbl = NULL;
     }
 
     iftraf_variable_reset();
@@ -1104,9 +1022,9 @@ static struct dpvs_sockopts iftraf_sockopts = {
 };
 
 static struct dpvs_lcore_job iftraf_job = {
-    .name = "iftraf_ring_proc",
+    .name = "iftraf_tick",
     .type = LCORE_JOB_LOOP,
-    .func = iftraf_process_ring,
+    .func = iftraf_tick,
 };
 
 int iftraf_init(void)
@@ -1116,6 +1034,7 @@ int iftraf_init(void)
     iftraf_disable = true;
 
     iftraf_tlb_rnd = (uint32_t)random();
+    iftraf_tick_cycles = rte_get_timer_hz() * IFTRAF_TICK_MS / 1000;
 
     iftraf_sorted_list_init();
 
@@ -1143,6 +1062,7 @@ int iftraf_term(void)
         return err;
 
     dpvs_lcore_job_unregister(&iftraf_job, LCORE_ROLE_MASTER);
+    iftraf_sketches_free();
 
     return EDPVS_OK;
 }
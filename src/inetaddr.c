@@ -27,6 +27,7 @@
 #include "route6.h"
 #include "inetaddr.h"
 #include "conf/inetaddr.h"
+#include "ipvs/conn_persist.h"
 
 #define IFA
 #define RTE_LOGTYPE_IFA         RTE_LOGTYPE_USER1
@@ -445,6 +446,25 @@ struct netif_port *inet_addr_get_iface(int af, union inet_addr *addr)
     return NULL;
 }
 
+struct inet_ifaddr *inet_addr_ifa_peek(int af, const struct netif_port *dev,
+                                       const union inet_addr *addr)
+{
+    lcoreid_t cid;
+    uint32_t hash;
+    struct inet_ifaddr *ifa;
+
+    cid = rte_lcore_id();
+    hash = ifa_hash_key(af, addr);
+
+    list_for_each_entry(ifa, &inet_addr_tab[cid][hash], h_list) {
+        if (ifa->af == af && inet_addr_equal(af, &ifa->addr, addr)
+                && (!dev || ifa->idev->dev == dev))
+            return ifa;
+    }
+
+    return NULL;
+}
+
 struct inet_ifaddr *inet_addr_ifa_get(int af, const struct netif_port *dev,
                                       union inet_addr *addr)
 {
@@ -810,6 +830,10 @@ static int ifa_entry_add(const struct ifaddr_action *param)
         ifa_hash(idev, ifa);
         ifa_put(ifa);
 
+        /* as for a new ifa, the lports held already are skipped */
+        if (ifa->sa_pool)
+            dp_vs_conn_persist_reserve(ifa);
+
         RTE_LOG(DEBUG, IFA, "[%02d] %s: reuse expired ifaddr %s\n", rte_lcore_id(), __func__,
                 inet_ntop(ifa->af, &ifa->addr, ipstr, sizeof(ipstr)));
 
@@ -873,6 +897,10 @@ static int ifa_entry_add(const struct ifaddr_action *param)
 
     ifa_hash(idev, ifa);
 
+    /* before any new conn can take the lports of conns to be restored */
+    if (ifa->sa_pool)
+        dp_vs_conn_persist_reserve(ifa);
+
     RTE_LOG(DEBUG, IFA, "[%02d] %s: add ifaddr %s\n", rte_lcore_id(), __func__,
             inet_ntop(ifa->af, &ifa->addr, ipstr, sizeof(ipstr)));
 
@@ -21,188 +21,422 @@
 #include <libgen.h>
 #include <errno.h>
 #include <glob.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
 #include "ipset.h"
 #include "conf/ipset.h"
 #include "ctrl.h"
 #include "conf/common.h"
 #include "parser/parser.h"
 
-#define IPSET_TAB_SIZE (1<<8)
-#define IPSET_TAB_MASK (IPSET_TAB_SIZE - 1)
+#define IPSET_TAB_BITS  16
+#define IPSET_TAB_SIZE  (1 << IPSET_TAB_BITS)
+#define IPSET_TAB_MASK  (IPSET_TAB_SIZE - 1)
 
-#define this_ipset_lcore        (RTE_PER_LCORE(ipset_lcore))
-#define this_ipset_table_lcore  (this_ipset_lcore.ipset_table)
-#define this_num_ipset          (RTE_PER_LCORE(num_ipset))
+#define IPSET_LPM_MAX_RULES_DEF     (1 << 20)
+#define IPSET_LPM_NUM_TBL8S_DEF     (1 << 14)
+#define IPSET_LPM6_MAX_RULES_DEF    (1 << 14)
+#define IPSET_LPM6_NUM_TBL8S_DEF    0       /* IPSET_LPM6_TBL8S_PER_RULE each */
 
-struct ipset_lcore{
-	struct list_head ipset_table[IPSET_TAB_SIZE];
-};
+/* a /48../64 prefix takes 3..5 tbl8 groups, most of them shared */
+#define IPSET_LPM6_TBL8S_PER_RULE   2
 
-static RTE_DEFINE_PER_LCORE(struct ipset_lcore, ipset_lcore);
-static RTE_DEFINE_PER_LCORE(uint32_t, num_ipset);
+/*
+ * The set is shared by all lcores and looked up without locks. Members
+ * are kept as prefixes in an rte_lpm (IPv4) or rte_lpm6 (IPv6) FIB, whose
+ * next hop is merely a "hit" mark.
+ *
+ * There are two FIBs, readers only use the active one. The master applies
+ * an update batch to the standby FIB, publishes it as active, waits until
+ * every slave lcore has passed its msg loop (i.e. no packet of theirs may
+ * still be looking at the old FIB), then replays the batch to the old one.
+ * The LPMs are created on the first member of their family.
+ *
+ * The member hash table exists on master only, it's for config and dump.
+ */
+struct ipset_fib {
+    struct rte_lpm      *lpm;
+    struct rte_lpm6     *lpm6;
+};
 
-static inline unsigned int ipset_addr_hash(int af, union inet_addr *addr)
-{
-    uint32_t addr_fold;
+static struct ipset_fib ipset_fibs[2];
+static struct ipset_fib * volatile ipset_active = &ipset_fibs[0];
+/* the standby FIB may still be in use or missed updates, see ipset_sync() */
+static bool ipset_stale = false;
 
-    addr_fold = inet_addr_fold(af, addr);
+static struct list_head *ipset_table;
+static uint32_t num_ipset;
 
-    if (!addr_fold) {
-        RTE_LOG(DEBUG, IPSET, "%s: IP proto not support.\n", __func__);
-        return 0;
-    }
+static uint32_t ipset_lpm_max_rules = IPSET_LPM_MAX_RULES_DEF;
+static uint32_t ipset_lpm_num_tbl8s = IPSET_LPM_NUM_TBL8S_DEF;
+static uint32_t ipset_lpm6_max_rules = IPSET_LPM6_MAX_RULES_DEF;
+static uint32_t ipset_lpm6_num_tbl8s = IPSET_LPM6_NUM_TBL8S_DEF;
 
-    return rte_be_to_cpu_32(addr_fold)&IPSET_TAB_MASK;
+static inline struct ipset_fib *ipset_standby(void)
+{
+    return ipset_active == &ipset_fibs[0] ? &ipset_fibs[1] : &ipset_fibs[0];
 }
 
-
-static struct ipset_entry *ipset_new_entry(int af, union inet_addr *dest)
+static inline unsigned int ipset_addr_hash(int af, const union inet_addr *addr,
+                                           uint8_t plen)
 {
-    struct ipset_entry *new_ipset=NULL;
-    if(!dest)
-        return NULL;
-    new_ipset = rte_zmalloc("new_ipset_entry", sizeof(struct ipset_entry), 0);
-    if (new_ipset == NULL){
-        return NULL;
-    }
-    new_ipset->daddr.af = af;
-    memcpy(&new_ipset->daddr.addr, dest, sizeof(union inet_addr));
-    return new_ipset;
+    return rte_jhash_1word(inet_addr_fold(af, addr), plen) & IPSET_TAB_MASK;
 }
 
-
-int ipset_add(int af, union inet_addr *dest)
+/* check prefix length and clear host bits, plen 0 means a host address */
+static int ipset_conf_normalize(struct dp_vs_ipset_conf *cf)
 {
-    unsigned int hashkey;
-    struct ipset_entry *ipset_node, *ipset_new;
+    uint8_t maxlen;
+    union inet_addr mask;
 
-    hashkey = ipset_addr_hash(af, dest);
+    if (cf->af == AF_INET)
+        maxlen = 32;
+    else if (cf->af == AF_INET6)
+        maxlen = 128;
+    else
+        return EDPVS_NOTSUPP;
 
-    list_for_each_entry(ipset_node, &this_ipset_table_lcore[hashkey], list){
-        if (ipset_node->daddr.af == af && inet_addr_equal(af, &ipset_node->daddr.addr, dest)) {
-            return EDPVS_EXIST;
-        }
-    }
+    if (cf->plen == 0)
+        cf->plen = maxlen;
+    if (cf->plen > maxlen)
+        return EDPVS_INVAL;
 
-    ipset_new = ipset_new_entry(af, dest);
-    if (!ipset_new){
-        return EDPVS_NOMEM;
-    }
+    inet_plen_to_mask(cf->af, cf->plen, &mask);
+    inet_addr_net(cf->af, &cf->addr, &mask, &cf->addr);
 
-    list_add(&ipset_new->list, &this_ipset_table_lcore[hashkey]);
-    this_num_ipset++;
     return EDPVS_OK;
 }
 
-struct ipset_entry *ipset_addr_lookup(int af, union inet_addr *dest)
+static struct ipset_entry *ipset_entry_get(const struct dp_vs_ipset_conf *cf)
 {
-    unsigned int hashkey;
     struct ipset_entry *ipset_node;
+    unsigned int hashkey = ipset_addr_hash(cf->af, &cf->addr, cf->plen);
 
-    hashkey = ipset_addr_hash(af, dest);
-    list_for_each_entry(ipset_node, &this_ipset_table_lcore[hashkey], list){
-        if (ipset_node->daddr.af == af && inet_addr_equal(af, &ipset_node->daddr.addr, dest)) {
+    list_for_each_entry(ipset_node, &ipset_table[hashkey], list) {
+        if (ipset_node->daddr.af == cf->af && ipset_node->plen == cf->plen
+                && inet_addr_equal(cf->af, &ipset_node->daddr.addr, &cf->addr))
             return ipset_node;
-        }
     }
+
     return NULL;
 }
 
+static int ipset_member_add(const struct dp_vs_ipset_conf *cf)
+{
+    struct ipset_entry *ipset_new;
+
+    if (ipset_entry_get(cf))
+        return EDPVS_EXIST;
+
+    ipset_new = rte_zmalloc("new_ipset_entry", sizeof(struct ipset_entry), 0);
+    if (!ipset_new)
+        return EDPVS_NOMEM;
+    ipset_new->daddr.af = cf->af;
+    ipset_new->daddr.addr = cf->addr;
+    ipset_new->plen = cf->plen;
+
+    list_add(&ipset_new->list,
+             &ipset_table[ipset_addr_hash(cf->af, &cf->addr, cf->plen)]);
+    num_ipset++;
+    return EDPVS_OK;
+}
 
-int ipset_del(int af, union inet_addr *dest)
+static int ipset_member_del(const struct dp_vs_ipset_conf *cf)
 {
     struct ipset_entry *ipset_node;
 
-    ipset_node = ipset_addr_lookup(af, dest);
+    ipset_node = ipset_entry_get(cf);
     if (!ipset_node)
         return EDPVS_NOTEXIST;
+
     list_del(&ipset_node->list);
     rte_free(ipset_node);
-    this_num_ipset--;
+    num_ipset--;
     return EDPVS_OK;
 }
 
-static int ipset_add_del(bool add, struct dp_vs_multi_ipset_conf *cf)
+static int ipset_fib_create(int af)
+{
+    int i;
+    char name[32];
+    struct rte_lpm_config config = {
+        .max_rules      = ipset_lpm_max_rules,
+        .number_tbl8s   = ipset_lpm_num_tbl8s,
+        .flags          = 0,
+    };
+    struct rte_lpm6_config config6 = {
+        .max_rules      = ipset_lpm6_max_rules,
+        .number_tbl8s   = ipset_lpm6_num_tbl8s ? :
+                          ipset_lpm6_max_rules * IPSET_LPM6_TBL8S_PER_RULE,
+        .flags          = 0,
+    };
+
+    for (i = 0; i < NELEMS(ipset_fibs); i++) {
+        if (af == AF_INET && !ipset_fibs[i].lpm) {
+            snprintf(name, sizeof(name), "ipset_lpm%d", i);
+            ipset_fibs[i].lpm = rte_lpm_create(name, rte_socket_id(), &config);
+            if (!ipset_fibs[i].lpm)
+                goto errout;
+        } else if (af == AF_INET6 && !ipset_fibs[i].lpm6) {
+            snprintf(name, sizeof(name), "ipset_lpm6_%d", i);
+            ipset_fibs[i].lpm6 = rte_lpm6_create(name, rte_socket_id(), &config6);
+            if (!ipset_fibs[i].lpm6)
+                goto errout;
+        }
+    }
+
+    return EDPVS_OK;
+
+errout:
+    RTE_LOG(ERR, IPSET, "%s: fail to create %s -- %s\n",
+            __func__, name, rte_strerror(rte_errno));
+    return EDPVS_DPDKAPIFAIL;
+}
+
+static int ipset_fib_update(struct ipset_fib *fib, bool add,
+                            const struct dp_vs_ipset_conf *cf)
 {
-	lcoreid_t cid = rte_lcore_id();
-	struct dpvs_msg *msg;
-        struct dp_vs_ipset_conf *ip_cf;
-	int err = 0;
-	int i, multi_ipset_msg_size;
+    int ret;
 
-    for (i = 0; i < cf->num; i++) {
-        ip_cf = &cf->ipset_conf[i];
-        if (ip_cf->af != AF_INET && ip_cf->af != AF_INET6)
-            continue;
+    if (cf->af == AF_INET) {
         if (add)
-            err = ipset_add(ip_cf->af, &ip_cf->addr);
+            ret = rte_lpm_add(fib->lpm, rte_be_to_cpu_32(cf->addr.in.s_addr),
+                              cf->plen, 1);
         else
-            err = ipset_del(ip_cf->af, &ip_cf->addr);
+            ret = rte_lpm_delete(fib->lpm, rte_be_to_cpu_32(cf->addr.in.s_addr),
+                                 cf->plen);
+    } else {
+        if (add)
+            ret = rte_lpm6_add(fib->lpm6, cf->addr.in6.s6_addr, cf->plen, 1);
+        else
+            ret = rte_lpm6_delete(fib->lpm6, cf->addr.in6.s6_addr, cf->plen);
     }
 
-    if (err != EDPVS_OK) {
-        return err;
-    }
+    if (ret < 0)
+        return add ? EDPVS_NOROOM : EDPVS_NOTEXIST;
+    return EDPVS_OK;
+}
 
-    multi_ipset_msg_size = sizeof(struct dp_vs_multi_ipset_conf)
-                                + cf->num*sizeof(struct dp_vs_ipset_conf);
-    if (add)
-        msg = msg_make(MSG_TYPE_IPSET_ADD, 0, DPVS_MSG_MULTICAST,
-                           cid, multi_ipset_msg_size, cf);
-    else
-        msg = msg_make(MSG_TYPE_IPSET_DEL, 0, DPVS_MSG_MULTICAST,
-                           cid, multi_ipset_msg_size, cf);
+static void ipset_fib_clear(struct ipset_fib *fib)
+{
+    if (fib->lpm)
+        rte_lpm_delete_all(fib->lpm);
+    if (fib->lpm6)
+        rte_lpm6_delete_all(fib->lpm6);
+}
 
-    err = multicast_msg_send(msg, 0/*DPVS_MSG_F_ASYNC*/, NULL);
-    if (err != EDPVS_OK) {
-        msg_destroy(&msg);
-        return err;
+static int ipset_fib_rebuild(struct ipset_fib *fib)
+{
+    int i, err;
+    struct ipset_entry *ipset_node;
+    struct dp_vs_ipset_conf cf;
+
+    ipset_fib_clear(fib);
+
+    for (i = 0; i < IPSET_TAB_SIZE; i++) {
+        list_for_each_entry(ipset_node, &ipset_table[i], list) {
+            cf.af = ipset_node->daddr.af;
+            cf.addr = ipset_node->daddr.addr;
+            cf.plen = ipset_node->plen;
+            err = ipset_fib_update(fib, true, &cf);
+            if (err != EDPVS_OK)
+                return err;
+        }
     }
 
+    return EDPVS_OK;
+}
+
+/*
+ * wait for all slaves to process a message, after that none of them can
+ * reference a FIB which was not active before the call.
+ */
+static int ipset_sync(void)
+{
+    int err;
+    struct dpvs_msg *msg;
+
+    msg = msg_make(MSG_TYPE_IPSET_SYNC, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), 0, NULL);
+    if (!msg)
+        return EDPVS_NOMEM;
+
+    err = multicast_msg_send(msg, 0, NULL);
     msg_destroy(&msg);
+
+    return err;
+}
+
+/* make the standby FIB writable and up-to-date with the members */
+static int ipset_standby_prepare(void)
+{
+    int err;
+
+    if (likely(!ipset_stale))
+        return EDPVS_OK;
+
+    err = ipset_sync();
+    if (err != EDPVS_OK)
+        return err;
+
+    err = ipset_fib_rebuild(ipset_standby());
+    if (err != EDPVS_OK)
+        return err;
+
+    ipset_stale = false;
     return EDPVS_OK;
 }
 
+static void ipset_publish(struct ipset_fib *fib)
+{
+    rte_wmb();
+    ipset_active = fib;
+
+    if (ipset_sync() != EDPVS_OK) {
+        RTE_LOG(WARNING, IPSET, "%s: slaves not synchronized, "
+                "defer update of the standby set\n", __func__);
+        ipset_stale = true;
+    }
+}
 
-static int ipset_flush_lcore(void *arg)
+static int ipset_add_del(bool add, struct dp_vs_multi_ipset_conf *cf)
 {
-    struct ipset_entry *ipset_node, *next;
-    int i;
-    if (!rte_lcore_is_enabled(rte_lcore_id()))
-        return EDPVS_DISABLED;
+    int i, err = EDPVS_OK, ret;
+    int napplied = 0;
+    uint8_t *applied;
+    struct dp_vs_ipset_conf *ip_cf;
+    struct ipset_fib *standby, *active;
 
-    for (i = 0; i < IPSET_TAB_SIZE; i++) {
-        list_for_each_entry_safe(ipset_node, next, &this_ipset_table_lcore[i], list){
-            if (ipset_node) {
-                list_del(&ipset_node->list);
-                rte_free(ipset_node);
-                this_num_ipset--;
+    if (rte_lcore_id() != rte_get_main_lcore())
+        return EDPVS_NOTSUPP;
+
+    if ((ret = ipset_standby_prepare()) != EDPVS_OK)
+        return ret;
+
+    applied = rte_zmalloc(NULL, cf->num, 0);
+    if (!applied)
+        return EDPVS_NOMEM;
+
+    standby = ipset_standby();
+    for (i = 0; i < cf->num; i++) {
+        ip_cf = &cf->ipset_conf[i];
+        if (ipset_conf_normalize(ip_cf) != EDPVS_OK)
+            continue;
+
+        if (add) {
+            ret = ipset_member_add(ip_cf);
+            if (ret == EDPVS_OK)
+                ret = ipset_fib_create(ip_cf->af);
+            if (ret == EDPVS_OK) {
+                ret = ipset_fib_update(standby, true, ip_cf);
+                if (ret != EDPVS_OK)
+                    ipset_member_del(ip_cf);
+            } else if (ret != EDPVS_EXIST) {
+                ipset_member_del(ip_cf);
             }
+        } else {
+            ret = ipset_member_del(ip_cf);
+            if (ret == EDPVS_OK)
+                ipset_fib_update(standby, false, ip_cf);
+        }
+
+        if (ret == EDPVS_OK) {
+            applied[i] = 1;
+            napplied++;
+        } else {
+            err = ret;
         }
     }
-    return 0;
+
+    if (napplied) {
+        active = ipset_active;
+        ipset_publish(standby);
+
+        /* the old one is the standby now, bring it up to date */
+        for (i = 0; !ipset_stale && i < cf->num; i++) {
+            if (applied[i]
+                    && ipset_fib_update(active, add, &cf->ipset_conf[i]) != EDPVS_OK)
+                ipset_stale = true;
+        }
+    }
+
+    rte_free(applied);
+
+    if (err != EDPVS_OK)
+        RTE_LOG(DEBUG, IPSET, "%s: %d of %d members %s -- %s\n", __func__,
+                napplied, cf->num, add ? "added" : "deleted", dpvs_strerror(err));
+    return err;
 }
 
 static int ipset_flush(void)
 {
-    lcoreid_t cid = rte_lcore_id();
-    struct dpvs_msg *msg;
-    int err = 0;
+    int i;
+    struct ipset_entry *ipset_node, *next;
+    struct ipset_fib *active;
 
-    ipset_flush_lcore(NULL);
-    msg = msg_make(MSG_TYPE_IPSET_FLUSH, 0, DPVS_MSG_MULTICAST,
-                   cid, 0, NULL);
+    if (ipset_stale && ipset_sync() != EDPVS_OK)
+        return EDPVS_BUSY;
 
-    err = multicast_msg_send(msg, 0/*DPVS_MSG_F_ASYNC*/, NULL);
-    if (err != EDPVS_OK) {
-        msg_destroy(&msg);
-        return err;
+    for (i = 0; i < IPSET_TAB_SIZE; i++) {
+        list_for_each_entry_safe(ipset_node, next, &ipset_table[i], list) {
+            list_del(&ipset_node->list);
+            rte_free(ipset_node);
+        }
     }
-    msg_destroy(&msg);
+    num_ipset = 0;
+
+    active = ipset_active;
+    ipset_fib_clear(ipset_standby());
+    ipset_stale = false;
+    ipset_publish(ipset_standby());
+    if (!ipset_stale)
+        ipset_fib_clear(active);
 
     return EDPVS_OK;
 }
 
+bool ipset_addr_lookup(int af, const union inet_addr *dest)
+{
+    uint32_t next_hop;
+    const struct ipset_fib *fib = ipset_active;
+
+    if (af == AF_INET)
+        return fib->lpm && rte_lpm_lookup(fib->lpm,
+                rte_be_to_cpu_32(dest->in.s_addr), &next_hop) == 0;
+
+    if (af == AF_INET6)
+        return fib->lpm6 && rte_lpm6_lookup(fib->lpm6,
+                dest->in6.s6_addr, &next_hop) == 0;
+
+    return false;
+}
+
+int ipset_add(int af, union inet_addr *dest, uint8_t plen)
+{
+    struct {
+        struct dp_vs_multi_ipset_conf   cf;
+        struct dp_vs_ipset_conf         ip;
+    } conf = {
+        .cf.num = 1,
+        .ip = { .af = af, .addr = *dest, .plen = plen },
+    };
+
+    return ipset_add_del(true, &conf.cf);
+}
+
+int ipset_del(int af, union inet_addr *dest, uint8_t plen)
+{
+    struct {
+        struct dp_vs_multi_ipset_conf   cf;
+        struct dp_vs_ipset_conf         ip;
+    } conf = {
+        .cf.num = 1,
+        .ip = { .af = af, .addr = *dest, .plen = plen },
+    };
+
+    return ipset_add_del(false, &conf.cf);
+}
+
 static int ipset_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
 {
     struct dp_vs_multi_ipset_conf *cf = (void *)conf;
@@ -213,6 +447,9 @@ static int ipset_sockopt_set(sockoptid_t opt, const void *conf, size_t size)
 
     if (!conf || size < sizeof(struct dp_vs_multi_ipset_conf) + sizeof(struct dp_vs_ipset_conf))
         return EDPVS_INVAL;
+    if (cf->num <= 0 || size < sizeof(struct dp_vs_multi_ipset_conf)
+                             + cf->num * sizeof(struct dp_vs_ipset_conf))
+        return EDPVS_INVAL;
 
     switch (opt) {
         case SOCKOPT_SET_IPSET_ADD:
@@ -237,7 +474,7 @@ static int ipset_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
     int i;
     int off = 0;
 
-    nips = this_num_ipset;
+    nips = num_ipset;
     *outsize = sizeof(struct dp_vs_ipset_conf_array) + \
                    nips * sizeof(struct dp_vs_ipset_conf);
     *out = rte_calloc(NULL, 1, *outsize, 0);
@@ -246,11 +483,12 @@ static int ipset_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
     array = *out;
 
     for (i = 0; i < IPSET_TAB_SIZE; i++) {
-        list_for_each_entry(ipset_node, &this_ipset_table_lcore[i], list) {
+        list_for_each_entry(ipset_node, &ipset_table[i], list) {
             if (off >= nips)
                 break;
-        memcpy(&array->ips[off].addr.in, &ipset_node->daddr.addr, sizeof(union inet_addr));
-                array->ips[off++].af = ipset_node->daddr.af;
+            array->ips[off].af = ipset_node->daddr.af;
+            array->ips[off].addr = ipset_node->daddr.addr;
+            array->ips[off++].plen = ipset_node->plen;
         }
     }
     array->nipset = off;
@@ -258,68 +496,12 @@ static int ipset_sockopt_get(sockoptid_t opt, const void *conf, size_t size,
     return 0;
 }
 
-static int ipset_msg_process(bool add, struct dpvs_msg *msg)
-{
-    struct dp_vs_multi_ipset_conf *cf;
-    struct dp_vs_ipset_conf *ip_cf;
-    int err = 0;
-    int i;
-
-    assert(msg);
-
-    if (msg->len < sizeof(struct dp_vs_multi_ipset_conf) + sizeof(struct dp_vs_ipset_conf)) {
-        return EDPVS_INVAL;
-    }
-
-    cf = (struct dp_vs_multi_ipset_conf *)msg->data;
-
-    for (i = 0; i < cf->num; i++) {
-        ip_cf = &cf->ipset_conf[i];
-        if (add)
-            err = ipset_add(ip_cf->af, &ip_cf->addr);
-        else
-            err = ipset_del(ip_cf->af, &ip_cf->addr);
-    }
-
-    if (err != EDPVS_OK)
-         RTE_LOG(ERR, IPSET, "%s: fail to %s ipset.\n", __func__, add? "add":"del");
-
-    return err;
- }
-
-
-static int ipset_add_msg_cb(struct dpvs_msg *msg)
-{
-    return ipset_msg_process(true, msg);
-}
-
-static int ipset_del_msg_cb(struct dpvs_msg *msg)
-{
-    return ipset_msg_process(false, msg);
-}
-
-static int ipset_flush_msg_cb(struct dpvs_msg *msg)
-{
-    return ipset_flush_lcore(NULL);
-}
-
-static int ipset_lcore_init(void *arg)
+static int ipset_sync_msg_cb(struct dpvs_msg *msg)
 {
-    int i;
-
-    if (!rte_lcore_is_enabled(rte_lcore_id()))
-        return EDPVS_DISABLED;
-
-    if (!netif_lcore_is_fwd_worker(rte_lcore_id()))
-        return EDPVS_NOTSUPP;
-
-    for (i = 0; i < IPSET_TAB_SIZE; i++)
-        INIT_LIST_HEAD(&this_ipset_table_lcore[i]);
-
+    /* nothing to do, slaves only need to pass here */
     return EDPVS_OK;
 }
 
-
 static struct dpvs_sockopts ipset_sockopts = {
     .version        = SOCKOPT_VERSION,
     .set_opt_min    = SOCKOPT_SET_IPSET_ADD,
@@ -330,11 +512,41 @@ static struct dpvs_sockopts ipset_sockopts = {
     .get            = ipset_sockopt_get,
 };
 
+/* one member per line, an IPv4/IPv6 address or prefix, '#' for comments */
+static int ipset_parse_member(char *buf, struct dp_vs_ipset_conf *cf)
+{
+    char *plen, *end;
+    unsigned long len;
+
+    buf[strcspn(buf, "# \t")] = '\0';
+    if (buf[0] == '\0')
+        return EDPVS_NOTEXIST;
+
+    memset(cf, 0, sizeof(*cf));
+    plen = strchr(buf, '/');
+    if (plen) {
+        *plen++ = '\0';
+        len = strtoul(plen, &end, 10);
+        if (*plen == '\0' || *end != '\0' || len == 0 || len > 128)
+            return EDPVS_INVAL;
+        cf->plen = len;
+    }
+
+    if (inet_pton(AF_INET, buf, &cf->addr.in) > 0)
+        cf->af = AF_INET;
+    else if (inet_pton(AF_INET6, buf, &cf->addr.in6) > 0)
+        cf->af = AF_INET6;
+    else
+        return EDPVS_INVAL;
+
+    return EDPVS_OK;
+}
+
 static int ipset_parse_conf_file(void)
 {
     char *buf, ch;
     struct dp_vs_multi_ipset_conf *ips = NULL;
-    int ip_num = 0, ipset_size = 0, ip_index = 0;
+    int ip_num = 0, ipset_size = 0, ip_index = 0, line = 0;
 
     buf = (char *) MALLOC(CFG_FILE_MAX_BUF_SZ);
     if (buf == NULL) {
@@ -351,7 +563,7 @@ static int ipset_parse_conf_file(void)
         return -1;
     }
 
-    RTE_LOG(DEBUG, IPSET, "gfwip list has %u ips\n", ip_num);
+    RTE_LOG(DEBUG, IPSET, "gfwip list has %u lines\n", ip_num);
 
     fseek(g_current_stream, 0, SEEK_SET);
 
@@ -362,24 +574,32 @@ static int ipset_parse_conf_file(void)
         FREE(buf);
         return -1;
     }
-    ips->num = ip_num;
 
-    while (read_line(buf, CFG_FILE_MAX_BUF_SZ)) {
-        if (inet_pton(AF_INET, buf, &ips->ipset_conf[ip_index].addr) <= 0)
-             ips->ipset_conf[ip_index].af = 0;
-        else
-             ips->ipset_conf[ip_index].af = AF_INET;
-        ip_index++;
-    }
-    if (ips != NULL) {
-        ipset_sockopt_set(SOCKOPT_SET_IPSET_ADD, ips, ipset_size);
-        rte_free(ips);
-        FREE(buf);
-        return 0;
+    /* the whole file is loaded as one batch, i.e. one FIB switch */
+    while (read_line(buf, CFG_FILE_MAX_BUF_SZ) && ip_index < ip_num) {
+        line++;
+        switch (ipset_parse_member(buf, &ips->ipset_conf[ip_index])) {
+        case EDPVS_OK:
+            ip_index++;
+            break;
+        case EDPVS_INVAL:
+            RTE_LOG(WARNING, IPSET, "bad gfwip member at line %d\n", line);
+            break;
+        default:
+            break;
+        }
     }
+    ips->num = ip_index;
+
+    if (ip_index)
+        ipset_sockopt_set(SOCKOPT_SET_IPSET_ADD, ips,
+                          sizeof(struct dp_vs_multi_ipset_conf)
+                          + ip_index * sizeof(struct dp_vs_ipset_conf));
+    RTE_LOG(INFO, IPSET, "gfwip list loaded, %u members\n", num_ipset);
 
+    rte_free(ips);
     FREE(buf);
-    return -1;
+    return 0;
 }
 
 static void ipset_read_conf_file(char *conf_file)
@@ -425,37 +645,17 @@ static int ipset_register_msg_cb(void)
     int err;
 
     memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
-    msg_type.type   = MSG_TYPE_IPSET_ADD;
-    msg_type.mode   = DPVS_MSG_MULTICAST;
-    msg_type.cid    = rte_lcore_id();
-    msg_type.unicast_msg_cb = ipset_add_msg_cb;
-    err = msg_type_mc_register(&msg_type);
-    if (err != EDPVS_OK) {
-        RTE_LOG(ERR, IPSET, "%s: fail to register add msg.\n", __func__);
-        return err;
-    }
-
-    memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
-    msg_type.type   = MSG_TYPE_IPSET_DEL;
+    msg_type.type   = MSG_TYPE_IPSET_SYNC;
     msg_type.mode   = DPVS_MSG_MULTICAST;
+    msg_type.prio   = MSG_PRIO_NORM;
     msg_type.cid    = rte_lcore_id();
-    msg_type.unicast_msg_cb = ipset_del_msg_cb;
+    msg_type.unicast_msg_cb = ipset_sync_msg_cb;
     err = msg_type_mc_register(&msg_type);
     if (err != EDPVS_OK) {
-        RTE_LOG(ERR, IPSET, "%s: fail to register del msg.\n", __func__);
+        RTE_LOG(ERR, IPSET, "%s: fail to register sync msg.\n", __func__);
         return err;
     }
 
-    memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
-    msg_type.type   = MSG_TYPE_IPSET_FLUSH;
-    msg_type.mode   = DPVS_MSG_MULTICAST;
-    msg_type.cid    = rte_lcore_id();
-    msg_type.unicast_msg_cb = ipset_flush_msg_cb;
-    err = msg_type_mc_register(&msg_type);
-    if (err != EDPVS_OK) {
-        RTE_LOG(ERR, IPSET, "%s: fail to register flush msg.\n", __func__);
-        return err;
-    }
     return EDPVS_OK;
 }
 
@@ -465,91 +665,172 @@ static int ipset_unregister_msg_cb(void)
     int err;
 
     memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
-    msg_type.type   = MSG_TYPE_IPSET_ADD;
+    msg_type.type   = MSG_TYPE_IPSET_SYNC;
     msg_type.mode   = DPVS_MSG_MULTICAST;
+    msg_type.prio   = MSG_PRIO_NORM;
     msg_type.cid    = rte_lcore_id();
-    msg_type.unicast_msg_cb = ipset_add_msg_cb;
+    msg_type.unicast_msg_cb = ipset_sync_msg_cb;
     err = msg_type_mc_unregister(&msg_type);
     if (err != EDPVS_OK) {
-        RTE_LOG(ERR, IPSET, "%s: fail to register add msg.\n", __func__);
+        RTE_LOG(ERR, IPSET, "%s: fail to unregister sync msg.\n", __func__);
         return err;
     }
 
-    memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
-    msg_type.type   = MSG_TYPE_IPSET_DEL;
-    msg_type.mode   = DPVS_MSG_MULTICAST;
-    msg_type.cid    = rte_lcore_id();
-    msg_type.unicast_msg_cb = ipset_del_msg_cb;
-    err = msg_type_mc_unregister(&msg_type);
-    if (err != EDPVS_OK) {
-        RTE_LOG(ERR, IPSET, "%s: fail to register del msg.\n", __func__);
-        return err;
-    }
-
-    memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
-    msg_type.type   = MSG_TYPE_IPSET_FLUSH;
-    msg_type.mode   = DPVS_MSG_MULTICAST;
-    msg_type.cid    = rte_lcore_id();
-    msg_type.unicast_msg_cb = ipset_flush_msg_cb;
-    err = msg_type_mc_unregister(&msg_type);
-    if (err != EDPVS_OK) {
-        RTE_LOG(ERR, IPSET, "%s: fail to register flush msg.\n", __func__);
-        return err;
-    }
     return EDPVS_OK;
 }
 
 int ipset_init(void)
 {
     int err, i;
-    lcoreid_t cid;
 
-    this_num_ipset = 0;
+    num_ipset = 0;
 
+    ipset_table = rte_malloc(NULL, sizeof(struct list_head) * IPSET_TAB_SIZE, 0);
+    if (!ipset_table)
+        return EDPVS_NOMEM;
     for (i = 0; i < IPSET_TAB_SIZE; i++)
-        INIT_LIST_HEAD(&this_ipset_table_lcore[i]);
-
-    rte_eal_mp_remote_launch(ipset_lcore_init, NULL, CALL_MAIN);
-    RTE_LCORE_FOREACH_WORKER(cid) {
-        if ((err = rte_eal_wait_lcore(cid)) < 0) {
-            RTE_LOG(WARNING, IPSET, "%s: lcore %d: %s.\n",
-                    __func__, cid, dpvs_strerror(err));
-        }
-    }
+        INIT_LIST_HEAD(&ipset_table[i]);
 
     if ((err = ipset_register_msg_cb()) != EDPVS_OK) {
         RTE_LOG(WARNING, IPSET, "fail to register ipset msg type.\n");
         ipset_unregister_msg_cb();
-        return err;
+        goto errout;
     }
 
     if ((err = sockopt_register(&ipset_sockopts)) != EDPVS_OK) {
         ipset_unregister_msg_cb();
-        return err;
+        goto errout;
     }
     ipset_read_conf_file(IPSET_CFG_FILE_NAME);
 
     return EDPVS_OK;
+
+errout:
+    rte_free(ipset_table);
+    ipset_table = NULL;
+    return err;
 }
 
 int ipset_term(void)
 {
-    int err;
-    lcoreid_t cid;
+    int err, i;
 
     if ((err = ipset_unregister_msg_cb()) != EDPVS_OK)
         return err;
     if ((err = sockopt_unregister(&ipset_sockopts)) != EDPVS_OK)
         return err;
 
-    rte_eal_mp_remote_launch(ipset_flush_lcore, NULL, CALL_MAIN);
-    RTE_LCORE_FOREACH_WORKER(cid) {
-        if ((err = rte_eal_wait_lcore(cid)) < 0) {
-            RTE_LOG(WARNING, IPSET, "%s: lcore %d: %s.\n",
-                    __func__, cid, dpvs_strerror(err));
-        }
+    ipset_flush();
+
+    for (i = 0; i < NELEMS(ipset_fibs); i++) {
+        if (ipset_fibs[i].lpm)
+            rte_lpm_free(ipset_fibs[i].lpm);
+        if (ipset_fibs[i].lpm6)
+            rte_lpm6_free(ipset_fibs[i].lpm6);
+        memset(&ipset_fibs[i], 0, sizeof(ipset_fibs[i]));
     }
 
+    rte_free(ipset_table);
+    ipset_table = NULL;
+
     return EDPVS_OK;
 }
 
+/* config file */
+static void ipset_lpm_max_rules_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t max_rules;
+
+    assert(str);
+    max_rules = atoi(str);
+    if (max_rules < 16 || max_rules > (1 << 24)) {
+        RTE_LOG(WARNING, IPSET, "invalid gfwip:lpm_max_rules %s, using default %d\n",
+                str, IPSET_LPM_MAX_RULES_DEF);
+        ipset_lpm_max_rules = IPSET_LPM_MAX_RULES_DEF;
+    } else {
+        RTE_LOG(INFO, IPSET, "gfwip:lpm_max_rules = %d\n", max_rules);
+        ipset_lpm_max_rules = max_rules;
+    }
+
+    FREE_PTR(str);
+}
+
+static void ipset_lpm_num_tbl8s_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t num_tbl8s;
+
+    assert(str);
+    num_tbl8s = atoi(str);
+    if (num_tbl8s < 16 || num_tbl8s > (1 << 24)) {
+        RTE_LOG(WARNING, IPSET, "invalid gfwip:lpm_num_tbl8s %s, using default %d\n",
+                str, IPSET_LPM_NUM_TBL8S_DEF);
+        ipset_lpm_num_tbl8s = IPSET_LPM_NUM_TBL8S_DEF;
+    } else {
+        RTE_LOG(INFO, IPSET, "gfwip:lpm_num_tbl8s = %d\n", num_tbl8s);
+        ipset_lpm_num_tbl8s = num_tbl8s;
+    }
+
+    FREE_PTR(str);
+}
+
+static void ipset_lpm6_max_rules_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t max_rules;
+
+    assert(str);
+    max_rules = atoi(str);
+    if (max_rules < 16 || max_rules > (1 << 24)) {
+        RTE_LOG(WARNING, IPSET, "invalid gfwip:lpm6_max_rules %s, using default %d\n",
+                str, IPSET_LPM6_MAX_RULES_DEF);
+        ipset_lpm6_max_rules = IPSET_LPM6_MAX_RULES_DEF;
+    } else {
+        RTE_LOG(INFO, IPSET, "gfwip:lpm6_max_rules = %d\n", max_rules);
+        ipset_lpm6_max_rules = max_rules;
+    }
+
+    FREE_PTR(str);
+}
+
+static void ipset_lpm6_num_tbl8s_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t num_tbl8s;
+
+    assert(str);
+    num_tbl8s = atoi(str);
+    if (num_tbl8s && (num_tbl8s < 16 || num_tbl8s > (1 << 24))) {
+        RTE_LOG(WARNING, IPSET, "invalid gfwip:lpm6_num_tbl8s %s, using default %d\n",
+                str, IPSET_LPM6_NUM_TBL8S_DEF);
+        ipset_lpm6_num_tbl8s = IPSET_LPM6_NUM_TBL8S_DEF;
+    } else {
+        RTE_LOG(INFO, IPSET, "gfwip:lpm6_num_tbl8s = %d\n", num_tbl8s);
+        ipset_lpm6_num_tbl8s = num_tbl8s;
+    }
+
+    FREE_PTR(str);
+}
+
+void ipset_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        ipset_lpm_max_rules = IPSET_LPM_MAX_RULES_DEF;
+        ipset_lpm_num_tbl8s = IPSET_LPM_NUM_TBL8S_DEF;
+        ipset_lpm6_max_rules = IPSET_LPM6_MAX_RULES_DEF;
+        ipset_lpm6_num_tbl8s = IPSET_LPM6_NUM_TBL8S_DEF;
+    }
+}
+
+void install_ipset_keywords(void)
+{
+    install_keyword("gfwip", NULL, KW_TYPE_INIT);
+    install_sublevel();
+    install_keyword("lpm_max_rules", ipset_lpm_max_rules_handler, KW_TYPE_INIT);
+    install_keyword("lpm_num_tbl8s", ipset_lpm_num_tbl8s_handler, KW_TYPE_INIT);
+    install_keyword("lpm6_max_rules", ipset_lpm6_max_rules_handler, KW_TYPE_INIT);
+    install_keyword("lpm6_num_tbl8s", ipset_lpm6_num_tbl8s_handler, KW_TYPE_INIT);
+    install_sublevel_end();
+}
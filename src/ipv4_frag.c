@@ -17,6 +17,7 @@
  */
 /**
  * fragment and reassemble of IPv4 packet.
+ * IPv6 fragments share the reassemble table, its keys are per family.
  */
 #include <assert.h>
 #include "dpdk.h"
@@ -169,27 +170,16 @@ static struct ipv4_frag ip4_frags[DPVS_MAX_LCORE];
  * for all fun in calling chain to use **mbuf if any func uses
  * mbuf after reasm. just modify ip4_defrag() is not enough.
  */
-int ipv4_reassamble(struct rte_mbuf *mbuf)
+static int frag_reasm_inplace(struct rte_mbuf *mbuf, struct rte_mbuf *asm_mbuf)
 {
-    struct rte_mbuf *asm_mbuf, *next, *seg, *prev;
-    struct rte_ipv4_hdr *iph = ip4_hdr(mbuf);
-
-    assert(mbuf->l3_len > 0);
-
-    /* dpdk frag lib need mbuf->data_off of fragments
-     * start with l2 header if exist. */
-    rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
-
-    asm_mbuf = rte_ipv4_frag_reassemble_packet(
-            this_ip4_frag.reasm_tbl,
-            &this_ip4_frag.death_tbl,
-            mbuf, rte_rdtsc(), iph);
-
-    if (!asm_mbuf) /* no way to distinguish error and in-progress */
-        return EDPVS_INPROGRESS;
+    struct rte_mbuf *next, *seg, *prev;
 
     rte_pktmbuf_adj(asm_mbuf, mbuf->l2_len);
 
+    /* the heading frag came last, it's already in place */
+    if (asm_mbuf == mbuf)
+        return EDPVS_OK;
+
     /* as kernel, make this frag as heading mbuf.
      * the latest fragment (mbuf) should be linear. */
 
@@ -255,6 +245,114 @@ int ipv4_reassamble(struct rte_mbuf *mbuf)
     return EDPVS_OK;
 }
 
+int ipv4_reassamble(struct rte_mbuf *mbuf)
+{
+    struct rte_mbuf *asm_mbuf;
+    struct rte_ipv4_hdr *iph = ip4_hdr(mbuf);
+
+    assert(mbuf->l3_len > 0);
+
+    /* dpdk frag lib need mbuf->data_off of fragments
+     * start with l2 header if exist. */
+    rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
+
+    asm_mbuf = rte_ipv4_frag_reassemble_packet(
+            this_ip4_frag.reasm_tbl,
+            &this_ip4_frag.death_tbl,
+            mbuf, rte_rdtsc(), iph);
+
+    if (!asm_mbuf) /* no way to distinguish error and in-progress */
+        return EDPVS_INPROGRESS;
+
+    return frag_reasm_inplace(mbuf, asm_mbuf);
+}
+
+/*
+ * size of the largest fragment of a reassembled IPv6 datagram, the
+ * non-heading fragments are chained without their headers.
+ */
+static uint16_t ipv6_frag_max_size(const struct rte_mbuf *mbuf)
+{
+    const struct rte_mbuf *seg;
+    uint32_t size = mbuf->data_len + sizeof(struct ipv6_extension_fragment);
+
+    mbuf_foreach_seg(mbuf, seg)
+        size = RTE_MAX(size, seg->data_len + sizeof(struct rte_ipv6_hdr)
+                       + (uint32_t)sizeof(struct ipv6_extension_fragment));
+
+    return RTE_MIN(size, (uint32_t)UINT16_MAX);
+}
+
+/*
+ * the fragment header must follow the fixed header, the reassembled
+ * packet has no fragment header and its l3_len is the fixed header.
+ */
+int ipv6_reassamble(struct rte_mbuf *mbuf)
+{
+    int err;
+    struct rte_mbuf *asm_mbuf;
+    struct rte_ipv6_hdr *ip6h = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+    struct ipv6_extension_fragment *fh;
+
+    fh = rte_ipv6_frag_get_ipv6_fragment_header(ip6h);
+    if (unlikely(!fh || mbuf->data_len < sizeof(*ip6h) + sizeof(*fh)))
+        return EDPVS_INVPKT;
+
+    /* dpdk frag lib takes the fragment header as part of l3 */
+    mbuf->l3_len = sizeof(*ip6h) + sizeof(*fh);
+    rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
+
+    asm_mbuf = rte_ipv6_frag_reassemble_packet(
+            this_ip4_frag.reasm_tbl,
+            &this_ip4_frag.death_tbl,
+            mbuf, rte_rdtsc(), ip6h, fh);
+
+    if (!asm_mbuf)
+        return EDPVS_INPROGRESS;
+
+    err = frag_reasm_inplace(mbuf, asm_mbuf);
+    mbuf->l3_len = sizeof(*ip6h);
+    if (err == EDPVS_OK)
+        mbuf_set_frag_size(mbuf, ipv6_frag_max_size(mbuf));
+
+    return err;
+}
+
+/*
+ * fragments can't offload the L4 checksum of the datagram, finish it
+ * from the pseudo header checksum left in the L4 header.
+ */
+int ip_frag_l4_cksum(struct rte_mbuf *mbuf)
+{
+    uint16_t sum, *cksum;
+    uint32_t off;
+
+    switch (mbuf->ol_flags & PKT_TX_L4_MASK) {
+    case PKT_TX_TCP_CKSUM:
+        off = mbuf->l3_len + offsetof(struct rte_tcp_hdr, cksum);
+        break;
+    case PKT_TX_UDP_CKSUM:
+        off = mbuf->l3_len + offsetof(struct rte_udp_hdr, dgram_cksum);
+        break;
+    default:
+        return EDPVS_OK;
+    }
+
+    if (unlikely(mbuf->data_len < off + sizeof(*cksum)))
+        return EDPVS_INVPKT;
+    if (rte_raw_cksum_mbuf(mbuf, mbuf->l3_len,
+                           mbuf->pkt_len - mbuf->l3_len, &sum) != 0)
+        return EDPVS_INVPKT;
+
+    cksum = rte_pktmbuf_mtod_offset(mbuf, uint16_t *, off);
+    *cksum = (uint16_t)~sum;
+    if (*cksum == 0 && (mbuf->ol_flags & PKT_TX_L4_MASK) == PKT_TX_UDP_CKSUM)
+        *cksum = 0xffff;
+    mbuf->ol_flags &= ~PKT_TX_L4_MASK;
+
+    return EDPVS_OK;
+}
+
 /* this function consumes mbuf also free route. */
 int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
           int (*output)(struct rte_mbuf *))
@@ -275,6 +373,9 @@ int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
         goto out;
     }
 
+    if ((err = ip_frag_l4_cksum(mbuf)) != EDPVS_OK)
+        goto out;
+
     hlen = ip4_hdrlen(mbuf);
     mtu -= hlen; /* IP payload space */
     left = mbuf->pkt_len - hlen;
@@ -301,7 +402,7 @@ int ipv4_fragment(struct rte_mbuf *mbuf, unsigned int mtu,
         /* copy metadata from orig pkt */
         route4_get(rt);
         /* no need to hold before consume mbuf */
-        MBUF_USERDATA(mbuf, struct route_entry *, MBUF_FIELD_ROUTE) = rt;
+        MBUF_USERDATA(frag, struct route_entry *, MBUF_FIELD_ROUTE) = rt;
         frag->port = mbuf->port;
         frag->ol_flags = 0; /* do not offload csum for frag */
         frag->l2_len = mbuf->l2_len;
@@ -31,6 +31,7 @@
 #include "mbuf.h"
 #include "inet.h"
 #include "ipv6.h"
+#include "ipv4_frag.h"
 #include "route6.h"
 #include "parser/parser.h"
 #include "neigh.h"
@@ -289,17 +290,113 @@ static inline unsigned int ip6_mtu_forward(struct route6 *rt)
         return IPV6_MIN_MTU;
 }
 
+/*
+ * the fixed header is the unfragmentable part, extension headers if any go
+ * into the fragments. it consumes mbuf and its route.
+ */
 static int ip6_fragment(struct rte_mbuf *mbuf, uint32_t mtu,
                         int (*out)(struct rte_mbuf *))
 {
-    struct route6 *rt = MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE);
+    struct ip6_hdr *hdr = ip6_hdr(mbuf);
+    struct route6 *rt = NULL;
+    struct rte_mbuf *frag;
+    struct ip6_frag *fh;
+    unsigned int left, len, hlen, from, offset;
+    uint32_t id;
+    uint8_t nxt;
+    void *to;
+    int err;
+
+    /* MBUF_FIELD_ROUTE holds the device for multicast */
+    if (ipv6_addr_is_multicast(&hdr->ip6_dst)) {
+        err = EDPVS_NOTSUPP;
+        goto out;
+    }
+    rt = MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE);
+
+    hlen = sizeof(struct ip6_hdr) + sizeof(struct ip6_frag);
+    if (unlikely(mtu < hlen + 8)) {
+        err = EDPVS_INVAL;
+        goto out;
+    }
+
+    if ((err = ip_frag_l4_cksum(mbuf)) != EDPVS_OK)
+        goto out;
 
-    /* TODO: */
+    nxt = hdr->ip6_nxt;
+    id = htonl((uint32_t)rte_rand());
+    mtu -= hlen; /* fragmentable part space */
+    left = mbuf->pkt_len - sizeof(struct ip6_hdr);
+    from = sizeof(struct ip6_hdr);
+    offset = 0;
 
-    IP6_INC_STATS(fragfails);
-    route6_put(rt);
+    while (left > 0) {
+        len = left < mtu ? left : mtu; /* min(left, mtu) */
+
+        /* if we are not last frag,
+         * ensure next start on eight byte boundary */
+        if (len < left)
+            len &= ~7;
+
+        frag = rte_pktmbuf_alloc(mbuf->pool);
+        if (!frag) {
+            err = EDPVS_NOMEM;
+            goto out;
+        }
+        mbuf_userdata_reset(frag);
+
+        route6_get(rt);
+        MBUF_USERDATA(frag, struct route6 *, MBUF_FIELD_ROUTE) = rt;
+        frag->port = mbuf->port;
+        frag->ol_flags = 0; /* do not offload csum for frag */
+        frag->l2_len = mbuf->l2_len;
+        frag->l3_len = hlen;
+
+        /* copy the fixed header, leave room for fragment header */
+        if (unlikely((to = rte_pktmbuf_append(frag, hlen + len)) == NULL)
+                || mbuf_copy_bits(mbuf, 0, to, sizeof(struct ip6_hdr)) != 0
+                || mbuf_copy_bits(mbuf, from, to + hlen, len) != 0) {
+            err = EDPVS_NOROOM;
+            route6_put(rt);
+            rte_pktmbuf_free(frag);
+            goto out;
+        }
+        left -= len;
+
+        hdr = ip6_hdr(frag);
+        hdr->ip6_nxt = IPPROTO_FRAGMENT;
+        hdr->ip6_plen = htons(sizeof(struct ip6_frag) + len);
+
+        fh = (struct ip6_frag *)(hdr + 1);
+        fh->ip6f_nxt = nxt;
+        fh->ip6f_reserved = 0;
+        fh->ip6f_offlg = htons(offset);
+        if (left > 0)
+            fh->ip6f_offlg |= IP6F_MORE_FRAG;
+        fh->ip6f_ident = id;
+
+        offset += len;
+        from += len;
+
+        /* consumes frag and it's route */
+        err = out(frag);
+        if (err != EDPVS_OK)
+            goto out;
+
+        IP6_INC_STATS(fragcreates);
+    }
+
+    err = EDPVS_OK;
+
+out:
+    if (rt)
+        route6_put(rt);
     rte_pktmbuf_free(mbuf);
-    return EDPVS_FRAG;
+    if (err == EDPVS_OK)
+        IP6_INC_STATS(fragoks);
+    else
+        IP6_INC_STATS(fragfails);
+    return err;
 }
 
 static int ip6_output_fin2(struct rte_mbuf *mbuf)
@@ -340,7 +437,7 @@ static int ip6_output_fin2(struct rte_mbuf *mbuf)
 
 static int ip6_output_fin(struct rte_mbuf *mbuf)
 {
-    uint16_t mtu;
+    uint16_t mtu, frag_size;
     struct ip6_hdr *hdr = ip6_hdr(mbuf);
 
     if (ipv6_addr_is_multicast(&hdr->ip6_dst))
@@ -348,6 +445,11 @@ static int ip6_output_fin(struct rte_mbuf *mbuf)
     else
         mtu = MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE)->rt6_mtu;
 
+    /* a reassembled datagram goes out in fragments no larger than it came */
+    frag_size = mbuf_frag_size(mbuf);
+    if (unlikely(frag_size) && frag_size < mtu)
+        mtu = frag_size;
+
     if (mbuf->pkt_len > mtu)
         return ip6_fragment(mbuf, mtu, ip6_output_fin2);
     else
@@ -446,7 +548,7 @@ static int ip6_forward(struct rte_mbuf *mbuf)
     if (mtu < IPV6_MIN_MTU)
         mtu = IPV6_MIN_MTU;
 
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         mbuf->port = rt->rt6_dev->id;
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, mtu);
 
@@ -0,0 +1,734 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <assert.h>
+#include "dpdk.h"
+#include "ctrl.h"
+#include "ipvs/service.h"
+#include "ipvs/acl.h"
+
+#define ACL_VIP_TAB_BITS        8
+#define ACL_VIP_TAB_SIZE        (1 << ACL_VIP_TAB_BITS)
+#define ACL_VIP_TAB_MASK        (ACL_VIP_TAB_SIZE - 1)
+
+#define ACL_RULE_TAB_BITS       16
+#define ACL_RULE_TAB_SIZE       (1 << ACL_RULE_TAB_BITS)
+#define ACL_RULE_TAB_MASK       (ACL_RULE_TAB_SIZE - 1)
+
+#define ACL_TBL_MIN_SIZE        8
+#define ACL_PLEN_MAX            128
+
+/* config of a VIP, master only */
+struct acl_vip {
+    struct list_head    list;       /* dp_vs_acl_list.vips */
+    struct list_head    rules;      /* acl_rule.vlist */
+    uint32_t            nrules;
+    bool                dirty;      /* rules changed since compiled */
+
+    int                 af;
+    uint8_t             proto;
+    uint16_t            vport;
+    union inet_addr     vaddr;
+
+    struct dp_vs_acl    *acl;       /* published */
+    struct dp_vs_acl    *next;      /* being committed */
+};
+
+struct acl_rule {
+    struct list_head    list;       /* dp_vs_acl_list.rules */
+    struct list_head    vlist;
+    struct acl_vip      *vip;
+    union inet_addr     addr;
+    uint8_t             plen;
+};
+
+struct acl_slot {
+    union inet_addr     addr;
+    uint8_t             plen;
+    uint8_t             used;
+};
+
+/*
+ * the compiled tables are immutable once published, and freed through
+ * dp_vs_acl_list.gc, which relies on gc being their first member.
+ */
+struct dp_vs_acl {
+    struct list_head    gc;
+    int                 af;
+    uint32_t            mask;
+    uint8_t             nplens;
+    uint8_t             plens[ACL_PLEN_MAX + 1];   /* longest first */
+    struct acl_slot     slots[0];
+};
+
+struct acl_tbl_slot {
+    int                 af;
+    uint8_t             proto;
+    uint16_t            vport;
+    union inet_addr     vaddr;
+    const struct dp_vs_acl *acl;    /* NULL for an empty slot */
+};
+
+struct dp_vs_acl_tbl {
+    struct list_head    gc;
+    uint32_t            mask;
+    struct acl_tbl_slot slots[0];
+};
+
+static uint32_t acl_hash_rnd;
+
+static inline uint32_t acl_vip_hash(int af, uint8_t proto,
+                                    const union inet_addr *vaddr, uint16_t vport)
+{
+    return rte_jhash_3words(inet_addr_fold(af, vaddr),
+                            ((uint32_t)vport << 8) | proto, af, acl_hash_rnd);
+}
+
+static inline uint32_t acl_addr_hash(int af, const union inet_addr *addr,
+                                     uint8_t plen)
+{
+    if (af == AF_INET)
+        return rte_jhash_1word(addr->in.s_addr, acl_hash_rnd ^ plen);
+
+    return rte_jhash_32b(addr->in6.s6_addr32, 4, acl_hash_rnd ^ plen);
+}
+
+static inline void acl_addr_mask(int af, const union inet_addr *addr,
+                                 uint8_t plen, union inet_addr *net)
+{
+    int i, bits;
+
+    if (af == AF_INET) {
+        net->in.s_addr = plen ? addr->in.s_addr & htonl(~0U << (32 - plen)) : 0;
+        return;
+    }
+
+    for (i = 0; i < 4; i++) {
+        bits = RTE_MIN(RTE_MAX((int)plen - 32 * i, 0), 32);
+        net->in6.s6_addr32[i] = bits ?
+            addr->in6.s6_addr32[i] & htonl(~0U << (32 - bits)) : 0;
+    }
+}
+
+static inline bool acl_vip_match(int af, uint8_t proto,
+                                 const union inet_addr *vaddr, uint16_t vport,
+                                 int af2, uint8_t proto2,
+                                 const union inet_addr *vaddr2, uint16_t vport2)
+{
+    return af == af2 && proto == proto2 && vport == vport2
+        && inet_addr_equal(af, vaddr, vaddr2);
+}
+
+/*
+ * packet path
+ */
+const struct dp_vs_acl *dp_vs_acl_get(const struct dp_vs_acl_list *list,
+                                      int af, uint8_t proto,
+                                      const union inet_addr *vaddr,
+                                      uint16_t vport)
+{
+    uint32_t h;
+    const struct acl_tbl_slot *s;
+    const struct dp_vs_acl_tbl *tbl = list->tbl;
+
+    if (likely(!tbl))
+        return NULL;
+
+    for (h = acl_vip_hash(af, proto, vaddr, vport) & tbl->mask; ;
+            h = (h + 1) & tbl->mask) {
+        s = &tbl->slots[h];
+        if (!s->acl)
+            return NULL;
+        if (acl_vip_match(s->af, s->proto, &s->vaddr, s->vport,
+                          af, proto, vaddr, vport))
+            return s->acl;
+    }
+}
+
+bool dp_vs_acl_match(const struct dp_vs_acl *acl, const union inet_addr *addr)
+{
+    int i;
+    uint8_t plen;
+    uint32_t h;
+    union inet_addr net;
+    const struct acl_slot *s;
+
+    for (i = 0; i < acl->nplens; i++) {
+        plen = acl->plens[i];
+        acl_addr_mask(acl->af, addr, plen, &net);
+
+        for (h = acl_addr_hash(acl->af, &net, plen) & acl->mask; ;
+                h = (h + 1) & acl->mask) {
+            s = &acl->slots[h];
+            if (!s->used)
+                break;
+            if (s->plen == plen && inet_addr_equal(acl->af, &s->addr, &net))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * control plane
+ */
+static int acl_sync(void)
+{
+    int err;
+    struct dpvs_msg *msg;
+
+    msg = msg_make(MSG_TYPE_ACL_SYNC, 0, DPVS_MSG_MULTICAST,
+                   rte_lcore_id(), 0, NULL);
+    if (!msg)
+        return EDPVS_NOMEM;
+
+    err = multicast_msg_send(msg, 0, NULL);
+    msg_destroy(&msg);
+
+    return err;
+}
+
+/* free the unpublished tables after no slave may be looking at them */
+static void acl_gc(struct dp_vs_acl_list *list)
+{
+    struct list_head *pos, *n;
+
+    if (list_empty(&list->gc))
+        return;
+
+    if (acl_sync() != EDPVS_OK) {
+        RTE_LOG(WARNING, SERVICE, "%s: %s: slaves not synchronized, "
+                "defer freeing old tables\n", __func__, list->name);
+        return;
+    }
+
+    list_for_each_safe(pos, n, &list->gc) {
+        list_del(pos);
+        rte_free(pos);
+    }
+}
+
+static int acl_rule_normalize(struct dp_vs_acl_rule *rule)
+{
+    uint8_t maxlen;
+
+    if (rule->af == AF_INET)
+        maxlen = 32;
+    else if (rule->af == AF_INET6)
+        maxlen = 128;
+    else
+        return EDPVS_NOTSUPP;
+
+    if (rule->plen > maxlen)
+        return EDPVS_INVAL;
+
+    acl_addr_mask(rule->af, &rule->addr, rule->plen, &rule->addr);
+    return EDPVS_OK;
+}
+
+static struct acl_vip *acl_vip_find(const struct dp_vs_acl_list *list,
+                                    int af, uint8_t proto,
+                                    const union inet_addr *vaddr, uint16_t vport)
+{
+    struct acl_vip *vip;
+    uint32_t h = acl_vip_hash(af, proto, vaddr, vport) & ACL_VIP_TAB_MASK;
+
+    list_for_each_entry(vip, &list->vips[h], list) {
+        if (acl_vip_match(vip->af, vip->proto, &vip->vaddr, vip->vport,
+                          af, proto, vaddr, vport))
+            return vip;
+    }
+
+    return NULL;
+}
+
+static inline uint32_t acl_rule_hash(const struct acl_vip *vip,
+                                     const union inet_addr *addr, uint8_t plen)
+{
+    return (acl_vip_hash(vip->af, vip->proto, &vip->vaddr, vip->vport)
+            ^ acl_addr_hash(vip->af, addr, plen)) & ACL_RULE_TAB_MASK;
+}
+
+static struct acl_rule *acl_rule_find(const struct dp_vs_acl_list *list,
+                                      const struct acl_vip *vip,
+                                      const union inet_addr *addr, uint8_t plen)
+{
+    struct acl_rule *rule;
+
+    list_for_each_entry(rule, &list->rules[acl_rule_hash(vip, addr, plen)], list) {
+        if (rule->vip == vip && rule->plen == plen
+                && inet_addr_equal(vip->af, &rule->addr, addr))
+            return rule;
+    }
+
+    return NULL;
+}
+
+static int acl_rule_add(struct dp_vs_acl_list *list,
+                        const struct dp_vs_acl_rule *cf)
+{
+    struct acl_vip *vip;
+    struct acl_rule *rule;
+
+    vip = acl_vip_find(list, cf->af, cf->proto, &cf->vaddr, cf->vport);
+    if (!vip) {
+        vip = rte_zmalloc("acl_vip", sizeof(*vip), 0);
+        if (!vip)
+            return EDPVS_NOMEM;
+        INIT_LIST_HEAD(&vip->rules);
+        vip->af = cf->af;
+        vip->proto = cf->proto;
+        vip->vport = cf->vport;
+        vip->vaddr = cf->vaddr;
+        list_add(&vip->list, &list->vips[acl_vip_hash(cf->af, cf->proto,
+                        &cf->vaddr, cf->vport) & ACL_VIP_TAB_MASK]);
+        list->nvips++;
+        /* released by acl_commit() if no rule is added */
+        vip->dirty = true;
+    } else if (acl_rule_find(list, vip, &cf->addr, cf->plen)) {
+        return EDPVS_EXIST;
+    }
+
+    rule = rte_zmalloc("acl_rule", sizeof(*rule), 0);
+    if (!rule) {
+        /* nothing refers to a vip without rules and published table */
+        if (!vip->nrules && !vip->acl) {
+            list_del(&vip->list);
+            list->nvips--;
+            rte_free(vip);
+        }
+        return EDPVS_NOMEM;
+    }
+    rule->vip = vip;
+    rule->addr = cf->addr;
+    rule->plen = cf->plen;
+
+    list_add(&rule->list, &list->rules[acl_rule_hash(vip, &cf->addr, cf->plen)]);
+    list_add_tail(&rule->vlist, &vip->rules);
+    vip->nrules++;
+    vip->dirty = true;
+    list->nrules++;
+
+    return EDPVS_OK;
+}
+
+static void acl_rule_free(struct dp_vs_acl_list *list, struct acl_rule *rule)
+{
+    list_del(&rule->list);
+    list_del(&rule->vlist);
+    rule->vip->nrules--;
+    rule->vip->dirty = true;
+    list->nrules--;
+    rte_free(rule);
+}
+
+static int acl_rule_del(struct dp_vs_acl_list *list,
+                        const struct dp_vs_acl_rule *cf)
+{
+    struct acl_vip *vip;
+    struct acl_rule *rule;
+
+    vip = acl_vip_find(list, cf->af, cf->proto, &cf->vaddr, cf->vport);
+    if (!vip)
+        return EDPVS_NOTEXIST;
+
+    rule = acl_rule_find(list, vip, &cf->addr, cf->plen);
+    if (!rule)
+        return EDPVS_NOTEXIST;
+
+    acl_rule_free(list, rule);
+    return EDPVS_OK;
+}
+
+static struct dp_vs_acl *acl_compile(const struct acl_vip *vip)
+{
+    int plen;
+    uint32_t h, size;
+    bool seen[ACL_PLEN_MAX + 1] = { false };
+    struct dp_vs_acl *acl;
+    struct acl_slot *s;
+    const struct acl_rule *rule;
+
+    /* at most half full, so that probe sequences stay short */
+    size = RTE_MAX(rte_align32pow2(vip->nrules * 2), ACL_TBL_MIN_SIZE);
+    acl = rte_zmalloc("dp_vs_acl", sizeof(*acl) + size * sizeof(struct acl_slot),
+                      RTE_CACHE_LINE_SIZE);
+    if (!acl)
+        return NULL;
+    acl->af = vip->af;
+    acl->mask = size - 1;
+
+    list_for_each_entry(rule, &vip->rules, vlist) {
+        for (h = acl_addr_hash(vip->af, &rule->addr, rule->plen) & acl->mask; ;
+                h = (h + 1) & acl->mask) {
+            s = &acl->slots[h];
+            if (!s->used)
+                break;
+        }
+        s->addr = rule->addr;
+        s->plen = rule->plen;
+        s->used = 1;
+        seen[rule->plen] = true;
+    }
+
+    for (plen = ACL_PLEN_MAX; plen >= 0; plen--) {
+        if (seen[plen])
+            acl->plens[acl->nplens++] = plen;
+    }
+
+    return acl;
+}
+
+static int acl_tbl_build(struct dp_vs_acl_list *list, struct dp_vs_acl_tbl **ptbl)
+{
+    int i;
+    uint32_t h, n = 0, size;
+    struct acl_vip *vip;
+    struct acl_tbl_slot *s;
+    struct dp_vs_acl_tbl *tbl;
+    const struct dp_vs_acl *acl;
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+        list_for_each_entry(vip, &list->vips[i], list) {
+            if (vip->nrules)
+                n++;
+        }
+    }
+
+    *ptbl = NULL;
+    if (!n)
+        return EDPVS_OK;
+
+    size = RTE_MAX(rte_align32pow2(n * 2), ACL_TBL_MIN_SIZE);
+    tbl = rte_zmalloc("dp_vs_acl_tbl", sizeof(*tbl) + size * sizeof(struct acl_tbl_slot),
+                      RTE_CACHE_LINE_SIZE);
+    if (!tbl)
+        return EDPVS_NOMEM;
+    tbl->mask = size - 1;
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+        list_for_each_entry(vip, &list->vips[i], list) {
+            if (!vip->nrules)
+                continue;
+            acl = vip->dirty ? vip->next : vip->acl;
+            assert(acl);
+
+            for (h = acl_vip_hash(vip->af, vip->proto, &vip->vaddr, vip->vport)
+                        & tbl->mask; ; h = (h + 1) & tbl->mask) {
+                s = &tbl->slots[h];
+                if (!s->acl)
+                    break;
+            }
+            s->af = vip->af;
+            s->proto = vip->proto;
+            s->vport = vip->vport;
+            s->vaddr = vip->vaddr;
+            s->acl = acl;
+        }
+    }
+
+    *ptbl = tbl;
+    return EDPVS_OK;
+}
+
+/*
+ * compile the changed VIPs, publish a new VIP table and retire the old
+ * tables. on failure nothing is published, the rules are kept and take
+ * effect on the next successful commit.
+ */
+static int acl_commit(struct dp_vs_acl_list *list)
+{
+    int i, err = EDPVS_OK;
+    struct acl_vip *vip, *next;
+    struct dp_vs_acl_tbl *tbl, *old;
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE && err == EDPVS_OK; i++) {
+        list_for_each_entry(vip, &list->vips[i], list) {
+            if (!vip->dirty || !vip->nrules)
+                continue;
+            vip->next = acl_compile(vip);
+            if (!vip->next) {
+                err = EDPVS_NOMEM;
+                break;
+            }
+        }
+    }
+
+    if (err == EDPVS_OK)
+        err = acl_tbl_build(list, &tbl);
+
+    if (err != EDPVS_OK) {
+        for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+            list_for_each_entry(vip, &list->vips[i], list) {
+                if (vip->next) {
+                    rte_free(vip->next);
+                    vip->next = NULL;
+                }
+            }
+        }
+        RTE_LOG(ERR, SERVICE, "%s: %s: fail to compile -- %s\n",
+                __func__, list->name, dpvs_strerror(err));
+        return err;
+    }
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+        list_for_each_entry_safe(vip, next, &list->vips[i], list) {
+            if (!vip->dirty)
+                continue;
+            if (vip->acl)
+                list_add_tail(&vip->acl->gc, &list->gc);
+            vip->acl = vip->next;
+            vip->next = NULL;
+            vip->dirty = false;
+
+            if (!vip->nrules) {
+                list_del(&vip->list);
+                list->nvips--;
+                rte_free(vip);
+            }
+        }
+    }
+
+    old = list->tbl;
+    if (old)
+        list_add_tail(&old->gc, &list->gc);
+    rte_wmb();
+    list->tbl = tbl;
+
+    acl_gc(list);
+    return EDPVS_OK;
+}
+
+int dp_vs_acl_update(struct dp_vs_acl_list *list, bool add,
+                     struct dp_vs_acl_rule *rules, int nrules)
+{
+    int i, ret, err = EDPVS_OK;
+    int napplied = 0;
+
+    if (rte_lcore_id() != rte_get_main_lcore())
+        return EDPVS_NOTSUPP;
+
+    for (i = 0; i < nrules; i++) {
+        ret = acl_rule_normalize(&rules[i]);
+        if (ret == EDPVS_OK)
+            ret = add ? acl_rule_add(list, &rules[i]) : acl_rule_del(list, &rules[i]);
+
+        if (ret == EDPVS_OK)
+            napplied++;
+        else if (!(add && ret == EDPVS_EXIST))  /* adding is idempotent */
+            err = ret;
+    }
+
+    if (napplied) {
+        ret = acl_commit(list);
+        if (ret != EDPVS_OK)
+            err = ret;
+    }
+
+    if (err != EDPVS_OK)
+        RTE_LOG(DEBUG, SERVICE, "%s: %s: %d of %d rules %s -- %s\n", __func__,
+                list->name, napplied, nrules, add ? "added" : "deleted",
+                dpvs_strerror(err));
+    return err;
+}
+
+static void acl_vip_flush(struct dp_vs_acl_list *list, struct acl_vip *vip)
+{
+    struct acl_rule *rule, *next;
+
+    list_for_each_entry_safe(rule, next, &vip->rules, vlist)
+        acl_rule_free(list, rule);
+}
+
+int dp_vs_acl_flush_vip(struct dp_vs_acl_list *list, int af, uint8_t proto,
+                        const union inet_addr *vaddr, uint16_t vport)
+{
+    struct acl_vip *vip;
+
+    if (rte_lcore_id() != rte_get_main_lcore())
+        return EDPVS_NOTSUPP;
+
+    vip = acl_vip_find(list, af, proto, vaddr, vport);
+    if (!vip)
+        return EDPVS_OK;
+
+    acl_vip_flush(list, vip);
+    return acl_commit(list);
+}
+
+int dp_vs_acl_flush(struct dp_vs_acl_list *list)
+{
+    int i;
+    struct acl_vip *vip;
+
+    if (rte_lcore_id() != rte_get_main_lcore())
+        return EDPVS_NOTSUPP;
+
+    if (!list->nvips)
+        return EDPVS_OK;
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+        list_for_each_entry(vip, &list->vips[i], list)
+            acl_vip_flush(list, vip);
+    }
+
+    return acl_commit(list);
+}
+
+int dp_vs_acl_walk(const struct dp_vs_acl_list *list,
+                   dp_vs_acl_walk_cb_t cb, void *arg)
+{
+    int i, err;
+    struct acl_vip *vip;
+    struct acl_rule *rule;
+    struct dp_vs_acl_rule cf;
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+        list_for_each_entry(vip, &list->vips[i], list) {
+            list_for_each_entry(rule, &vip->rules, vlist) {
+                cf.af = vip->af;
+                cf.proto = vip->proto;
+                cf.vport = vip->vport;
+                cf.vaddr = vip->vaddr;
+                cf.addr = rule->addr;
+                cf.plen = rule->plen;
+                err = cb(&cf, arg);
+                if (err != EDPVS_OK)
+                    return err;
+            }
+        }
+    }
+
+    return EDPVS_OK;
+}
+
+int dp_vs_acl_list_init(struct dp_vs_acl_list *list, const char *name)
+{
+    int i;
+
+    memset(list, 0, sizeof(*list));
+    list->name = name;
+    INIT_LIST_HEAD(&list->gc);
+
+    list->vips = rte_malloc(NULL, sizeof(struct list_head) * ACL_VIP_TAB_SIZE, 0);
+    list->rules = rte_malloc(NULL, sizeof(struct list_head) * ACL_RULE_TAB_SIZE, 0);
+    if (!list->vips || !list->rules) {
+        dp_vs_acl_list_term(list);
+        return EDPVS_NOMEM;
+    }
+
+    for (i = 0; i < ACL_VIP_TAB_SIZE; i++)
+        INIT_LIST_HEAD(&list->vips[i]);
+    for (i = 0; i < ACL_RULE_TAB_SIZE; i++)
+        INIT_LIST_HEAD(&list->rules[i]);
+
+    return EDPVS_OK;
+}
+
+/*
+ * no lcore looks at the list any longer, so the tables are freed whether
+ * or not the flush could commit and synchronize the slaves.
+ */
+void dp_vs_acl_list_term(struct dp_vs_acl_list *list)
+{
+    int i;
+    struct list_head *pos, *n;
+    struct acl_vip *vip, *next;
+
+    if (list->vips && list->rules) {
+        dp_vs_acl_flush(list);
+
+        for (i = 0; i < ACL_VIP_TAB_SIZE; i++) {
+            list_for_each_entry_safe(vip, next, &list->vips[i], list) {
+                acl_vip_flush(list, vip);
+                if (vip->acl)
+                    list_add_tail(&vip->acl->gc, &list->gc);
+                list_del(&vip->list);
+                list->nvips--;
+                rte_free(vip);
+            }
+        }
+    }
+
+    if (list->tbl) {
+        list_add_tail(&list->tbl->gc, &list->gc);
+        list->tbl = NULL;
+    }
+
+    list_for_each_safe(pos, n, &list->gc) {
+        list_del(pos);
+        rte_free(pos);
+    }
+
+    if (list->vips) {
+        rte_free(list->vips);
+        list->vips = NULL;
+    }
+    if (list->rules) {
+        rte_free(list->rules);
+        list->rules = NULL;
+    }
+}
+
+static int acl_sync_msg_cb(struct dpvs_msg *msg)
+{
+    /* nothing to do, slaves only need to pass here */
+    return EDPVS_OK;
+}
+
+int dp_vs_acl_init(void)
+{
+    int err;
+    struct dpvs_msg_type msg_type;
+
+    acl_hash_rnd = (uint32_t)random();
+
+    memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
+    msg_type.type   = MSG_TYPE_ACL_SYNC;
+    msg_type.mode   = DPVS_MSG_MULTICAST;
+    msg_type.prio   = MSG_PRIO_NORM;
+    msg_type.cid    = rte_lcore_id();
+    msg_type.unicast_msg_cb = acl_sync_msg_cb;
+    err = msg_type_mc_register(&msg_type);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, SERVICE, "%s: fail to register sync msg.\n", __func__);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+int dp_vs_acl_term(void)
+{
+    int err;
+    struct dpvs_msg_type msg_type;
+
+    memset(&msg_type, 0, sizeof(struct dpvs_msg_type));
+    msg_type.type   = MSG_TYPE_ACL_SYNC;
+    msg_type.mode   = DPVS_MSG_MULTICAST;
+    msg_type.prio   = MSG_PRIO_NORM;
+    msg_type.cid    = rte_lcore_id();
+    msg_type.unicast_msg_cb = acl_sync_msg_cb;
+    err = msg_type_mc_unregister(&msg_type);
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, SERVICE, "%s: fail to unregister sync msg.\n", __func__);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
@@ -17,24 +17,52 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <netinet/ip6.h>
 #include "ipv4.h"
 #include "ipv6.h"
-#include "libconhash/conhash.h"
+#include "ipvs/siphash.h"
 #include "ipvs/conhash.h"
 
-struct conhash_node {
-    struct list_head    list;
-    struct node_s       node;       /* node in libconhash */
+/*
+ * Consistent hashing on a flat, sorted ring.
+ *
+ * Each dest owns (weight / gcd) * REPLICA points on a 64-bit ring, the
+ * points are SipHash values of the dest's address, port and replica number.
+ * A hash target is mapped to the first point not less than its SipHash
+ * value. A lookup table indexed by the top bits of the value narrows the
+ * binary search down to a few points.
+ *
+ * The ring is rebuilt as a whole whenever dests change, once per dest
+ * sockopt however many dests it carries, in control plane context of the
+ * lcore owning the service.
+ *
+ * The SipHash key is fixed, so that every lcore and every DPVS instance
+ * behind the same ECMP maps a target to the same dest.
+ */
+#define REPLICA                             160
+#define CONHASH_LUT_BITS_MAX                16
+#define QUIC_PACKET_8BYTE_CONNECTION_ID     (1 << 3)
+
+struct conhash_point {
+    uint64_t            hash;
+    struct dp_vs_dest   *dest;
 };
 
 struct conhash_sched_data {
-    struct list_head    nodes;      /* node list */
-    struct conhash_s   *conhash;    /* consistent hash meta data */
+    uint32_t            npoints;
+    uint32_t            lut_shift;  /* 64 - lut bits */
+    uint32_t            *lut;       /* first point of each lut slot, 1 extra */
+    struct conhash_point *ring;     /* sorted by hash */
+
+    uint32_t            ndests;
+    struct dp_vs_dest   **dests;    /* referenced by the ring */
+};
+
+static const siphash_key_t conhash_key = {
+    .key = { 0x646f6d2d68736168ULL, 0x7370766400686e6fULL },
 };
 
-#define REPLICA 160
-#define QUIC_PACKET_8BYTE_CONNECTION_ID  (1 << 3)
 
 /*
  * QUIC CID hash target for quic*
@@ -95,13 +123,39 @@ static int get_sip_hash_target(int af, const struct rte_mbuf *mbuf,
 }
 
 static inline struct dp_vs_dest *
-dp_vs_conhash_get(struct dp_vs_service *svc, struct conhash_s *conhash,
+conhash_ring_lookup(const struct conhash_sched_data *sched_data, uint64_t hash)
+{
+    uint32_t lo, hi, mid, slot;
+    const struct conhash_point *ring = sched_data->ring;
+
+    if (unlikely(!sched_data->npoints))
+        return NULL;
+
+    slot = hash >> sched_data->lut_shift;
+    lo = sched_data->lut[slot];
+    hi = sched_data->lut[slot + 1];
+
+    /* first point in [lo, hi) with ring[].hash >= hash */
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (ring[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == sched_data->npoints)
+        lo = 0;
+    return ring[lo].dest;
+}
+
+static inline struct dp_vs_dest *
+dp_vs_conhash_get(struct dp_vs_service *svc,
+                  const struct conhash_sched_data *sched_data,
                   const struct rte_mbuf *mbuf)
 {
-    char str[40] = {0};
-    uint64_t quic_cid;
+    uint64_t quic_cid, hash;
     uint32_t addr_fold;
-    const struct node_s *node;
 
     if (svc->flags & DP_VS_SVC_F_QID_HASH) {
         if (svc->proto != IPPROTO_UDP) {
@@ -110,16 +164,16 @@ dp_vs_conhash_get(struct dp_vs_service *svc, struct conhash_s *conhash,
         }
         /* try to get CID for hash target first, then source IP. */
         if (EDPVS_OK == get_quic_hash_target(svc->af, mbuf, &quic_cid)) {
-            snprintf(str, sizeof(str), "%lu", quic_cid);
+            hash = siphash_1u64(quic_cid, &conhash_key);
         } else if (EDPVS_OK == get_sip_hash_target(svc->af, mbuf, &addr_fold)) {
-            snprintf(str, sizeof(str), "%u", addr_fold);
+            hash = siphash_1u32(addr_fold, &conhash_key);
         } else {
             return NULL;
         }
 
     } else if (svc->flags & DP_VS_SVC_F_SIP_HASH) {
         if (EDPVS_OK == get_sip_hash_target(svc->af, mbuf, &addr_fold)) {
-            snprintf(str, sizeof(str), "%u", addr_fold);
+            hash = siphash_1u32(addr_fold, &conhash_key);
         } else {
             return NULL;
         }
@@ -129,179 +183,128 @@ dp_vs_conhash_get(struct dp_vs_service *svc, struct conhash_s *conhash,
         return NULL;
     }
 
-    node = conhash_lookup(conhash, str);
-    return node == NULL? NULL: node->data;
+    return conhash_ring_lookup(sched_data, hash);
 }
 
-static void node_fini(struct node_s *node)
+static int conhash_point_cmp(const void *a, const void *b)
 {
-    struct conhash_node *p_conhash_node = NULL;
-
-    if (!node)
-        return;
-
-    if (node->data) {
-        dp_vs_dest_put((struct dp_vs_dest *)node->data);
-        node->data = NULL;
-    }
-
-    p_conhash_node = container_of(node, struct conhash_node, node);
-    list_del(&(p_conhash_node->list));
-    rte_free(p_conhash_node);
+    const struct conhash_point *p1 = a, *p2 = b;
+    uint32_t f1, f2;
+
+    if (p1->hash != p2->hash)
+        return p1->hash < p2->hash ? -1 : 1;
+
+    /* tie-break independent of the dest list order */
+    f1 = rte_be_to_cpu_32(inet_addr_fold(p1->dest->af, &p1->dest->addr));
+    f2 = rte_be_to_cpu_32(inet_addr_fold(p2->dest->af, &p2->dest->addr));
+    if (f1 != f2)
+        return f1 < f2 ? -1 : 1;
+    return (int)rte_be_to_cpu_16(p1->dest->port) - (int)rte_be_to_cpu_16(p2->dest->port);
 }
 
-static int dp_vs_conhash_add_dest(struct dp_vs_service *svc,
-        struct dp_vs_dest *dest)
+static void conhash_sched_data_release(struct conhash_sched_data *sched_data)
 {
-    int ret;
-    char iden[64];
-    char addr[INET6_ADDRSTRLEN];
-    int16_t weight = 0;
-    struct node_s *p_node;
-    struct conhash_node *p_conhash_node;
-    struct conhash_sched_data *p_sched_data;
-    int weight_gcd;
-
-    p_sched_data = (struct conhash_sched_data *)(svc->sched_data);
-
-    weight = rte_atomic16_read(&dest->weight);
-    weight_gcd = dp_vs_gcd_weight(svc);
-    if (weight < 0) {
-        RTE_LOG(ERR, SERVICE, "%s: add dest with weight(%d) less than 0\n",
-                __func__, weight);
-        return EDPVS_INVAL;
-    }
-
-    p_conhash_node = rte_zmalloc(NULL, sizeof(struct conhash_node),
-            RTE_CACHE_LINE_SIZE);
-    if (!p_conhash_node) {
-        RTE_LOG(ERR, SERVICE, "%s: alloc conhash node failed\n", __func__);
-        return EDPVS_NOMEM;
-    }
-
-    INIT_LIST_HEAD(&(p_conhash_node->list));
-
-    // add node to conhash
-    p_node = &(p_conhash_node->node);
-    inet_ntop(dest->af, &dest->addr, addr, sizeof(addr));
-    snprintf(iden, sizeof(iden), "%s%d", addr, dest->port);
-    conhash_set_node(p_node, iden, weight / weight_gcd * REPLICA);
-
-    ret = conhash_add_node(p_sched_data->conhash, p_node);
-    if (ret < 0) {
-        RTE_LOG(ERR, SERVICE, "%s: conhash_add_node failed\n", __func__);
-        rte_free(p_conhash_node);
-        return EDPVS_INVAL;
-    }
+    uint32_t i;
 
-    // set node data
-    rte_atomic32_inc(&dest->refcnt);
-    p_node->data = dest;
+    for (i = 0; i < sched_data->ndests; i++)
+        dp_vs_dest_put(sched_data->dests[i]);
 
-    // add conhash node to list
-    list_add(&(p_conhash_node->list), &(p_sched_data->nodes));
+    if (sched_data->dests)
+        rte_free(sched_data->dests);
+    if (sched_data->ring)
+        rte_free(sched_data->ring);
+    if (sched_data->lut)
+        rte_free(sched_data->lut);
 
-    return EDPVS_OK;
+    memset(sched_data, 0, sizeof(*sched_data));
 }
 
-static int dp_vs_conhash_del_dest(struct dp_vs_service *svc,
-        struct dp_vs_dest *dest)
-{
-    int ret;
-    struct node_s *p_node;
-    struct conhash_node *p_conhash_node;
-    struct conhash_sched_data *p_sched_data;
-
-    p_sched_data = (struct conhash_sched_data *)(svc->sched_data);
-
-    list_for_each_entry(p_conhash_node, &(p_sched_data->nodes), list) {
-        if (p_conhash_node->node.data == dest) {
-            p_node = &(p_conhash_node->node);
-            ret = conhash_del_node(p_sched_data->conhash, p_node);
-            if (ret < 0) {
-                RTE_LOG(ERR, SERVICE, "%s: conhash_del_node failed\n", __func__);
-                return EDPVS_INVAL;
-            }
-            node_fini(p_node);
-            return EDPVS_OK;
-        }
-    }
-
-    return EDPVS_NOTEXIST;
-}
-
-static int dp_vs_conhash_edit_dest(struct dp_vs_service *svc,
-        struct dp_vs_dest *dest)
+/*
+ *      (Re)build the ring from the dests of service.
+ */
+static int dp_vs_conhash_rebuild(struct dp_vs_service *svc)
 {
-    int ret;
-    char iden[64];
-    char addr[INET6_ADDRSTRLEN];
-    int16_t weight;
-    struct node_s *p_node;
-    struct conhash_node *p_conhash_node;
-    struct conhash_sched_data *p_sched_data;
     int weight_gcd;
+    int16_t weight;
+    uint32_t i, r, n, ndests, npoints, replicas, lut_bits, slot;
+    uint64_t ident;
+    struct dp_vs_dest *dest;
+    struct conhash_sched_data new, *sched_data = svc->sched_data;
 
-    weight = rte_atomic16_read(&dest->weight);
+    memset(&new, 0, sizeof(new));
     weight_gcd = dp_vs_gcd_weight(svc);
-    p_sched_data = (struct conhash_sched_data *)(svc->sched_data);
-
-    // find node by addr and port
-    list_for_each_entry(p_conhash_node, &(p_sched_data->nodes), list) {
-        if (p_conhash_node->node.data == dest) {
-            if (p_conhash_node->node.replicas == weight / weight_gcd * REPLICA)
-                return EDPVS_OK;
-
-            // del from conhash
-            p_node = &(p_conhash_node->node);
-            ret = conhash_del_node(p_sched_data->conhash, p_node);
-            if (ret < 0) {
-                RTE_LOG(ERR, SERVICE, "%s: conhash_del_node failed\n", __func__);
-                return EDPVS_INVAL;
-            }
-
-            // adjust weight
-            inet_ntop(dest->af, &dest->addr, addr, sizeof(addr));
-            snprintf(iden, sizeof(iden), "%s%d", addr, dest->port);
-            conhash_set_node(p_node, iden, weight / weight_gcd * REPLICA);
-
-            // add to conhash again
-            ret = conhash_add_node(p_sched_data->conhash, p_node);
-            if (ret < 0) {
-                RTE_LOG(ERR, SERVICE, "%s: conhash_set_node failed\n", __func__);
-                return EDPVS_INVAL;
-            }
 
-            return EDPVS_OK;
+    ndests = npoints = 0;
+    list_for_each_entry(dest, &svc->dests, n_list) {
+        weight = rte_atomic16_read(&dest->weight);
+        if (weight < 0) {
+            RTE_LOG(ERR, SERVICE, "%s: dest with weight(%d) less than 0\n",
+                    __func__, weight);
+            return EDPVS_INVAL;
+        }
+        if (weight > 0) {
+            ndests++;
+            npoints += weight / weight_gcd * REPLICA;
         }
     }
 
-    return EDPVS_NOTEXIST;
-}
-
-/*
- *      Assign dest to connhash.
- */
-static int
-dp_vs_conhash_assign(struct dp_vs_service *svc)
-{
-    int err;
-    struct dp_vs_dest *dest;
-
-    list_for_each_entry(dest, &svc->dests, n_list) {
-        err = dp_vs_conhash_add_dest(svc, dest);
-        if (err != EDPVS_OK) {
-            RTE_LOG(ERR, SERVICE, "%s: add dest to conhash failed\n", __func__);
-            return err;
+    if (npoints) {
+        for (lut_bits = 1; lut_bits < CONHASH_LUT_BITS_MAX
+                && (1u << lut_bits) < npoints; lut_bits++)
+            ;
+
+        new.dests = rte_zmalloc(NULL, sizeof(struct dp_vs_dest *) * ndests, 0);
+        new.ring = rte_malloc(NULL, sizeof(struct conhash_point) * npoints,
+                              RTE_CACHE_LINE_SIZE);
+        new.lut = rte_malloc(NULL, sizeof(uint32_t) * ((1u << lut_bits) + 1),
+                             RTE_CACHE_LINE_SIZE);
+        if (!new.dests || !new.ring || !new.lut) {
+            conhash_sched_data_release(&new);
+            RTE_LOG(ERR, SERVICE, "%s: no memory for %u points\n",
+                    __func__, npoints);
+            return EDPVS_NOMEM;
+        }
+        new.lut_shift = 64 - lut_bits;
+
+        n = 0;
+        list_for_each_entry(dest, &svc->dests, n_list) {
+            weight = rte_atomic16_read(&dest->weight);
+            if (weight <= 0)
+                continue;
+
+            rte_atomic32_inc(&dest->refcnt);
+            new.dests[new.ndests++] = dest;
+
+            ident = (uint64_t)rte_be_to_cpu_32(inet_addr_fold(dest->af, &dest->addr)) << 32
+                  | rte_be_to_cpu_16(dest->port);
+            replicas = weight / weight_gcd * REPLICA;
+            for (r = 0; r < replicas; r++) {
+                new.ring[n].hash = siphash_2u64(ident, r, &conhash_key);
+                new.ring[n].dest = dest;
+                n++;
+            }
+        }
+        new.npoints = n;
+        qsort(new.ring, new.npoints, sizeof(struct conhash_point),
+              conhash_point_cmp);
+
+        for (i = 0, slot = 0; slot <= (1u << lut_bits); slot++) {
+            while (i < new.npoints && (new.ring[i].hash >> new.lut_shift) < slot)
+                i++;
+            new.lut[slot] = i;
         }
     }
 
+    conhash_sched_data_release(sched_data);
+    *sched_data = new;
+
     return EDPVS_OK;
 }
 
 static int dp_vs_conhash_init_svc(struct dp_vs_service *svc)
 {
     struct conhash_sched_data *sched_data = NULL;
+    int err;
 
     svc->sched_data = NULL;
 
@@ -313,35 +316,22 @@ static int dp_vs_conhash_init_svc(struct dp_vs_service *svc)
         return EDPVS_NOMEM;
     }
 
-    // init conhash
-    sched_data->conhash = conhash_init(NULL);
-    if (!sched_data->conhash) {
-        RTE_LOG(ERR, SERVICE, "%s: conhash init faild!\n", __func__);
+    svc->sched_data = sched_data;
+    err = dp_vs_conhash_rebuild(svc);
+    if (err != EDPVS_OK) {
         rte_free(sched_data);
-        return EDPVS_NOMEM;
+        svc->sched_data = NULL;
     }
 
-    // init node list
-    INIT_LIST_HEAD(&(sched_data->nodes));
-
-    // assign node
-    svc->sched_data = sched_data;
-    return dp_vs_conhash_assign(svc);
+    return err;
 }
 
 static int dp_vs_conhash_done_svc(struct dp_vs_service *svc)
 {
     struct conhash_sched_data *sched_data =
         (struct conhash_sched_data *)(svc->sched_data);
-    struct conhash_node *p_conhash_node, *p_conhash_node_next;
 
-    conhash_fini(sched_data->conhash, node_fini);
-
-    // del nodes left in list when rs weight is 0
-    list_for_each_entry_safe(p_conhash_node, p_conhash_node_next,
-                             &(sched_data->nodes), list) {
-       node_fini(&(p_conhash_node->node));
-    }
+    conhash_sched_data_release(sched_data);
 
     rte_free(svc->sched_data);
     svc->sched_data = NULL;
@@ -356,13 +346,9 @@ static int dp_vs_conhash_update_svc(struct dp_vs_service *svc,
 
     switch (opt) {
         case DPVS_SO_SET_ADDDEST:
-            ret = dp_vs_conhash_add_dest(svc, dest);
-            break;
         case DPVS_SO_SET_DELDEST:
-            ret = dp_vs_conhash_del_dest(svc, dest);
-            break;
         case DPVS_SO_SET_EDITDEST:
-            ret = dp_vs_conhash_edit_dest(svc, dest);
+            ret = dp_vs_conhash_rebuild(svc);
             break;
         default:
             ret = EDPVS_INVAL;
@@ -386,7 +372,7 @@ dp_vs_conhash_schedule(struct dp_vs_service *svc, const struct rte_mbuf *mbuf,
     struct conhash_sched_data *sched_data =
         (struct conhash_sched_data *)(svc->sched_data);
 
-    dest = dp_vs_conhash_get(svc, sched_data->conhash, mbuf);
+    dest = dp_vs_conhash_get(svc, sched_data, mbuf);
 
     return dp_vs_dest_is_valid(dest) ? dest : NULL;
 }
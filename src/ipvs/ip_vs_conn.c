@@ -17,6 +17,7 @@
  */
 #include <assert.h>
 #include <netinet/tcp.h>
+#include <rte_rcu_qsbr.h>
 #include "conf/common.h"
 #include "inet.h"
 #include "ipv4.h"
@@ -24,9 +25,13 @@
 #include "sa_pool.h"
 #include "ipvs/ipvs.h"
 #include "ipvs/conn.h"
+#include "ipvs/conn_tbl.h"
 #include "ipvs/dest.h"
 #include "ipvs/laddr.h"
 #include "ipvs/xmit.h"
+#include "ipvs/frag.h"
+#include "ipvs/conn_persist.h"
+#include "ipvs/sync.h"
 #include "ipvs/synproxy.h"
 #include "ipvs/proto_tcp.h"
 #include "ipvs/proto_udp.h"
@@ -37,17 +42,35 @@
 #include "sys_time.h"
 #include "global_data.h"
 
+/* global connection template table */
 #define DPVS_CONN_TBL_BITS          20
 #define DPVS_CONN_TBL_SIZE          (1 << DPVS_CONN_TBL_BITS)
 #define DPVS_CONN_TBL_MASK          (DPVS_CONN_TBL_SIZE - 1)
 
+/* shards of the template table, and shards scanned per expire job */
+#define DPVS_CT_SHARD_BITS          6
+#define DPVS_CT_SHARDS              (1 << DPVS_CT_SHARD_BITS)
+#define DPVS_CT_SHARD_MASK          (DPVS_CT_SHARDS - 1)
+#define DPVS_CT_SCAN_SHARDS         4
+#define DPVS_CT_SCAN_LOOPS          1000
+
+/* per-lcore flow table, 64B per bucket */
+#define DPVS_CONN_BKT_BITS          18
+#define DPVS_CONN_BKT_SIZE          (1 << DPVS_CONN_BKT_BITS)
+#define DPVS_CONN_OVF_BITS          14
+#define DPVS_CONN_OVF_SIZE          (1 << DPVS_CONN_OVF_BITS)
+
 /* too big ? adjust according to free mem ?*/
 #define DPVS_CONN_POOL_SIZE_DEF     2097151
 #define DPVS_CONN_POOL_SIZE_MIN     65536
 #define DPVS_CONN_CACHE_SIZE_DEF    256
 
+#define DPVS_CONN_SP_POOL_SIZE_DEF  0       /* as conn_pool_size */
+#define DPVS_CONN_SP_POOL_SIZE_MIN  1024
+
 static int conn_pool_size  = DPVS_CONN_POOL_SIZE_DEF;
 static int conn_pool_cache = DPVS_CONN_CACHE_SIZE_DEF;
+static int conn_sp_pool_size = DPVS_CONN_SP_POOL_SIZE_DEF;
 
 #define DPVS_CONN_INIT_TIMEOUT_DEF  3   /* sec */
 static int conn_init_timeout = DPVS_CONN_INIT_TIMEOUT_DEF;
@@ -59,6 +82,7 @@ static int conn_init_timeout = DPVS_CONN_INIT_TIMEOUT_DEF;
 #endif
 #define this_conn_count             (RTE_PER_LCORE(dp_vs_conn_count))
 #define this_conn_cache             (dp_vs_conn_cache[rte_socket_id()])
+#define this_conn_sp_cache          (dp_vs_conn_sp_cache[rte_socket_id()])
 
 /* dpvs control variables */
 static bool conn_expire_quiescent_template = false;
@@ -68,23 +92,52 @@ bool dp_vs_redirect_disable = true;
 /*
  * per-lcore dp_vs_conn{} hash table.
  */
-static RTE_DEFINE_PER_LCORE(struct list_head *, dp_vs_conn_tbl);
+static RTE_DEFINE_PER_LCORE(struct dp_vs_conn_tbl *, dp_vs_conn_tbl);
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
 static RTE_DEFINE_PER_LCORE(rte_spinlock_t, dp_vs_conn_lock);
 #endif
 
-/* global connection template table */
-static struct list_head *dp_vs_ct_tbl;
-static rte_spinlock_t dp_vs_ct_lock;
+/*
+ * global connection template table, shared by workers.
+ *
+ * buckets are hashed by <client network, vaddr, vport> and grouped into
+ * shards by the low bits of the hash. lookups take no lock: buckets are RCU
+ * lists of the in tuples, and a template is freed only after each worker has
+ * gone through its loop once (QSBR). adding and unlinking take the lock of
+ * the shard only.
+ *
+ * templates run no timer. users stamp last_seen with the global tick, and
+ * the master lcore scans a few shards per loop for the idle templates nobody
+ * holds, in a list per shard linked by the out tuples, which aren't hashed.
+ */
+struct dp_vs_ct_shard {
+    rte_spinlock_t          lock;
+    struct list_head        tmpls;      /* all templates of the shard */
+} __rte_cache_aligned;
 
+static struct list_head *dp_vs_ct_tbl;
+static struct dp_vs_ct_shard dp_vs_ct_shards[DPVS_CT_SHARDS];
+static struct rte_rcu_qsbr *dp_vs_ct_qsv;
+
+/* master lcore only: templates unlinked, and those waiting for workers */
+static struct list_head dp_vs_ct_expired;
+static struct list_head dp_vs_ct_reclaim;
+static uint64_t dp_vs_ct_reclaim_token;
+static uint32_t dp_vs_ct_scan_next;
+
+/* templates are allocated by workers and freed by the master lcore, so
+ * they're counted apart from the conns of each lcore */
+static rte_atomic32_t dp_vs_ct_count;
 static RTE_DEFINE_PER_LCORE(uint32_t, dp_vs_conn_count);
 
 static uint32_t dp_vs_conn_rnd; /* hash random */
 
 /*
- * memory pool for dp_vs_conn{}
+ * memory pool for dp_vs_conn{}, and for dp_vs_conn_synproxy{} of
+ * synproxy conns only.
  */
 static struct rte_mempool *dp_vs_conn_cache[DPVS_MAX_SOCKET];
+static struct rte_mempool *dp_vs_conn_sp_cache[DPVS_MAX_SOCKET];
 
 static int dp_vs_conn_expire(void *priv);
 
@@ -101,7 +154,10 @@ static struct dp_vs_conn *dp_vs_conn_alloc(enum dpvs_fwd_mode fwdmode,
 
     memset(conn, 0, sizeof(struct dp_vs_conn));
     conn->connpool = this_conn_cache;
-    this_conn_count++;
+    if (flags & DPVS_CONN_F_TEMPLATE)
+        rte_atomic32_inc(&dp_vs_ct_count);
+    else
+        this_conn_count++;
 
     /* no need to create redirect for the global template connection */
     if (likely((flags & DPVS_CONN_F_TEMPLATE) == 0))
@@ -109,6 +165,21 @@ static struct dp_vs_conn *dp_vs_conn_alloc(enum dpvs_fwd_mode fwdmode,
 
      conn->redirect = r;
 
+    /* synproxy part, for the whole life of the conn because of seq delta */
+    if ((flags & DPVS_CONN_F_SYNPROXY) && !(flags & DPVS_CONN_F_TEMPLATE)) {
+        if (unlikely(rte_mempool_get(this_conn_sp_cache,
+                                     (void **)&conn->synproxy) != 0)) {
+            RTE_LOG(ERR, IPVS, "%s: no memory for synproxy conn\n", __func__);
+            conn->synproxy = NULL;
+            dp_vs_redirect_free(conn);
+            rte_mempool_put(conn->connpool, conn);
+            this_conn_count--;
+            return NULL;
+        }
+        memset(conn->synproxy, 0, sizeof(struct dp_vs_conn_synproxy));
+        INIT_LIST_HEAD(&conn->synproxy->ack_mbuf);
+    }
+
     return conn;
 }
 
@@ -119,35 +190,58 @@ static void dp_vs_conn_free(struct dp_vs_conn *conn)
 
     dp_vs_redirect_free(conn);
 
+    if (conn->synproxy) {
+        rte_mempool_put(this_conn_sp_cache, conn->synproxy);
+        conn->synproxy = NULL;
+    }
+
+    if (conn->in_nh)
+        neigh_put(conn->in_nh);
+    if (conn->out_nh)
+        neigh_put(conn->out_nh);
+
+    if (conn->flags & DPVS_CONN_F_TEMPLATE)
+        rte_atomic32_dec(&dp_vs_ct_count);
+    else
+        this_conn_count--;
     rte_mempool_put(conn->connpool, conn);
-    this_conn_count--;
+}
+
+/* templates are stamped by workers and expired by the master lcore,
+ * skip the store if the tick is the same, the line is shared */
+static inline void dp_vs_ct_touch(struct dp_vs_conn *ct)
+{
+    dpvs_tick_t now = dpvs_timer_ticks(true);
+
+    if (ct->last_seen != now)
+        ct->last_seen = now;
 }
 
 static void dp_vs_conn_attach_timer(struct dp_vs_conn *conn, bool lock)
 {
     int rc;
 
+    /* expired by dp_vs_ct_expire_job() */
+    if (dp_vs_conn_is_template(conn)) {
+        dp_vs_ct_touch(conn);
+        return;
+    }
+
     if (dp_vs_conn_is_in_timer(conn))
         return;
 
     if (conn->flags & DPVS_CONN_F_ONE_PACKET) {
         return;
     }
-    if (dp_vs_conn_is_template(conn)) {
-        if (lock)
-            rc = dpvs_timer_sched(&conn->timer, &conn->timeout,
-                                  dp_vs_conn_expire, conn, true);
-        else
-            rc = dpvs_timer_sched_nolock(&conn->timer, &conn->timeout,
-                                  dp_vs_conn_expire, conn, true);
-    } else {
-        if (lock)
-            rc = dpvs_timer_sched(&conn->timer, &conn->timeout,
-                                  dp_vs_conn_expire, conn, false);
-        else
-            rc = dpvs_timer_sched_nolock(&conn->timer, &conn->timeout,
-                                  dp_vs_conn_expire, conn, false);
-    }
+
+    conn->last_seen = dpvs_timer_ticks(false);
+    conn->expires = conn->last_seen + timeval_to_ticks(&conn->timeout);
+    if (lock)
+        rc = dpvs_timer_sched(&conn->timer, &conn->timeout,
+                              dp_vs_conn_expire, conn, false);
+    else
+        rc = dpvs_timer_sched_nolock(&conn->timer, &conn->timeout,
+                              dp_vs_conn_expire, conn, false);
 
     if (rc == EDPVS_OK)
         dp_vs_conn_set_in_timer(conn);
@@ -160,24 +254,31 @@ static void dp_vs_conn_detach_timer(struct dp_vs_conn *conn, bool lock)
     if (!dp_vs_conn_is_in_timer(conn))
         return;
 
-    if (dp_vs_conn_is_template(conn)) {
-        if (lock)
-            rc = dpvs_timer_cancel(&conn->timer, true);
-        else
-            rc = dpvs_timer_cancel_nolock(&conn->timer, true);
-    } else {
-        if (lock)
-            rc = dpvs_timer_cancel(&conn->timer, false);
-        else
-            rc = dpvs_timer_cancel_nolock(&conn->timer, false);
-    }
+    if (lock)
+        rc = dpvs_timer_cancel(&conn->timer, false);
+    else
+        rc = dpvs_timer_cancel_nolock(&conn->timer, false);
 
     if (rc == EDPVS_OK)
         dp_vs_conn_clear_in_timer(conn);
 }
 
+/*
+ * per-lcore conns are refreshed lazily on the packet path: only the
+ * last-seen tick is stamped, and dp_vs_conn_expire() re-arms the timer
+ * for the remaining time when it fires. the timer is re-linked only if
+ * the new deadline is earlier than the armed one (e.g. a shorter timeout
+ * of the new state), or in timer handlers (@lock is false).
+ */
 static void dp_vs_conn_refresh_timer(struct dp_vs_conn *conn, bool lock)
 {
+    dpvs_tick_t now, expires;
+
+    if (dp_vs_conn_is_template(conn)) {
+        dp_vs_ct_touch(conn);
+        return;
+    }
+
     if (!dp_vs_conn_is_in_timer(conn))
         return;
 
@@ -185,17 +286,40 @@ static void dp_vs_conn_refresh_timer(struct dp_vs_conn *conn, bool lock)
         return;
     }
 
-    if (dp_vs_conn_is_template(conn)) {
-        if (lock)
-            dpvs_timer_update(&conn->timer, &conn->timeout, true);
-        else
-            dpvs_timer_update_nolock(&conn->timer, &conn->timeout, true);
-    } else {
-        if (lock)
-            dpvs_timer_update(&conn->timer, &conn->timeout, false);
-        else
-            dpvs_timer_update_nolock(&conn->timer, &conn->timeout, false);
-    }
+    now = dpvs_timer_ticks(false);
+    expires = now + timeval_to_ticks(&conn->timeout);
+    conn->last_seen = now;
+
+    if (likely(lock) && (int32_t)(expires - conn->expires) >= 0)
+        return;
+
+    if (lock)
+        dpvs_timer_update(&conn->timer, &conn->timeout, false);
+    else
+        dpvs_timer_update_nolock(&conn->timer, &conn->timeout, false);
+    conn->expires = expires;
+}
+
+/* re-arm the timer if the conn has seen packets since it's armed */
+static bool dp_vs_conn_lazy_rearm(struct dp_vs_conn *conn)
+{
+    dpvs_tick_t now, expires;
+    struct timeval delay;
+
+    if (dp_vs_conn_is_template(conn) || (conn->flags & DPVS_CONN_F_ONE_PACKET))
+        return false;
+
+    now = dpvs_timer_ticks(false);
+    expires = conn->last_seen + timeval_to_ticks(&conn->timeout);
+    if ((int32_t)(expires - now) <= 0)
+        return false;
+
+    ticks_to_timeval(expires - now, &delay);
+    if (dpvs_timer_update_nolock(&conn->timer, &delay, false) != EDPVS_OK)
+        return false;
+    conn->expires = expires;
+
+    return true;
 }
 
 static inline struct dp_vs_conn *
@@ -233,36 +357,90 @@ inline uint32_t dp_vs_conn_hashkey(int af,
     }
 }
 
-static inline int __dp_vs_conn_hash(struct dp_vs_conn *conn, uint32_t mask)
+static inline uint32_t conn_tuple_hashkey(const struct conn_tuple_hash *t,
+                                          uint32_t mask)
+{
+    return dp_vs_conn_hashkey(t->af, &t->saddr, t->sport,
+                              &t->daddr, t->dport, mask);
+}
+
+static inline struct dp_vs_ct_shard *dp_vs_ct_shard_of(uint32_t hash)
+{
+    return &dp_vs_ct_shards[hash & DPVS_CT_SHARD_MASK];
+}
+
+/* list_add() visible to lockless readers once they see @new */
+static inline void ct_list_add_rcu(struct list_head *new,
+                                   struct list_head *head)
+{
+    struct list_head *next = head->next;
+
+    new->next = next;
+    new->prev = head;
+    rte_smp_wmb();
+    head->next = new;
+    next->prev = new;
+}
+
+/* list_del() keeping ->next, readers may be still on @entry */
+static inline void ct_list_del_rcu(struct list_head *entry)
+{
+    __list_del(entry->prev, entry->next);
+    entry->prev = LIST_POISON2;
+}
+
+/* the template table holds a reference, and the template is HASHED */
+static void dp_vs_ct_hash(struct dp_vs_conn *ct)
+{
+    uint32_t hash = conn_tuple_hashkey(&tuplehash_in(ct), DPVS_CONN_TBL_MASK);
+    struct dp_vs_ct_shard *shard = dp_vs_ct_shard_of(hash);
+
+    rte_spinlock_lock(&shard->lock);
+    ct_list_add_rcu(&tuplehash_in(ct).list, &dp_vs_ct_tbl[hash]);
+    list_add(&tuplehash_out(ct).list, &shard->tmpls);
+    rte_spinlock_unlock(&shard->lock);
+}
+
+/* no more lookups of @ct, it's freed once idle as the others.
+ * lock the shard of @ct. */
+static inline void __dp_vs_ct_unhash(struct dp_vs_conn *ct)
+{
+    if (ct->flags & DPVS_CONN_F_HASHED) {
+        ct_list_del_rcu(&tuplehash_in(ct).list);
+        ct->flags &= ~DPVS_CONN_F_HASHED;
+    }
+}
+
+static void dp_vs_ct_unhash(struct dp_vs_conn *ct)
+{
+    uint32_t hash = conn_tuple_hashkey(&tuplehash_in(ct), DPVS_CONN_TBL_MASK);
+    struct dp_vs_ct_shard *shard = dp_vs_ct_shard_of(hash);
+
+    rte_spinlock_lock(&shard->lock);
+    __dp_vs_ct_unhash(ct);
+    rte_spinlock_unlock(&shard->lock);
+}
+
+static inline int __dp_vs_conn_hash(struct dp_vs_conn *conn)
 {
     uint32_t ihash, ohash;
 
     if (unlikely(conn->flags & DPVS_CONN_F_HASHED))
         return EDPVS_EXIST;
 
-    ihash = dp_vs_conn_hashkey(tuplehash_in(conn).af,
-                         &tuplehash_in(conn).saddr, tuplehash_in(conn).sport,
-                         &tuplehash_in(conn).daddr, tuplehash_in(conn).dport,
-                         mask);
-
-    ohash = dp_vs_conn_hashkey(tuplehash_out(conn).af,
-                         &tuplehash_out(conn).saddr, tuplehash_out(conn).sport,
-                         &tuplehash_out(conn).daddr, tuplehash_out(conn).dport,
-                         mask);
+    /* before a template is published to lockless readers */
+    conn->flags |= DPVS_CONN_F_HASHED;
+    rte_atomic32_inc(&conn->refcnt);
 
     if (dp_vs_conn_is_template(conn)) {
-        /* lock is complusory for template */
-        rte_spinlock_lock(&dp_vs_ct_lock);
-        list_add(&tuplehash_in(conn).list, &dp_vs_ct_tbl[ihash]);
-        list_add(&tuplehash_out(conn).list, &dp_vs_ct_tbl[ohash]);
-        rte_spinlock_unlock(&dp_vs_ct_lock);
+        dp_vs_ct_hash(conn);
     } else {
-        list_add(&tuplehash_in(conn).list, &this_conn_tbl[ihash]);
-        list_add(&tuplehash_out(conn).list, &this_conn_tbl[ohash]);
-    }
+        ihash = conn_tuple_hashkey(&tuplehash_in(conn), UINT32_MAX);
+        ohash = conn_tuple_hashkey(&tuplehash_out(conn), UINT32_MAX);
 
-    conn->flags |= DPVS_CONN_F_HASHED;
-    rte_atomic32_inc(&conn->refcnt);
+        dp_vs_conn_tbl_add(this_conn_tbl, &tuplehash_in(conn), ihash);
+        dp_vs_conn_tbl_add(this_conn_tbl, &tuplehash_out(conn), ohash);
+    }
 
     return EDPVS_OK;
 }
@@ -279,7 +457,7 @@ static inline int dp_vs_conn_hash(struct dp_vs_conn *conn)
     rte_spinlock_lock(&this_conn_lock);
 #endif
 
-    err = __dp_vs_conn_hash(conn, DPVS_CONN_TBL_MASK);
+    err = __dp_vs_conn_hash(conn);
 
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_unlock(&this_conn_lock);
@@ -303,15 +481,10 @@ static inline int dp_vs_conn_unhash(struct dp_vs_conn *conn)
         } else {
             dp_vs_redirect_unhash(conn);
 
-            if (dp_vs_conn_is_template(conn)) {
-                rte_spinlock_lock(&dp_vs_ct_lock);
-                list_del(&tuplehash_in(conn).list);
-                list_del(&tuplehash_out(conn).list);
-                rte_spinlock_unlock(&dp_vs_ct_lock);
-            } else {
-                list_del(&tuplehash_in(conn).list);
-                list_del(&tuplehash_out(conn).list);
-            }
+            dp_vs_conn_tbl_del(this_conn_tbl, &tuplehash_in(conn),
+                    conn_tuple_hashkey(&tuplehash_in(conn), UINT32_MAX));
+            dp_vs_conn_tbl_del(this_conn_tbl, &tuplehash_out(conn),
+                    conn_tuple_hashkey(&tuplehash_out(conn), UINT32_MAX));
             conn->flags &= ~DPVS_CONN_F_HASHED;
             rte_atomic32_dec(&conn->refcnt);
 
@@ -447,27 +620,23 @@ static inline void conn_tuplehash_dump(const char *msg,
             saddr, ntohs(t->sport), daddr, ntohs(t->dport));
 }
 
-static inline void conn_table_dump(void)
+static int conn_tuplehash_dump_cb(struct conn_tuple_hash *t, void *arg)
 {
-    int i;
-    struct conn_tuple_hash *tuphash;
+    conn_tuplehash_dump("        ", t);
+    return EDPVS_OK;
+}
 
-    RTE_LOG(DEBUG, IPVS, "Conn Table [%d]\n", rte_lcore_id());
+static inline void conn_table_dump(void)
+{
+    RTE_LOG(DEBUG, IPVS, "Conn Table [%d] tuples %u overflow %u\n",
+            rte_lcore_id(), this_conn_tbl->count, this_conn_tbl->ovf_count);
 
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_lock(&this_conn_lock);
 #endif
 
-    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++) {
-        if (list_empty(&this_conn_tbl[i]))
-            continue;
-
-        RTE_LOG(DEBUG, IPVS, "    hash %d\n", i);
-
-        list_for_each_entry(tuphash, &this_conn_tbl[i], list) {
-            conn_tuplehash_dump("        ", tuphash);
-        }
-    }
+    dp_vs_conn_tbl_walk(this_conn_tbl, 0, dp_vs_conn_tbl_slots(this_conn_tbl),
+                        conn_tuplehash_dump_cb, NULL);
 
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_unlock(&this_conn_lock);
@@ -541,7 +710,8 @@ static int dp_vs_conn_resend_packets(struct dp_vs_conn *conn,
     struct rte_mempool *pool;
     struct rte_mbuf *cloned_syn_mbuf;
 
-    if (conn->syn_mbuf && rte_atomic32_read(&conn->syn_retry_max) > 0) {
+    if (conn->synproxy && conn->synproxy->syn_mbuf &&
+            rte_atomic32_read(&conn->synproxy->syn_retry_max) > 0) {
         if (likely(conn->packet_xmit != NULL)) {
             pool = get_mbuf_pool(conn, DPVS_CONN_DIR_INBOUND);
 
@@ -550,7 +720,7 @@ static int dp_vs_conn_resend_packets(struct dp_vs_conn *conn,
                         "%s: no route for syn_proxy rs's syn retransmit\n",
                         __func__);
             } else {
-                cloned_syn_mbuf = mbuf_copy(conn->syn_mbuf, pool);
+                cloned_syn_mbuf = mbuf_copy(conn->synproxy->syn_mbuf, pool);
                 if (unlikely(!cloned_syn_mbuf)) {
                     RTE_LOG(WARNING, IPVS,
                             "%s: no memory for syn_proxy rs's syn retransmit\n",
@@ -562,7 +732,7 @@ static int dp_vs_conn_resend_packets(struct dp_vs_conn *conn,
             }
         }
 
-        rte_atomic32_dec(&conn->syn_retry_max);
+        rte_atomic32_dec(&conn->synproxy->syn_retry_max);
         dp_vs_estats_inc(SYNPROXY_RS_ERROR);
 
         return EDPVS_OK;
@@ -608,27 +778,33 @@ static void dp_vs_conn_sa_release(struct dp_vs_conn *conn)
         saddr6->sin6_port = conn->vport;
     }
 
-    sa_release(conn->out_dev, (struct sockaddr_storage *)&daddr,
+    sa_release(dp_vs_conn_nexthop_dev(conn, false),
+               (struct sockaddr_storage *)&daddr,
                (struct sockaddr_storage *)&saddr);
 }
 
 static void dp_vs_conn_free_packets(struct dp_vs_conn *conn)
 {
     struct dp_vs_synproxy_ack_pakcet *ack_mbuf, *t_ack_mbuf;
+    struct dp_vs_conn_synproxy *sp = conn->synproxy;
+
+    if (!sp)
+        return;
 
     /* free stored ack packet */
-    list_for_each_entry_safe(ack_mbuf, t_ack_mbuf, &conn->ack_mbuf, list) {
+    list_for_each_entry_safe(ack_mbuf, t_ack_mbuf, &sp->ack_mbuf, list) {
         list_del_init(&ack_mbuf->list);
         rte_pktmbuf_free(ack_mbuf->mbuf);
         sp_dbg_stats32_dec(sp_ack_saved);
         rte_mempool_put(this_ack_mbufpool, ack_mbuf);
     }
 
-    conn->ack_num = 0;
+    sp->ack_num = 0;
 
     /* free stored syn mbuf */
-    if (conn->syn_mbuf) {
-        rte_pktmbuf_free(conn->syn_mbuf);
+    if (sp->syn_mbuf) {
+        rte_pktmbuf_free(sp->syn_mbuf);
+        sp->syn_mbuf = NULL;
         sp_dbg_stats32_dec(sp_syn_saved);
     }
 }
@@ -643,6 +819,14 @@ static int dp_vs_conn_expire(void *priv)
     assert(conn->af == AF_INET || conn->af == AF_INET6);
     assert(rte_atomic32_read(&conn->refcnt) > 0);
 
+    /* refreshed lazily by traffic, not timed out yet */
+    if (dp_vs_conn_lazy_rearm(conn)) {
+        /* once per timeout, keeps the conn alive on the backup */
+        if (dp_vs_sync_send_enable)
+            dp_vs_sync_conn(conn, DP_VS_SYNC_CONN_SET);
+        return DTIMER_OK;
+    }
+
     pp = dp_vs_proto_lookup(conn->proto);
     dp_vs_conn_set_timeout(conn, pp);
     dpvs_time_rand_delay(&conn->timeout, 1000000);
@@ -679,6 +863,9 @@ static int dp_vs_conn_expire(void *priv)
         if (pp && pp->conn_expire)
             pp->conn_expire(pp, conn);
 
+        dp_vs_conn_persist_drop(conn);
+        if (dp_vs_sync_send_enable)
+            dp_vs_sync_conn(conn, DP_VS_SYNC_CONN_DEL);
         dp_vs_conn_sa_release(conn);
         dp_vs_conn_unbind_dest(conn);
         dp_vs_laddr_unbind(conn);
@@ -722,80 +909,82 @@ void dp_vs_conn_expire_now(struct dp_vs_conn *conn)
     conn->timeout.tv_usec = 0;
 
     /* no need to call 'dpvs_timer_update', because timer would
-     * be updated in 'dp_vs_conn_put' later */
+     * be updated in 'dp_vs_conn_put' later, the earlier deadline
+     * bypasses the lazy refresh */
     return;
 }
 
-static void conn_flush(void)
+static int conn_flush_cb(struct conn_tuple_hash *tuphash, void *arg)
 {
-    struct conn_tuple_hash *tuphash, *next;
-    struct dp_vs_conn *conn;
-    int i;
+    struct dp_vs_conn *conn = tuplehash_to_conn(tuphash);
 
-#ifdef CONFIG_DPVS_IPVS_CONN_LOCK
-    rte_spinlock_lock(&this_conn_lock);
-#endif
-    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++) {
-        list_for_each_entry_safe(tuphash, next, &this_conn_tbl[i], list) {
-            conn = tuplehash_to_conn(tuphash);
-
-            dp_vs_conn_detach_timer(conn, true);
+    dp_vs_conn_detach_timer(conn, true);
 
-            rte_atomic32_inc(&conn->refcnt);
-            if (rte_atomic32_read(&conn->refcnt) != 2) {
-                rte_atomic32_dec(&conn->refcnt);
+    rte_atomic32_inc(&conn->refcnt);
+    if (rte_atomic32_read(&conn->refcnt) != 2) {
+        rte_atomic32_dec(&conn->refcnt);
+    } else {
+        dp_vs_conn_unhash(conn);
+
+        if (conn->dest->fwdmode == DPVS_FWD_MODE_SNAT &&
+                conn->proto != IPPROTO_ICMP &&
+                conn->proto != IPPROTO_ICMPV6) {
+            struct sockaddr_storage daddr, saddr;
+            memset(&daddr, 0, sizeof(daddr));
+            memset(&saddr, 0, sizeof(saddr));
+
+            if (AF_INET == conn->af) {
+                struct sockaddr_in *daddr4 = (struct sockaddr_in *)&daddr;
+                struct sockaddr_in *saddr4 = (struct sockaddr_in *)&saddr;
+
+                daddr4->sin_family = AF_INET;
+                daddr4->sin_addr = conn->caddr.in;
+                daddr4->sin_port = conn->cport;
+
+                saddr4->sin_family = AF_INET;
+                saddr4->sin_addr = conn->vaddr.in;
+                saddr4->sin_port = conn->vport;
+            } else if (AF_INET6 == conn->af) {
+                struct sockaddr_in6 *daddr6 = (struct sockaddr_in6 *)&daddr;
+                struct sockaddr_in6 *saddr6 = (struct sockaddr_in6 *)&saddr;
+
+                daddr6->sin6_family = AF_INET6;
+                daddr6->sin6_addr = conn->caddr.in6;
+                daddr6->sin6_port = conn->cport;
+
+                saddr6->sin6_family = AF_INET6;
+                saddr6->sin6_addr = conn->vaddr.in6;
+                saddr6->sin6_port = conn->cport;
             } else {
-                dp_vs_conn_unhash(conn);
-
-                if (conn->dest->fwdmode == DPVS_FWD_MODE_SNAT &&
-                        conn->proto != IPPROTO_ICMP &&
-                        conn->proto != IPPROTO_ICMPV6) {
-                    struct sockaddr_storage daddr, saddr;
-                    memset(&daddr, 0, sizeof(daddr));
-                    memset(&saddr, 0, sizeof(saddr));
-
-                    if (AF_INET == conn->af) {
-                        struct sockaddr_in *daddr4 = (struct sockaddr_in *)&daddr;
-                        struct sockaddr_in *saddr4 = (struct sockaddr_in *)&saddr;
-
-                        daddr4->sin_family = AF_INET;
-                        daddr4->sin_addr = conn->caddr.in;
-                        daddr4->sin_port = conn->cport;
-
-                        saddr4->sin_family = AF_INET;
-                        saddr4->sin_addr = conn->vaddr.in;
-                        saddr4->sin_port = conn->vport;
-                    } else if (AF_INET6 == conn->af) {
-                        struct sockaddr_in6 *daddr6 = (struct sockaddr_in6 *)&daddr;
-                        struct sockaddr_in6 *saddr6 = (struct sockaddr_in6 *)&saddr;
-
-                        daddr6->sin6_family = AF_INET6;
-                        daddr6->sin6_addr = conn->caddr.in6;
-                        daddr6->sin6_port = conn->cport;
-
-                        saddr6->sin6_family = AF_INET6;
-                        saddr6->sin6_addr = conn->vaddr.in6;
-                        saddr6->sin6_port = conn->cport;
-                    } else {
-                        RTE_LOG(WARNING, IPVS, "%s: conn address family %d "
-                                "not supported!\n", __func__, conn->af);
-                    }
-                    sa_release(conn->out_dev, (struct sockaddr_storage *)&daddr,
-                              (struct sockaddr_storage *)&saddr);
-                }
+                RTE_LOG(WARNING, IPVS, "%s: conn address family %d "
+                        "not supported!\n", __func__, conn->af);
+            }
+            sa_release(dp_vs_conn_nexthop_dev(conn, false),
+                       (struct sockaddr_storage *)&daddr,
+                       (struct sockaddr_storage *)&saddr);
+        }
 
-                dp_vs_conn_unbind_dest(conn);
-                dp_vs_laddr_unbind(conn);
-                rte_atomic32_dec(&conn->refcnt);
+        dp_vs_conn_unbind_dest(conn);
+        dp_vs_laddr_unbind(conn);
+        rte_atomic32_dec(&conn->refcnt);
 
-                dp_vs_conn_free(conn);
+        dp_vs_conn_free(conn);
 
 #ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
-                conn_stats_dump("conn flush", conn);
+        conn_stats_dump("conn flush", conn);
 #endif
-            }
-        }
     }
+
+    return EDPVS_OK;
+}
+
+static void conn_flush(void)
+{
+#ifdef CONFIG_DPVS_IPVS_CONN_LOCK
+    rte_spinlock_lock(&this_conn_lock);
+#endif
+    dp_vs_conn_tbl_walk(this_conn_tbl, 0, dp_vs_conn_tbl_slots(this_conn_tbl),
+                        conn_flush_cb, NULL);
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_unlock(&this_conn_lock);
 #endif
@@ -881,21 +1070,9 @@ struct dp_vs_conn *dp_vs_conn_new(struct rte_mbuf *mbuf,
     new->dport  = rport;
     new->outwall = param->outwall;
 
-    /* neighbour confirm cache */
-    if (AF_INET == tuplehash_in(new).af) {
-        new->in_nexthop.in.s_addr = htonl(INADDR_ANY);
-    } else {
-        new->in_nexthop.in6 = in6addr_any;
-    }
-
-    if (AF_INET == tuplehash_out(new).af) {
-        new->out_nexthop.in.s_addr = htonl(INADDR_ANY);
-    } else {
-        new->out_nexthop.in6 = in6addr_any;
-    }
-
-    new->in_dev = NULL;
-    new->out_dev = NULL;
+    /* held by xmit */
+    new->in_nh = NULL;
+    new->out_nh = NULL;
 
     /* Controll member */
     new->control = NULL;
@@ -935,11 +1112,7 @@ struct dp_vs_conn *dp_vs_conn_new(struct rte_mbuf *mbuf,
     new->timeout.tv_usec = 0;
 
     /* synproxy */
-    INIT_LIST_HEAD(&new->ack_mbuf);
-    rte_atomic32_set(&new->syn_retry_max, 0);
-    rte_atomic32_set(&new->dup_ack_cnt, 0);
-
-    if ((flags & DPVS_CONN_F_SYNPROXY) && !dp_vs_conn_is_template(new)) {
+    if (new->synproxy) {
         struct tcphdr _tcph, *th = NULL;
         struct dp_vs_synproxy_ack_pakcet *ack_mbuf;
         struct dp_vs_proto *pp;
@@ -956,12 +1129,12 @@ struct dp_vs_conn *dp_vs_conn_new(struct rte_mbuf *mbuf,
             goto unbind_laddr;
         }
         ack_mbuf->mbuf = mbuf;
-        list_add_tail(&ack_mbuf->list, &new->ack_mbuf);
-        new->ack_num++;
+        list_add_tail(&ack_mbuf->list, &new->synproxy->ack_mbuf);
+        new->synproxy->ack_num++;
         sp_dbg_stats32_inc(sp_ack_saved);
 
         /* save ack_seq - 1 */
-        new->syn_proxy_seq.isn =
+        new->synproxy->syn_proxy_seq.isn =
             htonl((uint32_t) ((ntohl(th->ack_seq) - 1)));
 
         /* save ack_seq */
@@ -979,6 +1152,11 @@ struct dp_vs_conn *dp_vs_conn_new(struct rte_mbuf *mbuf,
     dpvs_time_rand_delay(&new->timeout, 1000000);
     dp_vs_conn_attach_timer(new, true);
 
+    if (dp_vs_conn_persist_enable)
+        dp_vs_conn_persist_save(new);
+    if (dp_vs_sync_send_enable)
+        dp_vs_sync_conn(new, DP_VS_SYNC_CONN_SET);
+
 #ifdef CONFIG_DPVS_IPVS_DEBUG
     conn_dump("new conn: ", new);
 #endif
@@ -993,12 +1171,374 @@ errout:
     return NULL;
 }
 
+/*
+ * build a conn from its image, a record of conn persistence or session sync,
+ * binding dest and laddr/lport again by address. NULL if its service, dest
+ * or laddr isn't configured (yet).
+ */
+static struct dp_vs_conn *dp_vs_conn_rebuild(const struct conn_persist_rec *rec)
+{
+    struct dp_vs_service *svc;
+    struct dp_vs_dest *dest;
+    struct dp_vs_conn *conn;
+    struct conn_tuple_hash *t;
+    bool outwall = false;
+    int err;
+
+    svc = dp_vs_service_lookup(rec->af, rec->proto, &rec->vaddr, rec->vport,
+                               0, NULL, NULL, &outwall, rte_lcore_id());
+    if (!svc)
+        return NULL;
+
+    dest = dp_vs_dest_lookup(rec->daf, svc, &rec->daddr, rec->dport);
+    if (!dest || dest->fwdmode != rec->fwdmode)
+        return NULL;
+
+    conn = dp_vs_conn_alloc(dest->fwdmode, rec->flags & DPVS_CONN_F_SYNPROXY);
+    if (unlikely(!conn))
+        return NULL;
+
+    conn->flags = rec->flags & (DPVS_CONN_F_SYNPROXY | DPVS_CONN_F_INACTIVE
+                                | DPVS_CONN_F_EXPIRE_QUIESCENT
+                                | DPVS_CONN_F_NOFASTXMIT);
+
+    t = &tuplehash_in(conn);
+    t->direct   = DPVS_CONN_DIR_INBOUND;
+    t->af       = rec->af;
+    t->proto    = rec->proto;
+    t->saddr    = rec->caddr;
+    t->sport    = rec->cport;
+    t->daddr    = rec->vaddr;
+    t->dport    = rec->vport;
+    INIT_LIST_HEAD(&t->list);
+
+    t = &tuplehash_out(conn);
+    t->direct   = DPVS_CONN_DIR_OUTBOUND;
+    t->af       = rec->daf;
+    t->proto    = rec->proto;
+    t->saddr    = rec->daddr;
+    t->sport    = rec->dport;
+    t->daddr    = rec->laddr;
+    t->dport    = rec->lport;
+    INIT_LIST_HEAD(&t->list);
+
+    conn->af    = rec->af;
+    conn->proto = rec->proto;
+    conn->caddr = rec->caddr;
+    conn->cport = rec->cport;
+    conn->vaddr = rec->vaddr;
+    conn->vport = rec->vport;
+    conn->laddr = rec->laddr;
+    conn->lport = rec->lport;
+    conn->daddr = rec->daddr;
+    conn->dport = rec->dport;
+    conn->outwall = rec->outwall;
+
+    /* devices and nexthops are resolved again by the xmit path */
+    conn->in_nh = NULL;
+    conn->out_nh = NULL;
+
+    conn->control = NULL;
+    rte_atomic32_clear(&conn->n_control);
+    rte_atomic32_set(&conn->refcnt, 1);
+
+    err = dp_vs_conn_bind_dest(conn, dest);
+    if (err != EDPVS_OK)
+        goto errout;
+
+    /* bound as an inactive conn, account it as it was */
+    conn->flags &= ~DPVS_CONN_F_INACTIVE;
+    conn->flags |= rec->flags & DPVS_CONN_F_INACTIVE;
+    if (!(conn->flags & DPVS_CONN_F_INACTIVE)) {
+        rte_atomic32_dec(&dest->inactconns);
+        rte_atomic32_inc(&dest->actconns);
+    }
+
+    dp_vs_redirect_init(conn);
+
+    if ((err = dp_vs_conn_hash(conn)) != EDPVS_OK)
+        goto unbind_dest;
+
+    /* last, so that an lport held for the record is never given back */
+    if (dest->fwdmode == DPVS_FWD_MODE_FNAT) {
+        if ((err = dp_vs_laddr_rebind(conn, svc, rec->reserved)) != EDPVS_OK)
+            goto unhash;
+    }
+
+    conn->state         = rec->state;
+    conn->old_state     = rec->state;
+    conn->fnat_seq      = rec->fnat_seq;
+    conn->rs_end_seq    = rec->rs_end_seq;
+    conn->rs_end_ack    = rec->rs_end_ack;
+    conn->timeout.tv_sec = rec->timeout;
+    conn->timeout.tv_usec = 0;
+    if (conn->synproxy)
+        conn->synproxy->syn_proxy_seq = rec->syn_proxy_seq;
+
+#ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
+    conn->ctime = rte_rdtsc();
+#endif
+
+#ifdef CONFIG_TIMER_DEBUG
+    snprintf(conn->timer.name, sizeof(conn->timer.name), "%s", "conn");
+#endif
+    dp_vs_conn_attach_timer(conn, true);
+
+#ifdef CONFIG_DPVS_IPVS_DEBUG
+    conn_dump("rebuild conn: ", conn);
+#endif
+    return conn;
+
+unhash:
+    dp_vs_conn_unhash(conn);
+unbind_dest:
+    dp_vs_conn_unbind_dest(conn);
+errout:
+    dp_vs_conn_free(conn);
+    return NULL;
+}
+
+/*
+ * rebuild the conn of a record left by the previous dpvs, see
+ * ipvs/conn_persist.h. the record stays pending if it can't be rebuilt.
+ */
+static struct dp_vs_conn *dp_vs_conn_restore(int af, uint16_t proto,
+            const union inet_addr *saddr, const union inet_addr *daddr,
+            uint16_t sport, uint16_t dport, int *dir)
+{
+    const struct conn_persist_rec *rec;
+    struct dp_vs_conn *conn;
+    uint32_t slot;
+    int rdir;
+
+    rec = dp_vs_conn_persist_lookup(af, proto, saddr, daddr, sport, dport,
+                                    &slot, &rdir);
+    if (!rec)
+        return NULL;
+
+    conn = dp_vs_conn_rebuild(rec);
+    if (!conn)
+        return NULL;
+
+    dp_vs_conn_persist_claim(conn, slot);
+    if (dir)
+        *dir = rdir;
+
+    return conn;
+}
+
+/* install, refresh or expire the conn of a sync record, see ipvs/sync.h */
+int dp_vs_conn_sync_recv(const struct conn_persist_rec *rec, bool del)
+{
+    struct dp_vs_conn *conn;
+    struct dp_vs_dest *dest;
+
+    conn = dp_vs_conn_get(rec->af, rec->proto, &rec->caddr, &rec->vaddr,
+                          rec->cport, rec->vport, NULL, false);
+    if (del) {
+        if (!conn)
+            return EDPVS_NOTEXIST;
+        /* the conn is ours since traffic came to it */
+        if (conn->flags & DPVS_CONN_F_SYNCED)
+            dp_vs_conn_expire_now(conn);
+        dp_vs_conn_put(conn);
+        return EDPVS_OK;
+    }
+
+    if (!conn) {
+        conn = dp_vs_conn_rebuild(rec);
+        if (!conn)
+            return EDPVS_NOTEXIST;
+        /* not synced back to the peer, see dp_vs_sync_conn() */
+        conn->flags |= DPVS_CONN_F_SYNCED;
+    } else if (!(conn->flags & DPVS_CONN_F_SYNCED)) {
+        /* ours, the peer's copy is stale, e.g. after a takeover */
+        dp_vs_conn_put(conn);
+        return EDPVS_OK;
+    } else {
+        /* account the state as tcp_state_trans() does */
+        dest = conn->dest;
+        if (dest && (conn->flags & DPVS_CONN_F_INACTIVE)
+                && !(rec->flags & DPVS_CONN_F_INACTIVE)) {
+            rte_atomic32_inc(&dest->actconns);
+            rte_atomic32_dec(&dest->inactconns);
+            conn->flags &= ~DPVS_CONN_F_INACTIVE;
+        } else if (dest && !(conn->flags & DPVS_CONN_F_INACTIVE)
+                && (rec->flags & DPVS_CONN_F_INACTIVE)) {
+            rte_atomic32_dec(&dest->actconns);
+            rte_atomic32_inc(&dest->inactconns);
+            conn->flags |= DPVS_CONN_F_INACTIVE;
+        }
+
+        conn->state         = rec->state;
+        conn->old_state     = rec->state;
+        conn->fnat_seq      = rec->fnat_seq;
+        conn->timeout.tv_sec = rec->timeout;
+        conn->timeout.tv_usec = 0;
+        if (conn->synproxy)
+            conn->synproxy->syn_proxy_seq = rec->syn_proxy_seq;
+    }
+
+    if (dp_vs_conn_persist_enable)
+        dp_vs_conn_persist_save(conn);
+
+    /* refreshes the timer with the timeout of the record */
+    dp_vs_conn_put(conn);
+    return EDPVS_OK;
+}
+
+/*
+ * burst lookup hints.
+ *
+ * tuples of a whole RX burst are parsed and hashed in one pass, and the
+ * buckets and candidate tuples of the conn table are prefetched before the
+ * packets are delivered one by one. dp_vs_conn_get() then takes the hash of
+ * the packet being delivered from the hint instead of computing it again,
+ * so that the conn table misses of the burst overlap with each other.
+ * netif calls them through netif_burst_ops.
+ */
+struct dp_vs_conn_hint {
+    uint8_t             af;     /* AF_UNSPEC if no hint */
+    uint8_t             proto;
+    uint16_t            sport;
+    uint16_t            dport;
+    uint32_t            hash;
+    union inet_addr     saddr;
+    union inet_addr     daddr;
+};
+
+static struct dp_vs_conn_hint dp_vs_conn_hints[DPVS_MAX_LCORE][NETIF_MAX_PKT_BURST];
+static RTE_DEFINE_PER_LCORE(struct dp_vs_conn_hint *, dp_vs_conn_cur_hint);
+#define this_conn_hints             (dp_vs_conn_hints[rte_lcore_id()])
+#define this_conn_cur_hint          (RTE_PER_LCORE(dp_vs_conn_cur_hint))
+
+static inline bool conn_hint_parse(struct rte_mbuf *mbuf,
+                                   struct dp_vs_conn_hint *h)
+{
+    uint16_t off = sizeof(struct rte_ether_hdr);
+    struct rte_ether_hdr *eth;
+    struct rte_ipv4_hdr *iph4;
+    struct rte_ipv6_hdr *iph6;
+    uint16_t *ports;
+
+    eth = rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr *);
+
+    if (eth->ether_type == htons(RTE_ETHER_TYPE_IPV4)) {
+        if (unlikely(mbuf->data_len < off + sizeof(*iph4)))
+            return false;
+        iph4 = rte_pktmbuf_mtod_offset(mbuf, struct rte_ipv4_hdr *, off);
+        if (ip4_is_frag(iph4) || (iph4->next_proto_id != IPPROTO_TCP
+                    && iph4->next_proto_id != IPPROTO_UDP))
+            return false;
+        off += (iph4->version_ihl & RTE_IPV4_HDR_IHL_MASK) << 2;
+        h->af = AF_INET;
+        h->proto = iph4->next_proto_id;
+        h->saddr.in.s_addr = iph4->src_addr;
+        h->daddr.in.s_addr = iph4->dst_addr;
+    } else if (eth->ether_type == htons(RTE_ETHER_TYPE_IPV6)) {
+        if (unlikely(mbuf->data_len < off + sizeof(*iph6)))
+            return false;
+        iph6 = rte_pktmbuf_mtod_offset(mbuf, struct rte_ipv6_hdr *, off);
+        /* extension headers are left to the slow path */
+        if (iph6->proto != IPPROTO_TCP && iph6->proto != IPPROTO_UDP)
+            return false;
+        off += sizeof(*iph6);
+        h->af = AF_INET6;
+        h->proto = iph6->proto;
+        memcpy(&h->saddr.in6, iph6->src_addr, sizeof(struct in6_addr));
+        memcpy(&h->daddr.in6, iph6->dst_addr, sizeof(struct in6_addr));
+    } else {
+        return false;
+    }
+
+    if (unlikely(mbuf->data_len < off + 2 * sizeof(uint16_t))) {
+        h->af = AF_UNSPEC;
+        return false;
+    }
+    ports = rte_pktmbuf_mtod_offset(mbuf, uint16_t *, off);
+    h->sport = ports[0];
+    h->dport = ports[1];
+
+    return true;
+}
+
+static void dp_vs_conn_prefetch_burst(struct rte_mbuf **mbufs, uint16_t count)
+{
+    uint16_t i;
+    struct dp_vs_conn_hint *h;
+    struct dp_vs_conn_tbl *tbl = this_conn_tbl;
+
+    this_conn_cur_hint = NULL;
+
+    if (unlikely(!tbl))
+        return;
+    count = RTE_MIN(count, (uint16_t)NETIF_MAX_PKT_BURST);
+
+    /* the packets netif prefetched, and the later ones as far ahead */
+    for (i = 0; i < count; i++) {
+        if (i + NETIF_PKT_PREFETCH_OFFSET < count)
+            rte_prefetch0(rte_pktmbuf_mtod(mbufs[i + NETIF_PKT_PREFETCH_OFFSET],
+                                           void *));
+        h = &this_conn_hints[i];
+        h->af = AF_UNSPEC;
+        conn_hint_parse(mbufs[i], h);
+    }
+
+    /* independent hash computations of the burst pipeline well */
+    for (i = 0; i < count; i++) {
+        h = &this_conn_hints[i];
+        if (h->af == AF_UNSPEC)
+            continue;
+        h->hash = dp_vs_conn_hashkey(h->af, &h->saddr, h->sport,
+                                     &h->daddr, h->dport, UINT32_MAX);
+        dp_vs_conn_tbl_prefetch(tbl, h->hash);
+    }
+
+    /* buckets are on the way, prefetch tuples with matching signature */
+    for (i = 0; i < count; i++) {
+        h = &this_conn_hints[i];
+        if (h->af != AF_UNSPEC)
+            dp_vs_conn_tbl_prefetch_tuple(tbl, h->hash);
+    }
+}
+
+static void dp_vs_conn_burst_select(uint16_t idx)
+{
+    if (idx < NETIF_MAX_PKT_BURST && this_conn_hints[idx].af != AF_UNSPEC)
+        this_conn_cur_hint = &this_conn_hints[idx];
+    else
+        this_conn_cur_hint = NULL;
+}
+
+static const struct netif_burst_ops dp_vs_conn_burst_ops = {
+    .prepare    = dp_vs_conn_prefetch_burst,
+    .select     = dp_vs_conn_burst_select,
+};
+
+static inline bool conn_hint_hash(int af, uint16_t proto,
+                                  const union inet_addr *saddr,
+                                  const union inet_addr *daddr,
+                                  uint16_t sport, uint16_t dport,
+                                  uint32_t *hash)
+{
+    const struct dp_vs_conn_hint *h = this_conn_cur_hint;
+
+    if (!h || h->af != af || h->proto != proto
+            || h->sport != sport || h->dport != dport
+            || !inet_addr_equal(af, &h->saddr, saddr)
+            || !inet_addr_equal(af, &h->daddr, daddr))
+        return false;
+
+    *hash = h->hash;
+    return true;
+}
+
 /**
  * try lookup and hold dp_vs_conn{} by packet tuple
  *
  *  <af, proto, saddr, sport, daddr, dport>.
  *
- * dp_vs_conn_tab[] for current lcore will be looked up.
+ * dp_vs_conn_tbl of current lcore will be looked up.
  * return conn found and direction as well or NULL if not exist.
  */
 struct dp_vs_conn *dp_vs_conn_get(int af, uint16_t proto,
@@ -1012,54 +1552,38 @@ struct dp_vs_conn *dp_vs_conn_get(int af, uint16_t proto,
     char sbuf[64], dbuf[64];
 #endif
 
-    if (unlikely(reverse)) {
-        hash = dp_vs_conn_hashkey(af, daddr, dport, saddr, sport,
-                            DPVS_CONN_TBL_MASK);
-    } else {
-        hash = dp_vs_conn_hashkey(af, saddr, sport, daddr, dport,
-                            DPVS_CONN_TBL_MASK);
-    }
-
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_lock(&this_conn_lock);
 #endif
     if (unlikely(reverse)) { /* swap source/dest for lookup */
-        list_for_each_entry(tuphash, &this_conn_tbl[hash], list) {
-            if (tuphash->sport == dport
-                    && tuphash->dport == sport
-                    && inet_addr_equal(af, &tuphash->saddr, daddr)
-                    && inet_addr_equal(af, &tuphash->daddr, saddr)
-                    && tuphash->proto == proto
-                    && tuphash->af == af) {
-                /* hit */
-                conn = tuplehash_to_conn(tuphash);
-                rte_atomic32_inc(&conn->refcnt);
-                if (dir)
-                    *dir = tuphash->direct;
-                break;
-            }
-        }
+        hash = dp_vs_conn_hashkey(af, daddr, dport, saddr, sport, UINT32_MAX);
+        tuphash = dp_vs_conn_tbl_lookup(this_conn_tbl, hash, af, proto,
+                                        daddr, saddr, dport, sport);
     } else {
-        list_for_each_entry(tuphash, &this_conn_tbl[hash], list) {
-            if (tuphash->sport == sport
-                    && tuphash->dport == dport
-                    && inet_addr_equal(af, &tuphash->saddr, saddr)
-                    && inet_addr_equal(af, &tuphash->daddr, daddr)
-                    && tuphash->proto == proto
-                    && tuphash->af == af) {
-                /* hit */
-                conn = tuplehash_to_conn(tuphash);
-                rte_atomic32_inc(&conn->refcnt);
-                if (dir)
-                    *dir = tuphash->direct;
-                break;
-            }
-        }
+        if (!conn_hint_hash(af, proto, saddr, daddr, sport, dport, &hash))
+            hash = dp_vs_conn_hashkey(af, saddr, sport, daddr, dport, UINT32_MAX);
+        tuphash = dp_vs_conn_tbl_lookup(this_conn_tbl, hash, af, proto,
+                                        saddr, daddr, sport, dport);
+    }
+
+    if (tuphash) {
+        /* hit */
+        conn = tuplehash_to_conn(tuphash);
+        rte_atomic32_inc(&conn->refcnt);
+        if (dir)
+            *dir = tuphash->direct;
     }
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_unlock(&this_conn_lock);
 #endif
 
+    if (unlikely(!conn && dp_vs_conn_persist_pending())) {
+        if (unlikely(reverse))
+            conn = dp_vs_conn_restore(af, proto, daddr, saddr, dport, sport, dir);
+        else
+            conn = dp_vs_conn_restore(af, proto, saddr, daddr, sport, dport, dir);
+    }
+
 #ifdef CONFIG_DPVS_IPVS_DEBUG
     RTE_LOG(DEBUG, IPVS, "conn lookup: [%d] %s %s/%d -> %s/%d %s %s\n",
             rte_lcore_id(), inet_proto_name(proto),
@@ -1071,7 +1595,26 @@ struct dp_vs_conn *dp_vs_conn_get(int af, uint16_t proto,
     return conn;
 }
 
-/* get reference to connection template */
+/* take a reference unless the expirer has taken the last one */
+static inline bool dp_vs_ct_get_unless_zero(struct dp_vs_conn *ct)
+{
+    int32_t cnt;
+
+    do {
+        cnt = rte_atomic32_read(&ct->refcnt);
+        if (unlikely(cnt == 0))
+            return false;
+    } while (!rte_atomic32_cmpset((volatile uint32_t *)&ct->refcnt.cnt,
+                                  cnt, cnt + 1));
+
+    return true;
+}
+
+/*
+ * get reference to connection template, lockless.
+ * the caller is a worker, which reports its quiescent state between packets,
+ * or the master lcore, which is the only one freeing templates.
+ */
 struct dp_vs_conn *dp_vs_ct_in_get(int af, uint16_t proto,
         const union inet_addr *saddr, const union inet_addr *daddr,
         uint16_t sport, uint16_t dport)
@@ -1087,7 +1630,6 @@ struct dp_vs_conn *dp_vs_ct_in_get(int af, uint16_t proto,
     hash = dp_vs_conn_hashkey(af, saddr, sport, daddr, dport,
                               DPVS_CONN_TBL_MASK);
 
-    rte_spinlock_lock(&dp_vs_ct_lock);
     list_for_each_entry(tuphash, &dp_vs_ct_tbl[hash], list) {
         conn = tuplehash_to_conn(tuphash);
         if (tuphash->sport == sport && tuphash->dport == dport
@@ -1096,13 +1638,11 @@ struct dp_vs_conn *dp_vs_ct_in_get(int af, uint16_t proto,
                 && dp_vs_conn_is_template(conn)
                 && tuphash->proto == proto
                 && tuphash->af == af) {
-            /* hit */
-            rte_atomic32_inc(&conn->refcnt);
-            isHit = true;
+            /* hit, unless it's expiring */
+            isHit = dp_vs_ct_get_unless_zero(conn);
             break;
         }
     }
-    rte_spinlock_unlock(&dp_vs_ct_lock);
 
 #ifdef CONFIG_DPVS_IPVS_DEBUG
     RTE_LOG(DEBUG, IPVS, "conn-template lookup: [%d] %s %s/%d -> %s/%d %s\n",
@@ -1141,17 +1681,9 @@ int dp_vs_check_template(struct dp_vs_conn *ct)
                 inet_ntop(ct->af, &ct->daddr, dbuf, sizeof(dbuf)) ? dbuf : "::",
                 ntohs(ct->dport));
 #endif
-        /* invalidate the connection */
-        if (ct->vport != htons(0xffff)) {
-            if (dp_vs_conn_unhash(ct) == EDPVS_OK) {
-                ct->dport = htons(0xffff);
-                ct->vport = htons(0xffff);
-                ct->lport = 0;
-                ct->cport = 0;
-                dp_vs_conn_hash(ct);
-            }
-        }
-        /* simply decrease the refcnt of the template, do not restart its timer */
+        /* invalidate the connection, lookups miss it from now on */
+        dp_vs_ct_unhash(ct);
+        /* simply decrease the refcnt of the template, do not stamp it */
         dp_vs_conn_put_no_reset(ct);
         return 0;
     }
@@ -1185,30 +1717,159 @@ static void dp_vs_conn_put_nolock(struct dp_vs_conn *conn)
     rte_atomic32_dec(&conn->refcnt);
 }
 
-static int conn_init_lcore(void *arg)
+/* idle templates nobody holds or is controlled by are unlinked */
+static void dp_vs_ct_expire_shard(struct dp_vs_ct_shard *shard,
+                                  dpvs_tick_t now)
+{
+    struct conn_tuple_hash *tuphash, *next;
+    struct dp_vs_conn *ct;
+
+    rte_spinlock_lock(&shard->lock);
+    list_for_each_entry_safe(tuphash, next, &shard->tmpls, list) {
+        ct = tuplehash_to_conn(tuphash);
+        if ((int32_t)(now - ct->last_seen - timeval_to_ticks(&ct->timeout)) < 0)
+            continue;
+
+        /* the table's reference is the last one, take it so that
+         * lookups can't get it any more */
+        if (rte_atomic32_read(&ct->n_control) ||
+                !rte_atomic32_cmpset((volatile uint32_t *)&ct->refcnt.cnt, 1, 0))
+            continue;
+        /* got controlled by a user put after the check */
+        if (unlikely(rte_atomic32_read(&ct->n_control))) {
+            rte_atomic32_set(&ct->refcnt, 1);
+            continue;
+        }
+
+        __dp_vs_ct_unhash(ct);
+        list_move_tail(&tuphash->list, &dp_vs_ct_expired);
+    }
+    rte_spinlock_unlock(&shard->lock);
+}
+
+/* free the templates once workers are through the grace period */
+static void dp_vs_ct_reclaim_expired(void)
+{
+    struct conn_tuple_hash *tuphash, *next;
+    struct dp_vs_conn *ct;
+
+    if (!list_empty(&dp_vs_ct_reclaim)) {
+        if (rte_rcu_qsbr_check(dp_vs_ct_qsv, dp_vs_ct_reclaim_token, false) != 1)
+            return;
+
+        list_for_each_entry_safe(tuphash, next, &dp_vs_ct_reclaim, list) {
+            ct = tuplehash_to_conn(tuphash);
+            list_del(&tuphash->list);
+#ifdef CONFIG_DPVS_IPVS_DEBUG
+            conn_dump("del conn: ", ct);
+#endif
+            dp_vs_conn_unbind_dest(ct);
+            dp_vs_conn_free(ct);
+        }
+    }
+
+    if (!list_empty(&dp_vs_ct_expired)) {
+        list_splice_init(&dp_vs_ct_expired, &dp_vs_ct_reclaim);
+        dp_vs_ct_reclaim_token = rte_rcu_qsbr_start(dp_vs_ct_qsv);
+    }
+}
+
+static void dp_vs_ct_expire_job(void *arg)
 {
     int i;
+    dpvs_tick_t now = dpvs_timer_ticks(true);
+
+    for (i = 0; i < DPVS_CT_SCAN_SHARDS; i++) {
+        dp_vs_ct_expire_shard(&dp_vs_ct_shards[dp_vs_ct_scan_next], now);
+        dp_vs_ct_scan_next = (dp_vs_ct_scan_next + 1) & DPVS_CT_SHARD_MASK;
+    }
+
+    dp_vs_ct_reclaim_expired();
+}
 
+/* no template pointer is kept across loops */
+static void dp_vs_ct_quiescent_job(void *arg)
+{
+    rte_rcu_qsbr_quiescent(dp_vs_ct_qsv, rte_lcore_id());
+}
+
+static struct dpvs_lcore_job dp_vs_ct_job_master = {
+    .name       = "ipvs_ct_expire",
+    .type       = LCORE_JOB_SLOW,
+    .func       = dp_vs_ct_expire_job,
+    .skip_loops = DPVS_CT_SCAN_LOOPS,
+};
+
+static struct dpvs_lcore_job dp_vs_ct_job_worker = {
+    .name       = "ipvs_ct_quiescent",
+    .type       = LCORE_JOB_LOOP,
+    .func       = dp_vs_ct_quiescent_job,
+};
+
+static int dp_vs_ct_init(void)
+{
+    int i, err;
+    size_t size;
+
+    dp_vs_ct_tbl = rte_malloc(NULL, sizeof(struct list_head) * DPVS_CONN_TBL_SIZE,
+            RTE_CACHE_LINE_SIZE);
+    if (!dp_vs_ct_tbl)
+        return EDPVS_NOMEM;
+
+    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++)
+        INIT_LIST_HEAD(&dp_vs_ct_tbl[i]);
+
+    for (i = 0; i < DPVS_CT_SHARDS; i++) {
+        rte_spinlock_init(&dp_vs_ct_shards[i].lock);
+        INIT_LIST_HEAD(&dp_vs_ct_shards[i].tmpls);
+    }
+    INIT_LIST_HEAD(&dp_vs_ct_expired);
+    INIT_LIST_HEAD(&dp_vs_ct_reclaim);
+    rte_atomic32_init(&dp_vs_ct_count);
+
+    /* workers register by lcore id in conn_init_lcore() */
+    size = rte_rcu_qsbr_get_memsize(DPVS_MAX_LCORE);
+    dp_vs_ct_qsv = rte_zmalloc("dp_vs_ct_qsv", size, RTE_CACHE_LINE_SIZE);
+    if (!dp_vs_ct_qsv)
+        return EDPVS_NOMEM;
+    if (rte_rcu_qsbr_init(dp_vs_ct_qsv, DPVS_MAX_LCORE) != 0)
+        return EDPVS_INVAL;
+
+    err = dpvs_lcore_job_register(&dp_vs_ct_job_worker, LCORE_ROLE_FWD_WORKER);
+    if (err != EDPVS_OK)
+        return err;
+    err = dpvs_lcore_job_register(&dp_vs_ct_job_master, LCORE_ROLE_MASTER);
+    if (err != EDPVS_OK) {
+        dpvs_lcore_job_unregister(&dp_vs_ct_job_worker, LCORE_ROLE_FWD_WORKER);
+        return err;
+    }
+
+    return EDPVS_OK;
+}
+
+static int conn_init_lcore(void *arg)
+{
     if (!rte_lcore_is_enabled(rte_lcore_id()))
         return EDPVS_DISABLED;
 
     if (!netif_lcore_is_fwd_worker(rte_lcore_id()))
         return EDPVS_IDLE;
 
-    this_conn_tbl = rte_malloc(NULL,
-                        sizeof(struct list_head) * DPVS_CONN_TBL_SIZE,
-                        RTE_CACHE_LINE_SIZE);
+    this_conn_tbl = dp_vs_conn_tbl_create(DPVS_CONN_BKT_SIZE,
+                        DPVS_CONN_OVF_SIZE, rte_socket_id());
     if (!this_conn_tbl)
         return EDPVS_NOMEM;
 
-    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++)
-        INIT_LIST_HEAD(&this_conn_tbl[i]);
-
 #ifdef CONFIG_DPVS_IPVS_CONN_LOCK
     rte_spinlock_init(&this_conn_lock);
 #endif
     this_conn_count = 0;
 
+    /* readers of the template table */
+    if (rte_rcu_qsbr_thread_register(dp_vs_ct_qsv, rte_lcore_id()) != 0)
+        return EDPVS_INVAL;
+    rte_rcu_qsbr_thread_online(dp_vs_ct_qsv, rte_lcore_id());
+
     return EDPVS_OK;
 }
 
@@ -1220,7 +1881,7 @@ static int conn_term_lcore(void *arg)
     conn_flush();
 
     if (this_conn_tbl) {
-        rte_free(this_conn_tbl);
+        dp_vs_conn_tbl_destroy(this_conn_tbl);
         this_conn_tbl = NULL;
     }
 
@@ -1232,15 +1893,31 @@ static int conn_term_lcore(void *arg)
  *     ipvsadm -ln -c
  *     ipvsadm -ln -c --sockpair af:proto:sip:sport:tip:tport
  *     ipvsadm -ln -c --persistent-conn
+ *
+ * Conns are listed incrementally. Each MSG_TYPE_CONN_GET_ALL msg walks at
+ * most DPVS_CONN_DUMP_SLOTS slots of a worker's table and returns where it
+ * stopped, so a worker never spends more than a bounded time on a dump in
+ * one loop. The template table is walked the same way, one lock hold at a
+ * time. Filters are applied on the worker, only matched conns are copied.
  */
-struct ip_vs_conn_array_list {
-    int head;
-    int tail;
-    struct list_head ca_list;
-    ipvs_conn_entry_t array[0];
+#define DPVS_CONN_DUMP_SLOTS        256     /* conn table slots per msg */
+#define DPVS_CT_DUMP_SLOTS          4096    /* template lists per lock hold */
+#define DPVS_CONN_DUMP_STEPS        64      /* msgs or lock holds per sockopt */
+
+struct conn_dump_req {
+    uint32_t                    cursor;
+    uint32_t                    skip;
+    uint32_t                    max;
+    struct ip_vs_conn_filter    filter;
 };
 
-static struct list_head conn_to_dump;
+struct conn_dump_ctx {
+    const struct ip_vs_conn_filter *filter;
+    struct ip_vs_conn_array     *arr;
+    uint32_t                    max;
+    uint32_t                    skip;   /* tuples of the slot to pass over */
+    uint32_t                    seen;   /* tuples of the slot visited */
+};
 
 static inline char* get_conn_state_name(uint16_t proto, uint16_t state)
 {
@@ -1388,148 +2065,209 @@ static int sockopt_conn_get_specified(const struct ip_vs_conn_req *conn_req,
     return EDPVS_NOTEXIST;
 }
 
-/* call me on the same lcore as the conn table,
- * lock me if the conn table is global
- * */
-static int __lcore_conn_table_dump(const struct list_head *cplist)
+static bool conn_filter_match(const struct ip_vs_conn_filter *filter,
+                              const struct dp_vs_conn *conn)
 {
-    int i;
-    struct conn_tuple_hash *tuphash;
+    if (filter->proto && filter->proto != conn->proto)
+        return false;
+    if (filter->vport && filter->vport != conn->vport)
+        return false;
+    if (filter->dport && filter->dport != conn->dport)
+        return false;
+
+    if (filter->vaf && (filter->vaf != tuplehash_in(conn).af ||
+                !inet_addr_equal(filter->vaf, &filter->vaddr, &conn->vaddr)))
+        return false;
+    if (filter->daf && (filter->daf != tuplehash_out(conn).af ||
+                !inet_addr_equal(filter->daf, &filter->daddr, &conn->daddr)))
+        return false;
+    if (filter->caf && (filter->caf != tuplehash_in(conn).af ||
+                !inet_addr_same_net(filter->caf, filter->cplen,
+                                    &filter->caddr, &conn->caddr)))
+        return false;
+
+    if (filter->state[0] && strncmp(filter->state,
+                get_conn_state_name(conn->proto, conn->state),
+                sizeof(filter->state)))
+        return false;
+
+    return true;
+}
+
+static int __conn_tuple_dump(struct conn_tuple_hash *tuphash, void *arg)
+{
+    struct conn_dump_ctx *ctx = arg;
     struct dp_vs_conn *conn;
-    struct ip_vs_conn_array_list *cparr = NULL;
-
-    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++) {
-        list_for_each_entry(tuphash, &cplist[i], list) {
-            if (tuphash->direct != DPVS_CONN_DIR_INBOUND)
-                continue;
-            conn = tuplehash_to_conn(tuphash);
-            if (unlikely(cparr == NULL || cparr->tail >= MAX_CTRL_CONN_GET_ENTRIES)) {
-                cparr = rte_zmalloc("conn_ctrl", sizeof(struct ip_vs_conn_array_list)
-                        + MAX_CTRL_CONN_GET_ENTRIES * sizeof(ipvs_conn_entry_t), 0);
-                if (unlikely(cparr == NULL))
-                    return EDPVS_NOMEM;
-                cparr->head = cparr->tail = 0;
-            }
-            sockopt_fill_conn_entry(conn, &cparr->array[cparr->tail++]);
-            if (cparr->tail >= MAX_CTRL_CONN_GET_ENTRIES) {
-                RTE_LOG(DEBUG, IPVS, "%s: adding %d elems to conn_to_dump list -- "
-                        "%p:%d-%d\n", __func__, cparr->tail - cparr->head, cparr,
-                        cparr->head, cparr->tail);
-                list_add_tail(&cparr->ca_list, &conn_to_dump);
-            }
-        }
+
+    if (ctx->skip) {
+        ctx->skip--;
+        ctx->seen++;
+        return EDPVS_OK;
     }
-    if (cparr && cparr->tail < MAX_CTRL_CONN_GET_ENTRIES) {
-        RTE_LOG(DEBUG, IPVS, "%s: adding %d elems to conn_to_dump list -- "
-                "%p:%d-%d\n", __func__, cparr->tail - cparr->head, cparr,
-                cparr->head, cparr->tail);
-        list_add_tail(&cparr->ca_list, &conn_to_dump);
+
+    if (tuphash->direct == DPVS_CONN_DIR_INBOUND) {
+        conn = tuplehash_to_conn(tuphash);
+        if (conn_filter_match(ctx->filter, conn)) {
+            if (ctx->arr->nconns >= ctx->max)
+                return EDPVS_NOROOM;
+            sockopt_fill_conn_entry(conn, &ctx->arr->array[ctx->arr->nconns]);
+            ctx->arr->nconns++;
+        }
     }
+    ctx->seen++;
+
     return EDPVS_OK;
 }
 
-static int sockopt_conn_get_all(const struct ip_vs_conn_req *conn_req,
-        struct ip_vs_conn_array *conn_arr)
+/*
+ * Walk the template table from (@cursor, @skip) until the reply is full or
+ * DPVS_CT_DUMP_SLOTS lists are done, and save where to continue.
+ * each list is walked under the lock of its shard.
+ */
+static void __ct_table_dump(const struct list_head *cplist,
+                            struct conn_dump_ctx *ctx,
+                            uint32_t *cursor, uint32_t *skip)
 {
-    int n, res, got = 0;
-    struct ip_vs_conn_array_list *larr, *next_larr;
-    struct dpvs_msg *msg;
-    lcoreid_t cid = conn_req->whence;
-
-again:
-    list_for_each_entry_safe(larr, next_larr, &conn_to_dump, ca_list) {
-        RTE_LOG(DEBUG, IPVS, "%s: printing conn_to_dump list(len=%d) --"
-                "%p:%d-%d\n", __func__, list_elems(&conn_to_dump), larr,
-                larr->head, larr->tail);
-        n = larr->tail - larr->head;
-        assert(n > 0);
-        if (n > MAX_CTRL_CONN_GET_ENTRIES - got) {
-            memcpy(&conn_arr->array[got], &larr->array[larr->head],
-                    (MAX_CTRL_CONN_GET_ENTRIES - got) * sizeof(ipvs_conn_entry_t));
-            larr->head += MAX_CTRL_CONN_GET_ENTRIES - got;
-            got += MAX_CTRL_CONN_GET_ENTRIES - got;
-
-            assert(got == MAX_CTRL_CONN_GET_ENTRIES);
-            conn_arr->nconns = got;
-            /* small chance that all done here, we assign GET_IPVS_CONN_RESL_MORE
-             * flag for simplicity here anyway */
-            conn_arr->resl = GET_IPVS_CONN_RESL_OK | GET_IPVS_CONN_RESL_MORE;
-            conn_arr->curcid = cid;
-            return EDPVS_OK;
-        } else {
-            memcpy(&conn_arr->array[got], &larr->array[larr->head],
-                    n * sizeof(ipvs_conn_entry_t));
-            larr->head += n;
-            assert(larr->head == larr->tail);
-            list_del_init(&larr->ca_list);
-            rte_free(larr);
-            got += n;
-            if (got == MAX_CTRL_CONN_GET_ENTRIES) {
-                conn_arr->nconns = got;
-                /* low chance that all done here, we assign GET_IPVS_CONN_RESL_MORE
-                 * flag for simplicity here anyway */
-                conn_arr->resl = GET_IPVS_CONN_RESL_OK | GET_IPVS_CONN_RESL_MORE;
-                conn_arr->curcid = cid;
-                return EDPVS_OK;
-            }
+    uint32_t n;
+    int err;
+    struct conn_tuple_hash *tuphash;
+    struct dp_vs_ct_shard *shard;
+
+    ctx->skip = *skip;
+    for (n = 0; n < DPVS_CT_DUMP_SLOTS && *cursor < DPVS_CONN_TBL_SIZE; n++) {
+        ctx->seen = 0;
+        err = EDPVS_OK;
+        shard = dp_vs_ct_shard_of(*cursor);
+        rte_spinlock_lock(&shard->lock);
+        list_for_each_entry(tuphash, &cplist[*cursor], list) {
+            if ((err = __conn_tuple_dump(tuphash, ctx)) != EDPVS_OK)
+                break;
         }
+        rte_spinlock_unlock(&shard->lock);
+        if (err != EDPVS_OK) {
+            *skip = ctx->seen;
+            return;
+        }
+        (*cursor)++;
+        ctx->skip = 0;
     }
+    *skip = 0;
+}
 
-    if ((conn_req->flag & GET_IPVS_CONN_FLAG_TEMPLATE)
-            && (cid == rte_get_main_lcore())) { /* persist conns */
-        rte_spinlock_lock(&dp_vs_ct_lock);
-        res = __lcore_conn_table_dump(dp_vs_ct_tbl);
-        rte_spinlock_unlock(&dp_vs_ct_lock);
-        if (res != EDPVS_OK) {
-            conn_arr->nconns = got;
-            conn_arr->resl = GET_IPVS_CONN_RESL_FAIL;
-            conn_arr->curcid = cid;
-            return res;
+/*
+ * The same as __ct_table_dump() for a per-lcore conn table, at most
+ * DPVS_CONN_DUMP_SLOTS slots are walked.
+ * call me on the same lcore as the conn table.
+ */
+static void __lcore_conn_table_dump(struct dp_vs_conn_tbl *tbl,
+                                    struct conn_dump_ctx *ctx,
+                                    uint32_t *cursor, uint32_t *skip)
+{
+    uint32_t n, next, slots = dp_vs_conn_tbl_slots(tbl);
+
+    ctx->skip = *skip;
+    for (n = 0; n < DPVS_CONN_DUMP_SLOTS && *cursor < slots; n++) {
+        ctx->seen = 0;
+        next = dp_vs_conn_tbl_walk(tbl, *cursor, 1, __conn_tuple_dump, ctx);
+        if (next == *cursor) { /* reply is full */
+            *skip = ctx->seen;
+            return;
         }
-        cid++;
-        goto again;
+        *cursor = next;
+        ctx->skip = 0;
     }
+    *skip = 0;
+}
 
-    if (conn_req->flag & GET_IPVS_CONN_FLAG_TEMPLATE) {
-        conn_arr->nconns = got;
+static int sockopt_conn_get_all(const struct ip_vs_conn_req *conn_req,
+        struct ip_vs_conn_array *conn_arr)
+{
+    int step, res = EDPVS_OK;
+    lcoreid_t cid = conn_req->whence;
+    uint32_t cursor = conn_req->cursor, skip = conn_req->skip;
+    struct conn_dump_ctx ctx = {
+        .filter = &conn_req->filter,
+        .arr    = conn_arr,
+        .max    = MAX_CTRL_CONN_GET_ENTRIES,
+    };
+    struct conn_dump_req dump_req;
+    struct dpvs_msg *msg;
+    struct dpvs_msg_reply *reply;
+    struct ip_vs_conn_array *resp_conn;
+
+    conn_arr->nconns = 0;
+
+    if (conn_req->flag & GET_IPVS_CONN_FLAG_TEMPLATE) { /* persist conns */
+        for (step = 0; step < DPVS_CONN_DUMP_STEPS && cursor < DPVS_CONN_TBL_SIZE
+                && conn_arr->nconns < MAX_CTRL_CONN_GET_ENTRIES; step++) {
+            __ct_table_dump(dp_vs_ct_tbl, &ctx, &cursor, &skip);
+        }
         conn_arr->resl = GET_IPVS_CONN_RESL_OK;
+        if (cursor < DPVS_CONN_TBL_SIZE)
+            conn_arr->resl |= GET_IPVS_CONN_RESL_MORE;
         conn_arr->curcid = 0;
+        conn_arr->cursor = cursor;
+        conn_arr->skip = skip;
         return EDPVS_OK;
     }
 
-    for ( ; cid < DPVS_MAX_LCORE; cid++)
-        if (g_slave_lcore_mask & (1UL << cid))
+    for (step = 0; step < DPVS_CONN_DUMP_STEPS
+            && conn_arr->nconns < MAX_CTRL_CONN_GET_ENTRIES; step++) {
+        for ( ; cid < DPVS_MAX_LCORE; cid++)
+            if (g_slave_lcore_mask & (1UL << cid))
+                break;
+        if (cid >= DPVS_MAX_LCORE)
             break;
-    if (cid >= DPVS_MAX_LCORE) {
-        conn_arr->nconns = got;
-        conn_arr->resl = GET_IPVS_CONN_RESL_OK;
-        conn_arr->curcid = 0;
-        return EDPVS_OK;
-    }
 
-    /* get conns table from cid and saved into dump list */
-    msg = msg_make(MSG_TYPE_CONN_GET_ALL, 0, DPVS_MSG_UNICAST, rte_lcore_id(), 0, NULL);
-    /* FIXME: When conns in session table are not many enough, blockable msg would get
-     * timeout probably due to the traverse of the whole huge session table.  So non-
-     * blockable msg is used. A more elegant solution is to use an upper time limit for
-     * the session table access in this case, which is much more complicated. */
-    res = msg_send(msg, cid, DPVS_MSG_F_ASYNC, NULL);
-    while (!test_msg_flags(msg, DPVS_MSG_F_STATE_FIN|DPVS_MSG_F_STATE_DROP))
-        ; /* wait until msg processed */
-
-    if (res != EDPVS_OK || test_msg_flags(msg, DPVS_MSG_F_STATE_DROP|
-                DPVS_MSG_F_CALLBACK_FAIL)) {
-        RTE_LOG(WARNING, IPVS, "%s: fail to get lcore%d's connection table -- %s\n",
-                __func__, (int)cid, dpvs_strerror(res));
-        conn_arr->nconns = got;
-        conn_arr->resl = GET_IPVS_CONN_RESL_FAIL;
-        conn_arr->curcid = cid;
+        dump_req.cursor = cursor;
+        dump_req.skip = skip;
+        dump_req.max = MAX_CTRL_CONN_GET_ENTRIES - conn_arr->nconns;
+        dump_req.filter = conn_req->filter;
+
+        msg = msg_make(MSG_TYPE_CONN_GET_ALL, 0, DPVS_MSG_UNICAST, rte_lcore_id(),
+                sizeof(dump_req), &dump_req);
+        if (unlikely(msg == NULL)) {
+            res = EDPVS_NOMEM;
+            break;
+        }
+        /* the walk is bounded, it's safe to wait for the reply */
+        res = msg_send(msg, cid, 0, &reply);
+        if (res != EDPVS_OK || !reply->data || reply->len < sizeof(*resp_conn)) {
+            RTE_LOG(WARNING, IPVS, "%s: fail to get lcore%d's connection table -- %s\n",
+                    __func__, (int)cid, dpvs_strerror(res));
+            msg_destroy(&msg);
+            if (res == EDPVS_OK)
+                res = EDPVS_MSG_FAIL;
+            break;
+        }
+
+        resp_conn = (struct ip_vs_conn_array *)reply->data;
+        assert(resp_conn->nconns <= dump_req.max);
+        memcpy(&conn_arr->array[conn_arr->nconns], resp_conn->array,
+                resp_conn->nconns * sizeof(ipvs_conn_entry_t));
+        conn_arr->nconns += resp_conn->nconns;
+
+        if (resp_conn->resl & GET_IPVS_CONN_RESL_MORE) {
+            cursor = resp_conn->cursor;
+            skip = resp_conn->skip;
+        } else {
+            cid++;
+            cursor = skip = 0;
+        }
         msg_destroy(&msg);
-        return res;
     }
-    msg_destroy(&msg);
-    cid++;
-    goto again;
+
+    if (res != EDPVS_OK)
+        conn_arr->resl = GET_IPVS_CONN_RESL_FAIL;
+    else if (cid < DPVS_MAX_LCORE)
+        conn_arr->resl = GET_IPVS_CONN_RESL_OK | GET_IPVS_CONN_RESL_MORE;
+    else
+        conn_arr->resl = GET_IPVS_CONN_RESL_OK;
+    conn_arr->curcid = cid < DPVS_MAX_LCORE ? cid : 0;
+    conn_arr->cursor = cursor;
+    conn_arr->skip = skip;
+
+    return res;
 }
 
 static int sockopt_conn_get(sockoptid_t opt, const void *in, size_t inlen,
@@ -1564,13 +2302,10 @@ static int sockopt_conn_get(sockoptid_t opt, const void *in, size_t inlen,
         {
             if (!(conn_req->flag & (GET_IPVS_CONN_FLAG_ALL|GET_IPVS_CONN_FLAG_MORE)))
                 return EDPVS_INVAL;
-            if (!(conn_req->flag & GET_IPVS_CONN_FLAG_MORE)) {
-                struct ip_vs_conn_array_list *calst, *tcalst;
-                list_for_each_entry_safe(calst, tcalst, &conn_to_dump, ca_list) {
-                    list_del_init(&calst->ca_list);
-                    rte_free(calst);
-                }
-            }
+            if (conn_req->filter.caf && (conn_req->filter.cplen < 1 ||
+                        conn_req->filter.cplen > (conn_req->filter.caf == AF_INET
+                                                  ? 32 : 128)))
+                return EDPVS_INVAL;
 
             arr_size = sizeof(struct ip_vs_conn_array) + MAX_CTRL_CONN_GET_ENTRIES *
                 sizeof(ipvs_conn_entry_t);
@@ -1653,7 +2388,41 @@ static int conn_get_msgcb_slave(struct dpvs_msg *msg)
 
 static int conn_get_all_msgcb_slave(struct dpvs_msg *msg)
 {
-    return  __lcore_conn_table_dump(this_conn_tbl);
+    const struct conn_dump_req *dump_req;
+    struct ip_vs_conn_array *reply_data;
+    struct conn_dump_ctx ctx;
+    uint32_t cursor, skip;
+
+    assert(msg->len == sizeof(struct conn_dump_req));
+    dump_req = (struct conn_dump_req *)&msg->data[0];
+    if (unlikely(!dump_req->max || dump_req->max > MAX_CTRL_CONN_GET_ENTRIES))
+        return EDPVS_INVAL;
+
+    reply_data = msg_reply_alloc(sizeof(struct ip_vs_conn_array) +
+            dump_req->max * sizeof(ipvs_conn_entry_t));
+    if (unlikely(!reply_data))
+        return EDPVS_NOMEM;
+    memset(reply_data, 0, sizeof(struct ip_vs_conn_array));
+
+    ctx.filter = &dump_req->filter;
+    ctx.arr = reply_data;
+    ctx.max = dump_req->max;
+    cursor = dump_req->cursor;
+    skip = dump_req->skip;
+    __lcore_conn_table_dump(this_conn_tbl, &ctx, &cursor, &skip);
+
+    reply_data->resl = GET_IPVS_CONN_RESL_OK;
+    if (cursor < dp_vs_conn_tbl_slots(this_conn_tbl))
+        reply_data->resl |= GET_IPVS_CONN_RESL_MORE;
+    reply_data->curcid = rte_lcore_id();
+    reply_data->cursor = cursor;
+    reply_data->skip = skip;
+
+    msg->reply.len = sizeof(struct ip_vs_conn_array) +
+        reply_data->nconns * sizeof(ipvs_conn_entry_t);
+    msg->reply.data = reply_data;
+
+    return EDPVS_OK;
 }
 
 static int register_conn_get_msg(void)
@@ -1735,8 +2504,6 @@ static int conn_ctrl_init(void)
 {
     int err;
 
-    INIT_LIST_HEAD(&conn_to_dump);
-
     if ((err = register_conn_get_msg()) != EDPVS_OK)
         return err;
 
@@ -1751,13 +2518,6 @@ static int conn_ctrl_init(void)
 
 static void conn_ctrl_term(void)
 {
-    struct ip_vs_conn_array_list *calst, *tcalst;
-
-    list_for_each_entry_safe(calst, tcalst, &conn_to_dump, ca_list) {
-        list_del_init(&calst->ca_list);
-        rte_free(calst);
-    }
-
     sockopt_unregister(&conn_sockopts);
     unregister_conn_get_msg();
 }
@@ -1769,19 +2529,12 @@ int dp_vs_conn_init(void)
     char poolname[32];
 
     /* init connection template table */
-    dp_vs_ct_tbl = rte_malloc(NULL, sizeof(struct list_head) * DPVS_CONN_TBL_SIZE,
-            RTE_CACHE_LINE_SIZE);
-    if (!dp_vs_ct_tbl) {
-        err = EDPVS_NOMEM;
+    if ((err = dp_vs_ct_init()) != EDPVS_OK) {
         RTE_LOG(WARNING, IPVS, "%s: %s.\n",
             __func__, dpvs_strerror(err));
         return err;
     }
 
-    for (i = 0; i < DPVS_CONN_TBL_SIZE; i++)
-        INIT_LIST_HEAD(&dp_vs_ct_tbl[i]);
-    rte_spinlock_init(&dp_vs_ct_lock);
-
     /*
      * unlike linux per_cpu() which can assign CPU number,
      * RTE_PER_LCORE() can only access own instances.
@@ -1810,10 +2563,29 @@ int dp_vs_conn_init(void)
             err = EDPVS_NOMEM;
             goto cleanup;
         }
+
+        snprintf(poolname, sizeof(poolname), "dp_vs_conn_sp_%d", i);
+        dp_vs_conn_sp_cache[i] = rte_mempool_create(poolname,
+                                    conn_sp_pool_size ? : conn_pool_size,
+                                    sizeof(struct dp_vs_conn_synproxy),
+                                    conn_pool_cache,
+                                    0, NULL, NULL, NULL, NULL,
+                                    i, 0);
+        if (!dp_vs_conn_sp_cache[i]) {
+            err = EDPVS_NOMEM;
+            goto cleanup;
+        }
     }
 
     dp_vs_conn_rnd = (uint32_t)random();
 
+    /* after the conn tables, before any conn */
+    if ((err = dp_vs_conn_persist_init()) != EDPVS_OK)
+        goto cleanup;
+
+    if ((err = netif_register_burst_ops(&dp_vs_conn_burst_ops)) != EDPVS_OK)
+        goto cleanup;
+
     return EDPVS_OK;
 
 cleanup:
@@ -1825,6 +2597,10 @@ int dp_vs_conn_term(void)
 {
     lcoreid_t lcore;
 
+    /* templates are left to the process exit as the mempools */
+    dpvs_lcore_job_unregister(&dp_vs_ct_job_master, LCORE_ROLE_MASTER);
+    dpvs_lcore_job_unregister(&dp_vs_ct_job_worker, LCORE_ROLE_FWD_WORKER);
+
     /* no API opposite to rte_mempool_create() */
 
     rte_eal_mp_remote_launch(conn_term_lcore, NULL, SKIP_MAIN);
@@ -1832,6 +2608,11 @@ int dp_vs_conn_term(void)
         rte_eal_wait_lcore(lcore);
     }
 
+    netif_unregister_burst_ops(&dp_vs_conn_burst_ops);
+
+    /* records of the flushed conns are kept for the next dpvs */
+    dp_vs_conn_persist_term();
+
     conn_ctrl_term();
 
     return EDPVS_OK;
@@ -1842,11 +2623,41 @@ int dp_vs_conn_pool_size(void)
     return conn_pool_size;
 }
 
+/* each conn has a timer */
+static uint32_t conn_timer_size(void)
+{
+    return conn_pool_size;
+}
+
 int dp_vs_conn_pool_cache_size(void)
 {
     return conn_pool_cache;
 }
 
+void dp_vs_conn_mem_info(eal_mem_conn_ret_t *info)
+{
+    int i;
+
+    memset(info, 0, sizeof(*info));
+    info->conn_size = sizeof(struct dp_vs_conn);
+    info->synproxy_size = sizeof(struct dp_vs_conn_synproxy);
+
+    for (i = 0; i < get_numa_nodes(); i++) {
+        if (dp_vs_conn_cache[i]) {
+            info->conn_elt_size = rte_mempool_calc_obj_size(
+                    dp_vs_conn_cache[i]->elt_size, dp_vs_conn_cache[i]->flags, NULL);
+            info->conn_pool_size += dp_vs_conn_cache[i]->size;
+            info->conn_pool_used += rte_mempool_in_use_count(dp_vs_conn_cache[i]);
+        }
+        if (dp_vs_conn_sp_cache[i]) {
+            info->synproxy_elt_size = rte_mempool_calc_obj_size(
+                    dp_vs_conn_sp_cache[i]->elt_size, dp_vs_conn_sp_cache[i]->flags, NULL);
+            info->synproxy_pool_size += dp_vs_conn_sp_cache[i]->size;
+            info->synproxy_pool_used += rte_mempool_in_use_count(dp_vs_conn_sp_cache[i]);
+        }
+    }
+}
+
 static void conn_pool_size_handler(vector_t tokens)
 {
     char *str = set_value(tokens);
@@ -1869,6 +2680,28 @@ static void conn_pool_size_handler(vector_t tokens)
     FREE_PTR(str);
 }
 
+static void conn_sp_pool_size_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int pool_size;
+
+    assert(str);
+
+    pool_size = atoi(str);
+
+    if (pool_size < DPVS_CONN_SP_POOL_SIZE_MIN) {
+        RTE_LOG(WARNING, IPVS, "invalid synproxy_pool_size %s, using conn_pool_size\n",
+                str);
+        conn_sp_pool_size = DPVS_CONN_SP_POOL_SIZE_DEF;
+    } else {
+        is_power2(pool_size, 1, &pool_size);
+        RTE_LOG(INFO, IPVS, "synproxy_pool_size = %d (round to 2^n-1)\n", pool_size);
+        conn_sp_pool_size = pool_size - 1;
+    }
+
+    FREE_PTR(str);
+}
+
 static void conn_pool_cache_handler(vector_t tokens)
 {
     char *str = set_value(tokens);
@@ -1940,7 +2773,9 @@ void ipvs_conn_keyword_value_init(void)
         /* KW_TYPE_INIT keyword */
         conn_pool_size = DPVS_CONN_POOL_SIZE_DEF;
         conn_pool_cache = DPVS_CONN_CACHE_SIZE_DEF;
+        conn_sp_pool_size = DPVS_CONN_SP_POOL_SIZE_DEF;
         dp_vs_redirect_disable = true;
+        dp_vs_frag_enable = false;
     }
     /* KW_TYPE_NORMAL keyword */
     conn_init_timeout = DPVS_CONN_INIT_TIMEOUT_DEF;
@@ -1949,13 +2784,20 @@ void ipvs_conn_keyword_value_init(void)
 
 void install_ipvs_conn_keywords(void)
 {
+    /* the keywords are installed before the timer module is initialized,
+     * which sizes its wheels by conn_pool_size */
+    dpvs_timer_size_register(conn_timer_size);
+
     install_sublevel();
     install_keyword("conn_pool_size", conn_pool_size_handler, KW_TYPE_INIT);
     install_keyword("conn_pool_cache", conn_pool_cache_handler, KW_TYPE_INIT);
+    install_keyword("synproxy_pool_size", conn_sp_pool_size_handler, KW_TYPE_INIT);
     install_keyword("conn_init_timeout", conn_init_timeout_handler, KW_TYPE_NORMAL);
     install_keyword("expire_quiescent_template", conn_expire_quiscent_template_handler,
             KW_TYPE_NORMAL);
     install_keyword("redirect", conn_redirect_handler, KW_TYPE_INIT);
+    install_frag_keywords();
+    install_conn_persist_keywords();
     install_xmit_keywords();
     install_sublevel_end();
 }
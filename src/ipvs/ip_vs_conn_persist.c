@@ -0,0 +1,718 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * image layout of conn:persist_file, all links are indexes, not pointers:
+ *
+ *   conn_persist_hdr
+ *   section of worker 0: uint32_t buckets[nslots], conn_persist_rec recs[nslots]
+ *   section of worker 1: ...
+ *
+ * a bucket heads a chain of tuples, linked by conn_persist_rec.next[dir].
+ * the index and the free list are rebuilt from the records on attaching,
+ * so a dpvs crashing in the middle of an update leaves at most that record
+ * stale, never the image unusable.
+ *
+ * the pending FNAT records are also chained by laddr on attaching, out of
+ * the image, so that adding a laddr visits only its own records.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <rte_jhash.h>
+#include "netif.h"
+#include "sa_pool.h"
+#include "scheduler.h"
+#include "parser/parser.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/proto_tcp.h"
+#include "ipvs/conn_persist.h"
+
+#define CONN_PERSIST_MAGIC          0x44504353  /* "DPCS" */
+#define CONN_PERSIST_VERSION        1
+
+#define CONN_PERSIST_SLOTS_DEF      262144
+#define CONN_PERSIST_SLOTS_MIN      1024
+#define CONN_PERSIST_SLOTS_MAX      16777216
+
+#define CONN_PERSIST_LADDR_BUCKETS  256
+
+/* pending records checked for expiry per job run */
+#define CONN_PERSIST_SCAN_SLOTS     1024
+#define CONN_PERSIST_SCAN_LOOPS     1000
+
+struct conn_persist_hdr {
+    uint32_t                magic;
+    uint32_t                version;
+    uint32_t                rec_size;
+    uint32_t                nsects;
+    uint32_t                nslots;     /* per section, power of 2 */
+    uint32_t                hash_rnd;
+    uint64_t                lcore_mask; /* worker of each section */
+    uint64_t                sect_size;
+    uint8_t                 pad[24];
+};
+
+struct conn_persist_lcore {
+    uint32_t                *buckets;
+    struct conn_persist_rec *recs;
+    uint32_t                free;       /* free list by next[0], slot + 1 */
+    uint32_t                cursor;     /* expiry scan */
+
+    /* pending FNAT records by laddr, chains of slots by laddr_next[slot - 1] */
+    uint32_t                *laddr_next;
+    uint32_t                laddr_buckets[CONN_PERSIST_LADDR_BUCKETS];
+
+    /* statistics */
+    uint32_t                used;
+    uint32_t                restored;
+    uint32_t                expired;
+    uint32_t                full;
+} __rte_cache_aligned;
+
+bool dp_vs_conn_persist_enable = false;
+
+RTE_DEFINE_PER_LCORE(uint32_t, dp_vs_conn_persist_pending);
+
+static char conn_persist_file[PATH_MAX];
+static uint32_t conn_persist_nslots = CONN_PERSIST_SLOTS_DEF;
+
+static struct conn_persist_hdr *conn_persist_hdr;
+static size_t conn_persist_size;
+static int conn_persist_fd = -1;
+
+static struct conn_persist_lcore conn_persist_lcores[DPVS_MAX_LCORE];
+
+#define this_persist                (&conn_persist_lcores[rte_lcore_id()])
+#define this_persist_pending        (RTE_PER_LCORE(dp_vs_conn_persist_pending))
+
+static inline uint32_t conn_persist_laddr_hash(int af,
+                                               const union inet_addr *laddr)
+{
+    return rte_jhash_1word(inet_addr_fold(af, laddr), conn_persist_hdr->hash_rnd)
+        & (CONN_PERSIST_LADDR_BUCKETS - 1);
+}
+
+/* a chain link names the tuple @dir of record @slot, 0 ends a chain */
+static inline uint32_t conn_persist_link(uint32_t slot, int dir)
+{
+    return (slot << 1) | dir;
+}
+
+static inline struct conn_persist_rec *
+conn_persist_slot_rec(const struct conn_persist_lcore *pl, uint32_t slot)
+{
+    return &pl->recs[slot - 1];
+}
+
+static inline uint32_t conn_persist_hash(int af, uint16_t proto,
+                                         const union inet_addr *saddr,
+                                         const union inet_addr *daddr,
+                                         uint16_t sport, uint16_t dport)
+{
+    uint32_t vect[10];
+
+    vect[0] = ((uint32_t)sport) << 16 | (uint32_t)dport;
+    vect[1] = ((uint32_t)af) << 16 | (uint32_t)proto;
+    if (af == AF_INET) {
+        vect[2] = saddr->in.s_addr;
+        vect[3] = daddr->in.s_addr;
+        return rte_jhash_32b(vect, 4, conn_persist_hdr->hash_rnd)
+            & (conn_persist_hdr->nslots - 1);
+    }
+
+    memcpy(&vect[2], &saddr->in6, 16);
+    memcpy(&vect[6], &daddr->in6, 16);
+    return rte_jhash_32b(vect, 10, conn_persist_hdr->hash_rnd)
+        & (conn_persist_hdr->nslots - 1);
+}
+
+static inline uint32_t conn_persist_rec_hash(const struct conn_persist_rec *rec,
+                                             int dir)
+{
+    if (dir == DPVS_CONN_DIR_INBOUND)
+        return conn_persist_hash(rec->af, rec->proto, &rec->caddr,
+                                 &rec->vaddr, rec->cport, rec->vport);
+    return conn_persist_hash(rec->daf, rec->proto, &rec->daddr,
+                             &rec->laddr, rec->dport, rec->lport);
+}
+
+static inline bool conn_persist_rec_match(const struct conn_persist_rec *rec,
+                                          int dir, int af, uint16_t proto,
+                                          const union inet_addr *saddr,
+                                          const union inet_addr *daddr,
+                                          uint16_t sport, uint16_t dport)
+{
+    if (rec->proto != proto)
+        return false;
+
+    if (dir == DPVS_CONN_DIR_INBOUND)
+        return rec->af == af && rec->cport == sport && rec->vport == dport
+            && inet_addr_equal(af, &rec->caddr, saddr)
+            && inet_addr_equal(af, &rec->vaddr, daddr);
+
+    return rec->daf == af && rec->dport == sport && rec->lport == dport
+        && inet_addr_equal(af, &rec->daddr, saddr)
+        && inet_addr_equal(af, &rec->laddr, daddr);
+}
+
+static void conn_persist_link_rec(struct conn_persist_lcore *pl, uint32_t slot)
+{
+    int dir;
+    uint32_t hash;
+    struct conn_persist_rec *rec = conn_persist_slot_rec(pl, slot);
+
+    for (dir = DPVS_CONN_DIR_INBOUND; dir < DPVS_CONN_DIR_MAX; dir++) {
+        hash = conn_persist_rec_hash(rec, dir);
+        rec->next[dir] = pl->buckets[hash];
+        pl->buckets[hash] = conn_persist_link(slot, dir);
+    }
+}
+
+static void conn_persist_unlink_rec(struct conn_persist_lcore *pl, uint32_t slot)
+{
+    int dir;
+    uint32_t link, *pos;
+    struct conn_persist_rec *rec = conn_persist_slot_rec(pl, slot);
+
+    for (dir = DPVS_CONN_DIR_INBOUND; dir < DPVS_CONN_DIR_MAX; dir++) {
+        pos = &pl->buckets[conn_persist_rec_hash(rec, dir)];
+        while ((link = *pos) != 0) {
+            if (link == conn_persist_link(slot, dir)) {
+                *pos = rec->next[dir];
+                break;
+            }
+            pos = &conn_persist_slot_rec(pl, link >> 1)->next[link & 1];
+        }
+    }
+}
+
+static void conn_persist_free_rec(struct conn_persist_lcore *pl, uint32_t slot)
+{
+    struct conn_persist_rec *rec = conn_persist_slot_rec(pl, slot);
+
+    conn_persist_unlink_rec(pl, slot);
+    rec->status = CONN_PERSIST_FREE;
+    rec->next[0] = pl->free;
+    pl->free = slot;
+    pl->used--;
+}
+
+bool dp_vs_conn_persistable(struct dp_vs_conn *conn)
+{
+    if (!conn->dest || dp_vs_conn_is_template(conn)
+            || (conn->flags & DPVS_CONN_F_ONE_PACKET)
+            || conn->dest->fwdmode == DPVS_FWD_MODE_SNAT)
+        return false;
+
+    switch (conn->proto) {
+    case IPPROTO_UDP:
+        return true;
+    case IPPROTO_TCP:
+        return conn->state != DPVS_TCP_S_NONE
+            && conn->state != DPVS_TCP_S_SYN_SENT
+            && conn->state != DPVS_TCP_S_SYN_RECV
+            && conn->state != DPVS_TCP_S_SYNACK
+            && conn->state != DPVS_TCP_S_LISTEN;
+    default:
+        return false;
+    }
+}
+
+static inline void conn_persist_fill(struct conn_persist_rec *rec,
+                                     const struct dp_vs_conn *conn)
+{
+    rec->flags          = conn->flags;
+    rec->state          = conn->state;
+    rec->timeout        = conn->timeout.tv_sec;
+    rec->fnat_seq       = conn->fnat_seq;
+    if (conn->synproxy)
+        rec->syn_proxy_seq = conn->synproxy->syn_proxy_seq;
+    rec->rs_end_seq     = conn->rs_end_seq;
+    rec->rs_end_ack     = conn->rs_end_ack;
+}
+
+void dp_vs_conn_persist_save(struct dp_vs_conn *conn)
+{
+    uint32_t slot;
+    struct conn_persist_rec *rec;
+    struct conn_persist_lcore *pl = this_persist;
+
+    if (!pl->recs)
+        return;
+
+    if (conn->persist_slot) {
+        conn_persist_fill(conn_persist_slot_rec(pl, conn->persist_slot), conn);
+        return;
+    }
+
+    if (!dp_vs_conn_persistable(conn))
+        return;
+
+    slot = pl->free;
+    if (unlikely(!slot)) {
+        pl->full++;
+        return;
+    }
+    rec = conn_persist_slot_rec(pl, slot);
+    pl->free = rec->next[0];
+    pl->used++;
+
+    rec->af         = conn->af;
+    rec->daf        = tuplehash_out(conn).af;
+    rec->proto      = conn->proto;
+    rec->fwdmode    = conn->dest->fwdmode;
+    rec->outwall    = conn->outwall;
+    rec->caddr      = conn->caddr;
+    rec->vaddr      = conn->vaddr;
+    rec->laddr      = conn->laddr;
+    rec->daddr      = conn->daddr;
+    rec->cport      = conn->cport;
+    rec->vport      = conn->vport;
+    rec->lport      = conn->lport;
+    rec->dport      = conn->dport;
+    conn_persist_fill(rec, conn);
+    conn_persist_link_rec(pl, slot);
+
+    /* a record is valid only when the status is written */
+    __atomic_store_n(&rec->status, CONN_PERSIST_LIVE, __ATOMIC_RELEASE);
+    conn->persist_slot = slot;
+}
+
+void dp_vs_conn_persist_drop(struct dp_vs_conn *conn)
+{
+    struct conn_persist_lcore *pl = this_persist;
+
+    if (!conn->persist_slot || !pl->recs)
+        return;
+
+    conn_persist_free_rec(pl, conn->persist_slot);
+    conn->persist_slot = 0;
+}
+
+const struct conn_persist_rec *
+dp_vs_conn_persist_lookup(int af, uint16_t proto,
+                          const union inet_addr *saddr,
+                          const union inet_addr *daddr,
+                          uint16_t sport, uint16_t dport,
+                          uint32_t *slot, int *dir)
+{
+    uint32_t link;
+    struct conn_persist_rec *rec;
+    struct conn_persist_lcore *pl = this_persist;
+
+    if (!pl->recs)
+        return NULL;
+
+    link = pl->buckets[conn_persist_hash(af, proto, saddr, daddr, sport, dport)];
+    while (link) {
+        rec = conn_persist_slot_rec(pl, link >> 1);
+        if (rec->status == CONN_PERSIST_PENDING
+                && conn_persist_rec_match(rec, link & 1, af, proto,
+                                          saddr, daddr, sport, dport)) {
+            *slot = link >> 1;
+            *dir = link & 1;
+            return rec;
+        }
+        link = rec->next[link & 1];
+    }
+
+    return NULL;
+}
+
+void dp_vs_conn_persist_claim(struct dp_vs_conn *conn, uint32_t slot)
+{
+    struct conn_persist_lcore *pl = this_persist;
+    struct conn_persist_rec *rec = conn_persist_slot_rec(pl, slot);
+
+    assert(rec->status == CONN_PERSIST_PENDING);
+
+    rec->status = CONN_PERSIST_LIVE;
+    rec->reserved = 0;      /* the lport is the conn's now */
+    conn->persist_slot = slot;
+    pl->restored++;
+    if (--this_persist_pending == 0)
+        RTE_LOG(INFO, IPVS, "%s: [%02d] %u conns restored, %u expired\n",
+                __func__, rte_lcore_id(), pl->restored, pl->expired);
+}
+
+/* out tuple of @rec as sa_pool takes it, see dp_vs_laddr_rebind() */
+static void conn_persist_rec_sa(const struct conn_persist_rec *rec,
+                                struct sockaddr_storage *dsin,
+                                struct sockaddr_storage *ssin)
+{
+    memset(dsin, 0, sizeof(struct sockaddr_storage));
+    memset(ssin, 0, sizeof(struct sockaddr_storage));
+
+    if (rec->daf == AF_INET) {
+        struct sockaddr_in *daddr, *saddr;
+        daddr = (struct sockaddr_in *)dsin;
+        daddr->sin_family = AF_INET;
+        daddr->sin_addr = rec->daddr.in;
+        daddr->sin_port = rec->dport;
+        saddr = (struct sockaddr_in *)ssin;
+        saddr->sin_family = AF_INET;
+        saddr->sin_addr = rec->laddr.in;
+        saddr->sin_port = rec->lport;
+    } else {
+        struct sockaddr_in6 *daddr, *saddr;
+        daddr = (struct sockaddr_in6 *)dsin;
+        daddr->sin6_family = AF_INET6;
+        daddr->sin6_addr = rec->daddr.in6;
+        daddr->sin6_port = rec->dport;
+        saddr = (struct sockaddr_in6 *)ssin;
+        saddr->sin6_family = AF_INET6;
+        saddr->sin6_addr = rec->laddr.in6;
+        saddr->sin6_port = rec->lport;
+    }
+}
+
+/* give back the lport held for a pending record being dropped */
+static void conn_persist_rec_unreserve(struct conn_persist_rec *rec)
+{
+    struct sockaddr_storage dsin, ssin;
+
+    if (!rec->reserved)
+        return;
+
+    rec->reserved = 0;
+    conn_persist_rec_sa(rec, &dsin, &ssin);
+    sa_release(NULL, &dsin, &ssin);
+}
+
+void dp_vs_conn_persist_reserve(struct inet_ifaddr *ifa)
+{
+    uint32_t slot, nheld = 0;
+    struct sockaddr_storage dsin, ssin;
+    struct conn_persist_rec *rec;
+    struct conn_persist_lcore *pl = this_persist;
+
+    if (!this_persist_pending || !pl->laddr_next)
+        return;
+
+    /* records claimed or expired since attaching are left in the chain */
+    slot = pl->laddr_buckets[conn_persist_laddr_hash(ifa->af, &ifa->addr)];
+    for (; slot; slot = pl->laddr_next[slot - 1]) {
+        rec = conn_persist_slot_rec(pl, slot);
+        if (rec->status != CONN_PERSIST_PENDING || rec->reserved
+                || rec->daf != ifa->af
+                || !inet_addr_equal(ifa->af, &rec->laddr, &ifa->addr))
+            continue;
+
+        conn_persist_rec_sa(rec, &dsin, &ssin);
+        if (sa_claim(ifa->idev->dev, &dsin, &ssin) == EDPVS_OK) {
+            rec->reserved = 1;
+            nheld++;
+        }
+    }
+
+    if (nheld)
+        RTE_LOG(INFO, IPVS, "%s: [%02d] %u lports held for pending conns\n",
+                __func__, rte_lcore_id(), nheld);
+}
+
+/* drop the pending records not taken back in their timeout */
+static void conn_persist_job(void *arg)
+{
+    uint32_t i, slot;
+    uint64_t now;
+    struct conn_persist_rec *rec;
+    struct conn_persist_lcore *pl = this_persist;
+
+    if (likely(!this_persist_pending) || !pl->recs)
+        return;
+
+    now = rte_get_timer_cycles();
+    for (i = 0; i < CONN_PERSIST_SCAN_SLOTS && this_persist_pending; i++) {
+        slot = pl->cursor + 1;
+        pl->cursor = (pl->cursor + 1) & (conn_persist_hdr->nslots - 1);
+
+        rec = conn_persist_slot_rec(pl, slot);
+        if (rec->status != CONN_PERSIST_PENDING || (int64_t)(rec->expire - now) > 0)
+            continue;
+
+        conn_persist_rec_unreserve(rec);
+        conn_persist_free_rec(pl, slot);
+        pl->expired++;
+        if (--this_persist_pending == 0)
+            RTE_LOG(INFO, IPVS, "%s: [%02d] %u conns restored, %u expired\n",
+                    __func__, rte_lcore_id(), pl->restored, pl->expired);
+    }
+}
+
+static struct dpvs_lcore_job conn_persist_lcore_job = {
+    .name       = "conn_persist",
+    .type       = LCORE_JOB_SLOW,
+    .func       = conn_persist_job,
+    .skip_loops = CONN_PERSIST_SCAN_LOOPS,
+};
+
+/* per-lcore pending counter is set on the worker itself */
+static int conn_persist_lcore_init(void *arg)
+{
+    lcoreid_t cid = rte_lcore_id();
+    uint32_t *npending = arg;
+
+    if (netif_lcore_is_fwd_worker(cid))
+        this_persist_pending = npending[cid];
+
+    return EDPVS_OK;
+}
+
+/* take over the records of the image, rebuild index and free lists */
+static uint32_t conn_persist_attach(struct conn_persist_lcore *pl, bool fresh)
+{
+    uint32_t slot, hash, npending = 0;
+    uint64_t now = rte_get_timer_cycles();
+    struct conn_persist_rec *rec;
+
+    memset(pl->buckets, 0, sizeof(uint32_t) * conn_persist_hdr->nslots);
+    pl->free = 0;
+    pl->used = 0;
+    pl->cursor = 0;
+
+    for (slot = conn_persist_hdr->nslots; slot > 0; slot--) {
+        rec = conn_persist_slot_rec(pl, slot);
+        if (fresh || rec->status == CONN_PERSIST_FREE || !rec->timeout) {
+            rec->status = CONN_PERSIST_FREE;
+            rec->next[0] = pl->free;
+            pl->free = slot;
+            continue;
+        }
+
+        /* the conn lived till the previous dpvs stopped, grant it a timeout.
+         * its lport is held once its laddr is added again. */
+        rec->status = CONN_PERSIST_PENDING;
+        rec->reserved = 0;
+        rec->expire = now + (uint64_t)rec->timeout * rte_get_timer_hz();
+        conn_persist_link_rec(pl, slot);
+        pl->used++;
+        npending++;
+
+        if (rec->fwdmode != DPVS_FWD_MODE_FNAT || !pl->laddr_next)
+            continue;
+        hash = conn_persist_laddr_hash(rec->daf, &rec->laddr);
+        pl->laddr_next[slot - 1] = pl->laddr_buckets[hash];
+        pl->laddr_buckets[hash] = slot;
+    }
+
+    return npending;
+}
+
+static bool conn_persist_valid(const struct conn_persist_hdr *hdr,
+                               uint32_t nsects, uint64_t lcore_mask,
+                               uint64_t sect_size)
+{
+    return hdr->magic == CONN_PERSIST_MAGIC
+        && hdr->version == CONN_PERSIST_VERSION
+        && hdr->rec_size == sizeof(struct conn_persist_rec)
+        && hdr->nsects == nsects
+        && hdr->nslots == conn_persist_nslots
+        && hdr->lcore_mask == lcore_mask
+        && hdr->sect_size == sect_size;
+}
+
+int dp_vs_conn_persist_init(void)
+{
+    int err;
+    bool fresh;
+    uint8_t nsects;
+    uint64_t lcore_mask, sect_size;
+    uint32_t npending[DPVS_MAX_LCORE] = { 0 }, total = 0;
+    lcoreid_t cid;
+    struct stat st;
+    struct statfs sfs;
+    uint8_t *sect;
+
+    if (!conn_persist_file[0])
+        return EDPVS_OK;
+
+    netif_get_slave_lcores(&nsects, &lcore_mask);
+    sect_size = RTE_ALIGN_CEIL(sizeof(uint32_t) * conn_persist_nslots +
+            sizeof(struct conn_persist_rec) * conn_persist_nslots,
+            RTE_CACHE_LINE_SIZE);
+
+    conn_persist_fd = open(conn_persist_file, O_RDWR | O_CREAT, 0600);
+    if (conn_persist_fd < 0) {
+        RTE_LOG(ERR, IPVS, "%s: fail to open %s: %s\n", __func__,
+                conn_persist_file, strerror(errno));
+        return EDPVS_SYSCALL;
+    }
+
+    /* hugetlbfs maps whole huge pages */
+    if (fstat(conn_persist_fd, &st) < 0 || fstatfs(conn_persist_fd, &sfs) < 0) {
+        err = EDPVS_SYSCALL;
+        goto errout;
+    }
+    conn_persist_size = RTE_ALIGN_CEIL(sizeof(struct conn_persist_hdr) +
+            nsects * sect_size, (size_t)sfs.f_bsize);
+
+    fresh = (size_t)st.st_size != conn_persist_size;
+    if (fresh && (ftruncate(conn_persist_fd, 0) < 0 ||
+                  ftruncate(conn_persist_fd, conn_persist_size) < 0)) {
+        RTE_LOG(ERR, IPVS, "%s: fail to size %s: %s\n", __func__,
+                conn_persist_file, strerror(errno));
+        err = EDPVS_SYSCALL;
+        goto errout;
+    }
+
+    conn_persist_hdr = mmap(NULL, conn_persist_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, conn_persist_fd, 0);
+    if (conn_persist_hdr == MAP_FAILED) {
+        RTE_LOG(ERR, IPVS, "%s: fail to map %s: %s\n", __func__,
+                conn_persist_file, strerror(errno));
+        conn_persist_hdr = NULL;
+        err = EDPVS_NOMEM;
+        goto errout;
+    }
+
+    if (!fresh && !conn_persist_valid(conn_persist_hdr, nsects,
+                                      lcore_mask, sect_size)) {
+        RTE_LOG(WARNING, IPVS, "%s: %s doesn't match the config, "
+                "conns of the previous dpvs are discarded\n",
+                __func__, conn_persist_file);
+        fresh = true;
+    }
+    if (fresh) {
+        conn_persist_hdr->magic = 0;
+        conn_persist_hdr->version = CONN_PERSIST_VERSION;
+        conn_persist_hdr->rec_size = sizeof(struct conn_persist_rec);
+        conn_persist_hdr->nsects = nsects;
+        conn_persist_hdr->nslots = conn_persist_nslots;
+        conn_persist_hdr->hash_rnd = (uint32_t)random();
+        conn_persist_hdr->lcore_mask = lcore_mask;
+        conn_persist_hdr->sect_size = sect_size;
+    }
+
+    sect = (uint8_t *)(conn_persist_hdr + 1);
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (cid >= 64 || !(lcore_mask & (1ULL << cid)))
+            continue;
+        conn_persist_lcores[cid].buckets = (uint32_t *)sect;
+        conn_persist_lcores[cid].recs = (struct conn_persist_rec *)
+            (sect + sizeof(uint32_t) * conn_persist_nslots);
+        if (!fresh) {
+            conn_persist_lcores[cid].laddr_next = rte_zmalloc(NULL,
+                    sizeof(uint32_t) * conn_persist_nslots, 0);
+            if (!conn_persist_lcores[cid].laddr_next) {
+                err = EDPVS_NOMEM;
+                goto errout;
+            }
+        }
+        npending[cid] = conn_persist_attach(&conn_persist_lcores[cid], fresh);
+        total += npending[cid];
+        sect += sect_size;
+    }
+
+    /* the image is consistent from now on */
+    __atomic_store_n(&conn_persist_hdr->magic, CONN_PERSIST_MAGIC, __ATOMIC_RELEASE);
+
+    err = dpvs_lcore_job_register(&conn_persist_lcore_job, LCORE_ROLE_FWD_WORKER);
+    if (err != EDPVS_OK)
+        goto errout;
+
+    rte_eal_mp_remote_launch(conn_persist_lcore_init, npending, SKIP_MAIN);
+    rte_eal_mp_wait_lcore();
+
+    dp_vs_conn_persist_enable = true;
+    RTE_LOG(INFO, IPVS, "%s: %s attached, %u conns of %u lcores pending\n",
+            __func__, conn_persist_file, total, nsects);
+
+    return EDPVS_OK;
+
+errout:
+    dp_vs_conn_persist_term();
+    return err;
+}
+
+/* the image is left for the next dpvs */
+int dp_vs_conn_persist_term(void)
+{
+    lcoreid_t cid;
+
+    if (dp_vs_conn_persist_enable)
+        dpvs_lcore_job_unregister(&conn_persist_lcore_job, LCORE_ROLE_FWD_WORKER);
+    dp_vs_conn_persist_enable = false;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (conn_persist_lcores[cid].laddr_next)
+            rte_free(conn_persist_lcores[cid].laddr_next);
+    }
+    memset(conn_persist_lcores, 0, sizeof(conn_persist_lcores));
+
+    if (conn_persist_hdr) {
+        munmap(conn_persist_hdr, conn_persist_size);
+        conn_persist_hdr = NULL;
+    }
+
+    if (conn_persist_fd >= 0) {
+        close(conn_persist_fd);
+        conn_persist_fd = -1;
+    }
+
+    return EDPVS_OK;
+}
+
+static void conn_persist_file_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (strlen(str) >= sizeof(conn_persist_file)) {
+        RTE_LOG(WARNING, IPVS, "invalid conn:persist_file %s\n", str);
+    } else {
+        snprintf(conn_persist_file, sizeof(conn_persist_file), "%s", str);
+        RTE_LOG(INFO, IPVS, "conn:persist_file = %s\n", conn_persist_file);
+    }
+
+    FREE_PTR(str);
+}
+
+static void conn_persist_conns_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int nslots;
+
+    assert(str);
+
+    nslots = atoi(str);
+    if (nslots < CONN_PERSIST_SLOTS_MIN || nslots > CONN_PERSIST_SLOTS_MAX) {
+        RTE_LOG(WARNING, IPVS, "invalid conn:persist_conns %s, using default %d\n",
+                str, CONN_PERSIST_SLOTS_DEF);
+        conn_persist_nslots = CONN_PERSIST_SLOTS_DEF;
+    } else {
+        is_power2(nslots, 0, &nslots);
+        RTE_LOG(INFO, IPVS, "conn:persist_conns = %d (round to 2^n)\n", nslots);
+        conn_persist_nslots = nslots;
+    }
+
+    FREE_PTR(str);
+}
+
+void install_conn_persist_keywords(void)
+{
+    install_keyword("persist_file", conn_persist_file_handler, KW_TYPE_INIT);
+    install_keyword("persist_conns", conn_persist_conns_handler, KW_TYPE_INIT);
+}
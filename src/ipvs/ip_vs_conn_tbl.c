@@ -0,0 +1,229 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include "ipvs/conn_tbl.h"
+
+struct dp_vs_conn_tbl *dp_vs_conn_tbl_create(uint32_t nbuckets, uint32_t novf,
+                                             int socket_id)
+{
+    uint32_t i;
+    struct dp_vs_conn_tbl *tbl;
+
+    if (!nbuckets || !novf || (nbuckets & (nbuckets - 1))
+            || (novf & (novf - 1)) || novf > nbuckets)
+        return NULL;
+
+    tbl = rte_zmalloc_socket("conn_tbl", sizeof(*tbl),
+                             RTE_CACHE_LINE_SIZE, socket_id);
+    if (!tbl)
+        return NULL;
+
+    tbl->buckets = rte_zmalloc_socket("conn_tbl_bkt",
+                        sizeof(struct dp_vs_conn_bucket) * nbuckets,
+                        RTE_CACHE_LINE_SIZE, socket_id);
+    if (!tbl->buckets)
+        goto errout;
+
+    tbl->ovf_tbl = rte_malloc_socket("conn_tbl_ovf",
+                        sizeof(struct list_head) * novf,
+                        RTE_CACHE_LINE_SIZE, socket_id);
+    if (!tbl->ovf_tbl)
+        goto errout;
+    for (i = 0; i < novf; i++)
+        INIT_LIST_HEAD(&tbl->ovf_tbl[i]);
+
+    tbl->nbuckets = nbuckets;
+    tbl->bkt_mask = nbuckets - 1;
+    tbl->novf     = novf;
+    tbl->ovf_mask = novf - 1;
+
+    return tbl;
+
+errout:
+    if (tbl->buckets)
+        rte_free(tbl->buckets);
+    rte_free(tbl);
+    return NULL;
+}
+
+void dp_vs_conn_tbl_destroy(struct dp_vs_conn_tbl *tbl)
+{
+    if (!tbl)
+        return;
+
+    rte_free(tbl->ovf_tbl);
+    rte_free(tbl->buckets);
+    rte_free(tbl);
+}
+
+static inline bool conn_tbl_bkt_insert(struct dp_vs_conn_bucket *b,
+                                       uint16_t sig, struct conn_tuple_hash *t)
+{
+    int i;
+
+    for (i = 0; i < DPVS_CONN_TBL_BKT_ENTRIES; i++) {
+        if (!b->tuph[i]) {
+            b->sig[i] = sig;
+            b->tuph[i] = t;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline bool conn_tbl_bkt_remove(struct dp_vs_conn_bucket *b,
+                                       const struct conn_tuple_hash *t)
+{
+    int i;
+
+    for (i = 0; i < DPVS_CONN_TBL_BKT_ENTRIES; i++) {
+        if (b->tuph[i] == t) {
+            b->tuph[i] = NULL;
+            b->sig[i] = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int dp_vs_conn_tbl_add(struct dp_vs_conn_tbl *tbl,
+                       struct conn_tuple_hash *t, uint32_t hash)
+{
+    int k, slot;
+    uint16_t sig, vsig;
+    uint32_t bkt, alt;
+    struct conn_tuple_hash *victim;
+
+    sig = conn_tbl_sig(hash);
+    bkt = hash & tbl->bkt_mask;
+    alt = conn_tbl_alt_bkt(tbl, bkt, sig);
+
+    if (conn_tbl_bkt_insert(&tbl->buckets[bkt], sig, t)
+            || conn_tbl_bkt_insert(&tbl->buckets[alt], sig, t)) {
+        tbl->count++;
+        return EDPVS_OK;
+    }
+
+    /*
+     * both buckets are full, displace residents to their alternative
+     * buckets. the slot to evict is rotated by signature and depth so
+     * that the walk doesn't ping-pong between the same two entries.
+     */
+    for (k = 0; k < DPVS_CONN_TBL_MAX_KICKS; k++) {
+        slot = (sig + k) % DPVS_CONN_TBL_BKT_ENTRIES;
+        victim = tbl->buckets[bkt].tuph[slot];
+        vsig = tbl->buckets[bkt].sig[slot];
+
+        tbl->buckets[bkt].tuph[slot] = t;
+        tbl->buckets[bkt].sig[slot] = sig;
+
+        t = victim;
+        sig = vsig;
+        bkt = conn_tbl_alt_bkt(tbl, bkt, sig);
+        if (conn_tbl_bkt_insert(&tbl->buckets[bkt], sig, t)) {
+            tbl->count++;
+            return EDPVS_OK;
+        }
+    }
+
+    /* still homeless, spill it. it's candidate buckets are bkt and alt. */
+    alt = conn_tbl_alt_bkt(tbl, bkt, sig);
+    list_add(&t->list, &tbl->ovf_tbl[conn_tbl_ovf_idx(tbl, bkt, alt)]);
+    tbl->buckets[RTE_MIN(bkt, alt)].ovf_cnt++;
+    tbl->ovf_count++;
+
+    return EDPVS_OK;
+}
+
+int dp_vs_conn_tbl_del(struct dp_vs_conn_tbl *tbl,
+                       struct conn_tuple_hash *t, uint32_t hash)
+{
+    uint16_t sig;
+    uint32_t bkt, alt;
+
+    sig = conn_tbl_sig(hash);
+    bkt = hash & tbl->bkt_mask;
+    alt = conn_tbl_alt_bkt(tbl, bkt, sig);
+
+    if (unlikely(!list_empty(&t->list))) {
+        list_del_init(&t->list);
+        tbl->buckets[RTE_MIN(bkt, alt)].ovf_cnt--;
+        tbl->ovf_count--;
+        tbl->ovf_gen++;
+        return EDPVS_OK;
+    }
+
+    if (conn_tbl_bkt_remove(&tbl->buckets[bkt], t)
+            || conn_tbl_bkt_remove(&tbl->buckets[alt], t)) {
+        tbl->count--;
+        return EDPVS_OK;
+    }
+
+    return EDPVS_NOTEXIST;
+}
+
+static int conn_tbl_walk_ovf(struct dp_vs_conn_tbl *tbl, struct list_head *head,
+                             dp_vs_conn_tbl_walk_cb_t cb, void *arg)
+{
+    int err;
+    uint32_t gen;
+    struct conn_tuple_hash *t;
+
+restart:
+    list_for_each_entry(t, head, list) {
+        gen = tbl->ovf_gen;
+        err = cb(t, arg);
+        if (err != EDPVS_OK)
+            return err;
+        /* the chain was changed by the callback */
+        if (gen != tbl->ovf_gen)
+            goto restart;
+    }
+
+    return EDPVS_OK;
+}
+
+uint32_t dp_vs_conn_tbl_walk(struct dp_vs_conn_tbl *tbl, uint32_t cursor,
+                             uint32_t nslots, dp_vs_conn_tbl_walk_cb_t cb,
+                             void *arg)
+{
+    int i;
+    uint32_t end;
+    struct dp_vs_conn_bucket *b;
+    struct conn_tuple_hash *t;
+
+    end = RTE_MIN(cursor + nslots, dp_vs_conn_tbl_slots(tbl));
+
+    for ( ; cursor < end; cursor++) {
+        if (cursor < tbl->nbuckets) {
+            b = &tbl->buckets[cursor];
+            for (i = 0; i < DPVS_CONN_TBL_BKT_ENTRIES; i++) {
+                t = b->tuph[i];
+                if (t && cb(t, arg) != EDPVS_OK)
+                    return cursor;
+            }
+        } else {
+            if (conn_tbl_walk_ovf(tbl, &tbl->ovf_tbl[cursor - tbl->nbuckets],
+                                  cb, arg) != EDPVS_OK)
+                return cursor;
+        }
+    }
+
+    return cursor;
+}
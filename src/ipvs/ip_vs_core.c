@@ -33,11 +33,15 @@
 #include "ipvs/laddr.h"
 #include "ipvs/xmit.h"
 #include "ipvs/synproxy.h"
+#include "ipvs/acl.h"
 #include "ipvs/blklst.h"
 #include "ipvs/whtlst.h"
 #include "ipvs/proto_udp.h"
 #include "route6.h"
 #include "ipvs/redirect.h"
+#include "ipvs/frag.h"
+#include "ipvs/conn_persist.h"
+#include "ipvs/sync.h"
 
 static inline int dp_vs_fill_iphdr(int af, struct rte_mbuf *mbuf,
                                    struct dp_vs_iphdr *iph)
@@ -157,6 +161,11 @@ static struct dp_vs_conn *dp_vs_sched_persist(struct dp_vs_service *svc,
         dport = ports[1];
     }
 
+    if (dp_vs_dest_limited(dest)) {
+        dp_vs_conn_put(ct);
+        return NULL;
+    }
+
     /* create a new connection according to the template */
     dp_vs_conn_fill_param(iph->af, iph->proto, &iph->saddr, &iph->daddr,
             ports[0], ports[1], dport, &param);
@@ -303,6 +312,9 @@ struct dp_vs_conn *dp_vs_schedule(struct dp_vs_service *svc,
         return NULL;
     }
 
+    if (dp_vs_dest_limited(dest))
+        return NULL;
+
     if (dest->fwdmode == DPVS_FWD_MODE_SNAT)
         return dp_vs_snat_schedule(dest, iph, ports, mbuf, outwall);
 
@@ -500,7 +512,7 @@ static int __xmit_outbound_icmp6(struct rte_mbuf *mbuf,
         return EDPVS_NOROUTE;
     }
 
-    if (mbuf->pkt_len > rt6->rt6_mtu) {
+    if (ip6_pkt_too_big(mbuf, rt6->rt6_mtu)) {
         route6_put(rt6);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(rt6->rt6_mtu));
         rte_pktmbuf_free(mbuf);
@@ -614,7 +626,7 @@ static int __xmit_inbound_icmp6(struct rte_mbuf *mbuf,
         return EDPVS_NOROUTE;
     }
 
-    if (mbuf->pkt_len > rt6->rt6_mtu) {
+    if (ip6_pkt_too_big(mbuf, rt6->rt6_mtu)) {
         route6_put(rt6);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(rt6->rt6_mtu));
         rte_pktmbuf_free(mbuf);
@@ -965,18 +977,14 @@ static int __dp_vs_in(void *priv, struct rte_mbuf *mbuf,
         return INET_ACCEPT;
 
     /*
-     * Defrag ipvs-forwarding TCP/UDP is not supported for some reasons,
-     *
-     * - RSS/flow-director do not support TCP/UDP fragments, means it's
-     *   not able to direct frags to same lcore as original TCP/UDP packets.
-     * - per-lcore conn table will miss if frags reachs wrong lcore.
-     *
-     * If we redirect frags to "correct" lcore, it may cause performance
-     * issue. Also it need to understand RSS algorithm. Moreover, for the
-     * case frags in same flow are not occur in same lcore, a global lock is
-     * needed, which is not a good idea.
+     * RSS/flow-director can't direct TCP/UDP fragments to the lcore of the
+     * conn, fragments are reassembled in pre-routing if conn:fragment is
+     * on (see ipvs/frag.h), or dropped there. the ones left here are not
+     * IPVS traffic.
      */
     if (af == AF_INET && ip4_is_frag(ip4_hdr(mbuf))) {
+        if (dp_vs_frag_enable)
+            return INET_ACCEPT;
         RTE_LOG(DEBUG, IPVS, "%s: frag not support.\n", __func__);
         return INET_DROP;
     }
@@ -1065,6 +1073,15 @@ static int __dp_vs_in(void *priv, struct rte_mbuf *mbuf,
         if (err != EDPVS_OK)
             RTE_LOG(WARNING, IPVS, "%s: fail to trans state.", __func__);
     }
+    /* traffic took over a conn synced from the peer, it's ours from now on */
+    if (unlikely(conn->flags & DPVS_CONN_F_SYNCED))
+        conn->flags &= ~DPVS_CONN_F_SYNCED;
+    if (conn->state != conn->old_state) {
+        if (dp_vs_conn_persist_enable)
+            dp_vs_conn_persist_save(conn);
+        if (dp_vs_sync_send_enable)
+            dp_vs_sync_conn(conn, DP_VS_SYNC_CONN_SET);
+    }
     conn->old_state = conn->state;
 
     /* holding the conn, need a "put" later. */
@@ -1091,6 +1108,16 @@ static int __dp_vs_pre_routing(void *priv, struct rte_mbuf *mbuf,
 {
     struct dp_vs_iphdr iph;
     struct dp_vs_service *svc;
+    int verdict;
+
+    if (dp_vs_frag_enable && unlikely(dp_vs_is_frag(af, mbuf))) {
+        if (!dp_vs_frag_match(af, mbuf))
+            return INET_ACCEPT;
+        verdict = dp_vs_frag_in(af, mbuf);
+        if (verdict != INET_ACCEPT)
+            return verdict;
+        /* mbuf holds the reassembled datagram now */
+    }
 
     if (EDPVS_OK != dp_vs_fill_iphdr(af, mbuf, &iph))
         return INET_ACCEPT;
@@ -1188,6 +1215,12 @@ int dp_vs_init(void)
         goto err_redirect;
     }
 
+    err = dp_vs_frag_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init frag: %s\n", dpvs_strerror(err));
+        goto err_frag;
+    }
+
     err = dp_vs_synproxy_init();
     if (err != EDPVS_OK) {
         RTE_LOG(ERR, IPVS, "fail to init synproxy: %s\n", dpvs_strerror(err));
@@ -1206,6 +1239,12 @@ int dp_vs_init(void)
         goto err_serv;
     }
 
+    err = dp_vs_acl_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init acl: %s\n", dpvs_strerror(err));
+        goto err_acl;
+    }
+
     err = dp_vs_blklst_init();
     if (err != EDPVS_OK) {
         RTE_LOG(ERR, IPVS, "fail to init blklst: %s\n", dpvs_strerror(err));
@@ -1224,6 +1263,12 @@ int dp_vs_init(void)
         goto err_stats;
     }
 
+    err = dp_vs_sync_init();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "fail to init sync: %s\n", dpvs_strerror(err));
+        goto err_sync;
+    }
+
     err = inet_register_hooks(dp_vs_ops, NELEMS(dp_vs_ops));
     if (err != EDPVS_OK) {
         RTE_LOG(ERR, IPVS, "fail to register hooks: %s\n", dpvs_strerror(err));
@@ -1234,18 +1279,24 @@ int dp_vs_init(void)
     return EDPVS_OK;
 
 err_hooks:
+    dp_vs_sync_term();
+err_sync:
     dp_vs_stats_term();
 err_stats:
     dp_vs_whtlst_term();
 err_whtlst:
     dp_vs_blklst_term();
 err_blklst:
+    dp_vs_acl_term();
+err_acl:
     dp_vs_service_term();
 err_serv:
     dp_vs_sched_term();
 err_sched:
     dp_vs_synproxy_term();
 err_synproxy:
+    dp_vs_frag_term();
+err_frag:
     dp_vs_redirects_term();
 err_redirect:
     dp_vs_conn_term();
@@ -1265,6 +1316,10 @@ int dp_vs_term(void)
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to unregister hooks: %s\n", dpvs_strerror(err));
 
+    err = dp_vs_sync_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate sync: %s\n", dpvs_strerror(err));
+
     err = dp_vs_stats_term();
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to terminate term: %s\n", dpvs_strerror(err));
@@ -1277,6 +1332,10 @@ int dp_vs_term(void)
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to terminate blklst: %s\n", dpvs_strerror(err));
 
+    err = dp_vs_acl_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate acl: %s\n", dpvs_strerror(err));
+
     err = dp_vs_service_term();
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to terminate serv: %s\n", dpvs_strerror(err));
@@ -1289,6 +1348,10 @@ int dp_vs_term(void)
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to terminate synproxy: %s\n", dpvs_strerror(err));
 
+    err = dp_vs_frag_term();
+    if (err != EDPVS_OK)
+        RTE_LOG(ERR, IPVS, "fail to terminate frag: %s\n", dpvs_strerror(err));
+
     err = dp_vs_redirects_term();
     if (err != EDPVS_OK)
         RTE_LOG(ERR, IPVS, "fail to terminate redirect: %s\n", dpvs_strerror(err));
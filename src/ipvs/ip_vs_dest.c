@@ -47,6 +47,41 @@ struct dp_vs_dest *dp_vs_dest_lookup(int af,
     return NULL;
 }
 
+/* bucket depth of the lcore share of @rate, in tokens scaled by US_PER_S */
+static inline int64_t dp_vs_dest_limit_burst(uint64_t rate, uint32_t nshares)
+{
+    return rate * US_PER_S / nshares;
+}
+
+/*
+ * every slave lcore owns 1/n of the limits, kept exact in the scaled
+ * tokens rather than rounded, the master keeps them for display only.
+ */
+static void dp_vs_dest_limit_update(struct dp_vs_dest *dest,
+                                    struct dp_vs_dest_conf *udest,
+                                    uint8_t num_lcores)
+{
+    struct dp_vs_dest_limit *lim = &dest->limit;
+
+    lim->max_cps = udest->max_cps;
+    lim->max_bps = udest->max_bps;
+    lim->credit  = 0;
+
+    if (rte_lcore_id() == rte_get_main_lcore() || !num_lcores) {
+        lim->nshares = 0;
+        return;
+    }
+    lim->nshares = num_lcores;
+
+    /* start with full buckets, of one connection at least */
+    lim->conn_tokens = RTE_MAX(dp_vs_dest_limit_burst(lim->max_cps,
+                                                      lim->nshares),
+                               (int64_t)US_PER_S);
+    lim->byte_tokens = dp_vs_dest_limit_burst(lim->max_bps, lim->nshares);
+    lim->last_bytes  = dest->stats.inbytes + dest->stats.outbytes;
+    lim->last_cycles = rte_get_timer_cycles();
+}
+
 static void __dp_vs_dest_update(struct dp_vs_service *svc,
                                 struct dp_vs_dest *dest,
                                 struct dp_vs_dest_conf *udest)
@@ -74,6 +109,8 @@ static void __dp_vs_dest_update(struct dp_vs_service *svc,
         dest->max_conn = udest->max_conn % num_lcores;
         dest->min_conn = udest->min_conn % num_lcores;
     }
+
+    dp_vs_dest_limit_update(dest, udest, num_lcores);
 }
 
 
@@ -96,7 +133,6 @@ int dp_vs_dest_new(struct dp_vs_service *svc,
     dest->vaddr = svc->addr;
     dest->vport = svc->port;
     dest->conn_timeout = svc->conn_timeout;
-    dest->limit_proportion = svc->limit_proportion;
     dest->vfwmark = svc->fwmark;
     dest->addr = udest->addr;
     dest->port = udest->port;
@@ -113,6 +149,18 @@ int dp_vs_dest_new(struct dp_vs_service *svc,
     return EDPVS_OK;
 }
 
+/*
+ * the scheduler of a service is updated once for a batch of dests, after
+ * the batch, by dp_vs_dests_set().
+ */
+static inline void dp_vs_dest_sched_update(struct dp_vs_service *svc,
+                                           struct dp_vs_dest *dest,
+                                           sockoptid_t opt)
+{
+    if (svc->scheduler->update_service && !svc->sched_batch)
+        svc->scheduler->update_service(svc, dest, opt);
+}
+
 int
 dp_vs_dest_add(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
 {
@@ -157,8 +205,7 @@ dp_vs_dest_add(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
     svc->num_dests++;
 
     /* call the update_service function of its scheduler */
-    if (svc->scheduler->update_service)
-        svc->scheduler->update_service(svc, dest, DPVS_SO_SET_ADDDEST);
+    dp_vs_dest_sched_update(svc, dest, DPVS_SO_SET_ADDDEST);
 
     return EDPVS_OK;
 }
@@ -211,8 +258,7 @@ dp_vs_dest_edit(struct dp_vs_service *svc, struct dp_vs_dest_conf *udest)
     }
 
     /* call the update_service, because server weight may be changed */
-    if (svc->scheduler->update_service)
-        svc->scheduler->update_service(svc, dest, DPVS_SO_SET_EDITDEST);
+    dp_vs_dest_sched_update(svc, dest, DPVS_SO_SET_EDITDEST);
 
     return EDPVS_OK;
 }
@@ -255,8 +301,8 @@ void dp_vs_dest_unlink(struct dp_vs_service *svc,
     /*
      *  Call the update_service function of its scheduler
      */
-    if (svcupd && svc->scheduler->update_service)
-        svc->scheduler->update_service(svc, dest, DPVS_SO_SET_DELDEST);
+    if (svcupd)
+        dp_vs_dest_sched_update(svc, dest, DPVS_SO_SET_DELDEST);
 }
 
 int
@@ -309,6 +355,9 @@ int dp_vs_dest_get_entries(const struct dp_vs_service *svc,
         entry.actconns = rte_atomic32_read(&dest->actconns);
         entry.inactconns = rte_atomic32_read(&dest->inactconns);
         entry.persistconns = rte_atomic32_read(&dest->persistconns);
+        entry.max_cps = dest->limit.max_cps;
+        entry.max_bps = dest->limit.max_bps;
+        entry.limit_drops = dest->limit.drops;
         ret = dp_vs_stats_add(&(entry.stats), &dest->stats);
         if (ret != EDPVS_OK)
             break;
@@ -320,6 +369,103 @@ int dp_vs_dest_get_entries(const struct dp_vs_service *svc,
     return ret;
 }
 
+/*
+ * the buckets are refilled lazily here, by the time elapsed since last check.
+ * bytes are charged afterwards from the dest traffic counters, so packets of
+ * established connections are never dropped, only new connections are
+ * refused while the byte bucket is in debt.
+ *
+ * the svc limit_proportion admits that percent of new connections, by
+ * credits rather than at random.
+ */
+bool dp_vs_dest_limited(struct dp_vs_dest *dest)
+{
+    struct dp_vs_dest_limit *lim = &dest->limit;
+    uint64_t now, gap, cycles, elapsed, bytes, hz;
+    int64_t burst;
+    unsigned proportion;
+
+    proportion = dest->svc ? dest->svc->limit_proportion : 0;
+    if (proportion >= 100)
+        proportion = 0;
+
+    if (likely(!proportion && (!lim->nshares ||
+                               (!lim->max_cps && !lim->max_bps))))
+        return false;
+
+    if (!lim->nshares)
+        goto check_proportion;
+
+    hz = rte_get_timer_hz();
+    now = rte_get_timer_cycles();
+    gap = now - lim->last_cycles;
+    cycles = RTE_MIN(gap, hz);
+    elapsed = cycles * US_PER_S / hz;
+    /* advance by the whole microseconds refilled, the rest counts next time.
+     * a gap over a second refills one second, the rest is dropped. */
+    if (gap > cycles)
+        lim->last_cycles = now;
+    else
+        lim->last_cycles += elapsed * hz / US_PER_S;
+
+    if (lim->max_cps) {
+        burst = RTE_MAX(dp_vs_dest_limit_burst(lim->max_cps, lim->nshares),
+                        (int64_t)US_PER_S);
+        lim->conn_tokens = RTE_MIN(lim->conn_tokens +
+                            (int64_t)(lim->max_cps * elapsed / lim->nshares),
+                            burst);
+    }
+
+    if (lim->max_bps && elapsed > 0) {
+        bytes = dest->stats.inbytes + dest->stats.outbytes;
+        if (unlikely(bytes < lim->last_bytes)) /* stats zeroed */
+            lim->last_bytes = bytes;
+        bytes -= lim->last_bytes;
+        lim->last_bytes += bytes;
+
+        /* the refill covers the last second only, so do the bytes,
+         * taken at the average rate of the gap. gap and cycles are shifted
+         * under 32 bits, so that the products fit in 64 bits. */
+        if (gap > cycles) {
+            while (gap >> 32) {
+                gap >>= 1;
+                cycles >>= 1;
+            }
+            bytes = bytes / gap * cycles + bytes % gap * cycles / gap;
+        }
+
+        burst = dp_vs_dest_limit_burst(lim->max_bps, lim->nshares);
+        lim->byte_tokens = RTE_MIN(lim->byte_tokens +
+                            (int64_t)(lim->max_bps * elapsed / lim->nshares),
+                            burst);
+        /* at most one second of debt, also keeps the scaling in range */
+        bytes = RTE_MIN(bytes, 2 * (uint64_t)burst / US_PER_S + 1);
+        lim->byte_tokens -= (int64_t)bytes * US_PER_S;
+        lim->byte_tokens = RTE_MAX(lim->byte_tokens, -burst);
+    }
+
+    if ((lim->max_cps && lim->conn_tokens < US_PER_S) ||
+            (lim->max_bps && lim->byte_tokens < 0))
+        goto limited;
+
+check_proportion:
+    if (proportion) {
+        lim->credit += proportion;
+        if (lim->credit < 100)
+            goto limited;
+        lim->credit -= 100;
+    }
+
+    if (lim->nshares && lim->max_cps)
+        lim->conn_tokens -= US_PER_S;
+    return false;
+
+limited:
+    lim->drops++;
+    dp_vs_estats_inc(DEST_LIMIT_DROP);
+    return true;
+}
+
 int dp_vs_dest_init(void)
 {
     return EDPVS_OK;
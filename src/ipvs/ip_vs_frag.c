@@ -0,0 +1,184 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <rte_jhash.h>
+#include "netif.h"
+#include "inet.h"
+#include "ipv4_frag.h"
+#include "parser/parser.h"
+#include "ipvs/ipvs.h"
+#include "ipvs/conn.h"
+#include "ipvs/redirect.h"
+#include "ipvs/frag.h"
+
+bool dp_vs_frag_enable = false;
+
+/* reassembly lcores, the fwd workers */
+static lcoreid_t frag_lcores[DPVS_MAX_LCORE];
+static uint32_t frag_nlcores;
+static uint32_t frag_hash_rnd;
+
+static inline lcoreid_t frag_owner(int af, struct rte_mbuf *mbuf)
+{
+    uint32_t hash;
+    struct rte_ipv4_hdr *iph;
+    struct ip6_hdr *ip6h;
+    struct ipv6_extension_fragment *fh;
+
+    if (af == AF_INET) {
+        iph = ip4_hdr(mbuf);
+        hash = rte_jhash_3words(iph->src_addr, iph->dst_addr,
+                                iph->packet_id, frag_hash_rnd);
+    } else {
+        ip6h = ip6_hdr(mbuf);
+        fh = rte_ipv6_frag_get_ipv6_fragment_header((struct rte_ipv6_hdr *)ip6h);
+        hash = rte_jhash_32b((const uint32_t *)&ip6h->ip6_src, 8,
+                             frag_hash_rnd ^ fh->id);
+    }
+
+    return frag_lcores[hash % frag_nlcores];
+}
+
+bool dp_vs_frag_match(int af, struct rte_mbuf *mbuf)
+{
+    union inet_addr daddr;
+    struct inet_ifaddr *ifa;
+    struct rte_ipv4_hdr *iph;
+    struct ip6_hdr *ip6h;
+    struct ipv6_extension_fragment *fh;
+    uint8_t proto;
+    bool match;
+
+    if (af == AF_INET) {
+        iph = ip4_hdr(mbuf);
+        daddr.in.s_addr = iph->dst_addr;
+        proto = iph->next_proto_id;
+    } else {
+        if (unlikely(mbuf->data_len < sizeof(struct ip6_hdr) +
+                     sizeof(struct ipv6_extension_fragment)))
+            return false;
+        ip6h = ip6_hdr(mbuf);
+        fh = rte_ipv6_frag_get_ipv6_fragment_header((struct rte_ipv6_hdr *)ip6h);
+        daddr.in6 = ip6h->ip6_dst;
+        proto = fh->next_header;
+    }
+
+    if (dp_vs_vip_lookup(af, proto, &daddr, rte_lcore_id()))
+        return true;
+
+    /* replies of FNAT conns come to a local address with an sa_pool */
+    ifa = inet_addr_ifa_get(af, NULL, &daddr);
+    if (!ifa)
+        return false;
+    match = (ifa->sa_pool != NULL);
+    inet_addr_ifa_put(ifa);
+
+    return match;
+}
+
+int dp_vs_frag_in(int af, struct rte_mbuf *mbuf)
+{
+    int err;
+    lcoreid_t owner;
+
+    if (af == AF_INET6 && unlikely(mbuf->data_len < sizeof(struct ip6_hdr) +
+                                   sizeof(struct ipv6_extension_fragment)))
+        return INET_DROP;
+
+    owner = frag_owner(af, mbuf);
+    if (owner != rte_lcore_id()) {
+        /* recover mbuf.data_off to outer Ether header */
+        rte_pktmbuf_prepend(mbuf, (uint16_t)sizeof(struct rte_ether_hdr));
+
+        return dp_vs_redirect_pkt(mbuf, owner);
+    }
+
+    if (af == AF_INET) {
+        /* ip4_defrag() frees the mbuf on error */
+        if (ip4_defrag(mbuf, IP_DEFRAG_PRE_ROUTING) != EDPVS_OK)
+            return INET_STOLEN;
+        ip4_send_csum(ip4_hdr(mbuf));
+    } else {
+        err = ipv6_reassamble(mbuf);
+        if (err == EDPVS_INPROGRESS)
+            return INET_STOLEN;
+        if (err != EDPVS_OK) {
+            rte_pktmbuf_free(mbuf);
+            return INET_STOLEN;
+        }
+    }
+
+    return INET_ACCEPT;
+}
+
+int dp_vs_frag_init(void)
+{
+    lcoreid_t cid;
+
+    if (!dp_vs_frag_enable)
+        return EDPVS_OK;
+
+    if (dp_vs_redirect_disable) {
+        RTE_LOG(WARNING, IPVS, "%s: fragment needs conn:redirect on, "
+                "IPVS fragments are dropped\n", __func__);
+        dp_vs_frag_enable = false;
+        return EDPVS_OK;
+    }
+
+    frag_nlcores = 0;
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (netif_lcore_is_fwd_worker(cid))
+            frag_lcores[frag_nlcores++] = cid;
+    }
+    if (!frag_nlcores) {
+        dp_vs_frag_enable = false;
+        return EDPVS_OK;
+    }
+    frag_hash_rnd = (uint32_t)random();
+
+    return EDPVS_OK;
+}
+
+int dp_vs_frag_term(void)
+{
+    dp_vs_frag_enable = false;
+
+    return EDPVS_OK;
+}
+
+static void frag_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (strcasecmp(str, "on") == 0)
+        dp_vs_frag_enable = true;
+    else if (strcasecmp(str, "off") == 0)
+        dp_vs_frag_enable = false;
+    else
+        RTE_LOG(WARNING, IPVS, "invalid conn:fragment %s\n", str);
+
+    RTE_LOG(INFO, IPVS, "conn:fragment = %s\n", dp_vs_frag_enable ? "on" : "off");
+
+    FREE_PTR(str);
+}
+
+void install_frag_keywords(void)
+{
+    install_keyword("fragment", frag_handler, KW_TYPE_INIT);
+}
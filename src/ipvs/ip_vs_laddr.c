@@ -108,25 +108,45 @@ struct dp_vs_laddr {
 
 static uint32_t dp_vs_laddr_max_trails = 16;
 
-static inline int __laddr_step(struct dp_vs_service *svc)
+/* lports an laddr needs toward the RS not to be thought exhausting */
+#define DP_VS_LADDR_FREE_LOW    512
+
+static inline struct list_head *__laddr_next(struct dp_vs_service *svc,
+                                             struct list_head *pos)
 {
-   /* Why can't we always use the next laddr(rr scheduler) to setup new session?
-    * Because realserver rr/wrr scheduler may get synchronous with the laddr rr
-    * scheduler. If so, the local IP may stay invariant for a specified realserver,
-    * which is a hurt for realserver concurrency performance. To avoid the problem,
-    * we just choose 5% sessions to use the one after the next laddr randomly.
-    * */
-    if (strncmp(svc->scheduler->name, "rr", 2) == 0 ||
-            strncmp(svc->scheduler->name, "wrr", 3) == 0)
-        return (random() % 100) < 5 ? 2 : 1;
-
-    return 1;
+    if (unlikely(!pos))
+        return svc->laddr_list.next;
+
+    pos = pos->next;
+    if (pos == &svc->laddr_list)
+        pos = pos->next;
+
+    return pos;
 }
 
-static inline struct dp_vs_laddr *__get_laddr(struct dp_vs_service *svc)
+static inline uint32_t __laddr_free_ports(const struct dp_vs_laddr *laddr,
+                                          const struct dp_vs_conn *conn)
+{
+    return sa_pool_free_ports(laddr->af, laddr->iface, &laddr->addr,
+                              &conn->daddr, conn->dport);
+}
+
+/*
+ * Power of two choices: the next laddr in turn against a random other one.
+ * The one with more free lports toward the RS wins, so an laddr running
+ * out of lports gets no more conns before sa_fetch() would fail on it.
+ * While both have plenty, the one with less conns wins to even the load.
+ *
+ * The random candidate also keeps the laddr from getting synchronous with
+ * rr/wrr realserver schedulers, which would stick a realserver to one laddr.
+ */
+static inline struct dp_vs_laddr *__get_laddr(struct dp_vs_service *svc,
+                                              const struct dp_vs_conn *conn)
 {
     int step;
-    struct dp_vs_laddr *laddr = NULL;
+    uint32_t free_a, free_b;
+    struct list_head *pos;
+    struct dp_vs_laddr *laddr, *other;
 
     /* if list not inited ? list_empty() returns true ! */
     assert(svc->laddr_list.next);
@@ -135,18 +155,26 @@ static inline struct dp_vs_laddr *__get_laddr(struct dp_vs_service *svc)
         return NULL;
     }
 
-    step = __laddr_step(svc);
-    while (step-- > 0) {
-        if (unlikely(!svc->laddr_curr))
-            svc->laddr_curr = svc->laddr_list.next;
-        else
-            svc->laddr_curr = svc->laddr_curr->next;
+    svc->laddr_curr = __laddr_next(svc, svc->laddr_curr);
+    laddr = list_entry(svc->laddr_curr, struct dp_vs_laddr, list);
 
-        if (svc->laddr_curr == &svc->laddr_list)
-            svc->laddr_curr = svc->laddr_list.next;
+    if (conn && svc->num_laddrs > 1) {
+        pos = svc->laddr_curr;
+        for (step = 1 + random() % (svc->num_laddrs - 1); step > 0; step--)
+            pos = __laddr_next(svc, pos);
+        other = list_entry(pos, struct dp_vs_laddr, list);
+
+        free_a = __laddr_free_ports(laddr, conn);
+        free_b = __laddr_free_ports(other, conn);
+        if (free_a >= DP_VS_LADDR_FREE_LOW && free_b >= DP_VS_LADDR_FREE_LOW) {
+            if (rte_atomic32_read(&other->conn_counts)
+                    < rte_atomic32_read(&laddr->conn_counts))
+                laddr = other;
+        } else if (free_b > free_a) {
+            laddr = other;
+        }
     }
 
-    laddr = list_entry(svc->laddr_curr, struct dp_vs_laddr, list);
     rte_atomic32_inc(&laddr->refcnt);
 
     return laddr;
@@ -185,8 +213,9 @@ int dp_vs_laddr_bind(struct dp_vs_conn *conn, struct dp_vs_service *svc)
      * but there's also some resource on another laddr.
      */
     for (i = 0; i < dp_vs_laddr_max_trails && i < svc->num_laddrs; i++) {
-        /* select a local IP from service */
-        laddr = __get_laddr(svc);
+        /* select a local IP from service, load-aware for the first try,
+         * the others in turn if it fails. */
+        laddr = __get_laddr(svc, i ? NULL : conn);
         if (!laddr) {
             RTE_LOG(ERR, IPVS, "%s: no laddr available.\n", __func__);
             return EDPVS_RESOURCE;
@@ -254,6 +283,69 @@ int dp_vs_laddr_bind(struct dp_vs_conn *conn, struct dp_vs_service *svc)
     return EDPVS_OK;
 }
 
+/*
+ * bind @conn to the laddr and lport it has had, e.g., a conn restored after
+ * restart, which has its laddr/lport and out-tuplehash set already. @held
+ * if the lport was taken from sa_pool for it already.
+ */
+int dp_vs_laddr_rebind(struct dp_vs_conn *conn, struct dp_vs_service *svc,
+                       bool held)
+{
+    struct dp_vs_laddr *laddr;
+    struct sockaddr_storage dsin, ssin;
+    int err;
+
+    if (!conn || !conn->dest || !svc)
+        return EDPVS_INVAL;
+    if (dp_vs_conn_is_template(conn))
+        return EDPVS_OK;
+
+    list_for_each_entry(laddr, &svc->laddr_list, list) {
+        if (laddr->af == tuplehash_out(conn).af
+                && inet_addr_equal(laddr->af, &laddr->addr, &conn->laddr))
+            break;
+    }
+    if (&laddr->list == &svc->laddr_list)
+        return EDPVS_NOTEXIST;
+
+    memset(&dsin, 0, sizeof(struct sockaddr_storage));
+    memset(&ssin, 0, sizeof(struct sockaddr_storage));
+
+    if (laddr->af == AF_INET) {
+        struct sockaddr_in *daddr, *saddr;
+        daddr = (struct sockaddr_in *)&dsin;
+        daddr->sin_family = laddr->af;
+        daddr->sin_addr = conn->daddr.in;
+        daddr->sin_port = conn->dport;
+        saddr = (struct sockaddr_in *)&ssin;
+        saddr->sin_family = laddr->af;
+        saddr->sin_addr = conn->laddr.in;
+        saddr->sin_port = conn->lport;
+    } else {
+        struct sockaddr_in6 *daddr, *saddr;
+        daddr = (struct sockaddr_in6 *)&dsin;
+        daddr->sin6_family = laddr->af;
+        daddr->sin6_addr = conn->daddr.in6;
+        daddr->sin6_port = conn->dport;
+        saddr = (struct sockaddr_in6 *)&ssin;
+        saddr->sin6_family = laddr->af;
+        saddr->sin6_addr = conn->laddr.in6;
+        saddr->sin6_port = conn->lport;
+    }
+
+    if (!held) {
+        err = sa_claim(laddr->iface, &dsin, &ssin);
+        if (err != EDPVS_OK)
+            return err;
+    }
+
+    rte_atomic32_inc(&laddr->refcnt);
+    rte_atomic32_inc(&laddr->conn_counts);
+
+    conn->local = laddr;
+    return EDPVS_OK;
+}
+
 int dp_vs_laddr_unbind(struct dp_vs_conn *conn)
 {
     struct sockaddr_storage dsin, ssin;
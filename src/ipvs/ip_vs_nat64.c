@@ -58,6 +58,12 @@ int mbuf_6to4(struct rte_mbuf *mbuf,
     ip4h->dst_addr        = daddr->s_addr;
     ip4h->packet_id       = 0; // NO FRAG, so 0 is OK?
 
+    /* a reassembled datagram is fragmented again by ipv4_output() */
+    if (unlikely(mbuf_frag_size(mbuf))) {
+        ip4h->fragment_offset = 0;
+        ip4h->packet_id = ip4_select_id(ip4h);
+    }
+
     mbuf->l3_len = sizeof(struct rte_ipv4_hdr);
 
     return EDPVS_OK;
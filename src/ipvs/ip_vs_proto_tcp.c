@@ -169,8 +169,8 @@ static inline int tcp_send_csum(int af, int iphdrlen, struct tcphdr *th,
         struct ip6_hdr *ip6h = ip6_hdr(mbuf);
         if (rt6 && rt6->rt6_dev)
             dev = rt6->rt6_dev;
-        else if (conn->out_dev)
-            dev = conn->out_dev;
+        else
+            dev = dp_vs_conn_nexthop_dev(conn, false);
         if (likely(dev && (dev->flag & NETIF_PORT_FLAG_TX_TCP_CSUM_OFFLOAD))) {
             mbuf->l3_len = iphdrlen;
             mbuf->l4_len = (th->doff << 2);
@@ -186,8 +186,8 @@ static inline int tcp_send_csum(int af, int iphdrlen, struct tcphdr *th,
         struct rte_ipv4_hdr *iph = ip4_hdr(mbuf);
         if (rt && rt->port)
             dev = rt->port;
-        else if (conn->out_dev)
-            dev = conn->out_dev;
+        else
+            dev = dp_vs_conn_nexthop_dev(conn, false);
         if (likely(dev && (dev->flag & NETIF_PORT_FLAG_TX_TCP_CSUM_OFFLOAD))) {
             mbuf->l3_len = iphdrlen;
             mbuf->l4_len = (th->doff << 2);
@@ -258,7 +258,8 @@ static inline void tcp_in_adjust_seq(struct dp_vs_conn *conn, struct tcphdr *th)
     th->seq = htonl(ntohl(th->seq) + conn->fnat_seq.delta);
     /* recalc checksum later */
     /* adjust ack_seq for synproxy,including tcp hdr and sack opt */
-    dp_vs_synproxy_dnat_handler(th, &conn->syn_proxy_seq);
+    if (conn->synproxy)
+        dp_vs_synproxy_dnat_handler(th, &conn->synproxy->syn_proxy_seq);
     return;
 }
 
@@ -325,8 +326,8 @@ static inline int tcp_in_add_toa(struct dp_vs_conn *conn, struct rte_mbuf *mbuf,
     } else if (tuplehash_out(conn).af == AF_INET6 && (rt6 = MBUF_USERDATA(mbuf,
                     struct route6 *, MBUF_FIELD_ROUTE)) != NULL) {
         mtu = rt6->rt6_mtu;
-    } else if (conn->in_dev) { /* no route for fast-xmit */
-        mtu = conn->in_dev->mtu;
+    } else if (conn->in_nh) { /* no route for fast-xmit */
+        mtu = conn->in_nh->port->mtu;
     } else {
         RTE_LOG(DEBUG, IPVS, "add toa: MTU unknown.\n");
         return EDPVS_NOROUTE;
@@ -571,7 +572,7 @@ static int tcp_conn_sched(struct dp_vs_proto *proto,
      * So don't judge SYNPROXY flag here! If SYNPROXY flag judged, and syn_proxy
      * got disbled and keepalived reloaded, SYN packets for RS may never be sent. */
     if (dp_vs_synproxy_ack_rcv(iph->af, mbuf, th, proto, conn, iph, verdict) == 0) {
-        /* Attention: First ACK packet is also stored in conn->ack_mbuf */
+        /* Attention: First ACK packet is also stored in conn->synproxy->ack_mbuf */
         return EDPVS_PKTSTOLEN;
     }
 
@@ -641,7 +642,7 @@ tcp_conn_lookup(struct dp_vs_proto *proto, const struct dp_vs_iphdr *iph,
     if (unlikely(!th))
         return NULL;
 
-    if (dp_vs_blklst_lookup(iph->af, iph->proto, &iph->daddr,
+    if (dp_vs_blklst_filtered(iph->af, iph->proto, &iph->daddr,
                 th->dest, &iph->saddr)) {
         *drop = true;
         return NULL;
@@ -662,14 +663,10 @@ tcp_conn_lookup(struct dp_vs_proto *proto, const struct dp_vs_iphdr *iph,
      */
     if (conn != NULL) {
         if (th->ack) {
-            if ((*direct == DPVS_CONN_DIR_INBOUND) && conn->out_dev
-                 && (!inet_is_addr_any(tuplehash_in(conn).af, &conn->out_nexthop))) {
-                neigh_confirm(tuplehash_in(conn).af, &conn->out_nexthop,
-                              conn->out_dev);
-            } else if ((*direct == DPVS_CONN_DIR_OUTBOUND) && conn->in_dev
-                        && (!inet_is_addr_any(tuplehash_out(conn).af, &conn->in_nexthop))) {
-                neigh_confirm(tuplehash_out(conn).af, &conn->in_nexthop,
-                              conn->in_dev);
+            if ((*direct == DPVS_CONN_DIR_INBOUND) && conn->out_nh) {
+                neigh_confirm_held(conn->out_nh, conn->out_nh_gen);
+            } else if ((*direct == DPVS_CONN_DIR_OUTBOUND) && conn->in_nh) {
+                neigh_confirm_held(conn->in_nh, conn->in_nh_gen);
             }
         }
     } else {
@@ -931,9 +928,9 @@ struct rte_mempool *get_mbuf_pool(const struct dp_vs_conn *conn, int dir)
     int af;
 
     /* we need oif for correct rte_mempoll,
-     * most likely oif is conn->in/out_dev (fast-xmit),
+     * most likely oif is the nexthop dev of conn (fast-xmit),
      * if not, determine output device by route. */
-    dev = ((dir == DPVS_CONN_DIR_INBOUND) ? conn->in_dev : conn->out_dev);
+    dev = dp_vs_conn_nexthop_dev(conn, dir == DPVS_CONN_DIR_INBOUND);
 
     if (unlikely(!dev)) {
     /* dir is mbuf to revieve, route/af is mbuf to send
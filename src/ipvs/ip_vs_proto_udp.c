@@ -93,8 +93,8 @@ static inline int udp_send_csum(int af, int iphdrlen, struct rte_udp_hdr *uh,
             struct route6 *rt6 = MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE);
             if (rt6 && rt6->rt6_dev)
                 dev = rt6->rt6_dev;
-            else if (conn->out_dev)
-                dev = conn->out_dev;
+            else
+                dev = dp_vs_conn_nexthop_dev(conn, false);
             if (likely(dev && (dev->flag & NETIF_PORT_FLAG_TX_UDP_CSUM_OFFLOAD))) {
                 mbuf->l3_len = iphdrlen;
                 mbuf->l4_len = sizeof(struct rte_udp_hdr);
@@ -126,8 +126,8 @@ static inline int udp_send_csum(int af, int iphdrlen, struct rte_udp_hdr *uh,
             struct route_entry *rt = MBUF_USERDATA(mbuf, struct route_entry *, MBUF_FIELD_ROUTE);
             if (rt && rt->port)
                 dev = rt->port;
-            else if (conn->out_dev)
-                dev = conn->out_dev;
+            else
+                dev = dp_vs_conn_nexthop_dev(conn, false);
             if (likely(dev && (dev->flag & NETIF_PORT_FLAG_TX_UDP_CSUM_OFFLOAD))) {
                 mbuf->l3_len = iphdrlen;
                 mbuf->l4_len = sizeof(struct rte_udp_hdr);
@@ -207,7 +207,7 @@ udp_conn_lookup(struct dp_vs_proto *proto,
     if (unlikely(!uh))
         return NULL;
 
-    if (dp_vs_blklst_lookup(iph->af, iph->proto, &iph->daddr,
+    if (dp_vs_blklst_filtered(iph->af, iph->proto, &iph->daddr,
                 uh->dst_port, &iph->saddr)) {
         *drop = true;
         return NULL;
@@ -230,10 +230,8 @@ udp_conn_lookup(struct dp_vs_proto *proto,
      * UDP can only confirm neighbour to RS
      */
     if (conn != NULL) {
-        if ((*direct == DPVS_CONN_DIR_OUTBOUND) && conn->in_dev
-             && (!inet_is_addr_any(tuplehash_out(conn).af, &conn->in_nexthop))) {
-            neigh_confirm(tuplehash_out(conn).af, &conn->in_nexthop, conn->in_dev);
-        }
+        if ((*direct == DPVS_CONN_DIR_OUTBOUND) && conn->in_nh)
+            neigh_confirm_held(conn->in_nh, conn->in_nh_gen);
     } else {
         struct dp_vs_redirect *r;
 
@@ -218,7 +218,7 @@ __dp_vs_service_match_get4(const struct rte_mbuf *mbuf, bool *outwall, lcoreid_t
         if ((rt->flag & RTF_KNI) || (rt->flag & RTF_LOCALIN))
             return NULL;
         oif = rt->port->id;
-    } else if (outwall != NULL && (NULL != ipset_addr_lookup(AF_INET, &daddr))
+    } else if (outwall != NULL && ipset_addr_lookup(AF_INET, &daddr)
                                && (rt = route_gfw_net_lookup(&daddr.in))) {
         char dst[64];
         RTE_LOG(DEBUG, IPSET, "%s: IP %s is in the gfwip set, found route in the outwall table.\n", __func__,
@@ -480,6 +480,36 @@ void dp_vs_service_unbind(struct dp_vs_dest *dest)
     dest->svc = NULL;
 }
 
+int dp_vs_service_walk(lcoreid_t cid, dp_vs_service_walk_cb_t cb, void *arg)
+{
+    int idx, err;
+    struct dp_vs_service *svc;
+
+    for (idx = 0; idx < DP_VS_SVC_TAB_SIZE; idx++) {
+        list_for_each_entry(svc, &dp_vs_svc_table[cid][idx], s_list) {
+            err = cb(svc, arg);
+            if (err != EDPVS_OK)
+                return err;
+        }
+    }
+
+    for (idx = 0; idx < DP_VS_SVC_TAB_SIZE; idx++) {
+        list_for_each_entry(svc, &dp_vs_svc_fwm_table[cid][idx], f_list) {
+            err = cb(svc, arg);
+            if (err != EDPVS_OK)
+                return err;
+        }
+    }
+
+    list_for_each_entry(svc, &dp_vs_svc_match_list[cid], m_list) {
+        err = cb(svc, arg);
+        if (err != EDPVS_OK)
+            return err;
+    }
+
+    return EDPVS_OK;
+}
+
 static int dp_vs_service_add(struct dp_vs_service_conf *u,
                       struct dp_vs_service **svc_p,
                       lcoreid_t cid)
@@ -875,6 +905,8 @@ static void dp_vs_copy_udest_compat(struct dp_vs_dest_conf *udest,
     udest->weight     = udest_compat->weight;
     udest->max_conn   = udest_compat->max_conn;
     udest->min_conn   = udest_compat->min_conn;
+    udest->max_cps    = udest_compat->max_cps;
+    udest->max_bps    = udest_compat->max_bps;
 }
 
 static int gratuitous_arp_send_vip(struct in_addr *vip)
@@ -902,15 +934,112 @@ static int svc_msg_seq(void)
     return seq++;
 }
 
+static inline bool is_dest_opt(sockoptid_t opt)
+{
+    return opt == DPVS_SO_SET_ADDDEST || opt == DPVS_SO_SET_EDITDEST
+        || opt == DPVS_SO_SET_DELDEST;
+}
+
+static inline void dp_vs_dests_get(const void *udests, unsigned i,
+                                   struct dp_vs_dest_conf *udest)
+{
+    struct dp_vs_dest_user udest_compat;
+
+    memcpy(&udest_compat, (const char *)udests + i * sizeof(udest_compat),
+           sizeof(udest_compat));
+    dp_vs_copy_udest_compat(udest, &udest_compat);
+}
+
+/*
+ * check a batch of dests as a whole with the checks of dp_vs_dest_add/edit/
+ * del(), so that a batch fails before any dest of it is applied.
+ */
+static int dp_vs_dests_check(sockoptid_t opt, struct dp_vs_service *svc,
+                             const void *udests, unsigned ndests)
+{
+    unsigned i, j;
+    bool exist;
+    struct dp_vs_dest_conf udest, prev;
+
+    for (i = 0; i < ndests; i++) {
+        dp_vs_dests_get(udests, i, &udest);
+
+        if (opt != DPVS_SO_SET_DELDEST &&
+                (udest.weight < 0 || udest.min_conn > udest.max_conn))
+            return opt == DPVS_SO_SET_ADDDEST ? EDPVS_NOTSUPP : EDPVS_INVAL;
+
+        exist = dp_vs_dest_lookup(udest.af, svc, &udest.addr, udest.port) != NULL;
+        if (opt == DPVS_SO_SET_ADDDEST && exist)
+            return EDPVS_EXIST;
+        if (opt != DPVS_SO_SET_ADDDEST && !exist)
+            return EDPVS_NOTEXIST;
+
+        /* a dest added or deleted twice fails the second time */
+        if (opt == DPVS_SO_SET_EDITDEST)
+            continue;
+        for (j = 0; j < i; j++) {
+            dp_vs_dests_get(udests, j, &prev);
+            if (prev.af == udest.af && prev.port == udest.port
+                    && inet_addr_equal(udest.af, &prev.addr, &udest.addr))
+                return opt == DPVS_SO_SET_ADDDEST ? EDPVS_EXIST : EDPVS_NOTEXIST;
+        }
+    }
+
+    return EDPVS_OK;
+}
+
+/*
+ * apply a batch of dests entirely or not at all. once checked, only an
+ * allocation of ADDDEST can fail, the dests added before it are removed.
+ * the scheduler is updated once for the batch, with a NULL dest.
+ */
+static int dp_vs_dests_set(sockoptid_t opt, struct dp_vs_service *svc,
+                           const void *udests, unsigned ndests)
+{
+    int ret;
+    unsigned i;
+    struct dp_vs_dest_conf udest;
+
+    ret = dp_vs_dests_check(opt, svc, udests, ndests);
+    if (ret != EDPVS_OK)
+        return ret;
+
+    /* the scheduler is updated once, with all dests of the batch in place */
+    svc->sched_batch = true;
+    for (i = 0; i < ndests; i++) {
+        dp_vs_dests_get(udests, i, &udest);
+
+        if (opt == DPVS_SO_SET_ADDDEST)
+            ret = dp_vs_dest_add(svc, &udest);
+        else if (opt == DPVS_SO_SET_EDITDEST)
+            ret = dp_vs_dest_edit(svc, &udest);
+        else
+            ret = dp_vs_dest_del(svc, &udest);
+        if (ret != EDPVS_OK)
+            break;
+    }
+
+    if (ret != EDPVS_OK && opt == DPVS_SO_SET_ADDDEST) {
+        while (i-- > 0) {
+            dp_vs_dests_get(udests, i, &udest);
+            dp_vs_dest_del(svc, &udest);
+        }
+    }
+    svc->sched_batch = false;
+
+    if (svc->scheduler->update_service)
+        svc->scheduler->update_service(svc, NULL, opt);
+
+    return ret;
+}
+
 static int dp_vs_service_set(sockoptid_t opt, const void *user, size_t len)
 {
     int ret;
-    unsigned char arg[MAX_ARG_LEN];
-    struct dp_vs_service_user *usvc_compat;
+    unsigned ndests = 0;
+    struct dp_vs_service_user usvc_compat;
     struct dp_vs_service_conf usvc;
     struct dp_vs_service *svc = NULL;
-    struct dp_vs_dest_user *udest_compat;
-    struct dp_vs_dest_conf udest;
     struct in_addr *vip;
     lcoreid_t cid = rte_lcore_id();
 
@@ -919,6 +1048,15 @@ static int dp_vs_service_set(sockoptid_t opt, const void *user, size_t len)
         return gratuitous_arp_send_vip(vip);
     }
 
+    if (is_dest_opt(opt)) {
+        if (len < DP_VS_SVCDEST_LEN(1) ||
+                (len - DP_VS_SVCDEST_LEN(0)) % sizeof(struct dp_vs_dest_user))
+            return EDPVS_INVAL;
+        ndests = (len - DP_VS_SVCDEST_LEN(0)) / sizeof(struct dp_vs_dest_user);
+    } else if (opt != DPVS_SO_SET_FLUSH && len < DP_VS_SVCDEST_LEN(0)) {
+        return EDPVS_INVAL;
+    }
+
     // send to slave core
     if (cid == rte_get_main_lcore()) {
         struct dpvs_msg *msg;
@@ -937,12 +1075,10 @@ static int dp_vs_service_set(sockoptid_t opt, const void *user, size_t len)
     if (opt == DPVS_SO_SET_FLUSH)
         return dp_vs_services_flush(cid);
 
-    memcpy(arg, user, len);
-    usvc_compat = (struct dp_vs_service_user *)arg;
-    udest_compat = (struct dp_vs_dest_user *)(usvc_compat + 1);
+    memcpy(&usvc_compat, user, sizeof(usvc_compat));
 
     memset(&usvc, 0, sizeof(usvc));
-    ret = dp_vs_copy_usvc_compat(&usvc, usvc_compat);
+    ret = dp_vs_copy_usvc_compat(&usvc, &usvc_compat);
     if (ret != EDPVS_OK)
         return ret;
 
@@ -995,16 +1131,10 @@ static int dp_vs_service_set(sockoptid_t opt, const void *user, size_t len)
             ret = dp_vs_service_zero(svc);
             break;
         case DPVS_SO_SET_ADDDEST:
-            dp_vs_copy_udest_compat(&udest, udest_compat);
-            ret = dp_vs_dest_add(svc, &udest);
-            break;
         case DPVS_SO_SET_EDITDEST:
-            dp_vs_copy_udest_compat(&udest, udest_compat);
-            ret = dp_vs_dest_edit(svc, &udest);
-            break;
         case DPVS_SO_SET_DELDEST:
-            dp_vs_copy_udest_compat(&udest, udest_compat);
-            ret = dp_vs_dest_del(svc, &udest);
+            ret = dp_vs_dests_set(opt, svc, (const char *)user + DP_VS_SVCDEST_LEN(0),
+                                  ndests);
             break;
         default:
             ret = EDPVS_INVAL;
@@ -1057,6 +1187,7 @@ static int dp_vs_dests_copy_percore_stats(struct dp_vs_get_dests *master_dests,
         master_dests->entrytable[i].actconns += slave_dests->entrytable[i].actconns;
         master_dests->entrytable[i].inactconns += slave_dests->entrytable[i].inactconns;
         master_dests->entrytable[i].persistconns += slave_dests->entrytable[i].persistconns;
+        master_dests->entrytable[i].limit_drops += slave_dests->entrytable[i].limit_drops;
         dp_vs_stats_add(&master_dests->entrytable[i].stats, &slave_dests->entrytable[i].stats);
     }
 
@@ -1229,6 +1360,7 @@ static int dp_vs_service_get(sockoptid_t opt, const void *user, size_t len, void
                 info->size = 0;
                 info->num_services = rte_atomic16_read(&dp_vs_num_services[cid]);
                 info->num_lcores = num_lcores;
+                dp_vs_stats_global_get(&info->stats);
                 *out = info;
                 *outlen = sizeof(struct dp_vs_getinfo);
                 return EDPVS_OK;
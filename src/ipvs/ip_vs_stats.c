@@ -24,12 +24,23 @@
 #include "ipvs/dest.h"
 #include "ipvs/service.h"
 #include "ipvs/stats.h"
+#include "scheduler.h"
 
 #define this_dpvs_stats             (dpvs_stats[rte_lcore_id()])
 #define this_dpvs_estats            (dpvs_estats[rte_lcore_id()])
 
+/*
+ * rates are estimated every DPVS_EST_INTERVAL_MS by a slow job on each
+ * worker from the per-lcore counters it owns. EWMA is linear, so the sum
+ * of per-lcore smoothed rates got by master is the smoothed rate of the sum.
+ */
+#define DPVS_EST_INTERVAL_MS        2000
+#define DPVS_EST_JOB_LOOPS          10000
+
 static struct dp_vs_stats dpvs_stats[DPVS_MAX_LCORE];
 static struct dp_vs_estats dpvs_estats[DPVS_MAX_LCORE];
+static struct dp_vs_estimator dpvs_est[DPVS_MAX_LCORE];
+static uint64_t dpvs_est_last[DPVS_MAX_LCORE];
 
 void dp_vs_stats_clear(struct dp_vs_stats *stats)
 {
@@ -47,6 +58,12 @@ int dp_vs_stats_add(struct dp_vs_stats *dst, struct dp_vs_stats *src)
     dst->inbytes  += src->inbytes;
     dst->outbytes += src->outbytes;
     dst->outpkts  += src->outpkts;
+
+    dst->cps      += src->cps;
+    dst->inpps    += src->inpps;
+    dst->inbps    += src->inbps;
+    dst->outpps   += src->outpps;
+    dst->outbps   += src->outbps;
     return EDPVS_OK;
 }
 
@@ -56,15 +73,12 @@ int dp_vs_stats_in(struct dp_vs_conn *conn, struct rte_mbuf *mbuf)
     struct dp_vs_dest *dest = conn->dest;
 
     if (dest && dp_vs_dest_is_avail(dest)) {
-        /*limit rate*/
-        if ((dest->limit_proportion < 100) &&
-            (dest->limit_proportion > 0)) {
-            return (rand()%100) > dest->limit_proportion
-                        ? EDPVS_OVERLOAD : EDPVS_OK;
-        }
-
         dest->stats.inpkts++;
         dest->stats.inbytes += mbuf->pkt_len;
+        if (likely(dest->svc)) {
+            dest->svc->stats.inpkts++;
+            dest->svc->stats.inbytes += mbuf->pkt_len;
+        }
     }
 
 #ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
@@ -83,15 +97,12 @@ int dp_vs_stats_out(struct dp_vs_conn *conn, struct rte_mbuf *mbuf)
     struct dp_vs_dest *dest = conn->dest;
 
     if (dest && dp_vs_dest_is_avail(dest)) {
-        /*limit rate*/
-        if ((dest->limit_proportion < 100) &&
-            (dest->limit_proportion > 0)) {
-            return (rand()%100) > dest->limit_proportion
-            ? EDPVS_OVERLOAD : EDPVS_OK;
-        }
-
         dest->stats.outpkts++;
         dest->stats.outbytes += mbuf->pkt_len;
+        if (likely(dest->svc)) {
+            dest->svc->stats.outpkts++;
+            dest->svc->stats.outbytes += mbuf->pkt_len;
+        }
     }
 
 #ifdef CONFIG_DPVS_IPVS_STATS_DEBUG
@@ -109,9 +120,94 @@ void dp_vs_stats_conn(struct dp_vs_conn *conn)
     assert(conn && conn->dest);
 
     conn->dest->stats.conns++;
+    if (likely(conn->dest->svc))
+        conn->dest->svc->stats.conns++;
     this_dpvs_stats.conns++;
 }
 
+void dp_vs_stats_global_get(struct dp_vs_stats *stats)
+{
+    lcoreid_t cid;
+
+    memset(stats, 0, sizeof(*stats));
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++)
+        dp_vs_stats_add(stats, &dpvs_stats[cid]);
+}
+
+/* scaled rate per second of @delta in @elapsed ms */
+static inline uint64_t est_rate(uint64_t delta, int shift, uint32_t elapsed)
+{
+    return (delta << shift) * MS_PER_S / elapsed;
+}
+
+#define EST_EWMA(avg, delta, shift, elapsed) \
+    ((avg) += ((int64_t)est_rate(delta, shift, elapsed) - (int64_t)(avg)) >> 2)
+
+static void dp_vs_estimator_update(struct dp_vs_estimator *est,
+                                   struct dp_vs_stats *stats, uint32_t elapsed)
+{
+    /* counters were zeroed, restart from now */
+    if (unlikely(stats->conns < est->last_conns
+                || stats->inpkts < est->last_inpkts
+                || stats->outpkts < est->last_outpkts
+                || stats->inbytes < est->last_inbytes
+                || stats->outbytes < est->last_outbytes))
+        goto out;
+
+    EST_EWMA(est->cps, stats->conns - est->last_conns, 10, elapsed);
+    EST_EWMA(est->inpps, stats->inpkts - est->last_inpkts, 10, elapsed);
+    EST_EWMA(est->outpps, stats->outpkts - est->last_outpkts, 10, elapsed);
+    EST_EWMA(est->inbps, stats->inbytes - est->last_inbytes, 5, elapsed);
+    EST_EWMA(est->outbps, stats->outbytes - est->last_outbytes, 5, elapsed);
+
+    stats->cps    = (est->cps + 0x1FF) >> 10;
+    stats->inpps  = (est->inpps + 0x1FF) >> 10;
+    stats->outpps = (est->outpps + 0x1FF) >> 10;
+    stats->inbps  = (est->inbps + 0xF) >> 5;
+    stats->outbps = (est->outbps + 0xF) >> 5;
+
+out:
+    est->last_conns    = stats->conns;
+    est->last_inpkts   = stats->inpkts;
+    est->last_outpkts  = stats->outpkts;
+    est->last_inbytes  = stats->inbytes;
+    est->last_outbytes = stats->outbytes;
+}
+
+static int dp_vs_stats_est_svc(struct dp_vs_service *svc, void *arg)
+{
+    uint32_t elapsed = *(uint32_t *)arg;
+    struct dp_vs_dest *dest;
+
+    dp_vs_estimator_update(&svc->est, &svc->stats, elapsed);
+    list_for_each_entry(dest, &svc->dests, n_list)
+        dp_vs_estimator_update(&dest->est, &dest->stats, elapsed);
+
+    return EDPVS_OK;
+}
+
+static void dp_vs_stats_est_job(void *arg)
+{
+    lcoreid_t cid = rte_lcore_id();
+    uint64_t now = rte_get_timer_cycles();
+    uint32_t elapsed;
+
+    elapsed = (now - dpvs_est_last[cid]) * MS_PER_S / rte_get_timer_hz();
+    if (elapsed < DPVS_EST_INTERVAL_MS)
+        return;
+    dpvs_est_last[cid] = now;
+
+    dp_vs_estimator_update(&dpvs_est[cid], &dpvs_stats[cid], elapsed);
+    dp_vs_service_walk(cid, dp_vs_stats_est_svc, &elapsed);
+}
+
+static struct dpvs_lcore_job dp_vs_est_job = {
+    .name = "ipvs_est",
+    .type = LCORE_JOB_SLOW,
+    .func = dp_vs_stats_est_job,
+    .skip_loops = DPVS_EST_JOB_LOOPS,
+};
+
 void dp_vs_estats_inc(enum dp_vs_estats_type field)
 {
     this_dpvs_estats.mibs[field]++;
@@ -129,12 +225,17 @@ uint64_t dp_vs_estats_get(enum dp_vs_estats_type field)
 
 int dp_vs_stats_init(void)
 {
+    lcoreid_t cid;
+
     dp_vs_estats_clear();
-    srand(rte_rdtsc());
-    return EDPVS_OK;
+
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++)
+        dpvs_est_last[cid] = rte_get_timer_cycles();
+
+    return dpvs_lcore_job_register(&dp_vs_est_job, LCORE_ROLE_FWD_WORKER);
 }
 
 int dp_vs_stats_term(void)
 {
-    return EDPVS_OK;
+    return dpvs_lcore_job_unregister(&dp_vs_est_job, LCORE_ROLE_FWD_WORKER);
 }
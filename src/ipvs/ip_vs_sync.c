@@ -0,0 +1,807 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/*
+ * buffers flow between lcores through rings, never locked or shared:
+ *
+ *   worker --(sync_tx_ring, MP/SC)--> master --sendmmsg()--> peer
+ *   peer --recvmmsg()--> master --(rx_ring of the worker, SP/SC)--> worker
+ *
+ * all buffers come from one mempool and are returned by the lcore which
+ * consumes them last.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "netif.h"
+#include "scheduler.h"
+#include "parser/parser.h"
+#include "ipvs/conn.h"
+#include "ipvs/dest.h"
+#include "ipvs/sync.h"
+
+#define DP_VS_SYNC_BUFF_NUM_DEF     8192
+#define DP_VS_SYNC_BUFF_NUM_MIN     1024
+#define DP_VS_SYNC_BUFF_NUM_MAX     1048576
+#define DP_VS_SYNC_BUFF_CACHE       64
+
+#define DP_VS_SYNC_FLUSH_US_DEF     1000
+#define DP_VS_SYNC_FLUSH_US_MAX     1000000
+
+#define DP_VS_SYNC_TX_RING_SIZE     4096
+#define DP_VS_SYNC_RX_RING_SIZE     1024
+#define DP_VS_SYNC_BURST            32
+
+#define DP_VS_SYNC_SOCKBUF_SIZE     (4 * 1024 * 1024)
+
+struct dp_vs_sync_buff {
+    uint64_t                stamp;      /* cycles of the first conn */
+    uint16_t                len;
+    uint8_t                 data[DP_VS_SYNC_MESG_MAX] __rte_aligned(8);
+};
+
+struct dp_vs_sync_lcore {
+    struct dp_vs_sync_buff  *buff;      /* being filled */
+    struct rte_ring         *rx_ring;
+
+    /* statistics */
+    uint64_t                conns;      /* encoded */
+    uint64_t                nobuff;
+    uint64_t                installed;
+    uint64_t                failed;
+} __rte_cache_aligned;
+
+bool dp_vs_sync_send_enable = false;
+
+static int sync_mode = DP_VS_SYNC_MODE_OFF;
+static uint8_t sync_syncid = 0;
+static struct in_addr sync_laddr;
+static struct in_addr sync_peer;
+static uint16_t sync_port = DP_VS_SYNC_PORT_DEF;
+static uint32_t sync_flush_us = DP_VS_SYNC_FLUSH_US_DEF;
+static uint32_t sync_buff_num = DP_VS_SYNC_BUFF_NUM_DEF;
+
+static uint64_t sync_flush_cycles;
+static struct rte_mempool *sync_buff_pool;
+static struct rte_ring *sync_tx_ring;
+static int sync_fd = -1;
+static struct sockaddr_in sync_dst;
+static bool sync_jobs_registered = false;
+
+static struct dp_vs_sync_lcore sync_lcores[DPVS_MAX_LCORE];
+
+/* owned by the master lcore */
+static struct dp_vs_sync_buff *sync_rx_stash[DP_VS_SYNC_BURST];
+static uint64_t sync_tx_mesgs, sync_tx_drops, sync_rx_mesgs, sync_rx_drops;
+
+#define this_sync                   (&sync_lcores[rte_lcore_id()])
+
+static inline bool sync_has_fnat_seq(uint8_t proto, uint8_t fwdmode)
+{
+    return proto == IPPROTO_TCP && fwdmode == DPVS_FWD_MODE_FNAT;
+}
+
+static inline bool sync_has_synproxy_seq(uint8_t proto, uint16_t flags)
+{
+    return proto == IPPROTO_TCP && (flags & DPVS_CONN_F_SYNPROXY);
+}
+
+static inline uint32_t sync_addr_len(int af)
+{
+    return af == AF_INET6 ? sizeof(struct in6_addr) : sizeof(struct in_addr);
+}
+
+static uint32_t sync_conn_size(int af, int daf, uint8_t proto,
+                               uint8_t fwdmode, uint16_t flags)
+{
+    uint32_t size = sizeof(struct dp_vs_sync_conn);
+
+    size += 2 * sync_addr_len(af) + 2 * sync_addr_len(daf);
+    if (sync_has_fnat_seq(proto, fwdmode))
+        size += sizeof(struct dp_vs_seq);
+    if (sync_has_synproxy_seq(proto, flags))
+        size += sizeof(struct dp_vs_seq);
+
+    return size;
+}
+
+static inline uint8_t *sync_put_addr(uint8_t *p, int af,
+                                     const union inet_addr *addr)
+{
+    memcpy(p, addr, sync_addr_len(af));
+    return p + sync_addr_len(af);
+}
+
+static inline const uint8_t *sync_get_addr(const uint8_t *p, int af,
+                                           union inet_addr *addr)
+{
+    memcpy(addr, p, sync_addr_len(af));
+    return p + sync_addr_len(af);
+}
+
+static inline uint8_t *sync_put_seq(uint8_t *p, const struct dp_vs_seq *seq)
+{
+    uint32_t *w = (uint32_t *)p;
+
+    w[0] = htonl(seq->isn);
+    w[1] = htonl(seq->delta);
+    w[2] = htonl(seq->fdata_seq);
+    w[3] = htonl(seq->prev_delta);
+    return p + sizeof(*seq);
+}
+
+static inline const uint8_t *sync_get_seq(const uint8_t *p, struct dp_vs_seq *seq)
+{
+    const uint32_t *w = (const uint32_t *)p;
+
+    seq->isn        = ntohl(w[0]);
+    seq->delta      = ntohl(w[1]);
+    seq->fdata_seq  = ntohl(w[2]);
+    seq->prev_delta = ntohl(w[3]);
+    return p + sizeof(*seq);
+}
+
+/* hand the buffer of a worker over to the master lcore */
+static void sync_buff_flush(struct dp_vs_sync_lcore *sl)
+{
+    struct dp_vs_sync_buff *sb = sl->buff;
+    struct dp_vs_sync_mesg *m = (struct dp_vs_sync_mesg *)sb->data;
+
+    sl->buff = NULL;
+    m->size = htons(sb->len);
+    if (unlikely(rte_ring_mp_enqueue(sync_tx_ring, sb) != 0)) {
+        sl->nobuff++;
+        rte_mempool_put(sync_buff_pool, sb);
+    }
+}
+
+static struct dp_vs_sync_buff *sync_buff_new(void)
+{
+    struct dp_vs_sync_buff *sb;
+    struct dp_vs_sync_mesg *m;
+
+    if (unlikely(rte_mempool_get(sync_buff_pool, (void **)&sb) != 0))
+        return NULL;
+
+    m = (struct dp_vs_sync_mesg *)sb->data;
+    m->version  = DP_VS_SYNC_VERSION;
+    m->syncid   = sync_syncid;
+    m->lcore    = rte_lcore_id();
+    m->nconns   = 0;
+    m->pad      = 0;
+    sb->len     = sizeof(*m);
+    sb->stamp   = rte_get_timer_cycles();
+
+    return sb;
+}
+
+void dp_vs_sync_conn(struct dp_vs_conn *conn, int type)
+{
+    struct dp_vs_sync_lcore *sl = this_sync;
+    struct dp_vs_sync_buff *sb;
+    struct dp_vs_sync_mesg *m;
+    struct dp_vs_sync_conn *sc;
+    int daf = tuplehash_out(conn).af;
+    uint8_t fwdmode;
+    uint32_t size;
+    uint8_t *p;
+
+    /* conns of the peer are synced by the peer */
+    if ((conn->flags & DPVS_CONN_F_SYNCED) || !dp_vs_conn_persistable(conn))
+        return;
+
+    fwdmode = conn->dest->fwdmode;
+    size = sync_conn_size(conn->af, daf, conn->proto, fwdmode, conn->flags);
+
+    sb = sl->buff;
+    if (sb && (sb->len + size > DP_VS_SYNC_MESG_MAX ||
+               ((struct dp_vs_sync_mesg *)sb->data)->nconns == UINT8_MAX)) {
+        sync_buff_flush(sl);
+        sb = NULL;
+    }
+    if (!sb) {
+        sb = sync_buff_new();
+        if (unlikely(!sb)) {
+            sl->nobuff++;
+            return;
+        }
+        sl->buff = sb;
+    }
+
+    sc = (struct dp_vs_sync_conn *)(sb->data + sb->len);
+    sc->type    = type;
+    sc->af      = conn->af;
+    sc->daf     = daf;
+    sc->proto   = conn->proto;
+    sc->fwdmode = fwdmode;
+    sc->size    = size;
+    sc->flags   = htons(conn->flags);
+    sc->state   = htons(conn->state);
+    sc->cport   = conn->cport;
+    sc->vport   = conn->vport;
+    sc->lport   = conn->lport;
+    sc->dport   = conn->dport;
+    sc->outwall = conn->outwall;
+    sc->pad     = 0;
+    sc->timeout = htonl(conn->timeout.tv_sec);
+
+    p = (uint8_t *)(sc + 1);
+    p = sync_put_addr(p, conn->af, &conn->caddr);
+    p = sync_put_addr(p, conn->af, &conn->vaddr);
+    p = sync_put_addr(p, daf, &conn->daddr);
+    p = sync_put_addr(p, daf, &conn->laddr);
+    if (sync_has_fnat_seq(conn->proto, fwdmode))
+        p = sync_put_seq(p, &conn->fnat_seq);
+    if (sync_has_synproxy_seq(conn->proto, conn->flags))
+        p = sync_put_seq(p, &conn->synproxy->syn_proxy_seq);
+
+    m = (struct dp_vs_sync_mesg *)sb->data;
+    m->nconns++;
+    sb->len += size;
+    sl->conns++;
+}
+
+static int sync_conn_decode(const struct dp_vs_sync_conn *sc,
+                            struct conn_persist_rec *rec)
+{
+    const uint8_t *p = (const uint8_t *)(sc + 1);
+
+    if ((sc->af != AF_INET && sc->af != AF_INET6) ||
+            (sc->daf != AF_INET && sc->daf != AF_INET6) ||
+            (sc->proto != IPPROTO_TCP && sc->proto != IPPROTO_UDP) ||
+            (sc->type != DP_VS_SYNC_CONN_SET && sc->type != DP_VS_SYNC_CONN_DEL) ||
+            sc->fwdmode == DPVS_FWD_MODE_SNAT)
+        return EDPVS_INVAL;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->af         = sc->af;
+    rec->daf        = sc->daf;
+    rec->proto      = sc->proto;
+    rec->fwdmode    = sc->fwdmode;
+    rec->outwall    = sc->outwall;
+    rec->flags      = ntohs(sc->flags);
+    rec->state      = ntohs(sc->state);
+    rec->cport      = sc->cport;
+    rec->vport      = sc->vport;
+    rec->lport      = sc->lport;
+    rec->dport      = sc->dport;
+
+    if (sc->size != sync_conn_size(rec->af, rec->daf, rec->proto,
+                                   rec->fwdmode, rec->flags))
+        return EDPVS_INVAL;
+
+    /* outlive the refresh of the master by half a timeout */
+    rec->timeout    = ntohl(sc->timeout);
+    rec->timeout   += rec->timeout / 2;
+
+    p = sync_get_addr(p, rec->af, &rec->caddr);
+    p = sync_get_addr(p, rec->af, &rec->vaddr);
+    p = sync_get_addr(p, rec->daf, &rec->daddr);
+    p = sync_get_addr(p, rec->daf, &rec->laddr);
+    if (sync_has_fnat_seq(rec->proto, rec->fwdmode))
+        p = sync_get_seq(p, &rec->fnat_seq);
+    if (sync_has_synproxy_seq(rec->proto, rec->flags))
+        p = sync_get_seq(p, &rec->syn_proxy_seq);
+
+    return EDPVS_OK;
+}
+
+/* datagrams are checked by the master, records by the worker */
+static void sync_mesg_recv(struct dp_vs_sync_lcore *sl,
+                           const struct dp_vs_sync_buff *sb)
+{
+    const struct dp_vs_sync_mesg *m = (const struct dp_vs_sync_mesg *)sb->data;
+    const struct dp_vs_sync_conn *sc;
+    struct conn_persist_rec rec;
+    uint32_t off = sizeof(*m);
+    int i;
+
+    for (i = 0; i < m->nconns; i++) {
+        if (off + sizeof(*sc) > sb->len)
+            break;
+        sc = (const struct dp_vs_sync_conn *)(sb->data + off);
+        if (sc->size < sizeof(*sc) || off + sc->size > sb->len
+                || (sc->size & 0x3))
+            break;
+        off += sc->size;
+
+        if (sync_conn_decode(sc, &rec) != EDPVS_OK ||
+                dp_vs_conn_sync_recv(&rec, sc->type == DP_VS_SYNC_CONN_DEL)
+                != EDPVS_OK) {
+            sl->failed++;
+            continue;
+        }
+        sl->installed++;
+    }
+
+    if (i < m->nconns)
+        sl->failed += m->nconns - i;
+}
+
+static void sync_lcore_job(void *arg)
+{
+    int i, n;
+    struct dp_vs_sync_lcore *sl = this_sync;
+    struct dp_vs_sync_buff *sbs[DP_VS_SYNC_BURST];
+
+    if (sl->buff && rte_get_timer_cycles() - sl->buff->stamp >= sync_flush_cycles)
+        sync_buff_flush(sl);
+
+    if (!sl->rx_ring)
+        return;
+
+    n = rte_ring_sc_dequeue_burst(sl->rx_ring, (void **)sbs, DP_VS_SYNC_BURST, NULL);
+    for (i = 0; i < n; i++)
+        sync_mesg_recv(sl, sbs[i]);
+    if (n > 0)
+        rte_mempool_put_bulk(sync_buff_pool, (void **)sbs, n);
+}
+
+static void sync_master_send(void)
+{
+    int i, n, sent;
+    struct dp_vs_sync_buff *sbs[DP_VS_SYNC_BURST];
+    struct mmsghdr msgs[DP_VS_SYNC_BURST];
+    struct iovec iovs[DP_VS_SYNC_BURST];
+
+    n = rte_ring_sc_dequeue_burst(sync_tx_ring, (void **)sbs, DP_VS_SYNC_BURST, NULL);
+    if (!n)
+        return;
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * n);
+    for (i = 0; i < n; i++) {
+        iovs[i].iov_base = sbs[i]->data;
+        iovs[i].iov_len = sbs[i]->len;
+        msgs[i].msg_hdr.msg_name = &sync_dst;
+        msgs[i].msg_hdr.msg_namelen = sizeof(sync_dst);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* best effort, the next refresh of a lost conn makes up for it */
+    sent = sendmmsg(sync_fd, msgs, n, MSG_DONTWAIT);
+    if (sent < 0)
+        sent = 0;
+    sync_tx_mesgs += sent;
+    sync_tx_drops += n - sent;
+
+    rte_mempool_put_bulk(sync_buff_pool, (void **)sbs, n);
+}
+
+static bool sync_mesg_valid(const struct dp_vs_sync_buff *sb)
+{
+    const struct dp_vs_sync_mesg *m = (const struct dp_vs_sync_mesg *)sb->data;
+
+    return sb->len >= sizeof(*m)
+        && m->version == DP_VS_SYNC_VERSION
+        && m->syncid == sync_syncid
+        && ntohs(m->size) == sb->len
+        && m->lcore < DPVS_MAX_LCORE
+        && sync_lcores[m->lcore].rx_ring;
+}
+
+static void sync_master_recv(void)
+{
+    int i, n;
+    struct dp_vs_sync_buff *sb;
+    const struct dp_vs_sync_mesg *m;
+    struct mmsghdr msgs[DP_VS_SYNC_BURST];
+    struct iovec iovs[DP_VS_SYNC_BURST];
+
+    /* buffers not used by the last burst are kept */
+    for (i = 0; i < DP_VS_SYNC_BURST; i++) {
+        if (!sync_rx_stash[i] &&
+                rte_mempool_get(sync_buff_pool, (void **)&sync_rx_stash[i]) != 0)
+            return;
+    }
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < DP_VS_SYNC_BURST; i++) {
+        iovs[i].iov_base = sync_rx_stash[i]->data;
+        iovs[i].iov_len = DP_VS_SYNC_MESG_MAX;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    n = recvmmsg(sync_fd, msgs, DP_VS_SYNC_BURST, MSG_DONTWAIT, NULL);
+    for (i = 0; i < n; i++) {
+        sb = sync_rx_stash[i];
+        sb->len = msgs[i].msg_len;
+        if (!sync_mesg_valid(sb) || (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+            sync_rx_drops++;
+            continue;
+        }
+
+        m = (const struct dp_vs_sync_mesg *)sb->data;
+        if (rte_ring_sp_enqueue(sync_lcores[m->lcore].rx_ring, sb) != 0) {
+            sync_rx_drops++;
+            continue;
+        }
+        sync_rx_stash[i] = NULL;
+        sync_rx_mesgs++;
+    }
+}
+
+static void sync_master_job(void *arg)
+{
+    if (sync_mode & DP_VS_SYNC_MODE_MASTER)
+        sync_master_send();
+    if (sync_mode & DP_VS_SYNC_MODE_BACKUP)
+        sync_master_recv();
+}
+
+static struct dpvs_lcore_job sync_lcore_job_worker = {
+    .name       = "ipvs_sync",
+    .type       = LCORE_JOB_LOOP,
+    .func       = sync_lcore_job,
+};
+
+static struct dpvs_lcore_job sync_lcore_job_master = {
+    .name       = "ipvs_sync",
+    .type       = LCORE_JOB_LOOP,
+    .func       = sync_master_job,
+};
+
+static int sync_socket_open(void)
+{
+    int on = 1, off = 0, ttl = 1, size = DP_VS_SYNC_SOCKBUF_SIZE;
+    bool mcast = IN_MULTICAST(ntohl(sync_peer.s_addr));
+    struct sockaddr_in sin;
+    struct ip_mreq mreq;
+
+    sync_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sync_fd < 0)
+        return EDPVS_SYSCALL;
+
+    /* several dpvs on one host may join the group */
+    setsockopt(sync_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(sync_fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(sync_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr = sync_laddr;
+    if (sync_mode & DP_VS_SYNC_MODE_BACKUP) {
+        sin.sin_port = htons(sync_port);
+        if (mcast)
+            sin.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+    if (bind(sync_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+        return EDPVS_SYSCALL;
+
+    if (mcast) {
+        if (setsockopt(sync_fd, IPPROTO_IP, IP_MULTICAST_IF,
+                       &sync_laddr, sizeof(sync_laddr)) < 0 ||
+            setsockopt(sync_fd, IPPROTO_IP, IP_MULTICAST_LOOP,
+                       &off, sizeof(off)) < 0 ||
+            setsockopt(sync_fd, IPPROTO_IP, IP_MULTICAST_TTL,
+                       &ttl, sizeof(ttl)) < 0)
+            return EDPVS_SYSCALL;
+
+        if (sync_mode & DP_VS_SYNC_MODE_BACKUP) {
+            mreq.imr_multiaddr = sync_peer;
+            mreq.imr_interface = sync_laddr;
+            if (setsockopt(sync_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                           &mreq, sizeof(mreq)) < 0)
+                return EDPVS_SYSCALL;
+        }
+    }
+
+    memset(&sync_dst, 0, sizeof(sync_dst));
+    sync_dst.sin_family = AF_INET;
+    sync_dst.sin_addr = sync_peer;
+    sync_dst.sin_port = htons(sync_port);
+
+    return EDPVS_OK;
+}
+
+int dp_vs_sync_init(void)
+{
+    int err;
+    uint8_t nworks;
+    uint64_t lcore_mask;
+    lcoreid_t cid;
+    char name[32];
+
+    if (sync_mode == DP_VS_SYNC_MODE_OFF)
+        return EDPVS_OK;
+
+    if (!sync_laddr.s_addr || !sync_peer.s_addr) {
+        RTE_LOG(ERR, IPVS, "%s: sync:local_address and sync:peer_address "
+                "are required\n", __func__);
+        return EDPVS_INVAL;
+    }
+
+    netif_get_slave_lcores(&nworks, &lcore_mask);
+    sync_flush_cycles = rte_get_timer_hz() * sync_flush_us / 1000000;
+
+    sync_buff_pool = rte_mempool_create("dp_vs_sync_buff", sync_buff_num,
+                                        sizeof(struct dp_vs_sync_buff),
+                                        DP_VS_SYNC_BUFF_CACHE, 0, NULL, NULL,
+                                        NULL, NULL, SOCKET_ID_ANY, 0);
+    if (!sync_buff_pool) {
+        err = EDPVS_NOMEM;
+        goto errout;
+    }
+
+    if (sync_mode & DP_VS_SYNC_MODE_MASTER) {
+        sync_tx_ring = rte_ring_create("dp_vs_sync_tx", DP_VS_SYNC_TX_RING_SIZE,
+                                       SOCKET_ID_ANY, RING_F_SC_DEQ);
+        if (!sync_tx_ring) {
+            err = EDPVS_NOMEM;
+            goto errout;
+        }
+    }
+
+    if (sync_mode & DP_VS_SYNC_MODE_BACKUP) {
+        for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+            if (cid >= 64 || !(lcore_mask & (1ULL << cid)))
+                continue;
+            snprintf(name, sizeof(name), "dp_vs_sync_rx_%d", cid);
+            sync_lcores[cid].rx_ring = rte_ring_create(name,
+                    DP_VS_SYNC_RX_RING_SIZE, rte_lcore_to_socket_id(cid),
+                    RING_F_SP_ENQ | RING_F_SC_DEQ);
+            if (!sync_lcores[cid].rx_ring) {
+                err = EDPVS_NOMEM;
+                goto errout;
+            }
+        }
+    }
+
+    err = sync_socket_open();
+    if (err != EDPVS_OK) {
+        RTE_LOG(ERR, IPVS, "%s: fail to set up sync socket: %s\n",
+                __func__, strerror(errno));
+        goto errout;
+    }
+
+    err = dpvs_lcore_job_register(&sync_lcore_job_worker, LCORE_ROLE_FWD_WORKER);
+    if (err != EDPVS_OK)
+        goto errout;
+    err = dpvs_lcore_job_register(&sync_lcore_job_master, LCORE_ROLE_MASTER);
+    if (err != EDPVS_OK) {
+        dpvs_lcore_job_unregister(&sync_lcore_job_worker, LCORE_ROLE_FWD_WORKER);
+        goto errout;
+    }
+    sync_jobs_registered = true;
+
+    dp_vs_sync_send_enable = !!(sync_mode & DP_VS_SYNC_MODE_MASTER);
+
+    RTE_LOG(INFO, IPVS, "%s: syncid %u, %s%s %s:%u, %u workers\n", __func__,
+            sync_syncid, (sync_mode & DP_VS_SYNC_MODE_MASTER) ? "send" : "",
+            sync_mode == DP_VS_SYNC_MODE_BOTH ? "/recv" :
+            (sync_mode & DP_VS_SYNC_MODE_BACKUP) ? "recv" : "",
+            inet_ntoa(sync_peer), sync_port, nworks);
+
+    return EDPVS_OK;
+
+errout:
+    dp_vs_sync_term();
+    return err;
+}
+
+int dp_vs_sync_term(void)
+{
+    int i;
+    lcoreid_t cid;
+    uint64_t conns = 0, nobuff = 0, installed = 0, failed = 0;
+
+    dp_vs_sync_send_enable = false;
+
+    if (sync_jobs_registered) {
+        dpvs_lcore_job_unregister(&sync_lcore_job_master, LCORE_ROLE_MASTER);
+        dpvs_lcore_job_unregister(&sync_lcore_job_worker, LCORE_ROLE_FWD_WORKER);
+        sync_jobs_registered = false;
+
+        for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+            conns += sync_lcores[cid].conns;
+            nobuff += sync_lcores[cid].nobuff;
+            installed += sync_lcores[cid].installed;
+            failed += sync_lcores[cid].failed;
+        }
+        RTE_LOG(INFO, IPVS, "%s: sent %lu conns in %lu mesgs (%lu conns, %lu mesgs "
+                "dropped), received %lu mesgs (%lu dropped), %lu conns installed, "
+                "%lu failed\n", __func__, conns, sync_tx_mesgs, nobuff,
+                sync_tx_drops, sync_rx_mesgs, sync_rx_drops, installed, failed);
+    }
+
+    if (sync_fd >= 0) {
+        close(sync_fd);
+        sync_fd = -1;
+    }
+
+    /* the pool goes with the buffers still held */
+    for (cid = 0; cid < DPVS_MAX_LCORE; cid++) {
+        if (sync_lcores[cid].rx_ring)
+            rte_ring_free(sync_lcores[cid].rx_ring);
+    }
+    memset(sync_lcores, 0, sizeof(sync_lcores));
+    for (i = 0; i < DP_VS_SYNC_BURST; i++)
+        sync_rx_stash[i] = NULL;
+
+    if (sync_tx_ring) {
+        rte_ring_free(sync_tx_ring);
+        sync_tx_ring = NULL;
+    }
+
+    if (sync_buff_pool) {
+        rte_mempool_free(sync_buff_pool);
+        sync_buff_pool = NULL;
+    }
+
+    return EDPVS_OK;
+}
+
+static void sync_mode_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (!strcmp(str, "off"))
+        sync_mode = DP_VS_SYNC_MODE_OFF;
+    else if (!strcmp(str, "master"))
+        sync_mode = DP_VS_SYNC_MODE_MASTER;
+    else if (!strcmp(str, "backup"))
+        sync_mode = DP_VS_SYNC_MODE_BACKUP;
+    else if (!strcmp(str, "both"))
+        sync_mode = DP_VS_SYNC_MODE_BOTH;
+    else
+        RTE_LOG(WARNING, IPVS, "invalid sync:mode %s\n", str);
+
+    RTE_LOG(INFO, IPVS, "sync:mode = %d\n", sync_mode);
+
+    FREE_PTR(str);
+}
+
+static void sync_syncid_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int syncid;
+
+    assert(str);
+
+    syncid = atoi(str);
+    if (syncid < 0 || syncid > UINT8_MAX) {
+        RTE_LOG(WARNING, IPVS, "invalid sync:syncid %s, using default 0\n", str);
+        sync_syncid = 0;
+    } else {
+        RTE_LOG(INFO, IPVS, "sync:syncid = %d\n", syncid);
+        sync_syncid = syncid;
+    }
+
+    FREE_PTR(str);
+}
+
+static void sync_addr_handler(vector_t tokens, const char *name,
+                              struct in_addr *addr)
+{
+    char *str = set_value(tokens);
+
+    assert(str);
+
+    if (inet_pton(AF_INET, str, addr) != 1) {
+        RTE_LOG(WARNING, IPVS, "invalid sync:%s %s\n", name, str);
+        addr->s_addr = 0;
+    } else {
+        RTE_LOG(INFO, IPVS, "sync:%s = %s\n", name, str);
+    }
+
+    FREE_PTR(str);
+}
+
+static void sync_local_address_handler(vector_t tokens)
+{
+    sync_addr_handler(tokens, "local_address", &sync_laddr);
+}
+
+static void sync_peer_address_handler(vector_t tokens)
+{
+    sync_addr_handler(tokens, "peer_address", &sync_peer);
+}
+
+static void sync_port_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int port;
+
+    assert(str);
+
+    port = atoi(str);
+    if (port <= 0 || port > UINT16_MAX) {
+        RTE_LOG(WARNING, IPVS, "invalid sync:port %s, using default %d\n",
+                str, DP_VS_SYNC_PORT_DEF);
+        sync_port = DP_VS_SYNC_PORT_DEF;
+    } else {
+        RTE_LOG(INFO, IPVS, "sync:port = %d\n", port);
+        sync_port = port;
+    }
+
+    FREE_PTR(str);
+}
+
+static void sync_flush_interval_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int us;
+
+    assert(str);
+
+    us = atoi(str);
+    if (us <= 0 || us > DP_VS_SYNC_FLUSH_US_MAX) {
+        RTE_LOG(WARNING, IPVS, "invalid sync:flush_interval %s, using default %d\n",
+                str, DP_VS_SYNC_FLUSH_US_DEF);
+        sync_flush_us = DP_VS_SYNC_FLUSH_US_DEF;
+    } else {
+        RTE_LOG(INFO, IPVS, "sync:flush_interval = %dus\n", us);
+        sync_flush_us = us;
+    }
+
+    FREE_PTR(str);
+}
+
+static void sync_buff_num_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int num;
+
+    assert(str);
+
+    num = atoi(str);
+    if (num < DP_VS_SYNC_BUFF_NUM_MIN || num > DP_VS_SYNC_BUFF_NUM_MAX) {
+        RTE_LOG(WARNING, IPVS, "invalid sync:buff_num %s, using default %d\n",
+                str, DP_VS_SYNC_BUFF_NUM_DEF);
+        sync_buff_num = DP_VS_SYNC_BUFF_NUM_DEF;
+    } else {
+        RTE_LOG(INFO, IPVS, "sync:buff_num = %d\n", num);
+        sync_buff_num = num;
+    }
+
+    FREE_PTR(str);
+}
+
+void ipvs_sync_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        sync_mode = DP_VS_SYNC_MODE_OFF;
+        sync_syncid = 0;
+        sync_laddr.s_addr = 0;
+        inet_pton(AF_INET, DP_VS_SYNC_MCAST_DEF, &sync_peer);
+        sync_port = DP_VS_SYNC_PORT_DEF;
+        sync_flush_us = DP_VS_SYNC_FLUSH_US_DEF;
+        sync_buff_num = DP_VS_SYNC_BUFF_NUM_DEF;
+    }
+    /* KW_TYPE_NORMAL keyword */
+}
+
+void install_ipvs_sync_keywords(void)
+{
+    install_sublevel();
+    install_keyword("mode", sync_mode_handler, KW_TYPE_INIT);
+    install_keyword("syncid", sync_syncid_handler, KW_TYPE_INIT);
+    install_keyword("local_address", sync_local_address_handler, KW_TYPE_INIT);
+    install_keyword("peer_address", sync_peer_address_handler, KW_TYPE_INIT);
+    install_keyword("port", sync_port_handler, KW_TYPE_INIT);
+    install_keyword("flush_interval", sync_flush_interval_handler, KW_TYPE_INIT);
+    install_keyword("buff_num", sync_buff_num_handler, KW_TYPE_INIT);
+    install_sublevel_end();
+}
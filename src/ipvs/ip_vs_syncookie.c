@@ -0,0 +1,135 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <assert.h>
+#include <rte_random.h>
+#include "ipvs/siphash.h"
+#include "ipvs/syncookie.h"
+
+#define COOKIEBITS 24 /* Upper bits store count */
+#define COOKIEMASK (((uint32_t)1 << COOKIEBITS) - 1)
+
+/* hash input: saddr, daddr, (sport << 16 | dport) + (count << 32) */
+#define COOKIE_WORDS_MAX    5
+#define COOKIE_WORDS(af)    ((af) == AF_INET ? 2 : 5)
+
+static siphash_key_t syncookie_key[2];
+
+static inline void cookie_msg(int af, const struct dp_vs_syncookie_tuple *t,
+                              uint32_t count, uint64_t *w)
+{
+    uint64_t ports = ((uint32_t)t->sport << 16) + t->dport;
+
+    if (af == AF_INET) {
+        w[0] = ((uint64_t)t->daddr.in.s_addr << 32) | t->saddr.in.s_addr;
+        w[1] = ((uint64_t)count << 32) | ports;
+    } else {
+        memcpy(&w[0], &t->saddr.in6, sizeof(struct in6_addr));
+        memcpy(&w[2], &t->daddr.in6, sizeof(struct in6_addr));
+        w[4] = ((uint64_t)count << 32) | ports;
+    }
+}
+
+static inline uint32_t cookie_hash(int af, const struct dp_vs_syncookie_tuple *t,
+                                   uint32_t count, int c)
+{
+    uint64_t w[COOKIE_WORDS_MAX];
+
+    cookie_msg(af, t, count, w);
+    return (uint32_t)__siphash_aligned(w, COOKIE_WORDS(af) * sizeof(uint64_t),
+                                       &syncookie_key[c]);
+}
+
+static inline uint32_t cookie_make(uint32_t h0, uint32_t h1, uint32_t sseq,
+                                   uint32_t count, uint32_t data)
+{
+    return h0 + sseq + (count << COOKIEBITS) + ((h1 + data) & COOKIEMASK);
+}
+
+void dp_vs_syncookie_gen_burst(int af, const struct dp_vs_syncookie_tuple *tuples,
+                               unsigned int n, uint32_t count, uint32_t *cookies)
+{
+    const struct dp_vs_syncookie_tuple *t;
+    uint64_t msg0[COOKIE_WORDS_MAX * SIPHASH_LANES];
+    uint64_t msg1[COOKIE_WORDS_MAX * SIPHASH_LANES];
+    uint64_t h0[SIPHASH_LANES], h1[SIPHASH_LANES];
+    uint64_t w0[COOKIE_WORDS_MAX], w1[COOKIE_WORDS_MAX];
+    unsigned int i, l, j, nw = COOKIE_WORDS(af);
+
+    assert(n <= DP_VS_SYNCOOKIE_BURST);
+
+    /* a lonely SYN isn't worth a full set of lanes */
+    if (n == 1) {
+        t = &tuples[0];
+        cookies[0] = cookie_make(cookie_hash(af, t, 0, 0),
+                                 cookie_hash(af, t, count, 1),
+                                 t->sseq, count, t->data);
+        return;
+    }
+
+    for (i = 0; i < n; i += SIPHASH_LANES) {
+        for (l = 0; l < SIPHASH_LANES; l++) {
+            if (i + l < n) {
+                cookie_msg(af, &tuples[i + l], 0, w0);
+                cookie_msg(af, &tuples[i + l], count, w1);
+            } else {
+                memset(w0, 0, sizeof(w0));
+                memset(w1, 0, sizeof(w1));
+            }
+            for (j = 0; j < nw; j++) {
+                msg0[j * SIPHASH_LANES + l] = w0[j];
+                msg1[j * SIPHASH_LANES + l] = w1[j];
+            }
+        }
+
+        siphash_lanes(msg0, nw, &syncookie_key[0], h0);
+        siphash_lanes(msg1, nw, &syncookie_key[1], h1);
+
+        for (l = 0; l < SIPHASH_LANES && i + l < n; l++) {
+            t = &tuples[i + l];
+            cookies[i + l] = cookie_make((uint32_t)h0[l], (uint32_t)h1[l],
+                                         t->sseq, count, t->data);
+        }
+    }
+}
+
+uint32_t dp_vs_syncookie_check(int af, const struct dp_vs_syncookie_tuple *tuple,
+                               uint32_t cookie, uint32_t count, uint32_t maxdiff)
+{
+    uint32_t diff;
+
+    /* Strip away the layers from the cookie */
+    cookie -= cookie_hash(af, tuple, 0, 0) + tuple->sseq;
+
+    /* Cookie is now reduced to (count * 2^24) ^ (hash % 2^24) */
+    diff = (count - (cookie >> COOKIEBITS)) & ((uint32_t) -1 >> COOKIEBITS);
+    if (diff >= maxdiff)
+        return (uint32_t) -1;
+
+    return (cookie - cookie_hash(af, tuple, count - diff, 1))
+        & COOKIEMASK; /* Leaving the data behind */
+}
+
+void dp_vs_syncookie_init(void)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        syncookie_key[i].key[0] = rte_rand();
+        syncookie_key[i].key[1] = rte_rand();
+    }
+}
@@ -18,12 +18,13 @@
 #include <assert.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
-#include <openssl/md5.h>
 #include "conf/common.h"
 #include "dpdk.h"
 #include "ipvs/ipvs.h"
 #include "ipvs/synproxy.h"
+#include "ipvs/syncookie.h"
 #include "timer.h"
+#include "scheduler.h"
 #include "ipv4.h"
 #include "ipv6.h"
 #include "ipvs/proto.h"
@@ -76,14 +77,13 @@ rte_atomic64_t sp_ack_refused;
 static struct dpvs_timer g_second_timer;
 #endif
 
-/*
- * syncookies using digest function from openssl libray,
- * a little difference from kernel, which uses md5_transform
- * */
-static uint32_t g_net_secret[2][MD5_LBLOCK];
+/* syncookies are generated and checked by ip_vs_syncookie.c */
 static struct dpvs_timer g_minute_timer;
 static rte_atomic32_t g_minute_count;
 
+/* flushes the per-lcore SYN-ACK batch */
+static struct dpvs_lcore_job syn_proxy_synack_lcore_job;
+
 static int minute_timer_expire( void *priv)
 {
     struct timeval tv;
@@ -117,14 +117,11 @@ static int second_timer_expire(void *priv)
 
 int dp_vs_synproxy_init(void)
 {
-    int i;
+    int i, err;
     char ack_mbufpool_name[32];
     struct timeval tv;
 
-    for (i = 0; i < MD5_LBLOCK; i++) {
-        g_net_secret[0][i] = (uint32_t)random();
-        g_net_secret[1][i] = (uint32_t)random();
-    }
+    dp_vs_syncookie_init();
 
     rte_atomic32_set(&g_minute_count, (uint32_t)random());
     tv.tv_sec = 60; /* one minute timer */
@@ -147,6 +144,13 @@ int dp_vs_synproxy_init(void)
         }
     }
 
+    err = dpvs_lcore_job_register(&syn_proxy_synack_lcore_job, LCORE_ROLE_FWD_WORKER);
+    if (err != EDPVS_OK) {
+        for (i = 0; i < get_numa_nodes(); i++)
+            rte_mempool_free(dp_vs_synproxy_ack_mbufpool[i]);
+        return err;
+    }
+
 #ifdef CONFIG_SYNPROXY_DEBUG
     rte_atomic32_init(&sp_syn_saved);
     rte_atomic32_init(&sp_ack_saved);
@@ -163,6 +167,7 @@ int dp_vs_synproxy_term(void)
 {
     int i;
     dpvs_timer_cancel(&g_minute_timer, true);
+    dpvs_lcore_job_unregister(&syn_proxy_synack_lcore_job, LCORE_ROLE_FWD_WORKER);
 
     for (i = 0; i < get_numa_nodes(); i++)
         rte_mempool_free(dp_vs_synproxy_ack_mbufpool[i]);
@@ -170,140 +175,6 @@ int dp_vs_synproxy_term(void)
     return EDPVS_OK;
 }
 
-#define COOKIEBITS 24 /* Upper bits store count */
-#define COOKIEMASK (((uint32_t)1 << COOKIEBITS) - 1)
-
-static uint32_t
-cookie_hash(uint32_t saddr, uint32_t daddr,
-            uint16_t sport, uint16_t dport,
-            uint32_t count, int c)
-{
-    unsigned char hash[MD5_DIGEST_LENGTH];
-    uint32_t data[5];
-    uint32_t hvalue;
-
-    data[0] = saddr;
-    data[1] = daddr;
-    data[2] = (sport << 16) + dport;
-    data[3] = count;
-    data[4] = g_net_secret[c][0];
-
-    MD5((unsigned char *)data, sizeof(data), hash);
-    memcpy(&hvalue, hash, sizeof(hvalue));
-
-    return hvalue;
-}
-
-static uint32_t
-secure_tcp_syn_cookie(uint32_t saddr, uint32_t daddr,
-                      uint16_t sport, uint16_t dport,
-                      uint32_t sseq, uint32_t count,
-                      uint32_t data)
-{
-    /*
-     * Compute the secure sequence number.
-     * The output should be:
-     * HASH(sec1, saddr, sport, daddr, dport, sec1) + sseq + (count * 2^24)
-     *      + (HASH(sec2, saddr, sport, daddr, dport, count, sec2) % 2^24).
-     * Where sseq is their sequence number and count increases every minute by 1.
-     * As an extra hack, we add a small "data" value that encodes the MSS into
-     * the second hash value.
-     */
-    return (cookie_hash(saddr, daddr, sport, dport, 0, 0) +
-        sseq + (count << COOKIEBITS) +
-        ((cookie_hash(saddr, daddr, sport, dport, count, 1) + data) & COOKIEMASK));
-}
-
-static uint32_t
-check_tcp_syn_cookie(uint32_t cookie,
-                     uint32_t saddr, uint32_t daddr,
-                     uint16_t sport, uint16_t dport,
-                     uint32_t sseq, uint32_t count,
-                     uint32_t maxdiff)
-{
-    /*
-     * This retrieves the small "data" value from the syncookie.
-     * If the syncookie is bad, the data returned will be out of range.
-     * This must be checked by the caller.
-     *
-     * The count value used to generate the cookie must be within "maxdiff"
-     * if the current (passed-in) "count". The return value is (uint32_t) -1
-     * if this test fails.
-     */
-    uint32_t diff;
-
-    /* Strip away the layers from the cookie */
-    cookie -= cookie_hash(saddr, daddr, sport, dport, 0, 0) + sseq;
-
-    /* Cookie is now reduced to (count * 2^24) ^ (hash % 2^24) */
-    diff = (count - (cookie >> COOKIEBITS)) & ((uint32_t) -1 >> COOKIEBITS);
-    if (diff >= maxdiff)
-        return (uint32_t) -1;
-
-    return (cookie - cookie_hash(saddr, daddr, sport, dport, count - diff, 1))
-        & COOKIEMASK; /* Leaving the data behind */
-}
-
-static uint32_t
-cookie_hash_v6(const struct in6_addr *saddr,
-               const struct in6_addr *daddr,
-               uint16_t sport, uint16_t dport,
-               uint32_t count, int c)
-{
-    int i;
-    uint32_t hvalue, data[MD5_LBLOCK];
-    unsigned char hash[MD5_DIGEST_LENGTH];
-
-    for (i = 0; i < 4; i++)
-        data[i] = g_net_secret[c][i] + ((uint32_t *)saddr)[i];
-    for (i = 4; i < 8; i++)
-        data[i] = g_net_secret[c][i] + ((uint32_t *)daddr)[i-4];
-
-    data[8] = g_net_secret[c][8] + ((sport << 16) + dport);
-    data[9] = g_net_secret[c][9] + count;
-
-    for (i = 10; i < MD5_LBLOCK; i++)
-        data[i] = g_net_secret[c][i];
-
-    MD5((unsigned char*)data, sizeof(data), hash);
-    memcpy(&hvalue, hash, sizeof(hvalue));
-
-    return hvalue;
-}
-
-static uint32_t
-secure_tcp_syn_cookie_v6(const struct in6_addr *saddr,
-                      const struct in6_addr *daddr,
-                      uint16_t sport, uint16_t dport,
-                      uint32_t sseq, uint32_t count,
-                      uint32_t data)
-{
-    return (cookie_hash_v6(saddr, daddr, sport, dport, 0, 0)
-            + sseq + (count << COOKIEBITS)
-            + ((cookie_hash_v6(saddr, daddr, sport, dport, count, 1)
-                    + data) & COOKIEMASK));
-}
-
-static uint32_t
-check_tcp_syn_cookie_v6(uint32_t cookie,
-                        const struct in6_addr *saddr,
-                        const struct in6_addr *daddr,
-                        uint16_t sport, uint16_t dport,
-                        uint32_t sseq, uint32_t count,
-                        uint32_t maxdiff)
-{
-    uint32_t diff;
-
-    cookie -= cookie_hash_v6(saddr, daddr, sport, dport, 0, 0) + sseq;
-
-    diff = (count - (cookie >> COOKIEBITS)) & ((uint32_t) -1 >> COOKIEBITS);
-    if (diff >= maxdiff)
-        return (uint32_t) -1;
-
-    return (cookie - cookie_hash_v6(saddr, daddr, sport, dport,
-                count - diff, 1)) & COOKIEMASK;
-}
-
 /* This table has to be sorted and terminated with (uint16_t)-1.
  * XXX generate a better table.
  * Unresolved Issues: HIPPI with a 64K MSS is not well supported.
@@ -333,8 +204,27 @@ static uint16_t const msstab[] = {
  */
 #define DP_VS_SYNPROXY_COUNTER_TRIES 4
 
+static void syn_proxy_cookie_tuple(int af, struct rte_mbuf *mbuf,
+                                   const struct tcphdr *th,
+                                   struct dp_vs_syncookie_tuple *t)
+{
+    if (AF_INET6 == af) {
+        const struct ip6_hdr *ip6h = ip6_hdr(mbuf);
+
+        t->saddr.in6 = ip6h->ip6_src;
+        t->daddr.in6 = ip6h->ip6_dst;
+    } else {
+        const struct iphdr *iph = (struct iphdr*)ip4_hdr(mbuf);
+
+        t->saddr.in.s_addr = iph->saddr;
+        t->daddr.in.s_addr = iph->daddr;
+    }
+    t->sport = th->source;
+    t->dport = th->dest;
+}
+
 /*
- * Generate a syncookie for dp_vs module.
+ * Generate the data of a syncookie for dp_vs module.
  * Besides mss, we store additional tcp options in cookie "data".
  *
  * Cookie "data" format:
@@ -344,12 +234,8 @@ static uint16_t const msstab[] = {
  * [19-16] snd_wscale
  * [15-12] MSSIND
  */
-static uint32_t
-syn_proxy_cookie_v4_init_sequence(struct rte_mbuf *mbuf,
-                                  const struct tcphdr *th,
-                                  struct dp_vs_synproxy_opt *opts)
+static uint32_t syn_proxy_cookie_data(struct dp_vs_synproxy_opt *opts)
 {
-    const struct iphdr *iph = (struct iphdr*)ip4_hdr(mbuf);
     int mssind;
     const uint16_t mss = opts->mss_clamp;
     uint32_t data;
@@ -364,91 +250,27 @@ syn_proxy_cookie_v4_init_sequence(struct rte_mbuf *mbuf,
     data |= opts->tstamp_ok << DP_VS_SYNPROXY_TSOK_BIT;
     data |= ((opts->snd_wscale & 0xf) << DP_VS_SYNPROXY_SND_WSCALE_BITS);
 
-    return secure_tcp_syn_cookie(iph->saddr, iph->daddr,
-            th->source, th->dest, ntohl(th->seq),
-            rte_atomic32_read(&g_minute_count), data);
-}
-
-static uint32_t
-syn_proxy_cookie_v6_init_sequence(struct rte_mbuf *mbuf,
-                                  const struct tcphdr *th,
-                                  struct dp_vs_synproxy_opt *opts)
-{
-    const struct ip6_hdr *ip6h = ip6_hdr(mbuf);
-    int mssind;
-    const uint16_t mss = opts->mss_clamp;
-    uint32_t data;
-
-    /* XXX sort msstab[] by probability? Binary serarch? */
-    for (mssind = 0; mss > msstab[mssind + 1]; mssind++)
-        ;
-    opts->mss_clamp = msstab[mssind] + 1;
-
-    data = ((mssind & 0x0f) << DP_VS_SYNPROXY_MSS_BITS);
-    data |= opts->sack_ok << DP_VS_SYNPROXY_SACKOK_BIT;
-    data |= opts->tstamp_ok << DP_VS_SYNPROXY_TSOK_BIT;
-    data |= ((opts->snd_wscale & 0xf) << DP_VS_SYNPROXY_SND_WSCALE_BITS);
-
-    return secure_tcp_syn_cookie_v6(&ip6h->ip6_src, &ip6h->ip6_dst,
-            th->source, th->dest, ntohl(th->seq),
-            rte_atomic32_read(&g_minute_count), data);
+    return data;
 }
 
 /*
- * When syn_proxy_cookie_v4_init_sequence is used, we check cookie as follow:
+ * Check the cookie acked by the client, as follow:
  *  1. mssind check.
  *  2. get sack/timestamp/wscale options
  */
 static int
-syn_proxy_v4_cookie_check(struct rte_mbuf *mbuf, uint32_t cookie,
-                          struct dp_vs_synproxy_opt *opt)
+syn_proxy_cookie_check(int af, struct rte_mbuf *mbuf, uint32_t cookie,
+                       struct dp_vs_synproxy_opt *opt)
 {
-    const struct iphdr *iph = (struct iphdr*)ip4_hdr(mbuf);
     const struct tcphdr *th = tcp_hdr(mbuf);
+    struct dp_vs_syncookie_tuple tuple;
+    uint32_t mssind, res;
 
-    uint32_t seq = ntohl(th->seq) - 1;
-    uint32_t mssind;
-    uint32_t res = check_tcp_syn_cookie(cookie, iph->saddr, iph->daddr,
-            th->source, th->dest, seq, rte_atomic32_read(&g_minute_count),
-            DP_VS_SYNPROXY_COUNTER_TRIES);
-
-    if ((uint32_t) -1 == res) /* count is invalid, g_minute_count' >> g_minute_count */
-        return 0;
-
-    mssind = (res & DP_VS_SYNPROXY_MSS_MASK) >> DP_VS_SYNPROXY_MSS_BITS;
-
-    memset(opt, 0, sizeof(struct dp_vs_synproxy_opt));
-    if ((mssind < NUM_MSS) && ((res & DP_VS_SYNPROXY_OTHER_MASK) == 0)) {
-        opt->mss_clamp = msstab[mssind] + 1;
-        opt->sack_ok = (res & DP_VS_SYNPROXY_SACKOK_MASK) >> DP_VS_SYNPROXY_SACKOK_BIT;
-        opt->tstamp_ok = (res & DP_VS_SYNPROXY_TSOK_MASK) >> DP_VS_SYNPROXY_TSOK_BIT;
-        opt->snd_wscale = (res & DP_VS_SYNPROXY_SND_WSCALE_MASK)
-                            >> DP_VS_SYNPROXY_SND_WSCALE_BITS;
-        if (opt->snd_wscale > 0 && opt->snd_wscale <= DP_VS_SYNPROXY_WSCALE_MAX)
-            opt->wscale_ok = 1;
-        else if (opt->snd_wscale == 0)
-            opt->wscale_ok = 0;
-        else
-            return 0;
-
-        return 1;
-    }
-    return 0;
-}
-
-static int
-syn_proxy_v6_cookie_check(struct rte_mbuf *mbuf, uint32_t cookie,
-                          struct dp_vs_synproxy_opt *opt)
-{
-    const struct ip6_hdr *ip6h = ip6_hdr(mbuf);
-    const struct tcphdr *th = tcp_hdr(mbuf);
-
-    uint32_t seq = ntohl(th->seq) - 1;
-    uint32_t mssind;
-    uint32_t res = check_tcp_syn_cookie_v6(cookie, &ip6h->ip6_src, &ip6h->ip6_dst,
-                   th->source, th->dest, seq, rte_atomic32_read(&g_minute_count),
-                   DP_VS_SYNPROXY_COUNTER_TRIES);
+    syn_proxy_cookie_tuple(af, mbuf, th, &tuple);
+    tuple.sseq = ntohl(th->seq) - 1;
 
+    res = dp_vs_syncookie_check(af, &tuple, cookie,
+            rte_atomic32_read(&g_minute_count), DP_VS_SYNPROXY_COUNTER_TRIES);
     if ((uint32_t) -1 == res) /* count is invalid, g_minute_count' >> g_minute_count */
         return 0;
 
@@ -570,19 +392,16 @@ static void syn_proxy_parse_set_opts(struct rte_mbuf *mbuf, struct tcphdr *th,
     }
 }
 
-/* Reuse mbuf for syn proxy, called by syn_proxy_syn_rcv().
+/* Reuse mbuf for syn proxy, called by syn_proxy_synack_flush().
  * do following things:
- * 1) set tcp options,
- * 2) compute seq with cookie func,
- * 3) set tcp seq and ack_seq,
- * 4) exchange ip addr and tcp port,
- * 5) compute iphdr and tcp check (HW xmit checksum offload not support for syn).
+ * 1) set tcp seq(cookie) and ack_seq,
+ * 2) exchange ip addr and tcp port,
+ * 3) compute iphdr and tcp check (HW xmit checksum offload not support for syn).
+ * tcp options are set by syn_proxy_syn_rcv() already.
  */
-static void syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
-                                 struct tcphdr *th,
-                                 struct dp_vs_synproxy_opt *opt)
+static int syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
+                                struct tcphdr *th, uint32_t isn)
 {
-    uint32_t isn;
     uint16_t tmpport;
     int iphlen;
 
@@ -591,18 +410,6 @@ static void syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
     else
         iphlen = ip4_hdrlen(mbuf);
 
-    if (mbuf_may_pull(mbuf, iphlen + (th->doff << 2)) != 0)
-        return;
-
-    /* deal with tcp options */
-    syn_proxy_parse_set_opts(mbuf, th, opt);
-
-    /* get cookie */
-    if (AF_INET6 == af)
-        isn = syn_proxy_cookie_v6_init_sequence(mbuf, th, opt);
-    else
-        isn = syn_proxy_cookie_v4_init_sequence(mbuf, th, opt);
-
     /* set syn-ack flag */
     ((uint8_t *)th)[13] = 0x12;
 
@@ -632,7 +439,7 @@ static void syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
             th->check = ip6_phdr_cksum(ip6h, mbuf->ol_flags, mbuf->l3_len, IPPROTO_TCP);
         } else {
             if (mbuf_may_pull(mbuf, mbuf->pkt_len) != 0)
-                return;
+                return EDPVS_NOROOM;
             tcp6_send_csum((struct rte_ipv6_hdr*)ip6h, th);
         }
     } else {
@@ -652,7 +459,7 @@ static void syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
             th->check = rte_ipv4_phdr_cksum((struct rte_ipv4_hdr*)iph, mbuf->ol_flags);
         } else {
             if (mbuf_may_pull(mbuf, mbuf->pkt_len) != 0)
-                return;
+                return EDPVS_NOROOM;
             tcp4_send_csum((struct rte_ipv4_hdr*)iph, th);
         }
 
@@ -661,8 +468,91 @@ static void syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
         else
             ip4_send_csum((struct rte_ipv4_hdr*)iph);
     }
+
+    return EDPVS_OK;
 }
 
+/*
+ * SYN-ACKs aren't sent one by one, the SYNs of an RX burst are gathered
+ * per lcore and their cookies generated at once by the cookie engine.
+ * The batch is flushed when it's full and at the end of each lcore loop.
+ */
+struct syn_proxy_synack_batch {
+    int                             n;
+    struct rte_mbuf                 *mbufs[DP_VS_SYNCOOKIE_BURST];
+    struct tcphdr                   *ths[DP_VS_SYNCOOKIE_BURST];
+    struct dp_vs_syncookie_tuple    tuples[DP_VS_SYNCOOKIE_BURST];
+};
+
+static RTE_DEFINE_PER_LCORE(struct syn_proxy_synack_batch, synack_batch4);
+static RTE_DEFINE_PER_LCORE(struct syn_proxy_synack_batch, synack_batch6);
+
+#define this_synack_batch(af) ((af) == AF_INET6 ? &RTE_PER_LCORE(synack_batch6) \
+                                                : &RTE_PER_LCORE(synack_batch4))
+
+/* set L2 header and send the packet out
+ * It is noted that "ipv4_xmit" should not used here,
+ * because mbuf is reused. */
+static void syn_proxy_synack_xmit(struct rte_mbuf *mbuf)
+{
+    int ret;
+    struct netif_port *dev;
+    struct rte_ether_hdr *eth;
+    struct rte_ether_addr ethaddr;
+
+    dev = netif_port_get(mbuf->port);
+    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
+    if (unlikely(!dev || !eth)) {
+        RTE_LOG(ERR, IPVS, "%s: no memory\n", __func__);
+        rte_pktmbuf_free(mbuf);
+        return;
+    }
+    memcpy(&ethaddr, &eth->s_addr, sizeof(struct rte_ether_addr));
+    memcpy(&eth->s_addr, &eth->d_addr, sizeof(struct rte_ether_addr));
+    memcpy(&eth->d_addr, &ethaddr, sizeof(struct rte_ether_addr));
+
+    /* netif_xmit always consumes the mbuf */
+    if (unlikely(EDPVS_OK != (ret = netif_xmit(mbuf, dev)))) {
+        RTE_LOG(ERR, IPVS, "%s: netif_xmit failed -- %s\n",
+                __func__, dpvs_strerror(ret));
+    }
+}
+
+static void syn_proxy_synack_flush(int af)
+{
+    int i;
+    struct syn_proxy_synack_batch *batch = this_synack_batch(af);
+    uint32_t cookies[DP_VS_SYNCOOKIE_BURST];
+
+    if (!batch->n)
+        return;
+
+    dp_vs_syncookie_gen_burst(af, batch->tuples, batch->n,
+            rte_atomic32_read(&g_minute_count), cookies);
+
+    for (i = 0; i < batch->n; i++) {
+        if (syn_proxy_reuse_mbuf(af, batch->mbufs[i], batch->ths[i],
+                                 cookies[i]) != EDPVS_OK) {
+            rte_pktmbuf_free(batch->mbufs[i]);
+            continue;
+        }
+        syn_proxy_synack_xmit(batch->mbufs[i]);
+    }
+    batch->n = 0;
+}
+
+static void syn_proxy_synack_job(void *arg)
+{
+    syn_proxy_synack_flush(AF_INET);
+    syn_proxy_synack_flush(AF_INET6);
+}
+
+static struct dpvs_lcore_job syn_proxy_synack_lcore_job = {
+    .name = "synproxy_synack",
+    .type = LCORE_JOB_LOOP,
+    .func = syn_proxy_synack_job,
+};
+
 /* Syn-proxy step 1 logic: receive client's Syn.
  * Check if synproxy is enabled for this skb, and send syn/ack back
  *
@@ -677,13 +567,12 @@ static void syn_proxy_reuse_mbuf(int af, struct rte_mbuf *mbuf,
 int dp_vs_synproxy_syn_rcv(int af, struct rte_mbuf *mbuf,
         const struct dp_vs_iphdr *iph, int *verdict)
 {
-    int ret;
     struct dp_vs_service *svc = NULL;
     struct tcphdr *th, _tcph;
     struct dp_vs_synproxy_opt tcp_opt;
     struct netif_port *dev;
-    struct rte_ether_hdr *eth;
-    struct rte_ether_addr ethaddr;
+    struct syn_proxy_synack_batch *batch;
+    struct dp_vs_syncookie_tuple *tuple;
 
     th = mbuf_header_pointer(mbuf, iph->len, sizeof(_tcph), &_tcph);
     if (unlikely(NULL == th))
@@ -701,7 +590,7 @@ int dp_vs_synproxy_syn_rcv(int af, struct rte_mbuf *mbuf,
         }
 
         /* drop packet from blacklist */
-        if (dp_vs_blklst_lookup(iph->af, iph->proto, &iph->daddr,
+        if (dp_vs_blklst_filtered(iph->af, iph->proto, &iph->daddr,
                     th->dest, &iph->saddr)) {
             goto syn_rcv_out;
         }
@@ -737,28 +626,22 @@ int dp_vs_synproxy_syn_rcv(int af, struct rte_mbuf *mbuf,
             mbuf->ol_flags |= (PKT_TX_TCP_CKSUM | PKT_TX_IPV6);
     }
 
-    /* reuse mbuf */
-    syn_proxy_reuse_mbuf(af, mbuf, th, &tcp_opt);
-
-    /* set L2 header and send the packet out
-     * It is noted that "ipv4_xmit" should not used here,
-     * because mbuf is reused. */
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
-    if (unlikely(!eth)) {
-        RTE_LOG(ERR, IPVS, "%s: no memory\n", __func__);
+    /* deal with tcp options, mbuf is reused for SYN-ACK */
+    if (mbuf_may_pull(mbuf, iph->len + (th->doff << 2)) != 0)
         goto syn_rcv_out;
-    }
-    memcpy(&ethaddr, &eth->s_addr, sizeof(struct rte_ether_addr));
-    memcpy(&eth->s_addr, &eth->d_addr, sizeof(struct rte_ether_addr));
-    memcpy(&eth->d_addr, &ethaddr, sizeof(struct rte_ether_addr));
-
-    if (unlikely(EDPVS_OK != (ret = netif_xmit(mbuf, dev)))) {
-        RTE_LOG(ERR, IPVS, "%s: netif_xmit failed -- %s\n",
-                __func__, dpvs_strerror(ret));
-    /* should not set verdict to INET_DROP since netif_xmit
-     * always consume the mbuf while INET_DROP means mbuf'll
-     * be free in INET_HOOK.*/
-    }
+    th = (struct tcphdr *)(rte_pktmbuf_mtod(mbuf, char *) + iph->len);
+    syn_proxy_parse_set_opts(mbuf, th, &tcp_opt);
+
+    /* queue it for the cookie, the batch owns the mbuf from now on */
+    batch = this_synack_batch(af);
+    tuple = &batch->tuples[batch->n];
+    syn_proxy_cookie_tuple(af, mbuf, th, tuple);
+    tuple->sseq = ntohl(th->seq);
+    tuple->data = syn_proxy_cookie_data(&tcp_opt);
+    batch->mbufs[batch->n] = mbuf;
+    batch->ths[batch->n] = th;
+    if (++batch->n == DP_VS_SYNCOOKIE_BURST)
+        syn_proxy_synack_flush(af);
 
     *verdict = INET_STOLEN;
     return 0;
@@ -931,9 +814,9 @@ static int syn_proxy_send_rs_syn(int af, const struct tcphdr *th,
         }
 
         mbuf_userdata_reset(syn_mbuf_cloned);
-        cp->syn_mbuf = syn_mbuf_cloned;
+        cp->synproxy->syn_mbuf = syn_mbuf_cloned;
         sp_dbg_stats32_inc(sp_syn_saved);
-        rte_atomic32_set(&cp->syn_retry_max, dp_vs_synproxy_ctrl_syn_retry);
+        rte_atomic32_set(&cp->synproxy->syn_retry_max, dp_vs_synproxy_ctrl_syn_retry);
     }
 
     /* TODO: Save info for fast_response_xmit */
@@ -1154,12 +1037,8 @@ int dp_vs_synproxy_ack_rcv(int af, struct rte_mbuf *mbuf,
             return 0;
         }
 
-        if (AF_INET6 == af)
-            res_cookie_check = syn_proxy_v6_cookie_check(mbuf,
-                    ntohl(th->ack_seq) - 1, &opt);
-        else
-            res_cookie_check = syn_proxy_v4_cookie_check(mbuf,
-                    ntohl(th->ack_seq) - 1, &opt);
+        res_cookie_check = syn_proxy_cookie_check(af, mbuf,
+                ntohl(th->ack_seq) - 1, &opt);
         if (!res_cookie_check) {
             /* Update statistics */
             dp_vs_estats_inc(SYNPROXY_BAD_ACK);
@@ -1406,7 +1285,7 @@ int dp_vs_synproxy_synack_rcv(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
     if ((th->syn) && (th->ack) && (!th->rst) &&
             (cp->flags & DPVS_CONN_F_SYNPROXY) &&
             (cp->state == DPVS_TCP_S_SYN_SENT)) {
-        cp->syn_proxy_seq.delta = ntohl(cp->syn_proxy_seq.isn) - ntohl(th->seq);
+        cp->synproxy->syn_proxy_seq.delta = ntohl(cp->synproxy->syn_proxy_seq.isn) - ntohl(th->seq);
         cp->state = DPVS_TCP_S_ESTABLISHED;
         dp_vs_conn_set_timeout(cp, pp);
         dpvs_time_rand_delay(&cp->timeout, 1000000);
@@ -1431,20 +1310,20 @@ int dp_vs_synproxy_synack_rcv(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
         /* TODO: ip_vs_synproxy_save_fast_xmit_info ? */
 
         /* Free stored syn mbuf, no need for retransmition any more */
-        if (cp->syn_mbuf) {
-            rte_pktmbuf_free(cp->syn_mbuf);
-            cp->syn_mbuf = NULL;
+        if (cp->synproxy->syn_mbuf) {
+            rte_pktmbuf_free(cp->synproxy->syn_mbuf);
+            cp->synproxy->syn_mbuf = NULL;
             sp_dbg_stats32_dec(sp_syn_saved);
         }
 
-        if (list_empty(&cp->ack_mbuf)) {
+        if (list_empty(&cp->synproxy->ack_mbuf)) {
             /*
              * FIXME: Maybe a bug here, print err msg and go.
              * Attention: cp->state has been changed and we
              * should still DROP the syn/ack mbuf.
              */
             RTE_LOG(ERR, IPVS, "%s: got ack_mbuf NULL pointer: ack-saved = %u\n",
-                    __func__, cp->ack_num);
+                    __func__, cp->synproxy->ack_num);
             *verdict = INET_DROP;
             return 0;
         }
@@ -1455,15 +1334,15 @@ int dp_vs_synproxy_synack_rcv(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
          * The probe will be forward to RS and RS will respond a window update.
          * So DPVS has no need to send a window update.
          */
-        if (cp->ack_num == 1)
+        if (cp->synproxy->ack_num == 1)
             syn_proxy_send_window_update(tuplehash_out(cp).af, mbuf, cp, pp, th);
 
-        list_for_each_entry_safe(tmbuf, tmbuf2, &cp->ack_mbuf, list) {
+        list_for_each_entry_safe(tmbuf, tmbuf2, &cp->synproxy->ack_mbuf, list) {
             list_del_init(&tmbuf->list);
-            cp->ack_num--;
+            cp->synproxy->ack_num--;
             list_add_tail(&tmbuf->list, &save_mbuf);
         }
-        assert(cp->ack_num == 0);
+        assert(cp->synproxy->ack_num == 0);
 
         list_for_each_entry_safe(tmbuf, tmbuf2, &save_mbuf, list) {
             list_del_init(&tmbuf->list);
@@ -1483,7 +1362,7 @@ int dp_vs_synproxy_synack_rcv(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
                 __func__, ntohl(th->seq), ntohl(th->ack_seq));
 
         /* Count the delta of seq */
-        cp->syn_proxy_seq.delta = ntohl(cp->syn_proxy_seq.isn) - ntohl(th->seq);
+        cp->synproxy->syn_proxy_seq.delta = ntohl(cp->synproxy->syn_proxy_seq.isn) - ntohl(th->seq);
         cp->state = DPVS_TCP_S_CLOSE;
         cp->timeout.tv_sec = pp->timeout_table[cp->state];
         dpvs_time_rand_delay(&cp->timeout, 1000000);
@@ -1502,35 +1381,35 @@ static inline int __syn_proxy_reuse_conn(struct dp_vs_conn *cp,
     struct dp_vs_synproxy_ack_pakcet *tmbuf, *tmbuf2;
 
     /* Free stored ack packet */
-    list_for_each_entry_safe(tmbuf, tmbuf2, &cp->ack_mbuf, list) {
+    list_for_each_entry_safe(tmbuf, tmbuf2, &cp->synproxy->ack_mbuf, list) {
         list_del_init(&tmbuf->list);
-        cp->ack_num--;
+        cp->synproxy->ack_num--;
         rte_pktmbuf_free(tmbuf->mbuf);
         sp_dbg_stats32_dec(sp_ack_saved);
         rte_mempool_put(this_ack_mbufpool, tmbuf) ;
     }
-    assert(cp->ack_num == 0);
+    assert(cp->synproxy->ack_num == 0);
 
     /* Free stored syn mbuf */
-    if (cp->syn_mbuf) {
-        rte_pktmbuf_free(cp->syn_mbuf);
+    if (cp->synproxy->syn_mbuf) {
+        rte_pktmbuf_free(cp->synproxy->syn_mbuf);
         sp_dbg_stats32_dec(sp_syn_saved);
-        cp->syn_mbuf = NULL;
+        cp->synproxy->syn_mbuf = NULL;
     }
 
     /* Store new ack_mbuf */
-    assert(list_empty(&cp->ack_mbuf));
-    INIT_LIST_HEAD(&cp->ack_mbuf);
+    assert(list_empty(&cp->synproxy->ack_mbuf));
+    INIT_LIST_HEAD(&cp->synproxy->ack_mbuf);
 
     if (unlikely(rte_mempool_get(this_ack_mbufpool, (void **)&tmbuf) != 0))
         return EDPVS_NOMEM;
     tmbuf->mbuf = ack_mbuf;
-    list_add_tail(&tmbuf->list, &cp->ack_mbuf);
+    list_add_tail(&tmbuf->list, &cp->synproxy->ack_mbuf);
     sp_dbg_stats32_inc(sp_ack_saved);
-    cp->ack_num++;
+    cp->synproxy->ack_num++;
 
     /* Save ack_seq - 1 */
-    cp->syn_proxy_seq.isn = htonl((uint32_t)((ntohl(th->ack_seq) - 1)));
+    cp->synproxy->syn_proxy_seq.isn = htonl((uint32_t)((ntohl(th->ack_seq) - 1)));
     /* Do not change delta here, so original flow can still be valid */
 
     /* Save ack_seq */
@@ -1539,7 +1418,7 @@ static inline int __syn_proxy_reuse_conn(struct dp_vs_conn *cp,
     cp->fnat_seq.isn = 0;
 
     /* Clean duplicated ack count */
-    rte_atomic32_set(&cp->dup_ack_cnt, 0);
+    rte_atomic32_set(&cp->synproxy->dup_ack_cnt, 0);
 
     /* Set timeout value */
     cp->state = DPVS_TCP_S_SYN_SENT;
@@ -1578,13 +1457,9 @@ int dp_vs_synproxy_reuse_conn(int af, struct rte_mbuf *mbuf,
     if (((1 << (cp->state)) & tcp_conn_reuse_states) &&
             (cp->flags & DPVS_CONN_F_SYNPROXY) &&
             (!th->syn && th->ack && !th->rst && !th->fin) &&
-            (cp->syn_proxy_seq.isn != htonl((uint32_t)(ntohl(th->ack_seq) - 1)))) {
-        if (AF_INET6 == af)
-            res_cookie_check = syn_proxy_v6_cookie_check(mbuf,
-                    ntohl(th->ack_seq) - 1, &opt);
-        else
-            res_cookie_check = syn_proxy_v4_cookie_check(mbuf,
-                    ntohl(th->ack_seq) - 1, &opt);
+            (cp->synproxy->syn_proxy_seq.isn != htonl((uint32_t)(ntohl(th->ack_seq) - 1)))) {
+        res_cookie_check = syn_proxy_cookie_check(af, mbuf,
+                ntohl(th->ack_seq) - 1, &opt);
         if (!res_cookie_check) {
             /* Update statistics */
             dp_vs_estats_inc(SYNPROXY_BAD_ACK);
@@ -1647,11 +1522,11 @@ static int syn_proxy_is_ack_storm(struct tcphdr *tcph, struct dp_vs_conn *cp)
     if (unlikely(dp_vs_synproxy_ctrl_dup_ack_thresh == 0))
         return 1;
 
-    if(unlikely(tcph->seq == cp->last_seq &&
-                tcph->ack_seq == cp->last_ack_seq)) {
-        rte_atomic32_inc(&cp->dup_ack_cnt);
-        if (rte_atomic32_read(&cp->dup_ack_cnt) >= dp_vs_synproxy_ctrl_dup_ack_thresh) {
-            rte_atomic32_set(&cp->dup_ack_cnt, dp_vs_synproxy_ctrl_dup_ack_thresh);
+    if(unlikely(tcph->seq == cp->synproxy->last_seq &&
+                tcph->ack_seq == cp->synproxy->last_ack_seq)) {
+        rte_atomic32_inc(&cp->synproxy->dup_ack_cnt);
+        if (rte_atomic32_read(&cp->synproxy->dup_ack_cnt) >= dp_vs_synproxy_ctrl_dup_ack_thresh) {
+            rte_atomic32_set(&cp->synproxy->dup_ack_cnt, dp_vs_synproxy_ctrl_dup_ack_thresh);
             /* Update statisitcs */
             dp_vs_estats_inc(SYNPROXY_ACK_STORM);
             return 0;
@@ -1660,9 +1535,9 @@ static int syn_proxy_is_ack_storm(struct tcphdr *tcph, struct dp_vs_conn *cp)
         return 1;
     }
 
-    cp->last_seq = tcph->seq;
-    cp->last_ack_seq = tcph->ack_seq;
-    rte_atomic32_set(&cp->dup_ack_cnt, 0);
+    cp->synproxy->last_seq = tcph->seq;
+    cp->synproxy->last_ack_seq = tcph->ack_seq;
+    rte_atomic32_set(&cp->synproxy->dup_ack_cnt, 0);
 
     return 1;
 }
@@ -1675,16 +1550,20 @@ int dp_vs_synproxy_snat_handler(struct tcphdr *tcph, struct dp_vs_conn *cp)
 {
     uint32_t old_seq;
 
+    /* not a synproxy conn, nothing to adjust */
+    if (!cp->synproxy)
+        return 1;
+
     if (syn_proxy_is_ack_storm(tcph, cp) == 0)
         return 0;
 
-    if (cp->syn_proxy_seq.delta) {
+    if (cp->synproxy->syn_proxy_seq.delta) {
         old_seq = ntohl(tcph->seq);
-        tcph->seq = htonl((uint32_t)(old_seq + cp->syn_proxy_seq.delta));
+        tcph->seq = htonl((uint32_t)(old_seq + cp->synproxy->syn_proxy_seq.delta));
         //syn_proxy_seq_csum_update(tcph, htonl(old_seq), tch->seq);
 #ifdef CONFIG_DPVS_IPVS_DEBUG
         RTE_LOG(DEBUG, IPVS, "%s: tcph->seq %u => %u, delta = %u\n",
-                __func__, old_seq, ntohl(tcph->seq), cp->syn_proxy_seq.delta);
+                __func__, old_seq, ntohl(tcph->seq), cp->synproxy->syn_proxy_seq.delta);
 #endif
     }
 
@@ -1716,7 +1595,7 @@ int dp_vs_synproxy_filter_ack(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
 
         /* the length of ack list should be limited to avoid pktpool resource drained
          * when we does not recieve rs's reply to our syn in no time */
-        if (dp_vs_synproxy_ctrl_max_ack_saved < cp->ack_num) {
+        if (dp_vs_synproxy_ctrl_max_ack_saved < cp->synproxy->ack_num) {
             dp_vs_estats_inc(SYNPROXY_SYNSEND_QLEN);
             sp_dbg_stats64_inc(sp_ack_refused);
             *verdict = INET_DROP;
@@ -1731,8 +1610,8 @@ int dp_vs_synproxy_filter_ack(struct rte_mbuf *mbuf, struct dp_vs_conn *cp,
         }
 
         ack_mbuf->mbuf = mbuf;
-        list_add_tail(&ack_mbuf->list, &cp->ack_mbuf);
-        cp->ack_num++;
+        list_add_tail(&ack_mbuf->list, &cp->synproxy->ack_mbuf);
+        cp->synproxy->ack_num++;
         sp_dbg_stats32_inc(sp_ack_saved);
 
         *verdict = INET_STOLEN;
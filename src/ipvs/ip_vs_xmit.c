@@ -33,22 +33,64 @@
 static bool fast_xmit_close = false;
 static bool xmit_ttl = false;
 
+/*
+ * the nexthop for L2 fast xmit, which is held by the slow path of the first
+ * packets of the direction. it's shared by the conns of the neighbour, whose
+ * MAC updates are taken at once; a nexthop in PROBE state goes through the
+ * slow path for neigh_output() to probe it.
+ */
+static inline struct neighbour_entry *
+dp_vs_fast_xmit_nexthop(struct dp_vs_conn *conn, bool in,
+                        const struct rte_mbuf *mbuf)
+{
+    struct neighbour_entry *nh = dp_vs_conn_nexthop(conn, in);
+
+    if (unlikely(!nh || !neigh_held_reachable(nh)))
+        return NULL;
+
+    /* let the slow path fragment or send ICMP */
+    if (unlikely(mbuf->pkt_len > nh->port->mtu || mbuf_frag_size(mbuf)))
+        return NULL;
+
+    return nh;
+}
+
+static inline int dp_vs_fast_xmit_l2(struct neighbour_entry *nh,
+                                     struct rte_mbuf *mbuf,
+                                     uint16_t packet_type)
+{
+    struct rte_ether_hdr *eth;
+    int err;
+
+    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
+                    (uint16_t)sizeof(struct rte_ether_hdr));
+    rte_ether_addr_copy(&nh->eth_addr, &eth->d_addr);
+    rte_ether_addr_copy(&nh->port->addr, &eth->s_addr);
+    eth->ether_type = rte_cpu_to_be_16(packet_type);
+    mbuf->packet_type = packet_type;
+    mbuf->l2_len = sizeof(struct rte_ether_hdr);
+
+    err = netif_xmit(mbuf, nh->port);
+    if (err != EDPVS_OK)
+        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
+
+    /* must return OK since netif_xmit alway consume mbuf */
+    return EDPVS_OK;
+}
+
 static int __dp_vs_fast_xmit_fnat4(struct dp_vs_proto *proto,
                                    struct dp_vs_conn *conn,
                                    struct rte_mbuf *mbuf)
 {
     struct rte_ipv4_hdr *ip4h = ip4_hdr(mbuf);
-    struct rte_ether_hdr *eth;
+    struct neighbour_entry *nh;
     uint16_t packet_type = RTE_ETHER_TYPE_IPV4;
     int err;
 
-    if (unlikely(conn->in_dev == NULL))
+    nh = dp_vs_fast_xmit_nexthop(conn, true, mbuf);
+    if (unlikely(!nh))
         return EDPVS_NOROUTE;
 
-    if (unlikely(rte_is_zero_ether_addr(&conn->in_dmac) ||
-                 rte_is_zero_ether_addr(&conn->in_smac)))
-        return EDPVS_NOTSUPP;
-
     /* pre-handler before translation */
     if (proto->fnat_in_pre_handler) {
         err = proto->fnat_in_pre_handler(proto, conn, mbuf);
@@ -78,19 +120,7 @@ static int __dp_vs_fast_xmit_fnat4(struct dp_vs_proto *proto,
         ip4_send_csum(ip4h);
     }
 
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
-                    (uint16_t)sizeof(struct rte_ether_hdr));
-    rte_ether_addr_copy(&conn->in_dmac, &eth->d_addr);
-    rte_ether_addr_copy(&conn->in_smac, &eth->s_addr);
-    eth->ether_type = rte_cpu_to_be_16(packet_type);
-    mbuf->packet_type = packet_type;
-
-    err = netif_xmit(mbuf, conn->in_dev);
-    if (err != EDPVS_OK)
-        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
-
-    /* must return OK since netif_xmit alway consume mbuf */
-    return EDPVS_OK;
+    return dp_vs_fast_xmit_l2(nh, mbuf, packet_type);
 }
 
 static int __dp_vs_fast_xmit_fnat6(struct dp_vs_proto *proto,
@@ -98,17 +128,14 @@ static int __dp_vs_fast_xmit_fnat6(struct dp_vs_proto *proto,
                                    struct rte_mbuf *mbuf)
 {
     struct ip6_hdr *ip6h = ip6_hdr(mbuf);
-    struct rte_ether_hdr *eth;
+    struct neighbour_entry *nh;
     uint16_t packet_type = RTE_ETHER_TYPE_IPV6;
     int err;
 
-    if (unlikely(conn->in_dev == NULL))
+    nh = dp_vs_fast_xmit_nexthop(conn, true, mbuf);
+    if (unlikely(!nh))
         return EDPVS_NOROUTE;
 
-    if (unlikely(rte_is_zero_ether_addr(&conn->in_dmac) ||
-                 rte_is_zero_ether_addr(&conn->in_smac)))
-        return EDPVS_NOTSUPP;
-
     /* pre-handler before translation */
     if (proto->fnat_in_pre_handler) {
         err = proto->fnat_in_pre_handler(proto, conn, mbuf);
@@ -131,19 +158,7 @@ static int __dp_vs_fast_xmit_fnat6(struct dp_vs_proto *proto,
             return err;
     }
 
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
-                    (uint16_t)sizeof(struct rte_ether_hdr));
-    rte_ether_addr_copy(&conn->in_dmac, &eth->d_addr);
-    rte_ether_addr_copy(&conn->in_smac, &eth->s_addr);
-    eth->ether_type = rte_cpu_to_be_16(packet_type);
-    mbuf->packet_type = packet_type;
-
-    err = netif_xmit(mbuf, conn->in_dev);
-    if (err != EDPVS_OK)
-        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
-
-    /* must return OK since netif_xmit alway consume mbuf */
-    return EDPVS_OK;
+    return dp_vs_fast_xmit_l2(nh, mbuf, packet_type);
 }
 
 static int dp_vs_fast_xmit_fnat(int af,
@@ -160,17 +175,14 @@ static int __dp_vs_fast_outxmit_fnat4(struct dp_vs_proto *proto,
                                       struct rte_mbuf *mbuf)
 {
     struct rte_ipv4_hdr *ip4h = ip4_hdr(mbuf);
-    struct rte_ether_hdr *eth;
+    struct neighbour_entry *nh;
     uint16_t packet_type = RTE_ETHER_TYPE_IPV4;
     int err;
 
-    if (unlikely(conn->out_dev == NULL))
+    nh = dp_vs_fast_xmit_nexthop(conn, false, mbuf);
+    if (unlikely(!nh))
         return EDPVS_NOROUTE;
 
-    if (unlikely(rte_is_zero_ether_addr(&conn->out_dmac) ||
-                 rte_is_zero_ether_addr(&conn->out_smac)))
-        return EDPVS_NOTSUPP;
-
     /* pre-handler before translation */
     if (proto->fnat_out_pre_handler) {
         err = proto->fnat_out_pre_handler(proto, conn, mbuf);
@@ -200,19 +212,7 @@ static int __dp_vs_fast_outxmit_fnat4(struct dp_vs_proto *proto,
         ip4_send_csum(ip4h);
     }
 
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
-                    (uint16_t)sizeof(struct rte_ether_hdr));
-    rte_ether_addr_copy(&conn->out_dmac, &eth->d_addr);
-    rte_ether_addr_copy(&conn->out_smac, &eth->s_addr);
-    eth->ether_type = rte_cpu_to_be_16(packet_type);
-    mbuf->packet_type = packet_type;
-
-    err = netif_xmit(mbuf, conn->out_dev);
-    if (err != EDPVS_OK)
-        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
-
-    /* must return OK since netif_xmit alway consume mbuf */
-    return EDPVS_OK;
+    return dp_vs_fast_xmit_l2(nh, mbuf, packet_type);
 }
 
 static int __dp_vs_fast_outxmit_fnat6(struct dp_vs_proto *proto,
@@ -220,17 +220,14 @@ static int __dp_vs_fast_outxmit_fnat6(struct dp_vs_proto *proto,
                                       struct rte_mbuf *mbuf)
 {
     struct ip6_hdr *ip6h = ip6_hdr(mbuf);
-    struct rte_ether_hdr *eth;
+    struct neighbour_entry *nh;
     uint16_t packet_type = RTE_ETHER_TYPE_IPV6;
     int err;
 
-    if (unlikely(conn->out_dev == NULL))
+    nh = dp_vs_fast_xmit_nexthop(conn, false, mbuf);
+    if (unlikely(!nh))
         return EDPVS_NOROUTE;
 
-    if (unlikely(rte_is_zero_ether_addr(&conn->out_dmac) ||
-                 rte_is_zero_ether_addr(&conn->out_smac)))
-        return EDPVS_NOTSUPP;
-
     /* pre-handler before translation */
     if (proto->fnat_out_pre_handler) {
         err = proto->fnat_out_pre_handler(proto, conn, mbuf);
@@ -253,19 +250,7 @@ static int __dp_vs_fast_outxmit_fnat6(struct dp_vs_proto *proto,
             return err;
     }
 
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
-                    (uint16_t)sizeof(struct rte_ether_hdr));
-    rte_ether_addr_copy(&conn->out_dmac, &eth->d_addr);
-    rte_ether_addr_copy(&conn->out_smac, &eth->s_addr);
-    eth->ether_type = rte_cpu_to_be_16(packet_type);
-    mbuf->packet_type = packet_type;
-
-    err = netif_xmit(mbuf, conn->out_dev);
-    if (err != EDPVS_OK)
-        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
-
-    /* must return OK since netif_xmit alway consume mbuf */
-    return EDPVS_OK;
+    return dp_vs_fast_xmit_l2(nh, mbuf, packet_type);
 }
 
 static int dp_vs_fast_outxmit_fnat(int af,
@@ -278,114 +263,45 @@ static int dp_vs_fast_outxmit_fnat(int af,
 }
 
 /*
- * ARP_HDR_ETHER SUPPORT ONLY
- * save source mac(client) for output in conn as dest mac
- */
-static void dp_vs_save_xmit_info(struct rte_mbuf *mbuf,
-                          struct dp_vs_proto *proto,
-                          struct dp_vs_conn *conn)
-{
-    struct rte_ether_hdr *eth = NULL;
-    struct netif_port *port = NULL;
-
-    if (!rte_is_zero_ether_addr(&conn->out_dmac) &&
-        !rte_is_zero_ether_addr(&conn->out_smac))
-        return;
-
-    if (unlikely(mbuf->l2_len != sizeof(struct rte_ether_hdr)))
-        return;
-
-    port = netif_port_get(mbuf->port);
-    if (port)
-        conn->out_dev = port;
-
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
-
-    rte_ether_addr_copy(&eth->s_addr, &conn->out_dmac);
-    rte_ether_addr_copy(&eth->d_addr, &conn->out_smac);
-
-    rte_pktmbuf_adj(mbuf, sizeof(struct rte_ether_hdr));
-}
-
-/*
- * save source mac(rs) for input in conn as dest mac
+ * hold the neighbour of the route as the nexthop of the conn, once resolved.
+ * in: route to rs
+ * out:route to client
  */
-static void dp_vs_save_outxmit_info(struct rte_mbuf *mbuf,
-                             struct dp_vs_proto *proto,
-                             struct dp_vs_conn *conn)
+static void dp_vs_conn_hold_nexthop(struct dp_vs_conn *conn, int af,
+                                    const union inet_addr *nexthop,
+                                    struct netif_port *dev, bool in)
 {
-    struct rte_ether_hdr *eth = NULL;
-    struct netif_port *port = NULL;
-
-    if (!rte_is_zero_ether_addr(&conn->in_dmac) &&
-        !rte_is_zero_ether_addr(&conn->in_smac))
-        return;
+    struct neighbour_entry **nh = in ? &conn->in_nh : &conn->out_nh;
+    uint32_t *gen = in ? &conn->in_nh_gen : &conn->out_nh_gen;
 
-    if (mbuf->l2_len != sizeof(struct rte_ether_hdr))
+    if (dp_vs_conn_nexthop(conn, in) || !dev)
         return;
 
-    port = netif_port_get(mbuf->port);
-    if (port)
-        conn->in_dev = port;
-
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf, mbuf->l2_len);
-
-    rte_ether_addr_copy(&eth->s_addr, &conn->in_dmac);
-    rte_ether_addr_copy(&eth->d_addr, &conn->in_smac);
-
-    rte_pktmbuf_adj(mbuf, sizeof(struct rte_ether_hdr));
+    *nh = neigh_hold(af, nexthop, dev, gen);
 }
 
-/*
- * in: route to rs
- * out:route to client
- */
 static void dp_vs_conn_cache_rt(struct dp_vs_conn *conn, struct route_entry *rt, bool in)
 {
-    if ((in && conn->in_dev && (conn->in_nexthop.in.s_addr != htonl(INADDR_ANY))) ||
-        (!in && conn->out_dev && (conn->out_nexthop.in.s_addr != htonl(INADDR_ANY))))
-        return;
+    union inet_addr nexthop;
 
-    if (in) {
-        conn->in_dev = rt->port;
-        if (rt->gw.s_addr == htonl(INADDR_ANY)) {
-            conn->in_nexthop.in = conn->daddr.in;
-        } else {
-            conn->in_nexthop.in = rt->gw;
-        }
+    if (rt->gw.s_addr == htonl(INADDR_ANY))
+        nexthop.in = in ? conn->daddr.in : conn->caddr.in;
+    else
+        nexthop.in = rt->gw;
 
-    } else {
-        conn->out_dev = rt->port;
-        if (rt->gw.s_addr == htonl(INADDR_ANY)) {
-            conn->out_nexthop.in = conn->caddr.in;
-        } else {
-            conn->out_nexthop.in = rt->gw;
-        }
-    }
+    dp_vs_conn_hold_nexthop(conn, AF_INET, &nexthop, rt->port, in);
 }
 
 static void dp_vs_conn_cache_rt6(struct dp_vs_conn *conn, struct route6 *rt, bool in)
 {
-    if ((in && conn->in_dev && !ipv6_addr_any(&conn->in_nexthop.in6)) ||
-        (!in && conn->out_dev && !ipv6_addr_any(&conn->out_nexthop.in6)))
-        return;
+    union inet_addr nexthop;
 
-    if (in) {
-        conn->in_dev = rt->rt6_dev;
-        if (ipv6_addr_any(&rt->rt6_gateway)) {
-            conn->in_nexthop.in6 = conn->daddr.in6;
-        } else {
-            conn->in_nexthop.in6 = rt->rt6_gateway;
-        }
+    if (ipv6_addr_any(&rt->rt6_gateway))
+        nexthop.in6 = in ? conn->daddr.in6 : conn->caddr.in6;
+    else
+        nexthop.in6 = rt->rt6_gateway;
 
-    } else {
-        conn->out_dev = rt->rt6_dev;
-        if (ipv6_addr_any(&rt->rt6_gateway)) {
-            conn->out_nexthop.in6 = conn->caddr.in6;
-        } else {
-            conn->out_nexthop.in6 = rt->rt6_gateway;
-        }
-    }
+    dp_vs_conn_hold_nexthop(conn, AF_INET6, &nexthop, rt->rt6_dev, in);
 }
 
 static int __dp_vs_xmit_fnat4(struct dp_vs_proto *proto,
@@ -398,7 +314,6 @@ static int __dp_vs_xmit_fnat4(struct dp_vs_proto *proto,
     int err, mtu;
 
     if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
-        dp_vs_save_xmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_xmit_fnat(AF_INET, proto, conn, mbuf)) {
             return EDPVS_OK;
         }
@@ -504,7 +419,6 @@ static int __dp_vs_xmit_fnat6(struct dp_vs_proto *proto,
     int err, mtu;
 
     if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
-        dp_vs_save_xmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_xmit_fnat(AF_INET6, proto, conn, mbuf)) {
             return EDPVS_OK;
         }
@@ -538,7 +452,7 @@ static int __dp_vs_xmit_fnat6(struct dp_vs_proto *proto,
 
     // check mtu
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, mtu);
 
@@ -636,7 +550,7 @@ static int __dp_vs_xmit_fnat64(struct dp_vs_proto *proto,
      */
     mtu = rt->mtu;
     pkt_len = mbuf_nat6to4_len(mbuf);
-    if (pkt_len > mtu) {
+    if (pkt_len > mtu && !mbuf_frag_size(mbuf)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, mtu);
 
@@ -723,7 +637,6 @@ static int __dp_vs_out_xmit_fnat4(struct dp_vs_proto *proto,
     int err, mtu;
 
     if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
-        dp_vs_save_outxmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_outxmit_fnat(AF_INET, proto, conn, mbuf)) {
             return EDPVS_OK;
         }
@@ -826,7 +739,6 @@ static int __dp_vs_out_xmit_fnat6(struct dp_vs_proto *proto,
     int err, mtu;
 
     if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
-        dp_vs_save_outxmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_outxmit_fnat(AF_INET6, proto, conn, mbuf)) {
             return EDPVS_OK;
         }
@@ -856,7 +768,7 @@ static int __dp_vs_out_xmit_fnat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, false);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1087,7 +999,7 @@ static void __dp_vs_xmit_icmp4(struct rte_mbuf *mbuf,
             /* seq adjustment (changed by SynProxy) */
             if (ciph->next_proto_id == IPPROTO_TCP) {
                 uint32_t *seq = (uint32_t *)ports + 1;
-                *seq = htonl(ntohl(*seq) - conn->syn_proxy_seq.delta);
+                *seq = htonl(ntohl(*seq) - dp_vs_conn_synproxy_delta(conn));
             }
         } else {
             ports[1] = conn->vport;
@@ -1187,7 +1099,7 @@ static void __dp_vs_xmit_icmp6(struct rte_mbuf *mbuf,
             /* seq adjustment (changed by SynProxy) */
             if (nexthdr == IPPROTO_TCP) {
                 uint32_t *seq = (uint32_t *)ports + 1;
-                *seq = htonl(ntohl(*seq) - conn->syn_proxy_seq.delta);
+                *seq = htonl(ntohl(*seq) - dp_vs_conn_synproxy_delta(conn));
             }
         } else {
             ports[1] = conn->vport;
@@ -1302,7 +1214,7 @@ static int __dp_vs_xmit_dr6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1454,7 +1366,7 @@ static int __dp_vs_xmit_snat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1592,16 +1504,13 @@ static int dp_vs_fast_xmit_nat(struct dp_vs_proto *proto,
                     struct rte_mbuf *mbuf)
 {
     struct rte_ipv4_hdr *iph = ip4_hdr(mbuf);
-    struct rte_ether_hdr *eth;
+    struct neighbour_entry *nh;
     int err;
 
-    if (unlikely(conn->in_dev == NULL))
+    nh = dp_vs_fast_xmit_nexthop(conn, true, mbuf);
+    if (unlikely(!nh))
         return EDPVS_NOROUTE;
 
-    if (unlikely(rte_is_zero_ether_addr(&conn->in_dmac) ||
-                 rte_is_zero_ether_addr(&conn->in_smac)))
-        return EDPVS_NOTSUPP;
-
     iph->hdr_checksum = 0;
     iph->dst_addr = conn->daddr.in.s_addr;
 
@@ -1617,19 +1526,7 @@ static int dp_vs_fast_xmit_nat(struct dp_vs_proto *proto,
         ip4_send_csum(iph);
     }
 
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
-                    (uint16_t)sizeof(struct rte_ether_hdr));
-    rte_ether_addr_copy(&conn->in_dmac, &eth->d_addr);
-    rte_ether_addr_copy(&conn->in_smac, &eth->s_addr);
-    eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
-    mbuf->packet_type = RTE_ETHER_TYPE_IPV4;
-
-    err = netif_xmit(mbuf, conn->in_dev);
-    if (err != EDPVS_OK)
-        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
-
-    /* must return OK since netif_xmit alway consume mbuf */
-    return EDPVS_OK;
+    return dp_vs_fast_xmit_l2(nh, mbuf, RTE_ETHER_TYPE_IPV4);
 }
 
 static int dp_vs_fast_outxmit_nat(struct dp_vs_proto *proto,
@@ -1637,16 +1534,13 @@ static int dp_vs_fast_outxmit_nat(struct dp_vs_proto *proto,
                           struct rte_mbuf *mbuf)
 {
     struct rte_ipv4_hdr *iph = ip4_hdr(mbuf);
-    struct rte_ether_hdr *eth;
+    struct neighbour_entry *nh;
     int err;
 
-    if (unlikely(conn->out_dev == NULL))
+    nh = dp_vs_fast_xmit_nexthop(conn, false, mbuf);
+    if (unlikely(!nh))
         return EDPVS_NOROUTE;
 
-    if (unlikely(rte_is_zero_ether_addr(&conn->out_dmac) ||
-                 rte_is_zero_ether_addr(&conn->out_smac)))
-        return EDPVS_NOTSUPP;
-
     iph->hdr_checksum = 0;
     iph->src_addr = conn->vaddr.in.s_addr;
 
@@ -1662,19 +1556,7 @@ static int dp_vs_fast_outxmit_nat(struct dp_vs_proto *proto,
         ip4_send_csum(iph);
     }
 
-    eth = (struct rte_ether_hdr *)rte_pktmbuf_prepend(mbuf,
-                    (uint16_t)sizeof(struct rte_ether_hdr));
-    rte_ether_addr_copy(&conn->out_dmac, &eth->d_addr);
-    rte_ether_addr_copy(&conn->out_smac, &eth->s_addr);
-    eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
-    mbuf->packet_type = RTE_ETHER_TYPE_IPV4;
-
-    err = netif_xmit(mbuf, conn->out_dev);
-    if (err != EDPVS_OK)
-        RTE_LOG(DEBUG, IPVS, "%s: fail to netif_xmit.\n", __func__);
-
-    /* must return OK since netif_xmit alway consume mbuf */
-    return EDPVS_OK;
+    return dp_vs_fast_xmit_l2(nh, mbuf, RTE_ETHER_TYPE_IPV4);
 }
 
 static int __dp_vs_out_xmit_snat6(struct dp_vs_proto *proto,
@@ -1701,7 +1583,7 @@ static int __dp_vs_out_xmit_snat6(struct dp_vs_proto *proto,
         dp_vs_conn_cache_rt6(conn, rt6, false);
     }
 
-    if (mbuf->pkt_len > rt6->rt6_mtu) {
+    if (ip6_pkt_too_big(mbuf, rt6->rt6_mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(rt6->rt6_mtu));
         err = EDPVS_FRAG;
@@ -1761,7 +1643,6 @@ static int __dp_vs_xmit_nat4(struct dp_vs_proto *proto,
     int err, mtu;
 
     if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
-        dp_vs_save_xmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_xmit_nat(proto, conn, mbuf)) {
             return EDPVS_OK;
         }
@@ -1870,7 +1751,7 @@ static int __dp_vs_xmit_nat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, true);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -1932,7 +1813,6 @@ static int __dp_vs_out_xmit_nat4(struct dp_vs_proto *proto,
     int err, mtu;
 
     if (!fast_xmit_close && !(conn->flags & DPVS_CONN_F_NOFASTXMIT)) {
-        dp_vs_save_outxmit_info(mbuf, proto, conn);
         if (!dp_vs_fast_outxmit_nat(proto, conn, mbuf)) {
             return EDPVS_OK;
         }
@@ -2042,7 +1922,7 @@ static int __dp_vs_out_xmit_nat6(struct dp_vs_proto *proto,
     dp_vs_conn_cache_rt6(conn, rt6, false);
 
     mtu = rt6->rt6_mtu;
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -2221,7 +2101,7 @@ static int __dp_vs_xmit_tunnel6(struct dp_vs_proto *proto,
         goto errout;
     }
 
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -2297,7 +2177,7 @@ static int __dp_vs_xmit_tunnel_6o4(struct dp_vs_proto *proto,
         goto errout;
     }
 
-    if (mbuf->pkt_len > mtu) {
+    if (ip6_pkt_too_big(mbuf, mtu)) {
         RTE_LOG(DEBUG, IPVS, "%s: frag needed.\n", __func__);
         icmp6_send(mbuf, ICMP6_PACKET_TOO_BIG, 0, htonl(mtu));
         err = EDPVS_FRAG;
@@ -2308,7 +2188,8 @@ static int __dp_vs_xmit_tunnel_6o4(struct dp_vs_proto *proto,
     new_iph->version_ihl = 0x45;
     new_iph->type_of_service = 0;
     new_iph->total_length = htons(mbuf->pkt_len);
-    new_iph->fragment_offset = htons(RTE_IPV4_HDR_DF_FLAG);
+    /* a reassembled datagram is fragmented again by ipv4_output() */
+    new_iph->fragment_offset = mbuf_frag_size(mbuf) ? 0 : htons(RTE_IPV4_HDR_DF_FLAG);
     new_iph->time_to_live = old_ip6h->ip6_hlim;
     new_iph->next_proto_id = IPPROTO_IPV6;
     new_iph->src_addr = rt->src.s_addr;
@@ -45,8 +45,6 @@
     v1 ^= key->key[1]; \
     v0 ^= key->key[0];
 
-#if __BITS_PER_LONG == 64
-
 /**
  * taken from definition in include/linux/bitops.h
  *
@@ -59,6 +57,187 @@ static inline uint64_t rol64(uint64_t word, unsigned int shift)
     return (word << (shift & 63)) | (word >> ((-shift) & 63));
 }
 
+#define POSTAMBLE \
+    v3 ^= b; \
+    SIPROUND; \
+    SIPROUND; \
+    v0 ^= b; \
+    v2 ^= 0xff; \
+    SIPROUND; \
+    SIPROUND; \
+    SIPROUND; \
+    SIPROUND; \
+    return (v0 ^ v1) ^ (v2 ^ v3);
+
+/**
+ * siphash_1u64 - compute 64-bit siphash PRF value of a uint64_t
+ * @first: first uint64_t
+ * @key: the siphash key
+ */
+uint64_t siphash_1u64(const uint64_t first, const siphash_key_t *key)
+{
+    PREAMBLE(8)
+    v3 ^= first;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= first;
+    POSTAMBLE
+}
+
+/**
+ * siphash_2u64 - compute 64-bit siphash PRF value of 2 uint64_t
+ * @first: first uint64_t
+ * @second: second uint64_t
+ * @key: the siphash key
+ */
+uint64_t siphash_2u64(const uint64_t first, const uint64_t second,
+        const siphash_key_t *key)
+{
+    PREAMBLE(16)
+    v3 ^= first;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= first;
+    v3 ^= second;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= second;
+    POSTAMBLE
+}
+
+/**
+ * siphash_1u32 - compute 64-bit siphash PRF value of a uint32_t
+ * @first: first uint32_t
+ * @key: the siphash key
+ */
+uint64_t siphash_1u32(const uint32_t first, const siphash_key_t *key)
+{
+    PREAMBLE(4)
+    b |= first;
+    POSTAMBLE
+}
+
+/**
+ * siphash_3u32 - compute 64-bit siphash PRF value of 3 uint32_t
+ * @first: first uint32_t
+ * @second: second uint32_t
+ * @third: third uint32_t
+ * @key: the siphash key
+ */
+uint64_t siphash_3u32(const uint32_t first, const uint32_t second,
+        const uint32_t third, const siphash_key_t *key)
+{
+    uint64_t combined = (uint64_t)second << 32 | first;
+    PREAMBLE(12)
+    v3 ^= combined;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= combined;
+    b |= third;
+    POSTAMBLE
+}
+
+/**
+ * __siphash_aligned - compute 64-bit siphash PRF value of a buffer
+ * @data: buffer to hash, 8 bytes aligned
+ * @len: size of @data
+ * @key: the siphash key
+ */
+uint64_t __siphash_aligned(const void *data, size_t len,
+        const siphash_key_t *key)
+{
+    const uint8_t *end = data + len - (len % sizeof(uint64_t));
+    const uint8_t left = len & (sizeof(uint64_t) - 1);
+    uint64_t m;
+    PREAMBLE(len)
+    for (; data != end; data += sizeof(uint64_t)) {
+        m = rte_le_to_cpu_64(*((uint64_t *)data));
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+    switch (left) {
+    case 7: b |= ((uint64_t)end[6]) << 48; /* fall through */
+    case 6: b |= ((uint64_t)end[5]) << 40; /* fall through */
+    case 5: b |= ((uint64_t)end[4]) << 32; /* fall through */
+    case 4: b |= rte_le_to_cpu_32(*((uint32_t *)data)); break;
+    case 3: b |= ((uint64_t)end[2]) << 16; /* fall through */
+    case 2: b |= rte_le_to_cpu_16(*((uint16_t *)data)); break;
+    case 1: b |= end[0];
+    }
+    POSTAMBLE
+}
+
+static inline void sipround_lanes(uint64_t *restrict v0, uint64_t *restrict v1,
+                                  uint64_t *restrict v2, uint64_t *restrict v3)
+{
+    int l;
+
+    for (l = 0; l < SIPHASH_LANES; l++) {
+        v0[l] += v1[l]; v1[l] = rol64(v1[l], 13); v1[l] ^= v0[l]; v0[l] = rol64(v0[l], 32);
+        v2[l] += v3[l]; v3[l] = rol64(v3[l], 16); v3[l] ^= v2[l];
+        v0[l] += v3[l]; v3[l] = rol64(v3[l], 21); v3[l] ^= v0[l];
+        v2[l] += v1[l]; v1[l] = rol64(v1[l], 17); v1[l] ^= v2[l]; v2[l] = rol64(v2[l], 32);
+    }
+}
+
+/**
+ * siphash_lanes - compute SIPHASH_LANES siphash PRF values in lock-step
+ * @msg: @nwords uint64_t of each lane, word major: word i of lane l is
+ *       msg[i * SIPHASH_LANES + l]
+ * @nwords: number of uint64_t per lane
+ * @key: the siphash key, shared by all lanes
+ * @out: the SIPHASH_LANES hash values
+ *
+ * Lane l equals __siphash_aligned() of its @nwords words. The lanes share
+ * no state, so each step of the rounds is one loop over the lanes which
+ * the compiler turns into vector instructions (SSE2/AVX2/AVX-512).
+ */
+void siphash_lanes(const uint64_t *msg, unsigned int nwords,
+        const siphash_key_t *key, uint64_t *out)
+{
+    uint64_t v0[SIPHASH_LANES], v1[SIPHASH_LANES];
+    uint64_t v2[SIPHASH_LANES], v3[SIPHASH_LANES];
+    const uint64_t b = ((uint64_t)nwords * sizeof(uint64_t)) << 56;
+    unsigned int i;
+    int l;
+
+    for (l = 0; l < SIPHASH_LANES; l++) {
+        v0[l] = 0x736f6d6570736575ULL ^ key->key[0];
+        v1[l] = 0x646f72616e646f6dULL ^ key->key[1];
+        v2[l] = 0x6c7967656e657261ULL ^ key->key[0];
+        v3[l] = 0x7465646279746573ULL ^ key->key[1];
+    }
+
+    for (i = 0; i < nwords; i++, msg += SIPHASH_LANES) {
+        for (l = 0; l < SIPHASH_LANES; l++)
+            v3[l] ^= rte_le_to_cpu_64(msg[l]);
+        sipround_lanes(v0, v1, v2, v3);
+        sipround_lanes(v0, v1, v2, v3);
+        for (l = 0; l < SIPHASH_LANES; l++)
+            v0[l] ^= rte_le_to_cpu_64(msg[l]);
+    }
+
+    for (l = 0; l < SIPHASH_LANES; l++)
+        v3[l] ^= b;
+    sipround_lanes(v0, v1, v2, v3);
+    sipround_lanes(v0, v1, v2, v3);
+    for (l = 0; l < SIPHASH_LANES; l++) {
+        v0[l] ^= b;
+        v2[l] ^= 0xff;
+    }
+    sipround_lanes(v0, v1, v2, v3);
+    sipround_lanes(v0, v1, v2, v3);
+    sipround_lanes(v0, v1, v2, v3);
+    sipround_lanes(v0, v1, v2, v3);
+
+    for (l = 0; l < SIPHASH_LANES; l++)
+        out[l] = (v0[l] ^ v1[l]) ^ (v2[l] ^ v3[l]);
+}
+
+#if __BITS_PER_LONG == 64
+
 /* Note that on 64-bit, we make HalfSipHash1-3 actually be SipHash1-3, for
  * performance reasons. On 32-bit, below, we actually implement HalfSipHash1-3.
  */
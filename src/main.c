@@ -47,6 +47,7 @@
 #include "eal_mem.h"
 #include "scheduler.h"
 #include "pdump.h"
+#include "capture.h"
 
 #define DPVS    "dpvs"
 #define RTE_LOGTYPE_DPVS RTE_LOGTYPE_USER1
@@ -107,6 +108,8 @@ static void inline dpdk_version_check(void)
                     netif_ctrl_init,     netif_ctrl_term),      \
         DPVS_MODULE(MODULE_IFTRAF,      "iftraf",               \
                     iftraf_init,         iftraf_term),          \
+        DPVS_MODULE(MODULE_CAPTURE,     "capture",              \
+                    capture_init,        capture_term),         \
         DPVS_MODULE(MODULE_LAST,        "iftraf",               \
                     eal_mem_init,        eal_mem_term)          \
     }
@@ -33,6 +33,8 @@
 #define MBUF_DYNFIELDS_MAX   8
 static int mbuf_dynfields_offset[MBUF_DYNFIELDS_MAX];
 
+uint64_t mbuf_frag_flag;
+
 void *mbuf_userdata(struct rte_mbuf *mbuf, mbuf_usedata_field_t field)
 {
     return (void *)mbuf + mbuf_dynfields_offset[field];
@@ -206,6 +208,14 @@ int mbuf_init(void)
             .size = sizeof(mbuf_userdata_field_route_t),
             .align = 8,
         },
+        [ MBUF_FIELD_FRAG ] = {
+            .name = "frag_size",
+            .size = sizeof(mbuf_userdata_field_frag_t),
+            .align = 2,
+        },
+    };
+    const struct rte_mbuf_dynflag rte_mbuf_frag_flag = {
+        .name = "reassembled",
     };
 
     for (i = 0; i < NELEMS(rte_mbuf_userdata_fields); i++) {
@@ -219,5 +229,12 @@ int mbuf_init(void)
         mbuf_dynfields_offset[i] = offset;
     }
 
+    offset = rte_mbuf_dynflag_register(&rte_mbuf_frag_flag);
+    if (offset < 0) {
+        RTE_LOG(ERR, MBUF, "fail to register dynflag in mbuf!\n");
+        return EDPVS_NOROOM;
+    }
+    mbuf_frag_flag = 1ULL << offset;
+
     return EDPVS_OK;
 }
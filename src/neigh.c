@@ -253,6 +253,14 @@ static inline bool neigh_key_cmp(int af, const struct neighbour_entry *neighbour
            (neighbour->af == af);
 }
 
+/* free a removed entry, or leave it to the last neigh_put() if it's held */
+static void neigh_entry_release(struct neighbour_entry *neighbour)
+{
+    neighbour->gen++;
+    if (neighbour->refcnt == 0)
+        dpvs_mempool_put(neigh_mempool, neighbour);
+}
+
 static int neigh_entry_expire(struct neighbour_entry *neighbour)
 {
     struct neighbour_mbuf_entry *mbuf, *mbuf_next;
@@ -278,7 +286,7 @@ static int neigh_entry_expire(struct neighbour_entry *neighbour)
         dpvs_mempool_put(neigh_mempool, mbuf);
     }
 
-    dpvs_mempool_put(neigh_mempool, neighbour);
+    neigh_entry_release(neighbour);
     neigh_nums[cid]--;
 
     return DTIMER_STOP;
@@ -381,6 +389,8 @@ struct neighbour_entry *neigh_add_table(int af, const union inet_addr *ipaddr,
 
     new_neighbour->port = port;
     new_neighbour->que_num = 0;
+    new_neighbour->refcnt = 0;
+    new_neighbour->gen = 0;
     delay.tv_sec = nud_timeouts[new_neighbour->state];
     delay.tv_usec = 0;
 
@@ -466,6 +476,46 @@ void neigh_confirm(int af, union inet_addr *nexthop, struct netif_port *port)
     }
 }
 
+struct neighbour_entry *neigh_hold(int af, const union inet_addr *nexthop,
+                                   struct netif_port *port, uint32_t *gen)
+{
+    struct neighbour_entry *neighbour;
+
+    if (port->flag & NETIF_PORT_FLAG_NO_ARP)
+        return NULL;
+
+    neighbour = neigh_lookup_entry(af, nexthop, port,
+                                   neigh_hashkey(af, nexthop, port));
+    if (!neighbour)
+        return NULL;
+
+    /* not resolved yet, neigh_output() is on it */
+    if (neighbour->state != DPVS_NUD_S_REACHABLE &&
+        neighbour->state != DPVS_NUD_S_PROBE &&
+        neighbour->state != DPVS_NUD_S_DELAY)
+        return NULL;
+
+    neighbour->refcnt++;
+    *gen = neighbour->gen;
+    return neighbour;
+}
+
+void neigh_put(struct neighbour_entry *neighbour)
+{
+    assert(neighbour->refcnt > 0);
+
+    /* unhashed, by neigh_entry_release() */
+    if (--neighbour->refcnt == 0 && !(neighbour->flag & NEIGHBOUR_HASHED))
+        dpvs_mempool_put(neigh_mempool, neighbour);
+}
+
+void neigh_confirm_held(struct neighbour_entry *neighbour, uint32_t gen)
+{
+    if (neigh_held_valid(neighbour, gen) &&
+        !(neighbour->flag & NEIGHBOUR_STATIC))
+        neigh_entry_state_trans(neighbour, 2);
+}
+
 static void neigh_state_confirm(struct neighbour_entry *neighbour)
 {
     union inet_addr saddr, daddr;
@@ -853,7 +903,7 @@ static void neigh_process_ring(void *arg)
                        rte_pktmbuf_free(mbuf->m);
                        dpvs_mempool_put(neigh_mempool, mbuf);
                    }
-                   dpvs_mempool_put(neigh_mempool, neigh);
+                   neigh_entry_release(neigh);
                    neigh_nums[cid]--;
                } else {
                    RTE_LOG(WARNING, NEIGHBOUR, "%s: not exist\n", __func__);
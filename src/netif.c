@@ -39,6 +39,7 @@
 #include "neigh.h"
 #include "scheduler.h"
 #include "netif_flow.h"
+#include "capture.h"
 
 #include <rte_arp.h>
 #include <netinet/in.h>
@@ -66,7 +67,6 @@ int netif_pktpool_mbuf_cache = NETIF_PKTPOOL_MBUF_CACHE_DEF;
 #define NETIF_NB_TX_DESC_MIN    16
 #define NETIF_NB_TX_DESC_MAX    8192
 
-#define NETIF_PKT_PREFETCH_OFFSET   3
 #define NETIF_ISOL_RXQ_RING_SZ_DEF  1048576 // 1M bytes
 
 #define ARP_RING_SIZE 2048
@@ -1084,6 +1084,28 @@ int netif_register_pkt(struct pkt_type *pt)
     return EDPVS_OK;
 }
 
+static const struct netif_burst_ops *netif_burst_ops;
+
+int netif_register_burst_ops(const struct netif_burst_ops *ops)
+{
+    if (unlikely(!ops || !ops->prepare || !ops->select))
+        return EDPVS_INVAL;
+    if (netif_burst_ops)
+        return EDPVS_EXIST;
+
+    netif_burst_ops = ops;
+    return EDPVS_OK;
+}
+
+int netif_unregister_burst_ops(const struct netif_burst_ops *ops)
+{
+    if (netif_burst_ops != ops)
+        return EDPVS_NOTEXIST;
+
+    netif_burst_ops = NULL;
+    return EDPVS_OK;
+}
+
 int netif_unregister_pkt(struct pkt_type *pt)
 {
     struct pkt_type *cur;
@@ -2029,6 +2051,8 @@ static inline void netif_tx_burst(lcoreid_t cid, portid_t pid, queueid_t qindex)
                 kni_ingress(mbuf_copied, dev);
         }
     }
+    if (dev)
+        netif_capture(dev, txq->mbufs, txq->len, CAPTURE_DIR_TX);
 
     ntx = rte_eth_tx_burst(pid, txq->id, txq->mbufs, txq->len);
     lcore_stats[cid].opackets += ntx;
@@ -2296,6 +2320,9 @@ static int netif_deliver_mbuf(struct netif_port *dev, lcoreid_t cid,
         else
             RTE_LOG(WARNING, NETIF, "%s: failed to copy mbuf for kni\n", __func__);
     }
+    /* packets from the ring were captured by the lcore that received them */
+    if (!pkts_from_ring)
+        netif_capture(dev, &mbuf, 1, CAPTURE_DIR_RX);
 
     if (!pkts_from_ring && (dev->flag & NETIF_PORT_FLAG_TC_INGRESS)) {
         mbuf = tc_hook(netif_tc(dev), mbuf, TC_HOOK_INGRESS, &ret);
@@ -2429,16 +2456,23 @@ static int netif_arp_ring_init(void)
 void lcore_process_packets(struct rte_mbuf **mbufs, lcoreid_t cid, uint16_t count, bool pkts_from_ring)
 {
     int i, t;
+    const struct netif_burst_ops *bops = netif_burst_ops;
 
     /* prefetch packets */
     for (t = 0; t < count && t < NETIF_PKT_PREFETCH_OFFSET; t++)
         rte_prefetch0(rte_pktmbuf_mtod(mbufs[t], void *));
 
+    if (bops)
+        bops->prepare(mbufs, count);
+
     /* L2 filter */
     for (i = 0; i < count; i++) {
         struct rte_mbuf *mbuf = mbufs[i];
         struct netif_port *dev = netif_port_get(mbuf->port);
 
+        if (bops)
+            bops->select(i);
+
         if (unlikely(!dev)) {
             rte_pktmbuf_free(mbuf);
             lcore_stats[cid].dropped++;
@@ -2457,6 +2491,9 @@ void lcore_process_packets(struct rte_mbuf **mbufs, lcoreid_t cid, uint16_t coun
         /* handler should free mbuf */
         netif_deliver_mbuf(dev, cid, mbuf, pkts_from_ring);
     }
+
+    if (bops)
+        bops->select(NETIF_MAX_PKT_BURST);
 }
 
 static void lcore_process_arp_ring(lcoreid_t cid)
@@ -4244,6 +4281,7 @@ static int get_lcore_stats(lcoreid_t cid, void **out, size_t *out_len)
 
     netif_lcore_stats_get_t *get;
     struct netif_lcore_stats stats;
+    struct dpvs_timer_stats tstats;
 
     get = rte_zmalloc(NULL, sizeof(struct netif_lcore_stats_get),
             RTE_CACHE_LINE_SIZE);
@@ -4292,6 +4330,14 @@ static int get_lcore_stats(lcoreid_t cid, void **out, size_t *out_len)
     get->obytes = stats.obytes;
     get->dropped = stats.dropped;
 
+    if (dpvs_timer_stats_get(cid, &tstats) == EDPVS_OK) {
+        get->timer_expired = tstats.expired;
+        get->timer_cascaded = tstats.cascaded;
+        get->timer_deferred = tstats.deferred;
+        get->timer_backlog = tstats.backlog;
+        get->timer_max_latency = tstats.max_latency;
+    }
+
     *out = get;
     *out_len = sizeof(netif_lcore_stats_get_t);
 
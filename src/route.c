@@ -17,9 +17,11 @@
  */
 #include <string.h>
 #include <assert.h>
+#include <rte_lpm.h>
 #include "route.h"
 #include "conf/route.h"
 #include "ctrl.h"
+#include "parser/parser.h"
 
 
 #define RTE_LOGTYPE_ROUTE       RTE_LOGTYPE_USER1
@@ -28,11 +30,18 @@
 #define NET_ROUTE_TAB_SIZE      8
 #define NET_ROUTE_TAB_MASK      (NET_ROUTE_TAB_SIZE - 1)
 
+#define ROUTE_LPM_MAX_RULES_DEF     (1 << 16)
+#define ROUTE_LPM_NUM_TBL8S_DEF     (1 << 12)
+#define ROUTE_LPM_MAX_RULES_MIN     16
+#define ROUTE_LPM_MAX_RULES_MAX     (1 << 24)   /* rte_lpm next hop is 24 bits */
+
 #define this_route_lcore        (RTE_PER_LCORE(route_lcore))
 
 #define this_local_route_table  (this_route_lcore.local_route_table)
 #define this_net_route_table    (this_route_lcore.net_route_table)
 #define this_gfw_route_table    (this_route_lcore.gfw_route_table)
+#define this_net_route_fib      (this_route_lcore.net_route_fib)
+#define this_gfw_route_fib      (this_route_lcore.gfw_route_fib)
 
 #define this_num_routes         (RTE_PER_LCORE(num_routes))
 #define this_num_out_routes         (RTE_PER_LCORE(num_out_routes))
@@ -41,12 +50,40 @@
  * use per-lcore structure for lockless
  * to improve performance.
  */
+/*
+ * LPM (DIR-24-8) FIB for net routes. the lists above stay the authority
+ * for configuration and dumping, the FIB only answers data plane lookups.
+ *
+ * rte_lpm keeps a 24-bit next hop per prefix, so it indexes @entries where
+ * the route_entry lives. routes sharing a prefix (on different ports) share
+ * one index, it points to the first of them in list order, which is what
+ * the list scan used to return. rte_lpm has no /0 rule, default routes are
+ * kept aside in @dflt.
+ *
+ * a rte_lpm costs 64MB of hugepages for its tbl24 whatever the number of
+ * rules, so it's created with the first prefix of the table on the lcore,
+ * and freed with the last one. the outwall (gfw) table is mostly empty.
+ */
+struct route_fib {
+    const char          *tag;
+    struct rte_lpm      *lpm;
+    struct route_entry  *dflt;
+    uint32_t            num;        /* used entries */
+    uint32_t            cursor;     /* latest used index, for fast search */
+    struct route_entry  **entries;
+};
+
 struct route_lcore {
     struct list_head local_route_table[LOCAL_ROUTE_TAB_SIZE];
     struct list_head net_route_table;
     struct list_head gfw_route_table;
+    struct route_fib net_route_fib;
+    struct route_fib gfw_route_fib;
 };
 
+static uint32_t g_route_lpm_max_rules = ROUTE_LPM_MAX_RULES_DEF;
+static uint32_t g_route_lpm_num_tbl8s = ROUTE_LPM_NUM_TBL8S_DEF;
+
 static RTE_DEFINE_PER_LCORE(struct route_lcore, route_lcore);
 static RTE_DEFINE_PER_LCORE(rte_atomic32_t, num_routes);
 static RTE_DEFINE_PER_LCORE(rte_atomic32_t, num_out_routes);
@@ -117,15 +154,201 @@ static struct route_entry *route_new_entry(struct in_addr* dest,
 
 }
 
+static void route_fib_init(struct route_fib *fib, const char *tag)
+{
+    memset(fib, 0, sizeof(*fib));
+    fib->tag = tag;
+}
+
+static int route_fib_create(struct route_fib *fib)
+{
+    char name[64];
+    lcoreid_t cid = rte_lcore_id();
+    int socket_id = rte_socket_id();
+    struct rte_lpm_config config = {
+        .max_rules      = g_route_lpm_max_rules,
+        .number_tbl8s   = g_route_lpm_num_tbl8s,
+        .flags          = 0,
+    };
+
+    fib->entries = rte_zmalloc_socket("route_fib_entries",
+                        sizeof(struct route_entry *) * g_route_lpm_max_rules,
+                        RTE_CACHE_LINE_SIZE, socket_id);
+    if (!fib->entries)
+        return EDPVS_NOMEM;
+
+    snprintf(name, sizeof(name), "route_%s_lcore%d", fib->tag, cid);
+    fib->lpm = rte_lpm_create(name, socket_id, &config);
+    if (!fib->lpm) {
+        RTE_LOG(ERR, ROUTE, "%s: fail to create lpm %s on socket%d -- %s\n",
+                __func__, name, socket_id, rte_strerror(rte_errno));
+        rte_free(fib->entries);
+        fib->entries = NULL;
+        return EDPVS_DPDKAPIFAIL;
+    }
+
+    return EDPVS_OK;
+}
+
+/* free the LPM, default routes stay */
+static void route_fib_release(struct route_fib *fib)
+{
+    if (fib->lpm)
+        rte_lpm_free(fib->lpm);
+    if (fib->entries)
+        rte_free(fib->entries);
+    fib->lpm = NULL;
+    fib->entries = NULL;
+    fib->num = 0;
+    fib->cursor = 0;
+}
+
+static void route_fib_destroy(struct route_fib *fib)
+{
+    route_fib_release(fib);
+    fib->dflt = NULL;
+}
+
+static int route_fib_find_free_idx(const struct route_fib *fib, uint32_t *idx)
+{
+    uint32_t i;
+
+    if (fib->num >= g_route_lpm_max_rules)
+        return EDPVS_NOROOM;
+
+    for (i = (fib->cursor + 1) % g_route_lpm_max_rules; i != fib->cursor;
+            i = (i + 1) % g_route_lpm_max_rules) {
+        if (!fib->entries[i]) {
+            *idx = i;
+            return EDPVS_OK;
+        }
+    }
+
+    /* the cursor itself may be free after a deletion */
+    if (!fib->entries[fib->cursor]) {
+        *idx = fib->cursor;
+        return EDPVS_OK;
+    }
+
+    return EDPVS_NOROOM;
+}
+
+/* make @route reachable by lookups unless its prefix is served already */
+static int route_fib_add(struct route_fib *fib, struct route_entry *route)
+{
+    int err;
+    uint32_t idx, nh;
+    uint32_t ip = rte_be_to_cpu_32(route->dest.s_addr);
+
+    route->lpm_idx = ROUTE_LPM_IDX_NONE;
+
+    if (route->netmask == 0) {
+        if (!fib->dflt)
+            fib->dflt = route;
+        return EDPVS_OK;
+    }
+
+    if (!fib->lpm) {
+        err = route_fib_create(fib);
+        if (err != EDPVS_OK)
+            return err;
+    }
+
+    if (rte_lpm_is_rule_present(fib->lpm, ip, route->netmask, &nh) == 1)
+        return EDPVS_OK;
+
+    err = route_fib_find_free_idx(fib, &idx);
+    if (err != EDPVS_OK)
+        goto errout;
+
+    if (rte_lpm_add(fib->lpm, ip, route->netmask, idx) < 0) {
+        err = EDPVS_NOROOM;
+        goto errout;
+    }
+
+    fib->entries[idx] = route;
+    fib->cursor = idx;
+    fib->num++;
+    route->lpm_idx = idx;
+
+    return EDPVS_OK;
+
+errout:
+    if (!fib->num)
+        route_fib_release(fib);
+    return err;
+}
+
+/*
+ * called before @route is unlinked from @table. if @route is the one serving
+ * its prefix, hand the prefix over to the next route with the same prefix,
+ * or withdraw it from LPM.
+ */
+static void route_fib_del(struct route_fib *fib, struct list_head *table,
+                          struct route_entry *route)
+{
+    struct route_entry *next = NULL, *node;
+
+    if (route->netmask == 0) {
+        if (fib->dflt != route)
+            return;
+    } else {
+        if (route->lpm_idx == ROUTE_LPM_IDX_NONE
+                || fib->entries[route->lpm_idx] != route)
+            return;
+    }
+
+    list_for_each_entry(node, table, list) {
+        if (node != route && node->netmask == route->netmask
+                && ip_addr_netcmp(node->dest.s_addr, node->netmask, route)) {
+            next = node;
+            break;
+        }
+    }
+
+    if (route->netmask == 0) {
+        fib->dflt = next;
+        return;
+    }
+
+    if (next) {
+        next->lpm_idx = route->lpm_idx;
+        fib->entries[route->lpm_idx] = next;
+    } else {
+        rte_lpm_delete(fib->lpm, rte_be_to_cpu_32(route->dest.s_addr),
+                       route->netmask);
+        fib->entries[route->lpm_idx] = NULL;
+        if (--fib->num == 0)
+            route_fib_release(fib);
+    }
+    route->lpm_idx = ROUTE_LPM_IDX_NONE;
+}
+
+static inline struct route_entry *route_fib_lookup(const struct route_fib *fib,
+                                                   uint32_t dest)
+{
+    uint32_t idx;
+
+    if (fib->lpm && rte_lpm_lookup(fib->lpm, rte_be_to_cpu_32(dest), &idx) == 0)
+        return fib->entries[idx];
+
+    return fib->dflt;
+}
+
 static int route_net_add(struct in_addr *dest, uint8_t netmask, uint32_t flag,
                          struct in_addr *gw, struct netif_port *port,
                          struct in_addr *src, unsigned long mtu,short metric)
 {
+    int err;
     struct route_entry *route_node, *route;
     struct list_head *route_table = &this_net_route_table;
+    struct list_head *pos = route_table;
+    struct route_fib *fib = &this_net_route_fib;
 
     if (flag & RTF_OUTWALL) {
         route_table = &this_gfw_route_table;
+        pos = route_table;
+        fib = &this_gfw_route_fib;
     }
 
     list_for_each_entry(route_node, route_table, list){
@@ -134,27 +357,24 @@ static int route_net_add(struct in_addr *dest, uint8_t netmask, uint32_t flag,
             return EDPVS_EXIST;
         }
         if (route_node->netmask < netmask){
-            route = route_new_entry(dest,netmask, flag,
-                                    gw, port, src, mtu, metric);
-            if (!route){
-                return EDPVS_NOMEM;
-            }
-            __list_add(&route->list, (&route_node->list)->prev,
-                       &route_node->list);
-            if (flag & RTF_OUTWALL)
-                rte_atomic32_inc(&this_num_out_routes);
-            else
-                rte_atomic32_inc(&this_num_routes);
-            rte_atomic32_inc(&route->refcnt);
-            return EDPVS_OK;
+            pos = &route_node->list;
+            break;
         }
     }
+
     route = route_new_entry(dest,netmask, flag,
                       gw, port, src, mtu, metric);
     if (!route){
         return EDPVS_NOMEM;
     }
-    list_add_tail(&route->list, route_table);
+
+    err = route_fib_add(fib, route);
+    if (err != EDPVS_OK) {
+        rte_free(route);
+        return err;
+    }
+
+    list_add_tail(&route->list, pos);
     if (flag & RTF_OUTWALL)
         rte_atomic32_inc(&this_num_out_routes);
     else
@@ -192,12 +412,14 @@ struct route_entry *route_out_local_lookup(uint32_t dest)
     return NULL;
 }
 
-static struct route_entry *route_net_lookup(struct netif_port *port,
+static struct route_entry *route_net_lookup(struct list_head *route_table,
+                                            struct netif_port *port,
                                             struct in_addr *dest, uint8_t netmask)
 {
     struct route_entry *route_node;
-    list_for_each_entry(route_node, &this_net_route_table, list){
-        if (net_cmp(port, dest->s_addr, netmask, route_node)){
+    list_for_each_entry(route_node, route_table, list){
+        if (net_cmp(port, dest->s_addr, netmask, route_node)
+                && (netmask == route_node->netmask)){
             rte_atomic32_inc(&route_node->refcnt);
             return route_node;
         }
@@ -209,37 +431,31 @@ static struct route_entry *route_in_net_lookup(const struct netif_port *port,
                                                const struct in_addr *dest)
 {
     struct route_entry *route_node;
-    list_for_each_entry(route_node, &this_net_route_table, list){
-        if (net_cmp(route_node->port, dest->s_addr, route_node->netmask, route_node)){
-            rte_atomic32_inc(&route_node->refcnt);
-            return route_node;
-        }
-    }
-    return NULL;
+
+    route_node = route_fib_lookup(&this_net_route_fib, dest->s_addr);
+    if (route_node)
+        rte_atomic32_inc(&route_node->refcnt);
+    return route_node;
 }
 
 static struct route_entry *route_out_net_lookup(const struct in_addr *dest)
 {
     struct route_entry *route_node;
-    list_for_each_entry(route_node, &this_net_route_table, list){
-        if (net_cmp(route_node->port, dest->s_addr, route_node->netmask, route_node)){
-            rte_atomic32_inc(&route_node->refcnt);
-            return route_node;
-        }
-    }
-    return NULL;
+
+    route_node = route_fib_lookup(&this_net_route_fib, dest->s_addr);
+    if (route_node)
+        rte_atomic32_inc(&route_node->refcnt);
+    return route_node;
 }
 
 struct route_entry *route_gfw_net_lookup(const struct in_addr *dest)
 {
     struct route_entry *route_node;
-    list_for_each_entry(route_node, &this_gfw_route_table, list){
-        if (net_cmp(route_node->port, dest->s_addr, route_node->netmask, route_node)){
-            rte_atomic32_inc(&route_node->refcnt);
-            return route_node;
-        }
-    }
-    return NULL;
+
+    route_node = route_fib_lookup(&this_gfw_route_fib, dest->s_addr);
+    if (route_node)
+        rte_atomic32_inc(&route_node->refcnt);
+    return route_node;
 }
 
 static int route_local_add(struct in_addr* dest, uint8_t netmask, uint32_t flag,
@@ -310,9 +526,10 @@ static int route_del_lcore(struct in_addr* dest,uint8_t netmask, uint32_t flag,
     }
 
     if (flag & RTF_OUTWALL) {
-        route = route_gfw_net_lookup(dest);
+        route = route_net_lookup(&this_gfw_route_table, port, dest, netmask);
         if (!route)
             return EDPVS_NOTEXIST;
+        route_fib_del(&this_gfw_route_fib, &this_gfw_route_table, route);
         list_del(&route->list);
         rte_atomic32_dec(&route->refcnt);
         rte_atomic32_dec(&this_num_out_routes);
@@ -321,9 +538,10 @@ static int route_del_lcore(struct in_addr* dest,uint8_t netmask, uint32_t flag,
     }
 
     if(flag & RTF_FORWARD || (flag & RTF_DEFAULT)){
-        route = route_net_lookup(port, dest, netmask);
+        route = route_net_lookup(&this_net_route_table, port, dest, netmask);
         if (!route)
             return EDPVS_NOTEXIST;
+        route_fib_del(&this_net_route_fib, &this_net_route_table, route);
         list_del(&route->list);
         rte_atomic32_dec(&route->refcnt);
         rte_atomic32_dec(&this_num_routes);
@@ -472,7 +690,7 @@ struct route_entry *route4_output(const struct flow4 *fl4)
 static int route_lcore_flush(void)
 {
     int i = 0;
-    struct route_entry *route_node;
+    struct route_entry *route_node, *next;
 
     for (i = 0; i < LOCAL_ROUTE_TAB_SIZE; i++){
         list_for_each_entry(route_node, &this_local_route_table[i], list){
@@ -482,17 +700,20 @@ static int route_lcore_flush(void)
         }
     }
 
-    list_for_each_entry(route_node, &this_net_route_table, list){
+    list_for_each_entry_safe(route_node, next, &this_net_route_table, list){
         list_del(&route_node->list);
         rte_atomic32_dec(&this_num_routes);
         route4_put(route_node);
     }
 
-    list_for_each_entry(route_node, &this_gfw_route_table, list){
+    list_for_each_entry_safe(route_node, next, &this_gfw_route_table, list){
         list_del(&route_node->list);
         rte_atomic32_dec(&this_num_out_routes);
         route4_put(route_node);
     }
+
+    route_fib_destroy(&this_net_route_fib);
+    route_fib_destroy(&this_gfw_route_fib);
     return EDPVS_OK;
 }
 
@@ -739,6 +960,9 @@ static int route_lcore_init(void *arg)
     INIT_LIST_HEAD(&this_net_route_table);
     INIT_LIST_HEAD(&this_gfw_route_table);
 
+    route_fib_init(&this_net_route_fib, "net");
+    route_fib_init(&this_gfw_route_fib, "gfw");
+
     return EDPVS_OK;
 }
 
@@ -816,3 +1040,60 @@ int route_term(void)
 
     return EDPVS_OK;
 }
+
+/* config file */
+static void route_lpm_max_rules_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t max_rules;
+
+    assert(str);
+    max_rules = atoi(str);
+    if (max_rules < ROUTE_LPM_MAX_RULES_MIN || max_rules > ROUTE_LPM_MAX_RULES_MAX) {
+        RTE_LOG(WARNING, ROUTE, "invalid route:lpm_max_rules %s, using default %d\n",
+                str, ROUTE_LPM_MAX_RULES_DEF);
+        g_route_lpm_max_rules = ROUTE_LPM_MAX_RULES_DEF;
+    } else {
+        RTE_LOG(INFO, ROUTE, "route:lpm_max_rules = %d\n", max_rules);
+        g_route_lpm_max_rules = max_rules;
+    }
+
+    FREE_PTR(str);
+}
+
+static void route_lpm_num_tbl8s_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    uint32_t num_tbl8s;
+
+    assert(str);
+    num_tbl8s = atoi(str);
+    if (num_tbl8s < 16 || num_tbl8s > (1 << 24)) {
+        RTE_LOG(WARNING, ROUTE, "invalid route:lpm_num_tbl8s %s, using default %d\n",
+                str, ROUTE_LPM_NUM_TBL8S_DEF);
+        g_route_lpm_num_tbl8s = ROUTE_LPM_NUM_TBL8S_DEF;
+    } else {
+        RTE_LOG(INFO, ROUTE, "route:lpm_num_tbl8s = %d\n", num_tbl8s);
+        g_route_lpm_num_tbl8s = num_tbl8s;
+    }
+
+    FREE_PTR(str);
+}
+
+void route_keyword_value_init(void)
+{
+    if (dpvs_state_get() == DPVS_STATE_INIT) {
+        /* KW_TYPE_INIT keyword */
+        g_route_lpm_max_rules = ROUTE_LPM_MAX_RULES_DEF;
+        g_route_lpm_num_tbl8s = ROUTE_LPM_NUM_TBL8S_DEF;
+    }
+}
+
+void install_route_keywords(void)
+{
+    install_keyword("route", NULL, KW_TYPE_INIT);
+    install_sublevel();
+    install_keyword("lpm_max_rules", route_lpm_max_rules_handler, KW_TYPE_INIT);
+    install_keyword("lpm_num_tbl8s", route_lpm_num_tbl8s_handler, KW_TYPE_INIT);
+    install_sublevel_end();
+}
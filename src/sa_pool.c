@@ -61,13 +61,13 @@
 #define SAPOOL
 #define RTE_LOGTYPE_SAPOOL  RTE_LOGTYPE_USER1
 
-#define SAPOOL_DEF_HASH_SZ  16
-#define SAPOOL_MIN_HASH_SZ  1
-#define SAPOOL_MAX_HASH_SZ  128
+#define SAPOOL_DEF_DEST_NUM     64
+#define SAPOOL_MIN_DEST_NUM     1
+#define SAPOOL_MAX_DEST_NUM     1024
 
-enum {
-    SA_F_USED               = 0x01,
-};
+/* seconds, TIME_WAIT of Linux RS */
+#define SAPOOL_DEF_REUSE_DELAY  60
+#define SAPOOL_MAX_REUSE_DELAY  3600
 
 struct sa_flow {
     /* the ports one lcore can use means
@@ -83,74 +83,134 @@ static struct sa_flow       sa_flows[DPVS_MAX_LCORE];
 static uint8_t              sa_nlcore;
 static uint64_t             sa_lcore_mask;
 
-static uint8_t              sa_pool_hash_size  = SAPOOL_DEF_HASH_SZ;
+static uint32_t             sa_pool_dest_num   = SAPOOL_DEF_DEST_NUM;
+static uint32_t             sa_port_reuse_delay = SAPOOL_DEF_REUSE_DELAY;
 static bool                 sapool_flow_enable = true;
 
-static int sa_pool_alloc_hash(struct sa_pool *ap, uint8_t hash_sz,
-                               const struct sa_flow *flow)
+static inline uint16_t sa_port(const struct sa_pool *ap, uint32_t idx)
+{
+    return (uint16_t)((idx << ap->shift) | ap->base);
+}
+
+static inline void sa_bit_set(struct sa_bitmap *bm, uint32_t idx)
 {
-    int hash;
-    struct sa_entry_pool *pool;
-    struct sa_entry * sep;
-    uint32_t port; /* should be u32 or 65535==0 */
-    uint32_t sa_entry_pool_size;
-    uint32_t sa_entry_size;
-    uint32_t sa_entry_num;
+    uint32_t w = idx >> 6;
 
-    sa_entry_num = MAX_PORT >> flow->shift;
-    sa_entry_pool_size = sizeof(struct sa_entry_pool) * hash_sz;
-    sa_entry_size = sizeof(struct sa_entry) * sa_entry_num * hash_sz;
+    bm->bits[w] |= 1ULL << (idx & 63);
+    if (bm->bits[w] == ~0ULL)
+        bm->full[w >> 6] |= 1ULL << (w & 63);
+}
 
-    ap->pool_hash = rte_malloc(NULL, sa_entry_pool_size + sa_entry_size,
-                               RTE_CACHE_LINE_SIZE);
-    if (!ap->pool_hash)
-        return EDPVS_NOMEM;
+static inline void sa_bit_clear(struct sa_bitmap *bm, uint32_t idx)
+{
+    uint32_t w = idx >> 6;
+
+    bm->bits[w] &= ~(1ULL << (idx & 63));
+    bm->full[w >> 6] &= ~(1ULL << (w & 63));
+}
+
+/* in use and not in TIME_WAIT, the port must be of [low, high] */
+static inline bool sa_bit_used(const struct sa_bitmap *bm, uint32_t idx)
+{
+    uint32_t w = idx >> 6;
 
-    ap->pool_hash_sz = hash_sz;
-    sep = (struct sa_entry *)&ap->pool_hash[hash_sz];
+    return (bm->bits[w] & ~(bm->tw[0][w] | bm->tw[1][w])
+            & (1ULL << (idx & 63))) != 0;
+}
 
-    /* the big loop may take tens of milliseconds */
-    for (hash = 0; hash < hash_sz; hash++) {
-        pool = &ap->pool_hash[hash];
+/* neither in use, in TIME_WAIT nor out of [low, high] */
+static inline bool sa_bit_free(const struct sa_bitmap *bm, uint32_t idx)
+{
+    return (bm->bits[idx >> 6] & (1ULL << (idx & 63))) == 0;
+}
 
-        INIT_LIST_HEAD(&pool->used_enties);
-        INIT_LIST_HEAD(&pool->free_enties);
+static void sa_bitmap_reset(const struct sa_pool *ap, struct sa_bitmap *bm)
+{
+    memcpy(bm->bits, ap->init_bits, sizeof(uint64_t) * ap->nwords);
+    memcpy(bm->full, ap->init_full, sizeof(bm->full));
+    memset(bm->tw[0], 0, sizeof(uint64_t) * ap->nwords);
+    memset(bm->tw[1], 0, sizeof(uint64_t) * ap->nwords);
+    bm->used_cnt = 0;
+    bm->tw_cnt[0] = bm->tw_cnt[1] = 0;
+    bm->tw_stamp = rte_get_timer_cycles();
+}
 
-        pool->used_cnt = 0;
-        pool->free_cnt = 0;
-        pool->shift = flow->shift;
-        pool->sa_entries = &sep[sa_entry_num * hash];
+static void sa_bitmap_setup(const struct sa_pool *ap, struct sa_bitmap *bm,
+                            uint64_t **words)
+{
+    bm->bits = *words;
+    bm->tw[0] = bm->bits + ap->nwords;
+    bm->tw[1] = bm->tw[0] + ap->nwords;
+    *words = bm->tw[1] + ap->nwords;
 
-        for (port = ap->low; port <= ap->high; port++) {
-            struct sa_entry *sa;
+    sa_bitmap_reset(ap, bm);
+}
 
-            if (flow->mask &&
-                ((uint16_t)port & flow->mask) != ntohs(flow->port_base))
-                continue;
+static int sa_pool_alloc_bitmaps(struct sa_pool *ap, uint32_t dest_num,
+                                 const struct sa_flow *flow)
+{
+    uint32_t i, w, idx, hash_sz;
+    uint16_t port;
+    uint64_t *words;
 
-            sa = &pool->sa_entries[(uint16_t)(port >> pool->shift)];
-            sa->addr = ap->ifa->addr;
-            sa->port = htons((uint16_t)port);
-            list_add_tail(&sa->list, &pool->free_enties);
-            pool->free_cnt++;
-        }
+    ap->shift = flow->shift;
+    ap->base = flow->mask ? ntohs(flow->port_base) : 0;
+    ap->nbits = MAX_PORT >> flow->shift;
+    ap->nwords = ap->nbits / 64;
+
+    for (hash_sz = 1; hash_sz < dest_num; hash_sz <<= 1)
+        ;
+
+    /* shared, per-dest and the initial bitmaps in one chunk */
+    ap->dests = rte_malloc(NULL, sizeof(struct sa_bitmap) * dest_num
+                           + sizeof(struct list_head) * hash_sz
+                           + sizeof(uint64_t) * ap->nwords * (3 * (dest_num + 1) + 1),
+                           RTE_CACHE_LINE_SIZE);
+    if (!ap->dests)
+        return EDPVS_NOMEM;
+
+    ap->dest_num = dest_num;
+    ap->dest_hash = (struct list_head *)&ap->dests[dest_num];
+    ap->dest_hash_mask = hash_sz - 1;
+    for (i = 0; i < hash_sz; i++)
+        INIT_LIST_HEAD(&ap->dest_hash[i]);
+    INIT_LIST_HEAD(&ap->dest_free);
+
+    /* ports out of [low, high] are never free */
+    words = (uint64_t *)&ap->dest_hash[hash_sz];
+    ap->init_bits = words;
+    words += ap->nwords;
+    memset(ap->init_bits, 0, sizeof(uint64_t) * ap->nwords);
+    ap->nports = 0;
+    for (idx = 0; idx < ap->nbits; idx++) {
+        port = sa_port(ap, idx);
+        if (port < ap->low || port > ap->high)
+            ap->init_bits[idx >> 6] |= 1ULL << (idx & 63);
+        else
+            ap->nports++;
+    }
+    memset(ap->init_full, 0, sizeof(ap->init_full));
+    for (w = 0; w < SA_BITMAP_WORDS; w++) {
+        if (w >= ap->nwords || ap->init_bits[w] == ~0ULL)
+            ap->init_full[w >> 6] |= 1ULL << (w & 63);
+    }
+
+    sa_bitmap_setup(ap, &ap->shared, &words);
+    for (i = 0; i < dest_num; i++) {
+        sa_bitmap_setup(ap, &ap->dests[i], &words);
+        list_add_tail(&ap->dests[i].list, &ap->dest_free);
     }
 
     return EDPVS_OK;
 }
 
-static int sa_pool_free_hash(struct sa_pool *ap)
+static int sa_pool_free_bitmaps(struct sa_pool *ap)
 {
-    /* FIXME: it may take about 3ms to free the huge `sa->pool_hash`, and
-     * @rte_free uses a spinlock to protect its heap. If multiple workers
-     * free their sapools simultaneously, a worker may be stuck up to 3*N ms,
-     * where `N` is the dpvs worker number.
-     *
-     * use mempool for sapool could solve the problem. we still use @rte_free
-     * here considering sapool is not frequently changed.
-     */
-    rte_free(ap->pool_hash);    /* it may take up to 3ms */
-    ap->pool_hash_sz = 0;
+    /* @rte_free uses a spinlock to protect its heap, it's fast enough
+     * since the bitmaps are in one small chunk. */
+    rte_free(ap->dests);
+    ap->dests = NULL;
+    ap->dest_num = 0;
     return EDPVS_OK;
 }
 
@@ -224,14 +284,14 @@ int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high)
     ap->flags = 0;
     rte_atomic32_set(&ap->refcnt, 1);
 
-    err = sa_pool_alloc_hash(ap, sa_pool_hash_size, &sa_flows[cid]);
+    err = sa_pool_alloc_bitmaps(ap, sa_pool_dest_num, &sa_flows[cid]);
     if (err != EDPVS_OK) {
         goto free_ap;
     }
 
     err = sa_pool_add_filter(ifa, ap, cid);
     if (err != EDPVS_OK) {
-        goto free_hash;
+        goto free_bitmaps;
     }
 
     ifa->sa_pool = ap;
@@ -249,8 +309,8 @@ int sa_pool_create(struct inet_ifaddr *ifa, uint16_t low, uint16_t high)
 
     return EDPVS_OK;
 
-free_hash:
-    sa_pool_free_hash(ap);
+free_bitmaps:
+    sa_pool_free_bitmaps(ap);
 free_ap:
     rte_free(ap);
     return err;
@@ -287,7 +347,7 @@ int sa_pool_destroy(struct inet_ifaddr *ifa)
         return err;
     }
 
-    sa_pool_free_hash(ap);
+    sa_pool_free_bitmaps(ap);
     rte_free(ap);
 
     ifa->sa_pool = NULL;
@@ -306,95 +366,262 @@ int sa_pool_destroy(struct inet_ifaddr *ifa)
     return EDPVS_OK;
 }
 
-/* hash dest's <ip/port>. if no dest provided, just use first pool. */
-static inline struct sa_entry_pool *
-sa_pool_hash(const struct sa_pool *ap, const struct sockaddr_storage *ss)
+static inline bool sa_dest_key(const struct sockaddr_storage *ss,
+                               union inet_addr *daddr, __be16 *dport)
 {
-    uint32_t hashkey;
-    assert(ap && ap->pool_hash && ap->pool_hash_sz >= 1);
     if (!ss)
-        return &ap->pool_hash[0];
+        return false;
 
     if (ss->ss_family == AF_INET) {
-        uint16_t vect[2];
         const struct sockaddr_in *sin = (const struct sockaddr_in *)ss;
 
-        vect[0] = ntohl(sin->sin_addr.s_addr) & 0xffff;
-        vect[1] = ntohs(sin->sin_port);
-        hashkey = (vect[0] + vect[1]) % ap->pool_hash_sz;
-
-        return &ap->pool_hash[hashkey];
+        daddr->in = sin->sin_addr;
+        *dport = sin->sin_port;
+        return true;
     } else if (ss->ss_family == AF_INET6) {
-        uint32_t vect[5] = { 0 };
         const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)ss;
 
-        vect[0] = sin6->sin6_port;
-        memcpy(&vect[1], &sin6->sin6_addr, 16);
-        hashkey = rte_jhash_32b(vect, 5, sin6->sin6_family) % ap->pool_hash_sz;
+        daddr->in6 = sin6->sin6_addr;
+        *dport = sin6->sin6_port;
+        return true;
+    }
+
+    return false;
+}
+
+static inline struct list_head *sa_dest_bucket(const struct sa_pool *ap,
+                                               const union inet_addr *daddr,
+                                               __be16 dport)
+{
+    uint32_t hash;
+
+    if (ap->ifa->af == AF_INET)
+        hash = rte_jhash_2words(daddr->in.s_addr, dport, 0);
+    else
+        hash = rte_jhash_32b((const uint32_t *)&daddr->in6, 4, dport);
+
+    return &ap->dest_hash[hash & ap->dest_hash_mask];
+}
+
+static struct sa_bitmap *sa_dest_lookup(const struct sa_pool *ap,
+                                        const union inet_addr *daddr,
+                                        __be16 dport)
+{
+    struct sa_bitmap *bm;
+
+    list_for_each_entry(bm, sa_dest_bucket(ap, daddr, dport), list) {
+        if (bm->dport == dport && inet_addr_equal(ap->ifa->af, &bm->daddr, daddr))
+            return bm;
+    }
 
-        return &ap->pool_hash[hashkey];
+    return NULL;
+}
+
+/* NULL if all per-dest bitmaps have ports in use */
+static struct sa_bitmap *sa_dest_get(struct sa_pool *ap,
+                                     const union inet_addr *daddr,
+                                     __be16 dport)
+{
+    uint32_t i;
+    struct sa_bitmap *bm;
+
+    bm = sa_dest_lookup(ap, daddr, dport);
+    if (bm)
+        return bm;
+
+    bm = list_first_entry_or_null(&ap->dest_free, struct sa_bitmap, list);
+    if (bm) {
+        sa_bitmap_reset(ap, bm);
     } else {
-        return NULL;
+        /* take over a dest with ports in TIME_WAIT only, which stay
+         * quarantined until their delay is over */
+        for (i = 0; i < ap->dest_num; i++) {
+            if (!ap->dests[i].used_cnt) {
+                bm = &ap->dests[i];
+                break;
+            }
+        }
+        if (!bm)
+            return NULL;
+    }
+
+    list_del(&bm->list);
+    bm->daddr = *daddr;
+    bm->dport = dport;
+    list_add(&bm->list, sa_dest_bucket(ap, daddr, dport));
+
+    return bm;
+}
+
+static void sa_bitmap_tw_rotate(const struct sa_pool *ap, struct sa_bitmap *bm)
+{
+    uint32_t w;
+    uint64_t *older = bm->tw[1];
+
+    if (bm->tw_cnt[1]) {
+        for (w = 0; w < ap->nwords; w++) {
+            if (!older[w])
+                continue;
+            bm->bits[w] &= ~older[w];
+            bm->full[w >> 6] &= ~(1ULL << (w & 63));
+            older[w] = 0;
+        }
+    }
+
+    bm->tw[1] = bm->tw[0];
+    bm->tw[0] = older;
+    bm->tw_cnt[1] = bm->tw_cnt[0];
+    bm->tw_cnt[0] = 0;
+    bm->tw_stamp = rte_get_timer_cycles();
+}
+
+static inline void sa_bitmap_tw_expire(const struct sa_pool *ap,
+                                       struct sa_bitmap *bm)
+{
+    if (rte_get_timer_cycles() - bm->tw_stamp
+            >= sa_port_reuse_delay * rte_get_timer_hz())
+        sa_bitmap_tw_rotate(ap, bm);
+}
+
+/* first free index of @bm from @start on, wrapping around. ports in use in
+ * @excl are skipped. it takes one word if @start's word has free ports,
+ * otherwise it walks the summary, no more than SA_SUMMARY_WORDS words. */
+static int sa_bitmap_find(const struct sa_pool *ap, const struct sa_bitmap *bm,
+                          const struct sa_bitmap *excl, uint32_t start)
+{
+    uint32_t i, w, cw, sw, nsum = (ap->nwords + 63) / 64;
+    uint64_t word, sum;
+
+    w = start >> 6;
+    word = ~(bm->bits[w] | (excl ? excl->bits[w] : 0)) & (~0ULL << (start & 63));
+    if (word)
+        return (w << 6) + __builtin_ctzll(word);
+
+    w = (w + 1) % ap->nwords;
+    for (i = 0; i <= nsum; i++) {
+        sw = w >> 6;
+        sum = ~bm->full[sw] & (~0ULL << (w & 63));
+        while (sum) {
+            cw = (sw << 6) + __builtin_ctzll(sum);
+            word = ~(bm->bits[cw] | (excl ? excl->bits[cw] : 0));
+            if (word)
+                return (cw << 6) + __builtin_ctzll(word);
+            sum &= sum - 1;
+        }
+        w = ((sw + 1) % nsum) << 6;
     }
+
+    return -1;
+}
+
+static int sa_bitmap_fetch(const struct sa_pool *ap, struct sa_bitmap *bm,
+                           const struct sa_bitmap *excl, uint32_t *pidx)
+{
+    int i, idx;
+
+    sa_bitmap_tw_expire(ap, bm);
+
+    /* randomized start makes lport hard to guess */
+    for (i = 0; ; i++) {
+        idx = sa_bitmap_find(ap, bm, excl, (uint32_t)rte_rand() & (ap->nbits - 1));
+        if (idx >= 0)
+            break;
+        /* rather reuse the ports released longest ago than fail */
+        if (i == 2 || !(bm->tw_cnt[0] + bm->tw_cnt[1]))
+            return EDPVS_RESOURCE;
+        sa_bitmap_tw_rotate(ap, bm);
+    }
+
+    sa_bit_set(bm, idx);
+    bm->used_cnt++;
+    *pidx = idx;
+
+    return EDPVS_OK;
 }
 
-static inline int sa_pool_fetch(struct sa_entry_pool *pool,
+static void sa_bitmap_release(const struct sa_pool *ap, struct sa_bitmap *bm,
+                              uint32_t idx)
+{
+    bm->used_cnt--;
+
+    if (!sa_port_reuse_delay) {
+        sa_bit_clear(bm, idx);
+        return;
+    }
+
+    bm->tw[0][idx >> 6] |= 1ULL << (idx & 63);
+    bm->tw_cnt[0]++;
+    sa_bitmap_tw_expire(ap, bm);
+}
+
+static inline int sa_pool_fetch(struct sa_pool *ap,
+                                const struct sockaddr_storage *daddr,
                                 struct sockaddr_storage *ss)
 {
-    assert(pool && ss);
+    assert(ap && ss);
 
-    struct sa_entry *ent;
+    int err = EDPVS_RESOURCE;
+    uint32_t idx;
+    __be16 dport;
+    union inet_addr dip;
+    struct sa_bitmap *bm = NULL;
     struct sockaddr_in *sin = (struct sockaddr_in *)ss;
     struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
 
-    ent = list_first_entry_or_null(&pool->free_enties, struct sa_entry, list);
-    if (!ent) {
+    if (ss->ss_family != AF_INET && ss->ss_family != AF_INET6)
+        return EDPVS_NOTSUPP;
+
+    if (sa_dest_key(daddr, &dip, &dport))
+        bm = sa_dest_get(ap, &dip, dport);
+
+    if (bm)
+        err = sa_bitmap_fetch(ap, bm, &ap->shared, &idx);
+    if (err != EDPVS_OK)
+        err = sa_bitmap_fetch(ap, &ap->shared, bm, &idx);
+    if (err != EDPVS_OK) {
 #ifdef CONFIG_DPVS_SAPOOL_DEBUG
-        RTE_LOG(DEBUG, SAPOOL, "%s: no entry (used/free %d/%d)\n", __func__,
-                pool->used_cnt, pool->free_cnt);
+        RTE_LOG(DEBUG, SAPOOL, "%s: no port (used %d/%d)\n", __func__,
+                bm ? bm->used_cnt : ap->shared.used_cnt, ap->nports);
 #endif
-        pool->miss_cnt++;
-        return EDPVS_RESOURCE;
+        ap->miss_cnt++;
+        return err;
     }
 
     if (ss->ss_family == AF_INET) {
         sin->sin_family = AF_INET;
-        sin->sin_addr.s_addr = ent->addr.in.s_addr;
-        sin->sin_port = ent->port;
-    } else if (ss->ss_family == AF_INET6) {
-        sin6->sin6_family = AF_INET6;
-        sin6->sin6_addr = ent->addr.in6;
-        sin6->sin6_port = ent->port;
+        sin->sin_addr.s_addr = ap->ifa->addr.in.s_addr;
+        sin->sin_port = htons(sa_port(ap, idx));
     } else {
-        return EDPVS_NOTSUPP;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_addr = ap->ifa->addr.in6;
+        sin6->sin6_port = htons(sa_port(ap, idx));
     }
 
-    ent->flags |= SA_F_USED;
-    list_move_tail(&ent->list, &pool->used_enties);
-    pool->used_cnt++;
-    pool->free_cnt--;
-
 #ifdef CONFIG_DPVS_SAPOOL_DEBUG
     {
         char addr[64];
         RTE_LOG(DEBUG, SAPOOL, "%s: %s:%d fetched!\n", __func__,
-                inet_ntop(ss->ss_family, &ent->addr, addr, sizeof(addr)) ? : NULL,
-                ntohs(ent->port));
+                inet_ntop(ss->ss_family, &ap->ifa->addr, addr, sizeof(addr)) ? : NULL,
+                sa_port(ap, idx));
     }
 #endif
 
     return EDPVS_OK;
 }
 
-static inline int sa_pool_release(struct sa_entry_pool *pool,
+static inline int sa_pool_release(struct sa_pool *ap,
+                                  const struct sockaddr_storage *daddr,
                                   const struct sockaddr_storage *ss)
 {
-    assert(pool && ss);
+    assert(ap && ss);
 
-    struct sa_entry *ent;
+    uint16_t port;
+    uint32_t idx;
+    __be16 dport;
+    union inet_addr dip;
+    struct sa_bitmap *bm = NULL;
     const struct sockaddr_in *sin = (const struct sockaddr_in *)ss;
     const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)ss;
-    __be16 port;
 
     if (ss->ss_family == AF_INET)
         port = ntohs(sin->sin_port);
@@ -402,41 +629,82 @@ static inline int sa_pool_release(struct sa_entry_pool *pool,
         port = ntohs(sin6->sin6_port);
     else
         return EDPVS_NOTSUPP;
-    assert(port > 0 && port < MAX_PORT);
 
-    /* it's too slow to traverse the used_enties list
-     * (by list_for_each_entry_safe) to find the @entry
-     * matchs @sin. */
-    ent = &pool->sa_entries[port >> pool->shift];
-    if (!(ent->flags & SA_F_USED)) {
+    if (port < ap->low || port > ap->high
+            || (port & ((1 << ap->shift) - 1)) != ap->base) {
+        RTE_LOG(WARNING, SAPOOL, "%s: port %d not of the pool !\n", __func__, port);
+        return EDPVS_INVAL;
+    }
+    idx = port >> ap->shift;
+
+    /* the dest's bitmap or the shared one, see struct sa_pool */
+    if (sa_dest_key(daddr, &dip, &dport))
+        bm = sa_dest_lookup(ap, &dip, dport);
+    if (!bm || !sa_bit_used(bm, idx))
+        bm = &ap->shared;
+    if (!sa_bit_used(bm, idx)) {
         RTE_LOG(WARNING, SAPOOL, "%s: port %d not in use !\n", __func__, port);
         return EDPVS_INVAL;
     }
 
-    if (ss->ss_family == AF_INET)
-        assert(ent->addr.in.s_addr == sin->sin_addr.s_addr &&
-                ent->port == sin->sin_port);
-    else
-        assert(ipv6_addr_equal(&ent->addr.in6, &sin6->sin6_addr) &&
-                ent->port == sin6->sin6_port);
+    sa_bitmap_release(ap, bm, idx);
 
-    ent->flags &= (~SA_F_USED);
-    list_move_tail(&ent->list, &pool->free_enties);
-    pool->used_cnt--;
-    pool->free_cnt++;
+    if (bm != &ap->shared && !bm->used_cnt && !bm->tw_cnt[0] && !bm->tw_cnt[1])
+        list_move(&bm->list, &ap->dest_free);
 
 #ifdef CONFIG_DPVS_SAPOOL_DEBUG
     {
         char addr[64];
         RTE_LOG(DEBUG, SAPOOL, "%s: %s:%d released!\n", __func__,
-                inet_ntop(ss->ss_family, &ent->addr, addr, sizeof(addr)) ? : NULL,
-                ntohs(ent->port));
+                inet_ntop(ss->ss_family, &ap->ifa->addr, addr, sizeof(addr)) ? : NULL,
+                port);
     }
 #endif
 
     return EDPVS_OK;
 }
 
+/* take the very port of @ss, where sa_pool_fetch() could have got it */
+static int sa_pool_claim(struct sa_pool *ap,
+                         const struct sockaddr_storage *daddr,
+                         const struct sockaddr_storage *ss)
+{
+    uint16_t port;
+    uint32_t idx;
+    __be16 dport;
+    union inet_addr dip;
+    struct sa_bitmap *bm = NULL;
+    const struct sockaddr_in *sin = (const struct sockaddr_in *)ss;
+    const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)ss;
+
+    if (ss->ss_family == AF_INET)
+        port = ntohs(sin->sin_port);
+    else if (ss->ss_family == AF_INET6)
+        port = ntohs(sin6->sin6_port);
+    else
+        return EDPVS_NOTSUPP;
+
+    /* the port of another lcore can't come back to this one */
+    if (port < ap->low || port > ap->high
+            || (port & ((1 << ap->shift) - 1)) != ap->base)
+        return EDPVS_INVAL;
+    idx = port >> ap->shift;
+
+    if (sa_dest_key(daddr, &dip, &dport))
+        bm = sa_dest_get(ap, &dip, dport);
+
+    /* free in both the dest's bitmap and the shared one, see sa_pool_fetch() */
+    if (!sa_bit_free(&ap->shared, idx) || (bm && !sa_bit_free(bm, idx)))
+        return EDPVS_BUSY;
+    if (!bm)
+        bm = &ap->shared;
+
+    sa_bit_set(bm, idx);
+    bm->used_cnt++;
+
+    return EDPVS_OK;
+}
+
 /*
  * fetch unused <saddr, sport> pair by given hint.
  * given @ap equivalent to @dev+@saddr, and dport is useless.
@@ -489,8 +757,8 @@ static int sa4_fetch(struct netif_port *dev,
             return EDPVS_INVAL;
         }
 
-        err = sa_pool_fetch(sa_pool_hash(ifa->sa_pool,
-                            (struct sockaddr_storage *)daddr),
+        err = sa_pool_fetch(ifa->sa_pool,
+                            (const struct sockaddr_storage *)daddr,
                             (struct sockaddr_storage *)saddr);
         if (err == EDPVS_OK)
             rte_atomic32_inc(&ifa->sa_pool->refcnt);
@@ -527,8 +795,8 @@ static int sa4_fetch(struct netif_port *dev,
     }
 
     /* do fetch socket address */
-    err = sa_pool_fetch(sa_pool_hash(ifa->sa_pool,
-                        (struct sockaddr_storage *)daddr),
+    err = sa_pool_fetch(ifa->sa_pool,
+                        (const struct sockaddr_storage *)daddr,
                         (struct sockaddr_storage *)saddr);
     if (err == EDPVS_OK)
         rte_atomic32_inc(&ifa->sa_pool->refcnt);
@@ -563,8 +831,8 @@ static int sa6_fetch(struct netif_port *dev,
             return EDPVS_INVAL;
         }
 
-        err = sa_pool_fetch(sa_pool_hash(ifa->sa_pool,
-                            (struct sockaddr_storage *)daddr),
+        err = sa_pool_fetch(ifa->sa_pool,
+                            (const struct sockaddr_storage *)daddr,
                             (struct sockaddr_storage *)saddr);
         if (err == EDPVS_OK)
             rte_atomic32_inc(&ifa->sa_pool->refcnt);
@@ -606,8 +874,8 @@ static int sa6_fetch(struct netif_port *dev,
     }
 
     /* do fetch socket address */
-    err = sa_pool_fetch(sa_pool_hash(ifa->sa_pool,
-                        (struct sockaddr_storage *)daddr),
+    err = sa_pool_fetch(ifa->sa_pool,
+                        (const struct sockaddr_storage *)daddr,
                         (struct sockaddr_storage *)saddr);
     if (err == EDPVS_OK)
         rte_atomic32_inc(&ifa->sa_pool->refcnt);
@@ -634,6 +902,41 @@ int sa_fetch(int af, struct netif_port *dev,
         return EDPVS_NOTSUPP;
 }
 
+int sa_claim(const struct netif_port *dev,
+             const struct sockaddr_storage *daddr,
+             const struct sockaddr_storage *saddr)
+{
+    struct inet_ifaddr *ifa;
+    int err;
+
+    if (!saddr || (daddr && saddr->ss_family != daddr->ss_family))
+        return EDPVS_INVAL;
+
+    if (AF_INET == saddr->ss_family)
+        ifa = inet_addr_ifa_get(AF_INET, dev,
+                (union inet_addr *)&((const struct sockaddr_in *)saddr)->sin_addr);
+    else if (AF_INET6 == saddr->ss_family)
+        ifa = inet_addr_ifa_get(AF_INET6, dev,
+                (union inet_addr *)&((const struct sockaddr_in6 *)saddr)->sin6_addr);
+    else
+        return EDPVS_NOTSUPP;
+
+    if (!ifa)
+        return EDPVS_NOTEXIST;
+
+    if (!ifa->sa_pool) {
+        inet_addr_ifa_put(ifa);
+        return EDPVS_INVAL;
+    }
+
+    err = sa_pool_claim(ifa->sa_pool, daddr, saddr);
+    if (err == EDPVS_OK)
+        rte_atomic32_inc(&ifa->sa_pool->refcnt);
+
+    inet_addr_ifa_put(ifa);
+    return err;
+}
+
 /* call me with @saddr must not NULL */
 int sa_release(const struct netif_port *dev,
                const struct sockaddr_storage *daddr,
@@ -676,7 +979,7 @@ int sa_release(const struct netif_port *dev,
         return EDPVS_INVAL;
     }
 
-    err = sa_pool_release(sa_pool_hash(ifa->sa_pool, daddr), saddr);
+    err = sa_pool_release(ifa->sa_pool, daddr, saddr);
     if (err != EDPVS_OK) {
         inet_addr_ifa_put(ifa);
         return err;
@@ -689,23 +992,62 @@ int sa_release(const struct netif_port *dev,
     return EDPVS_OK;
 }
 
+/* ports of @ap which can still be fetched toward <@daddr, @dport> */
+static uint32_t sa_pool_avail(const struct sa_pool *ap,
+                              const union inet_addr *daddr, __be16 dport)
+{
+    uint32_t held;
+    const struct sa_bitmap *bm;
+
+    /* the ports held in the shared bitmap are excluded for every dest, and
+     * those of the dest's own bitmap too, see sa_pool_fetch() */
+    held = ap->shared.used_cnt + ap->shared.tw_cnt[0] + ap->shared.tw_cnt[1];
+    bm = sa_dest_lookup(ap, daddr, dport);
+    if (bm)
+        held += bm->used_cnt + bm->tw_cnt[0] + bm->tw_cnt[1];
+
+    return held < ap->nports ? ap->nports - held : 0;
+}
+
+uint32_t sa_pool_free_ports(int af, struct netif_port *dev,
+                            const union inet_addr *saddr,
+                            const union inet_addr *daddr, __be16 dport)
+{
+    struct inet_ifaddr *ifa;
+
+    /* read only here, no need to hold @ifa */
+    ifa = inet_addr_ifa_peek(af, dev, saddr);
+    if (!ifa || !ifa->sa_pool)
+        return 0;
+
+    return sa_pool_avail(ifa->sa_pool, daddr, dport);
+}
+
 int get_sa_pool_stats(const struct inet_ifaddr *ifa, struct sa_pool_stats *stats)
 {
-    int hash;
-    struct sa_entry_pool *pool;
+    uint32_t i, nbitmaps = 1;
+    const struct sa_pool *ap;
+    const struct sa_bitmap *bm;
+    uint32_t held;
 
     if (!ifa || !ifa->sa_pool || !stats)
         return EDPVS_INVAL;
+    ap = ifa->sa_pool;
 
     memset(stats, 0, sizeof(*stats));
-    for (hash = 0; hash < ifa->sa_pool->pool_hash_sz; hash++) {
-        pool = &ifa->sa_pool->pool_hash[hash];
-        assert(pool);
-
-        stats->used_cnt += pool->used_cnt;
-        stats->free_cnt += pool->free_cnt;
-        stats->miss_cnt += pool->miss_cnt;
+    held = ap->shared.tw_cnt[0] + ap->shared.tw_cnt[1];
+    stats->used_cnt = ap->shared.used_cnt;
+    for (i = 0; i < ap->dest_num; i++) {
+        bm = &ap->dests[i];
+        if (!bm->used_cnt && !bm->tw_cnt[0] && !bm->tw_cnt[1])
+            continue;
+        nbitmaps++;
+        stats->used_cnt += bm->used_cnt;
+        held += bm->tw_cnt[0] + bm->tw_cnt[1];
     }
+    /* ports in TIME_WAIT are neither used nor free */
+    stats->free_cnt = ap->nports * nbitmaps - stats->used_cnt - held;
+    stats->miss_cnt = ap->miss_cnt;
 
     return EDPVS_OK;
 }
@@ -750,6 +1092,7 @@ int sa_pool_term(void)
 /*
  * config file
  */
+/* the number of per-dest port bitmaps of each laddr on each lcore */
 static void sa_pool_hash_size_handler(vector_t tokens)
 {
     char *str = set_value(tokens);
@@ -759,10 +1102,28 @@ static void sa_pool_hash_size_handler(vector_t tokens)
         return;
 
     size = atoi(str);
-    if (size < SAPOOL_MIN_HASH_SZ || size > SAPOOL_MAX_HASH_SZ) {
+    if (size < SAPOOL_MIN_DEST_NUM || size > SAPOOL_MAX_DEST_NUM) {
         RTE_LOG(WARNING, SAPOOL, "%s: invalid pool_hash_size\n", __func__);
     } else {
-        sa_pool_hash_size = size;
+        sa_pool_dest_num = size;
+    }
+
+    FREE_PTR(str);
+}
+
+static void sa_port_reuse_delay_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int delay;
+
+    if (!str)
+        return;
+
+    delay = atoi(str);
+    if (delay < 0 || delay > SAPOOL_MAX_REUSE_DELAY) {
+        RTE_LOG(WARNING, SAPOOL, "%s: invalid port_reuse_delay\n", __func__);
+    } else {
+        sa_port_reuse_delay = delay;
     }
 
     FREE_PTR(str);
@@ -789,5 +1150,6 @@ void install_sa_pool_keywords(void)
 {
     install_keyword_root("sa_pool", NULL);
     install_keyword("pool_hash_size", sa_pool_hash_size_handler, KW_TYPE_INIT);
+    install_keyword("port_reuse_delay", sa_port_reuse_delay_handler, KW_TYPE_INIT);
     install_keyword("flow_enable", sa_pool_flow_enable_handler, KW_TYPE_INIT);
 }
@@ -125,6 +125,8 @@ struct tc_cls *tc_cls_create(struct Qsch *sch, const char *kind,
     }
 
     sch->cls_cnt++;
+    tc_cls_prog_build(sch);
+
     *errp = EDPVS_OK;
     return cls;
 
@@ -142,6 +144,7 @@ void tc_cls_destroy(struct tc_cls *cls)
 
     list_del(&cls->list);
     sch->cls_cnt--;
+    tc_cls_prog_build(sch);
 
     if (ops->destroy)
         ops->destroy(cls);
@@ -151,10 +154,15 @@ void tc_cls_destroy(struct tc_cls *cls)
 
 int tc_cls_change(struct tc_cls *cls, const void *arg)
 {
+    int err;
+
     if (!cls->ops->change)
         return EDPVS_NOTSUPP;
 
-    return cls->ops->change(cls, arg);
+    err = cls->ops->change(cls, arg);
+    tc_cls_prog_build(cls->sch);
+
+    return err;
 }
 
 struct tc_cls *tc_cls_lookup(struct Qsch *sch, tc_handle_t handle)
@@ -58,25 +58,17 @@ static int match_classify(struct tc_cls *cls, struct rte_mbuf *mbuf,
     int offset = sizeof(*eh);
     __be16 pkt_type = eh->ether_type;
     __be16 sport, dport;
-    struct netif_port *idev, *odev;
+    struct netif_port *dev;
     struct vlan_ethhdr *veh;
     int err = TC_ACT_RECLASSIFY; /* by default */
 
-    idev = netif_port_get_by_name(m->iifname);
-    odev = netif_port_get_by_name(m->oifname);
     sport = dport = 0;
 
-    /* check input device for ingress */
-    if (idev && (cls->sch->flags & QSCH_F_INGRESS)) {
-        if (idev->id != mbuf->port)
-            goto done;
-    }
-
-    /* check output device for egress */
-    if (odev && !(cls->sch->flags & QSCH_F_INGRESS)) {
-        if (odev->id != mbuf->port)
-            goto done;
-    }
+    /* check input device for ingress, output device for egress */
+    dev = netif_port_get_by_name((cls->sch->flags & QSCH_F_INGRESS) ?
+                                 m->iifname : m->oifname);
+    if (dev && dev->id != mbuf->port)
+        goto done;
 
     /* support IPv4 and 802.1q/IPv4 */
 l2parse:
@@ -290,6 +282,30 @@ static int match_init(struct tc_cls *cls, const void *arg)
     return EDPVS_OK;
 }
 
+/*
+ * devices are resolved here once rather than per packet, so a classifier
+ * naming a device created later is to be set again. as match_classify(),
+ * a name not resolved matches any device.
+ */
+static int match_compile(struct tc_cls *cls, struct tc_cls_rule *rule)
+{
+    struct match_cls_priv *priv = tc_cls_priv(cls);
+    const struct dp_vs_match *m = &priv->match;
+    struct netif_port *dev;
+
+    dev = netif_port_get_by_name((cls->sch->flags & QSCH_F_INGRESS) ?
+                                 m->iifname : m->oifname);
+
+    rule->af = m->af;
+    rule->proto = priv->proto;
+    rule->port = dev ? dev->id : -1;
+    rule->srange = m->srange;
+    rule->drange = m->drange;
+    rule->result = priv->result;
+
+    return EDPVS_OK;
+}
+
 static int match_dump(struct tc_cls *cls, void *arg)
 {
     struct match_cls_priv *priv = tc_cls_priv(cls);
@@ -306,6 +322,7 @@ struct tc_cls_ops match_cls_ops = {
     .name       = "match",
     .priv_size  = sizeof(struct match_cls_priv),
     .classify   = match_classify,
+    .compile    = match_compile,
     .init       = match_init,
     .change     = match_init,
     .dump       = match_dump,
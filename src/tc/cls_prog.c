@@ -0,0 +1,615 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * compiled classifiers of a Qsch.
+ *
+ * the classifiers of a Qsch are compiled into rules numbered by priority,
+ * and each field a rule looks at becomes a dimension. an exact-value field
+ * (device, pkt_type, af, proto) keeps the sorted values rules ask for, a
+ * range field (addresses, ports) keeps the elementary intervals split by the
+ * bounds of all ranges. each value or interval has a bitmap of the rules it
+ * satisfies, wildcards included. a packet looks up each dimension by binary
+ * search and ANDs the bitmaps, the lowest bit left is the matched classifier,
+ * so the cost hardly grows with the number of classifiers.
+ *
+ * the packet is parsed once into a tc_cls_key{} for all Qsch on its way.
+ */
+#include <stdlib.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <linux/if_ether.h>
+#include "mbuf.h"
+#include "netif.h"
+#include "vlan.h"
+#include "ipv6.h"
+#include "linux_ipv6.h"
+#include "tc/tc.h"
+#include "tc/sch.h"
+#include "tc/cls.h"
+
+/* Qsch with more classifiers are left to the list walk */
+#define TC_CLS_PROG_RULES_MAX   256
+#define TC_CLS_PROG_WORDS       (TC_CLS_PROG_RULES_MAX / 64)
+
+/* host order, v4 addresses and ports in @lo only */
+struct cls_bound {
+    uint64_t                hi;
+    uint64_t                lo;
+};
+
+/* exact values, one bitmap per value and the last one for the others */
+struct cls_vdim {
+    uint32_t                nvals;
+    uint32_t                *vals;      /* sorted */
+    uint64_t                *bits;
+};
+
+/* elementary intervals, bitmap k for [bounds[k-1], bounds[k]), the first
+ * one for below bounds[0] */
+struct cls_idim {
+    uint32_t                nbounds;
+    struct cls_bound        *bounds;    /* sorted */
+    uint64_t                *bits;
+};
+
+enum {
+    CLS_VDIM_PORT,
+    CLS_VDIM_PKT_TYPE,
+    CLS_VDIM_AF,
+    CLS_VDIM_PROTO,
+    CLS_VDIM_MAX
+};
+
+enum {
+    CLS_IDIM_SADDR4,
+    CLS_IDIM_DADDR4,
+    CLS_IDIM_SADDR6,
+    CLS_IDIM_DADDR6,
+    CLS_IDIM_SPORT,
+    CLS_IDIM_DPORT,
+    CLS_IDIM_MAX
+};
+
+struct tc_cls_prog {
+    uint32_t                nrules;
+    uint32_t                nwords;
+    struct cls_vdim         vdims[CLS_VDIM_MAX];
+    struct cls_idim         idims[CLS_IDIM_MAX];
+    struct tc_cls_result    results[0]; /* by priority */
+};
+
+/* field of a rule on a dimension */
+struct cls_vspec {
+    bool                    any;
+    uint32_t                val;
+};
+
+struct cls_ispec {
+    bool                    any;
+    struct cls_bound        min;
+    struct cls_bound        max;
+};
+
+static inline int cls_bound_cmp(const struct cls_bound *a,
+                                const struct cls_bound *b)
+{
+    if (a->hi != b->hi)
+        return a->hi < b->hi ? -1 : 1;
+    if (a->lo != b->lo)
+        return a->lo < b->lo ? -1 : 1;
+    return 0;
+}
+
+static int cls_bound_qsort_cmp(const void *a, const void *b)
+{
+    return cls_bound_cmp(a, b);
+}
+
+static int cls_val_qsort_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static inline void cls_bound_from_in6(struct cls_bound *b,
+                                      const struct in6_addr *in6)
+{
+    uint64_t hi, lo;
+
+    memcpy(&hi, &in6->s6_addr[0], sizeof(hi));
+    memcpy(&lo, &in6->s6_addr[8], sizeof(lo));
+    b->hi = rte_be_to_cpu_64(hi);
+    b->lo = rte_be_to_cpu_64(lo);
+}
+
+static inline void cls_bound_from_u32(struct cls_bound *b, uint32_t v)
+{
+    b->hi = 0;
+    b->lo = v;
+}
+
+static inline void cls_bits_set(uint64_t *bits, uint32_t rule)
+{
+    bits[rule / 64] |= 1ULL << (rule % 64);
+}
+
+static void cls_vdim_free(struct cls_vdim *d)
+{
+    rte_free(d->vals);
+    rte_free(d->bits);
+}
+
+static void cls_idim_free(struct cls_idim *d)
+{
+    rte_free(d->bounds);
+    rte_free(d->bits);
+}
+
+static int cls_vdim_build(struct cls_vdim *d, const struct cls_vspec *specs,
+                          uint32_t nrules, uint32_t nwords)
+{
+    uint32_t i, k, n = 0;
+    uint32_t vals[TC_CLS_PROG_RULES_MAX];
+
+    for (i = 0; i < nrules; i++) {
+        if (!specs[i].any)
+            vals[n++] = specs[i].val;
+    }
+    qsort(vals, n, sizeof(vals[0]), cls_val_qsort_cmp);
+    for (i = 0, k = 0; i < n; i++) {
+        if (k == 0 || vals[k - 1] != vals[i])
+            vals[k++] = vals[i];
+    }
+
+    d->nvals = k;
+    d->vals = rte_malloc(NULL, sizeof(uint32_t) * (k ? k : 1), 0);
+    d->bits = rte_zmalloc(NULL, sizeof(uint64_t) * nwords * (k + 1), 0);
+    if (!d->vals || !d->bits)
+        return EDPVS_NOMEM;
+    memcpy(d->vals, vals, sizeof(uint32_t) * k);
+
+    for (i = 0; i < nrules; i++) {
+        for (k = 0; k <= d->nvals; k++) {
+            if (specs[i].any || (k < d->nvals && d->vals[k] == specs[i].val))
+                cls_bits_set(&d->bits[k * nwords], i);
+        }
+    }
+
+    return EDPVS_OK;
+}
+
+static int cls_idim_build(struct cls_idim *d, const struct cls_ispec *specs,
+                          uint32_t nrules, uint32_t nwords)
+{
+    uint32_t i, k, n = 0;
+    struct cls_bound start, bounds[TC_CLS_PROG_RULES_MAX * 2];
+
+    for (i = 0; i < nrules; i++) {
+        if (specs[i].any)
+            continue;
+        bounds[n++] = specs[i].min;
+        /* the interval after max, unless max is the top */
+        bounds[n] = specs[i].max;
+        if (++bounds[n].lo == 0)
+            bounds[n].hi++;
+        if (bounds[n].hi || bounds[n].lo)
+            n++;
+    }
+    qsort(bounds, n, sizeof(bounds[0]), cls_bound_qsort_cmp);
+    for (i = 0, k = 0; i < n; i++) {
+        if (k == 0 || cls_bound_cmp(&bounds[k - 1], &bounds[i]) != 0)
+            bounds[k++] = bounds[i];
+    }
+
+    d->nbounds = k;
+    d->bounds = rte_malloc(NULL, sizeof(struct cls_bound) * (k ? k : 1), 0);
+    d->bits = rte_zmalloc(NULL, sizeof(uint64_t) * nwords * (k + 1), 0);
+    if (!d->bounds || !d->bits)
+        return EDPVS_NOMEM;
+    memcpy(d->bounds, bounds, sizeof(struct cls_bound) * k);
+
+    /* elementary intervals are either in or out of a range */
+    for (k = 0; k <= d->nbounds; k++) {
+        if (k == 0)
+            cls_bound_from_u32(&start, 0);
+        else
+            start = d->bounds[k - 1];
+
+        for (i = 0; i < nrules; i++) {
+            if (specs[i].any ||
+                    (cls_bound_cmp(&start, &specs[i].min) >= 0 &&
+                     cls_bound_cmp(&start, &specs[i].max) <= 0))
+                cls_bits_set(&d->bits[k * nwords], i);
+        }
+    }
+
+    return EDPVS_OK;
+}
+
+static inline const uint64_t *cls_vdim_lookup(const struct cls_vdim *d,
+                                              uint32_t val, uint32_t nwords)
+{
+    uint32_t lo = 0, hi = d->nvals, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (d->vals[mid] == val)
+            return &d->bits[mid * nwords];
+        if (d->vals[mid] < val)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return &d->bits[d->nvals * nwords];
+}
+
+static inline const uint64_t *cls_idim_lookup(const struct cls_idim *d,
+                                              const struct cls_bound *v,
+                                              uint32_t nwords)
+{
+    uint32_t lo = 0, hi = d->nbounds, mid;
+
+    /* number of bounds <= @v */
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (cls_bound_cmp(&d->bounds[mid], v) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return &d->bits[lo * nwords];
+}
+
+static inline bool cls_bits_and(uint64_t *bits, const uint64_t *dim,
+                                uint32_t nwords)
+{
+    uint32_t w;
+    uint64_t any = 0;
+
+    for (w = 0; w < nwords; w++) {
+        bits[w] &= dim[w];
+        any |= bits[w];
+    }
+
+    return any != 0;
+}
+
+void tc_cls_prog_free(struct tc_cls_prog *prog)
+{
+    int i;
+
+    if (!prog)
+        return;
+
+    for (i = 0; i < CLS_VDIM_MAX; i++)
+        cls_vdim_free(&prog->vdims[i]);
+    for (i = 0; i < CLS_IDIM_MAX; i++)
+        cls_idim_free(&prog->idims[i]);
+
+    rte_free(prog);
+}
+
+static void cls_ispec_addr(struct cls_ispec *spec, int af,
+                           const struct inet_addr_range *range)
+{
+    if (af == AF_INET) {
+        spec->any = range->max_addr.in.s_addr == htonl(INADDR_ANY);
+        cls_bound_from_u32(&spec->min, ntohl(range->min_addr.in.s_addr));
+        cls_bound_from_u32(&spec->max, ntohl(range->max_addr.in.s_addr));
+    } else {
+        spec->any = ipv6_addr_any(&range->max_addr.in6);
+        cls_bound_from_in6(&spec->min, &range->min_addr.in6);
+        cls_bound_from_in6(&spec->max, &range->max_addr.in6);
+    }
+}
+
+static void cls_ispec_port(struct cls_ispec *spec,
+                           const struct inet_addr_range *range)
+{
+    spec->any = !range->max_port;
+    cls_bound_from_u32(&spec->min, ntohs(range->min_port));
+    cls_bound_from_u32(&spec->max, ntohs(range->max_port));
+}
+
+static struct tc_cls_prog *cls_prog_compile(const struct tc_cls_rule *rules,
+                                            uint32_t nrules)
+{
+    int d;
+    uint32_t i, nwords = (nrules + 63) / 64;
+    struct tc_cls_prog *prog;
+    struct cls_vspec vspecs[TC_CLS_PROG_RULES_MAX];
+    struct cls_ispec ispecs[TC_CLS_PROG_RULES_MAX];
+
+    prog = rte_zmalloc(NULL, sizeof(*prog) + nrules * sizeof(prog->results[0]),
+                       RTE_CACHE_LINE_SIZE);
+    if (!prog)
+        return NULL;
+    prog->nrules = nrules;
+    prog->nwords = nwords;
+
+    for (d = 0; d < CLS_VDIM_MAX; d++) {
+        for (i = 0; i < nrules; i++) {
+            switch (d) {
+            case CLS_VDIM_PORT:
+                vspecs[i].any = rules[i].port < 0;
+                vspecs[i].val = rules[i].port;
+                break;
+            case CLS_VDIM_PKT_TYPE:
+                vspecs[i].any = rules[i].pkt_type == htons(ETH_P_ALL);
+                vspecs[i].val = rules[i].pkt_type;
+                break;
+            case CLS_VDIM_AF:
+                vspecs[i].any = rules[i].af == AF_UNSPEC;
+                vspecs[i].val = rules[i].af;
+                break;
+            case CLS_VDIM_PROTO:
+                vspecs[i].any = !rules[i].proto;
+                vspecs[i].val = rules[i].proto;
+                break;
+            }
+        }
+        if (cls_vdim_build(&prog->vdims[d], vspecs, nrules, nwords) != EDPVS_OK)
+            goto errout;
+    }
+
+    for (d = 0; d < CLS_IDIM_MAX; d++) {
+        for (i = 0; i < nrules; i++) {
+            switch (d) {
+            case CLS_IDIM_SADDR4:
+                cls_ispec_addr(&ispecs[i], AF_INET, &rules[i].srange);
+                break;
+            case CLS_IDIM_DADDR4:
+                cls_ispec_addr(&ispecs[i], AF_INET, &rules[i].drange);
+                break;
+            case CLS_IDIM_SADDR6:
+                cls_ispec_addr(&ispecs[i], AF_INET6, &rules[i].srange);
+                break;
+            case CLS_IDIM_DADDR6:
+                cls_ispec_addr(&ispecs[i], AF_INET6, &rules[i].drange);
+                break;
+            case CLS_IDIM_SPORT:
+                cls_ispec_port(&ispecs[i], &rules[i].srange);
+                break;
+            case CLS_IDIM_DPORT:
+                cls_ispec_port(&ispecs[i], &rules[i].drange);
+                break;
+            }
+        }
+        if (cls_idim_build(&prog->idims[d], ispecs, nrules, nwords) != EDPVS_OK)
+            goto errout;
+    }
+
+    for (i = 0; i < nrules; i++)
+        prog->results[i] = rules[i].result;
+
+    return prog;
+
+errout:
+    tc_cls_prog_free(prog);
+    return NULL;
+}
+
+void tc_cls_prog_build(struct Qsch *sch)
+{
+    uint32_t n = 0;
+    struct tc_cls *cls;
+    struct tc_cls_rule *rules = NULL;
+
+    tc_cls_prog_free(sch->cls_prog);
+    sch->cls_prog = NULL;
+
+    if (!sch->cls_cnt || sch->cls_cnt > TC_CLS_PROG_RULES_MAX)
+        return;
+
+    rules = rte_zmalloc(NULL, sizeof(*rules) * sch->cls_cnt, 0);
+    if (!rules)
+        goto out;
+
+    /* cls_list is sorted by priority */
+    list_for_each_entry(cls, &sch->cls_list, list) {
+        if (!cls->ops->compile)
+            goto out;
+
+        rules[n].pkt_type = cls->pkt_type;
+        if (cls->ops->compile(cls, &rules[n]) != EDPVS_OK)
+            goto out;
+        n++;
+    }
+
+    sch->cls_prog = cls_prog_compile(rules, n);
+
+out:
+    if (!sch->cls_prog)
+        RTE_LOG(DEBUG, TC, "%s: classifiers of qsch %x not compiled\n",
+                __func__, sch->handle);
+    rte_free(rules);
+}
+
+static void tc_cls_key_parse(struct rte_mbuf *mbuf, struct tc_cls_key *key)
+{
+    struct rte_ether_hdr *eh = rte_pktmbuf_mtod(mbuf, struct rte_ether_hdr *);
+    struct vlan_ethhdr *veh;
+    struct iphdr *iph;
+    struct ip6_hdr *ip6h;
+    struct tcphdr *th;
+    struct udphdr *uh;
+    __be16 pkt_type = eh->ether_type;
+    int offset = sizeof(*eh);
+
+    key->flags |= TC_CLS_KEY_F_PARSED;
+
+l2parse:
+    switch (ntohs(pkt_type)) {
+    case ETH_P_IP:
+        key->af = AF_INET;
+        if (mbuf_may_pull(mbuf, offset + sizeof(struct iphdr)) != 0) {
+            key->flags |= TC_CLS_KEY_F_ERR_L3;
+            return;
+        }
+
+        iph = rte_pktmbuf_mtod_offset(mbuf, struct iphdr *, offset);
+        key->saddr.in.s_addr = iph->saddr;
+        key->daddr.in.s_addr = iph->daddr;
+        key->proto = iph->protocol;
+        offset += (iph->ihl << 2);
+        break;
+
+    case ETH_P_IPV6:
+        key->af = AF_INET6;
+        if (mbuf_may_pull(mbuf, offset + sizeof(struct ip6_hdr)) != 0) {
+            key->flags |= TC_CLS_KEY_F_ERR_L3;
+            return;
+        }
+
+        ip6h = rte_pktmbuf_mtod_offset(mbuf, struct ip6_hdr *, offset);
+        key->saddr.in6 = ip6h->ip6_src;
+        key->daddr.in6 = ip6h->ip6_dst;
+        key->proto = ip6h->ip6_nxt;
+        offset = ip6_skip_exthdr(mbuf, offset + sizeof(struct ip6_hdr),
+                                 &key->proto);
+        if (offset < 0) {
+            key->flags |= TC_CLS_KEY_F_ERR_EXTHDR;
+            return;
+        }
+        break;
+
+    case ETH_P_8021Q:
+        veh = (struct vlan_ethhdr *)eh;
+        pkt_type = veh->h_vlan_encapsulated_proto;
+        offset += VLAN_HLEN;
+        goto l2parse;
+
+    default:
+        return;
+    }
+
+    switch (key->proto) {
+    case IPPROTO_TCP:
+        if (mbuf_may_pull(mbuf, offset + sizeof(struct tcphdr)) != 0) {
+            key->flags |= TC_CLS_KEY_F_ERR_L4;
+            return;
+        }
+
+        th = rte_pktmbuf_mtod_offset(mbuf, struct tcphdr *, offset);
+        key->sport = ntohs(th->source);
+        key->dport = ntohs(th->dest);
+        key->flags |= TC_CLS_KEY_F_PORTS;
+        break;
+
+    case IPPROTO_UDP:
+        if (mbuf_may_pull(mbuf, offset + sizeof(struct udphdr)) != 0) {
+            key->flags |= TC_CLS_KEY_F_ERR_L4;
+            return;
+        }
+
+        uh = rte_pktmbuf_mtod_offset(mbuf, struct udphdr *, offset);
+        key->sport = ntohs(uh->source);
+        key->dport = ntohs(uh->dest);
+        key->flags |= TC_CLS_KEY_F_PORTS;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * the same verdicts as match_classify() walking the classifiers in order:
+ * a truncated header drops the packet if any classifier gets as far as it.
+ */
+int tc_cls_prog_classify(const struct tc_cls_prog *prog,
+                         struct rte_mbuf *mbuf, struct tc_cls_key *key,
+                         uint32_t *pos, struct tc_cls_result *result)
+{
+    uint32_t i, w, nwords = prog->nwords;
+    uint64_t word, bits[TC_CLS_PROG_WORDS];
+    struct cls_bound sv, dv;
+    int sdim, ddim;
+
+    if (!(key->flags & TC_CLS_KEY_F_PARSED))
+        tc_cls_key_parse(mbuf, key);
+
+    memcpy(bits, cls_vdim_lookup(&prog->vdims[CLS_VDIM_PORT], key->port, nwords),
+           sizeof(uint64_t) * nwords);
+    if (!cls_bits_and(bits, cls_vdim_lookup(&prog->vdims[CLS_VDIM_PKT_TYPE],
+                                            key->pkt_type, nwords), nwords))
+        return TC_ACT_RECLASSIFY;
+
+    /* non-IP never matches */
+    if (!key->af || !cls_bits_and(bits, cls_vdim_lookup(&prog->vdims[CLS_VDIM_AF],
+                                                         key->af, nwords), nwords))
+        return TC_ACT_RECLASSIFY;
+    if (unlikely(key->flags & TC_CLS_KEY_F_ERR_L3))
+        return TC_ACT_SHOT;
+
+    if (key->af == AF_INET) {
+        cls_bound_from_u32(&sv, ntohl(key->saddr.in.s_addr));
+        cls_bound_from_u32(&dv, ntohl(key->daddr.in.s_addr));
+        sdim = CLS_IDIM_SADDR4;
+        ddim = CLS_IDIM_DADDR4;
+    } else {
+        cls_bound_from_in6(&sv, &key->saddr.in6);
+        cls_bound_from_in6(&dv, &key->daddr.in6);
+        sdim = CLS_IDIM_SADDR6;
+        ddim = CLS_IDIM_DADDR6;
+    }
+    if (!cls_bits_and(bits, cls_idim_lookup(&prog->idims[sdim], &sv, nwords), nwords) ||
+            !cls_bits_and(bits, cls_idim_lookup(&prog->idims[ddim], &dv, nwords), nwords))
+        return TC_ACT_RECLASSIFY;
+    if (unlikely(key->flags & TC_CLS_KEY_F_ERR_EXTHDR))
+        return TC_ACT_SHOT;
+
+    if (key->proto && !cls_bits_and(bits, cls_vdim_lookup(&prog->vdims[CLS_VDIM_PROTO],
+                                                           key->proto, nwords), nwords))
+        return TC_ACT_RECLASSIFY;
+    if (unlikely(key->flags & TC_CLS_KEY_F_ERR_L4))
+        return TC_ACT_SHOT;
+
+    if (key->flags & TC_CLS_KEY_F_PORTS) {
+        cls_bound_from_u32(&sv, key->sport);
+        cls_bound_from_u32(&dv, key->dport);
+        if (!cls_bits_and(bits, cls_idim_lookup(&prog->idims[CLS_IDIM_SPORT],
+                                                &sv, nwords), nwords) ||
+                !cls_bits_and(bits, cls_idim_lookup(&prog->idims[CLS_IDIM_DPORT],
+                                                    &dv, nwords), nwords))
+            return TC_ACT_RECLASSIFY;
+    }
+
+    /* the first rule from @*pos by priority */
+    for (i = *pos; i < prog->nrules; i = (w + 1) * 64) {
+        w = i / 64;
+        word = bits[w] & (~0ULL << (i % 64));
+        if (word) {
+            i = w * 64 + __builtin_ctzll(word);
+            if (i >= prog->nrules)
+                break;
+            *pos = i + 1;
+            *result = prog->results[i];
+            return TC_ACT_OK;
+        }
+    }
+
+    *pos = prog->nrules;
+    return TC_ACT_RECLASSIFY;
+}
@@ -0,0 +1,400 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+/**
+ * the Hierarchical Token Bucket scheduler of traffic control module.
+ * see linux/net/sched/sch_htb.c
+ *
+ * classes of the hierarchy are htb Qsch objects, a htb Qsch whose parent is
+ * also a htb borrows from it. a class sends at its "rate" with tokens of its
+ * own, and up to its "ceil" with tokens lent by the nearest ancestor having
+ * some. as in linux, bytes sent are charged to the ceil of the class and all
+ * its htb ancestors, and to the rate of the lender and its ancestors only.
+ *
+ * every bucket is global, shared by the per-lcore copies of the Qsch. it's
+ * refilled and consumed with atomic operations, and each lcore takes tokens
+ * from it a quantum ahead into a cache of its own, and gives back the bytes
+ * it charged in a quantum of debt, so most packets don't touch it at all.
+ */
+#include <assert.h>
+#include <rte_atomic.h>
+#include "netif.h"
+#include "global_data.h"
+#include "tc/tc.h"
+#include "tc/sch.h"
+#include "tc/cls.h"
+#include "conf/tc.h"
+
+/* refill a global bucket at most once in this time, in nanosec */
+#define HTB_REFILL_NS           10000
+
+extern struct Qsch_ops htb_sch_ops;
+
+struct htb_bucket {
+    rte_atomic64_t          tokens;     /* bytes, negative for debt */
+    rte_atomic64_t          t_c;        /* time check-point */
+} __rte_cache_aligned;
+
+struct htb_sch_shared {
+    struct htb_bucket       rate;
+    struct htb_bucket       ceil;
+};
+
+/* lcore view of a global bucket */
+struct htb_tb {
+    struct qsch_rate        rate;       /* token fill speed */
+    uint32_t                burst;      /* bucket depth: bytes */
+    int64_t                 burst_ns;   /* bucket depth: in time */
+    uint32_t                quantum;    /* bytes taken from bucket at a time */
+    int64_t                 cache;      /* bytes taken and not used yet */
+    struct htb_bucket       *glob;
+};
+
+struct htb_sch_priv {
+    /* parameters */
+    uint32_t                limit;      /* Maximal length of backlog: bytes */
+    uint32_t                max_size;   /* max sigle packet size for enqueue */
+    struct htb_tb           rate;       /* guaranteed */
+    struct htb_tb           ceil;       /* upmost, borrowing included */
+
+    /* internal variables */
+    struct Qsch             *parent;    /* htb parent to borrow from */
+    struct htb_sch_shared   *shm;
+};
+
+static inline int64_t htb_tb_read(struct htb_bucket *b)
+{
+    return rte_atomic64_read(&b->tokens);
+}
+
+static inline bool htb_tb_cmpset(struct htb_bucket *b, int64_t old, int64_t new)
+{
+    return rte_atomic64_cmpset((volatile uint64_t *)&b->tokens.cnt, old, new);
+}
+
+static void htb_tb_refill(const struct htb_tb *tb, int64_t now)
+{
+    struct htb_bucket *b = tb->glob;
+    int64_t t_c, elapsed, toks, old, new;
+
+    t_c = rte_atomic64_read(&b->t_c);
+    elapsed = now - t_c;
+    if (elapsed < HTB_REFILL_NS)
+        return;
+
+    /* t_c moves by the time of whole tokens only, the time of a fraction
+     * of byte is kept for the next refill. a full bucket loses the rest. */
+    toks = qsch_t2l_ns(&tb->rate, min_t(int64_t, elapsed, tb->burst_ns));
+    if (!toks)
+        return;
+    if (elapsed < tb->burst_ns)
+        now = t_c + qsch_l2t_ns(&tb->rate, toks);
+
+    /* tokens arrived since t_c are added by whoever moves it */
+    if (!rte_atomic64_cmpset((volatile uint64_t *)&b->t_c.cnt, t_c, now))
+        return;
+
+    /* not exceed bucket depth, and forgive debt beyond it */
+    do {
+        old = htb_tb_read(b);
+        new = min_t(int64_t, old + toks, tb->burst);
+        new = max_t(int64_t, new, -(int64_t)tb->burst);
+        if (new == old)
+            return;
+    } while (!htb_tb_cmpset(b, old, new));
+}
+
+/* whether the cache has tokens for @len bytes, take some from the global
+ * bucket if not, a quantum more than needed. */
+static bool htb_tb_consume(struct htb_tb *tb, uint32_t len, int64_t now)
+{
+    struct htb_bucket *b = tb->glob;
+    int64_t need, take, old;
+
+    if (likely(tb->cache >= len))
+        return true;
+    need = len - tb->cache;
+
+    htb_tb_refill(tb, now);
+
+    do {
+        old = htb_tb_read(b);
+        if (old < need)
+            return false;
+        take = min_t(int64_t, old, need + tb->quantum);
+    } while (!htb_tb_cmpset(b, old, old - take));
+
+    tb->cache += take;
+    return true;
+}
+
+/* charge @len bytes to the cache, which gives back a quantum of debt
+ * to the global bucket. */
+static inline void htb_tb_charge(struct htb_tb *tb, uint32_t len)
+{
+    tb->cache -= len;
+    if (tb->cache < -(int64_t)tb->quantum) {
+        rte_atomic64_add(&tb->glob->tokens, tb->cache);
+        tb->cache = 0;
+    }
+}
+
+static void htb_tb_reset(struct htb_tb *tb)
+{
+    rte_atomic64_set(&tb->glob->tokens, tb->burst);
+    rte_atomic64_set(&tb->glob->t_c, tc_get_ns());
+}
+
+/* @sch itself if it can send @len bytes at its rate, or the nearest
+ * ancestor lending them within the ceil of the classes in between. */
+static struct Qsch *htb_lender(struct Qsch *sch, uint32_t len, int64_t now)
+{
+    struct htb_sch_priv *priv;
+
+    for (; sch; sch = priv->parent) {
+        priv = qsch_priv(sch);
+
+        if (!htb_tb_consume(&priv->ceil, len, now))
+            return NULL;
+        if (htb_tb_consume(&priv->rate, len, now))
+            return sch;
+    }
+
+    return NULL;
+}
+
+/* the classes below @lender borrowed, their rate isn't charged */
+static void htb_charge(struct Qsch *sch, struct Qsch *lender, uint32_t len)
+{
+    struct htb_sch_priv *priv;
+    bool lent = false;
+
+    for (; sch; sch = priv->parent) {
+        priv = qsch_priv(sch);
+
+        if (sch == lender)
+            lent = true;
+        if (lent)
+            htb_tb_charge(&priv->rate, len);
+        htb_tb_charge(&priv->ceil, len);
+    }
+}
+
+static int htb_enqueue(struct Qsch *sch, struct rte_mbuf *mbuf)
+{
+    struct htb_sch_priv *priv = qsch_priv(sch);
+
+    if (unlikely(mbuf->pkt_len > priv->max_size)) {
+        RTE_LOG(WARNING, TC, "%s: packet too big.\n", __func__);
+        return qsch_drop(sch, mbuf);
+    }
+
+    if (unlikely(sch->qstats.backlog + mbuf->pkt_len > priv->limit)) {
+        return qsch_drop(sch, mbuf);
+    }
+
+    return qsch_enqueue_tail(sch, mbuf);
+}
+
+static struct rte_mbuf *htb_dequeue(struct Qsch *sch)
+{
+    struct rte_mbuf *mbuf;
+    struct Qsch *lender;
+    unsigned int pkt_len;
+
+    mbuf = qsch_peek_head(sch);
+    if (unlikely(!mbuf))
+        return NULL;
+    pkt_len = mbuf->pkt_len;
+
+    lender = htb_lender(sch, pkt_len, tc_get_ns());
+    if (!lender) {
+        /* tokens taken stay in the caches for the next try */
+        sch->qstats.overlimits++;
+        return NULL;
+    }
+
+    mbuf = qsch_dequeue_head(sch);
+    if (unlikely(!mbuf))
+        return NULL;
+
+    htb_charge(sch, lender, pkt_len);
+    return mbuf;
+}
+
+static void htb_tb_set(struct Qsch *sch, struct htb_tb *tb,
+                       const struct qsch_rate *rate, uint32_t burst)
+{
+    uint32_t quantum;
+
+    /* enough for the lcores to share the bucket */
+    quantum = burst / (2 * max_t(int, g_slave_lcore_num, 1));
+    quantum = max_t(uint32_t, quantum, qsch_dev(sch)->mtu);
+
+    tb->rate = *rate;
+    tb->burst = burst;
+    tb->burst_ns = qsch_l2t_ns(rate, burst);
+    tb->quantum = min_t(uint32_t, quantum, burst);
+    tb->cache = 0;
+}
+
+static int htb_change(struct Qsch *sch, const void *arg)
+{
+    struct htb_sch_priv *priv = qsch_priv(sch);
+    const struct tc_htb_qopt *qopt = arg;
+    struct qsch_rate rate = {}, ceil = {};
+    uint32_t buffer, cbuffer, limit;
+
+    /* set new values or used original */
+    if (qopt->rate.rate)
+        rate.rate_bytes_ps = qopt->rate.rate / 8;
+    else
+        rate = priv->rate.rate;
+
+    if (qopt->ceil.rate)
+        ceil.rate_bytes_ps = qopt->ceil.rate / 8;
+    else if (priv->ceil.rate.rate_bytes_ps)
+        ceil = priv->ceil.rate;
+    else
+        ceil = rate;
+
+    if (qopt->buffer)
+        buffer = qopt->buffer;
+    else
+        buffer = priv->rate.burst;
+
+    if (qopt->cbuffer)
+        cbuffer = qopt->cbuffer;
+    else if (priv->ceil.burst)
+        cbuffer = priv->ceil.burst;
+    else
+        cbuffer = buffer;
+
+    if (qopt->limit)
+        limit = qopt->limit;
+    else
+        limit = priv->limit;
+
+    /* sanity check */
+    if (!rate.rate_bytes_ps || !buffer)
+        return EDPVS_INVAL;
+    if (ceil.rate_bytes_ps < rate.rate_bytes_ps)
+        return EDPVS_INVAL;
+    if (min_t(uint32_t, buffer, cbuffer) < qsch_dev(sch)->mtu)
+        return EDPVS_INVAL;
+
+    /* save values to sch */
+    priv->limit = limit; /* could be zero (no backlog queue, drop if no token) */
+    priv->max_size = min_t(uint32_t, buffer, cbuffer);
+    htb_tb_set(sch, &priv->rate, &rate, buffer);
+    htb_tb_set(sch, &priv->ceil, &ceil, cbuffer);
+
+    if (rte_lcore_id() != g_master_lcore_id)
+        return EDPVS_OK;
+
+    htb_tb_reset(&priv->rate);
+    htb_tb_reset(&priv->ceil);
+
+    return EDPVS_OK;
+}
+
+static int htb_init(struct Qsch *sch, const void *arg)
+{
+    struct htb_sch_priv *priv = qsch_priv(sch);
+    struct Qsch *psch;
+
+    if (!arg)
+        return EDPVS_INVAL;
+
+    priv->shm = qsch_shm_get_or_create(sch, sizeof(struct htb_sch_shared));
+    if (!priv->shm)
+        return EDPVS_NOMEM;
+    priv->rate.glob = &priv->shm->rate;
+    priv->ceil.glob = &priv->shm->ceil;
+
+    /* hold the htb parent as long as borrowing from it */
+    psch = qsch_lookup(sch->tc, sch->parent);
+    if (psch && psch->ops == &htb_sch_ops)
+        priv->parent = psch;
+    else if (psch)
+        qsch_put(psch);
+
+    return htb_change(sch, arg);
+}
+
+static void htb_destroy(struct Qsch *sch)
+{
+    struct htb_sch_priv *priv = qsch_priv(sch);
+
+    if (priv->parent) {
+        qsch_put(priv->parent);
+        priv->parent = NULL;
+    }
+
+    if (priv->shm)
+        qsch_shm_put_or_destroy(sch);
+}
+
+static void htb_reset(struct Qsch *sch)
+{
+    struct htb_sch_priv *priv;
+
+    qsch_reset_queue(sch);
+
+    priv = qsch_priv(sch);
+    priv->rate.cache = 0;
+    priv->ceil.cache = 0;
+
+    if (rte_lcore_id() != g_master_lcore_id)
+        return;
+
+    htb_tb_reset(&priv->rate);
+    htb_tb_reset(&priv->ceil);
+}
+
+static int htb_dump(struct Qsch *sch, void *arg)
+{
+    struct htb_sch_priv *priv;
+    struct tc_htb_qopt *qopt = arg;
+
+    if (!sch || sch->ops != &htb_sch_ops)
+        return EDPVS_INVAL;
+
+    priv = qsch_priv(sch);
+
+    memset(qopt, 0, sizeof(*qopt));
+    qopt->rate.rate     = priv->rate.rate.rate_bytes_ps * 8;
+    qopt->ceil.rate     = priv->ceil.rate.rate_bytes_ps * 8;
+    qopt->buffer        = priv->rate.burst;
+    qopt->cbuffer       = priv->ceil.burst;
+    qopt->limit         = priv->limit;
+
+    return EDPVS_OK;
+}
+
+struct Qsch_ops htb_sch_ops = {
+    .name       = "htb",
+    .priv_size  = sizeof(struct htb_sch_priv),
+    .enqueue    = htb_enqueue,
+    .dequeue    = htb_dequeue,
+    .peek       = qsch_peek_head,
+    .init       = htb_init,
+    .reset      = htb_reset,
+    .destroy    = htb_destroy,
+    .change     = htb_change,
+    .dump       = htb_dump,
+};
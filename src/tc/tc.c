@@ -35,6 +35,7 @@ extern struct Qsch_ops pfifo_sch_ops;
 extern struct Qsch_ops bfifo_sch_ops;
 extern struct Qsch_ops pfifo_fast_ops;
 extern struct Qsch_ops tbf_sch_ops;
+extern struct Qsch_ops htb_sch_ops;
 extern struct tc_cls_ops match_cls_ops;
 
 static struct list_head qsch_ops_base;
@@ -108,6 +109,30 @@ int tc_unregister_cls(struct tc_cls_ops *ops)
     return EDPVS_OK;
 }
 
+/* the child Qsch a classifier selects, NULL to try the next classifier */
+static inline struct Qsch *tc_cls_target(struct Qsch *sch,
+                                         const struct tc_cls_result *res)
+{
+    struct Qsch *child_sch;
+
+    child_sch = qsch_lookup(sch->tc, res->sch_id);
+
+    if (unlikely(!child_sch)) {
+        RTE_LOG(WARNING, TC, "%s: target Qsch not exist.\n",
+                __func__);
+        return NULL;
+    }
+
+    if (unlikely(child_sch->parent != sch->handle)) {
+        RTE_LOG(WARNING, TC, "%s: classified to non-children scheduler\n",
+                __func__);
+        qsch_put(child_sch);
+        return NULL;
+    }
+
+    return child_sch;
+}
+
 struct rte_mbuf *tc_hook(struct netif_tc *tc, struct rte_mbuf *mbuf,
                          tc_hook_type_t type, int *ret)
 {
@@ -115,9 +140,10 @@ struct rte_mbuf *tc_hook(struct netif_tc *tc, struct rte_mbuf *mbuf,
     struct Qsch *sch, *child_sch;
     struct tc_cls *cls;
     struct tc_cls_result cls_res;
+    struct tc_cls_key cls_key;
     const int max_reclassify_loop = 8;
     int limit = 0;
-    uint32_t flags;
+    uint32_t flags, pos;
     __be16 pkt_type;
 
     assert(tc && mbuf && ret);
@@ -140,12 +166,38 @@ struct rte_mbuf *tc_hook(struct netif_tc *tc, struct rte_mbuf *mbuf,
 
     qsch_get(sch);
 
+    /* parsed by the first compiled classifiers */
+    cls_key.flags = 0;
+    cls_key.port = mbuf->port;
+    cls_key.pkt_type = pkt_type;
+
     /*
      * classify the traffic first.
      * support classify for child schedulers only.
      * it no classifier matchs, than use current scheduler.
      */
 again:
+    if (sch->cls_prog) {
+        /* all classifiers at once, see cls_prog.c */
+        if ((sch->flags & QSCH_F_INGRESS) ^ flags)
+            goto classified;
+
+        pos = 0;
+        while ((err = tc_cls_prog_classify(sch->cls_prog, mbuf, &cls_key,
+                                           &pos, &cls_res)) == TC_ACT_OK) {
+            if (unlikely(cls_res.drop))
+                goto drop;
+
+            child_sch = tc_cls_target(sch, &cls_res);
+            if (child_sch)
+                goto reclassify;
+        }
+        if (err == TC_ACT_SHOT)
+            goto drop;
+
+        goto classified;
+    }
+
     list_for_each_entry(cls, &sch->cls_list, list) {
         if (unlikely(cls->pkt_type != pkt_type &&
                      cls->pkt_type != htons(ETH_P_ALL)))
@@ -167,34 +219,27 @@ again:
         if (unlikely(cls_res.drop))
             goto drop;
 
-        child_sch = qsch_lookup(sch->tc, cls_res.sch_id);
-
-        if (unlikely(!child_sch)) {
-            RTE_LOG(WARNING, TC, "%s: target Qsch not exist.\n",
-                    __func__);
-            continue;
-        }
+        child_sch = tc_cls_target(sch, &cls_res);
+        if (child_sch)
+            goto reclassify;
+    }
+    goto classified;
 
-        if (unlikely(child_sch->parent != sch->handle)) {
-            RTE_LOG(WARNING, TC, "%s: classified to non-children scheduler\n",
-                    __func__);
-            qsch_put(child_sch);
-            continue;
-        }
+reclassify:
+    /* pass the packet to child scheduler */
+    qsch_put(sch);
+    sch = child_sch;
 
-        /* pass the packet to child scheduler */
-        qsch_put(sch);
-        sch = child_sch;
+    if (unlikely(limit++ >= max_reclassify_loop)) {
+        RTE_LOG(DEBUG, TC, "%s: exceed reclassify max loop.\n",
+                __func__);
+        goto drop;
+    }
 
-        if (unlikely(limit++ >= max_reclassify_loop)) {
-            RTE_LOG(DEBUG, TC, "%s: exceed reclassify max loop.\n",
-                    __func__);
-            goto drop;
-        }
+    /* classify again for new selected Qsch */
+    goto again;
 
-        /* classify again for new selected Qsch */
-        goto again;
-    }
+classified:
 
     /* this scheduler has no queue (for classify only) ? */
     if (unlikely(!sch->ops->enqueue))
@@ -329,6 +374,7 @@ int tc_init(void)
     tc_register_qsch(&bfifo_sch_ops);
     tc_register_qsch(&pfifo_fast_ops);
     tc_register_qsch(&tbf_sch_ops);
+    tc_register_qsch(&htb_sch_ops);
 
     /* classifier */
     INIT_LIST_HEAD(&cls_ops_base);
@@ -361,6 +407,7 @@ int tc_term(void)
     tc_unregister_qsch(&bfifo_sch_ops);
     tc_unregister_qsch(&pfifo_fast_ops);
     tc_unregister_qsch(&tbf_sch_ops);
+    tc_unregister_qsch(&htb_sch_ops);
 
     tc_unregister_cls(&match_cls_ops);
 
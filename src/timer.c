@@ -21,6 +21,11 @@
  * raychen@qiyi.com, Apr 2016, initial.
  * raychen@qiyi.com, Jul 2017, refator with size/level configurable wheels,
  *                             instead of fixed size ms/sec/min wheels.
+ *
+ * wheel sizes are derived from the number of timers registered, i.e., the
+ * conn pool, and the work of each tick is bounded by an expire budget,
+ * timers beyond the budget are carried to the next tick via per-level
+ * backlogs.
  */
 #include <unistd.h>
 #include <sys/time.h>
@@ -50,31 +55,48 @@
  * which leads to performance issue, timer need a big "first" level wheel
  * (hash) to "cover" most (millions of) connections.
  *
- * we can use different hash size for levels, consider hashs of non-first
- * level can be much smaller. but let's make things easier, pick up same size,
- * just assuming the memory is big enough.
+ * the first level is sized by the lcore's share of the timers registered by
+ * dpvs_timer_size_register(), i.e., the conn pool. the upper levels are much
+ * smaller and just big enough to cover TIMER_MAX_TICKS.
  */
 
 #define DPVS_TIMER_HZ           1000
 
 /*
- * with 1000hz, if LEVEL_SIZE is 2<<18 and LEVEL_DEPTH is 2:
- * it's about 524s for first wheel and 8.7 years for all wheels.
+ * with 1000hz, a first level of 1<<18 covers about 262s, and two upper
+ * levels of 1<<7 cover the rest of the 32-bit ticks range.
  */
-/* __NOTE__: make sure (LEVEL_SIZE ** LEVEL_DEPTH) > TIMER_MAX_TICKS. */
-#define LEVEL_SIZE              (2<<18)
-#define LEVEL_DEPTH             2
+#define LEVEL_DEPTH             3
+#define LEVEL0_BITS_MIN         12
+#define LEVEL0_BITS_MAX         19
+#define TIMER_TICK_BITS         32
 
 /* about 49 days with 1000hz, see dpvs_tick_t */
 #define TIMER_MAX_TICKS         0xffffffff
 #define TIMER_MAX_SECS          (TIMER_MAX_TICKS / DPVS_TIMER_HZ)
 
+/* max timers handled (expired or cascaded) per tick */
+#define TIMER_EXPIRE_BUDGET_DEF 4096
+#define TIMER_EXPIRE_BUDGET_MIN 64
+
+static uint32_t timer_expire_budget = TIMER_EXPIRE_BUDGET_DEF;
+static dpvs_timer_size_cb_t timer_size_cb;
+
 struct timer_scheduler {
     /* wheels and cursors */
     rte_spinlock_t      lock;
     uint32_t            cursors[LEVEL_DEPTH];
+    uint32_t            sizes[LEVEL_DEPTH];
+    dpvs_tick_t         level_ticks[LEVEL_DEPTH];
     struct list_head    *hashs[LEVEL_DEPTH];
 
+    /* due timers carried over to next ticks */
+    struct list_head    backlog[LEVEL_DEPTH];
+    uint64_t            backlog_since[LEVEL_DEPTH];
+    uint64_t            ticks;
+
+    struct dpvs_timer_stats stats;
+
     /* leverage dpdk rte_timer to drive us */
     struct rte_timer    rte_tim;
 };
@@ -84,6 +106,8 @@ static RTE_DEFINE_PER_LCORE(struct timer_scheduler, timer_sched);
 /* global timer. */
 static struct timer_scheduler g_timer_sched;
 
+/* for stats access from other lcores */
+static struct timer_scheduler *timer_scheds[DPVS_MAX_LCORE];
 
 static inline void timer_sched_lock(struct timer_scheduler *sched)
 {
@@ -119,15 +143,12 @@ void ticks_to_timeval(const dpvs_tick_t ticks, struct timeval *tv)
 }
 
 /* ticks for each level's step */
-static inline dpvs_tick_t get_level_ticks(int level)
+static inline dpvs_tick_t get_level_ticks(const struct timer_scheduler *sched,
+                                          int level)
 {
-    dpvs_tick_t ticks = 1;
     assert(level >= 0 && level < LEVEL_DEPTH);
 
-    while (--level >= 0)
-        ticks *= LEVEL_SIZE;
-
-    return ticks;
+    return sched->level_ticks[level];
 }
 
 static inline bool timer_pending(const struct dpvs_timer *timer)
@@ -189,9 +210,9 @@ static int __dpvs_timer_sched(struct timer_scheduler *sched,
 
     /* add to corresponding wheel, from higher level to lower. */
     for (level = LEVEL_DEPTH - 1; level >= 0; level--) {
-        off = timer->delay / get_level_ticks(level);
+        off = timer->delay / get_level_ticks(sched, level);
         if (off > 0) {
-            hash = (sched->cursors[level] + off) % LEVEL_SIZE;
+            hash = (sched->cursors[level] + off) % sched->sizes[level];
             list_add_tail(&timer->list, &sched->hashs[level][hash]);
 #ifdef CONFIG_TIMER_DEBUG
             assert(timer->handler == handler);
@@ -212,7 +233,7 @@ static void __time_now(struct timer_scheduler *sched, struct timeval *now)
     int l;
 
     for (l = LEVEL_DEPTH - 1; l >= 0; l--)
-        ticks += sched->cursors[l] * get_level_ticks(l);
+        ticks += sched->cursors[l] * get_level_ticks(sched, l);
     ticks_to_timeval(ticks, now);
 }
 
@@ -274,20 +295,82 @@ static inline void deviation_measure(void)
 }
 #endif
 
+/* move a timer of @level whose slot is due to a lower level wheel */
+static void timer_cascade(struct timer_scheduler *sched,
+                          struct dpvs_timer *timer, int level)
+{
+    uint64_t remainder, off, hash;
+    int lower = level;
+
+    /* note it may not drop to "next" lower level wheel. */
+    list_del(&timer->list);
+
+    remainder = timer->delay % get_level_ticks(sched, level);
+    while (--lower >= 0) {
+        off = remainder / get_level_ticks(sched, lower);
+        if (!off)
+            continue; /* next lower level */
+
+        hash = (sched->cursors[lower] + off) % sched->sizes[lower];
+        list_add_tail(&timer->list, &sched->hashs[lower][hash]);
+        break;
+    }
+
+    assert(lower >= 0);
+}
+
+/* handle due timers of @level, return the budget left */
+static uint32_t timer_run_backlog(struct timer_scheduler *sched,
+                                  int level, uint32_t budget)
+{
+    struct list_head *head = &sched->backlog[level];
+    struct dpvs_timer *timer;
+    uint64_t latency;
+
+    if (list_empty(head))
+        return budget;
+
+    latency = sched->ticks - sched->backlog_since[level];
+    if (unlikely(latency > sched->stats.max_latency))
+        sched->stats.max_latency = latency;
+
+    /* handlers may cancel other due timers, always pick up the first */
+    while (budget > 0 && !list_empty(head)) {
+        timer = list_first_entry(head, struct dpvs_timer, list);
+        budget--;
+
+        /* is all lower levels ticks empty ? */
+        if (!(timer->delay % get_level_ticks(sched, level))) {
+            timer_expire(sched, timer);
+            sched->stats.expired++;
+        } else {
+            timer_cascade(sched, timer, level);
+            sched->stats.cascaded++;
+        }
+    }
+
+    return budget;
+}
+
 /*
  * it takes exactly one tick between invokations,
  * except system (including timer handles) takes more than
  * one tick to get rte_timer_manage() called.
  * we needn't calculate ticks elapsed by ourself.
+ *
+ * due slots are moved to the backlogs, and at most timer_expire_budget
+ * timers are handled per tick. the rest is carried to next ticks so that
+ * a burst of concentrated timeouts can't stall the lcore.
  */
 static void rte_timer_tick_cb(struct rte_timer *tim, void *arg)
 {
     struct timer_scheduler *sched = arg;
-    struct dpvs_timer *timer, *next;
-    uint64_t left, hash, off, remainder;
-    int level, lower;
+    struct list_head *slot;
+    uint32_t budget = timer_expire_budget;
+    uint64_t age, oldest = 0;
+    int level;
     uint32_t *cursor;
-    bool carry;
+    bool carry, deferred = false;
 
     assert(tim && sched);
 
@@ -297,11 +380,13 @@ static void rte_timer_tick_cb(struct rte_timer *tim, void *arg)
 
     /* drive timer to move and handle expired timers. */
     timer_sched_lock(sched);
+    sched->ticks++;
+
     for (level = 0; level < LEVEL_DEPTH; level++) {
         cursor = &sched->cursors[level];
         (*cursor)++;
 
-        if (likely(*cursor < LEVEL_SIZE)) {
+        if (likely(*cursor < sched->sizes[level])) {
             carry = false;
         } else {
             /* reset the cursor and handle next level later. */
@@ -309,65 +394,94 @@ static void rte_timer_tick_cb(struct rte_timer *tim, void *arg)
             carry = true;
         }
 
-        list_for_each_entry_safe(timer, next,
-                                 &sched->hashs[level][*cursor], list) {
-            /* is all lower levels ticks empty ? */
-            left = timer->delay % get_level_ticks(level);
-            if (!left) {
-                timer_expire(sched, timer);
-            } else {
-                /* drop to lower level wheel, note it may not drop to
-                 * "next" lower level wheel. */
-                list_del(&timer->list);
-
-                lower = level;
-                remainder = timer->delay % get_level_ticks(level);
-                while (--lower >= 0) {
-                    off = remainder / get_level_ticks(lower);
-                    if (!off)
-                        continue; /* next lower level */
-
-                    hash = (sched->cursors[lower] + off) % LEVEL_SIZE;
-                    list_add_tail(&timer->list, &sched->hashs[lower][hash]);
-                    break;
-                }
-
-                assert(lower >= 0);
-            }
+        slot = &sched->hashs[level][*cursor];
+        if (!list_empty(slot)) {
+            if (list_empty(&sched->backlog[level]))
+                sched->backlog_since[level] = sched->ticks;
+            list_splice_tail_init(slot, &sched->backlog[level]);
         }
 
         if (!carry)
             break;
     }
+
+    for (level = 0; level < LEVEL_DEPTH && budget > 0; level++)
+        budget = timer_run_backlog(sched, level, budget);
+
+    for (level = 0; level < LEVEL_DEPTH; level++) {
+        if (list_empty(&sched->backlog[level]))
+            continue;
+        age = sched->ticks - sched->backlog_since[level];
+        if (age > oldest)
+            oldest = age;
+        deferred = true;
+    }
+    if (unlikely(deferred))
+        sched->stats.deferred++;
+    sched->stats.backlog = oldest;
+
     timer_sched_unlock(sched);
 
     return;
 }
 
-static int timer_init_schedler(struct timer_scheduler *sched, lcoreid_t cid)
+/*
+ * the first level is sized by the number of conns the scheduler may hold,
+ * upper levels share the remaining bits of the ticks range.
+ */
+static void timer_wheel_sizes(struct timer_scheduler *sched, uint32_t ntimers)
+{
+    int l, bits0 = LEVEL0_BITS_MIN, bits;
+
+    while (bits0 < LEVEL0_BITS_MAX && (1U << bits0) < ntimers)
+        bits0++;
+    bits = (TIMER_TICK_BITS - bits0 + LEVEL_DEPTH - 2) / (LEVEL_DEPTH - 1);
+
+    sched->sizes[0] = 1U << bits0;
+    sched->level_ticks[0] = 1;
+    for (l = 1; l < LEVEL_DEPTH; l++) {
+        sched->sizes[l] = 1U << bits;
+        sched->level_ticks[l] = sched->level_ticks[l - 1] * sched->sizes[l - 1];
+    }
+}
+
+static int timer_init_schedler(struct timer_scheduler *sched, lcoreid_t cid,
+                               uint32_t ntimers)
 {
-    int i, l;
+    uint32_t i;
+    int l;
 
     rte_spinlock_init(&sched->lock);
 
+    timer_wheel_sizes(sched, ntimers);
 
     timer_sched_lock(sched);
     for (l = 0; l < LEVEL_DEPTH; l++) {
         sched->cursors[l] = 0;
+        INIT_LIST_HEAD(&sched->backlog[l]);
+        sched->backlog_since[l] = 0;
 
         sched->hashs[l] = rte_malloc(NULL,
-                                     sizeof(struct list_head) * LEVEL_SIZE, 0);
+                            sizeof(struct list_head) * sched->sizes[l], 0);
         if (!sched->hashs[l]) {
             RTE_LOG(ERR, DTIMER, "[%02d] no memory.\n", cid);
+            while (--l >= 0) {
+                rte_free(sched->hashs[l]);
+                sched->hashs[l] = NULL;
+            }
             timer_sched_unlock(sched);
             return EDPVS_NOMEM;
         }
 
-        for (i = 0; i < LEVEL_SIZE; i++)
+        for (i = 0; i < sched->sizes[l]; i++)
             INIT_LIST_HEAD(&sched->hashs[l][i]);
     }
+    sched->ticks = 0;
+    memset(&sched->stats, 0, sizeof(sched->stats));
     timer_sched_unlock(sched);
 
+    timer_scheds[cid] = sched;
+
     rte_timer_init(&sched->rte_tim);
     /* ticks should be exactly same with precision */
     if (rte_timer_reset(&sched->rte_tim, g_cycles_per_sec / DPVS_TIMER_HZ,
@@ -376,14 +490,16 @@ static int timer_init_schedler(struct timer_scheduler *sched, lcoreid_t cid)
         return EDPVS_INVAL;
     }
 
-    RTE_LOG(DEBUG, DTIMER, "[%02d] timer initialized %p.\n", cid, sched);
+    RTE_LOG(DEBUG, DTIMER, "[%02d] timer initialized %p, wheels %u/%u/%u.\n",
+            cid, sched, sched->sizes[0], sched->sizes[1], sched->sizes[2]);
     return EDPVS_OK;
 }
 
 static int timer_term_schedler(struct timer_scheduler *sched)
 {
     struct dpvs_timer *timer, *next;
-    int i, l;
+    uint32_t i;
+    int l;
 
     rte_timer_stop_sync(&sched->rte_tim);
 
@@ -391,10 +507,12 @@ static int timer_term_schedler(struct timer_scheduler *sched)
     timer_sched_lock(sched);
 
     for (l = 0; l < LEVEL_DEPTH; l++) {
-        for (i = 0; i < LEVEL_SIZE; i++) {
+        for (i = 0; i < sched->sizes[l]; i++) {
             list_for_each_entry_safe(timer, next, &sched->hashs[l][i], list)
                 list_del(&timer->list);
         }
+        list_for_each_entry_safe(timer, next, &sched->backlog[l], list)
+            list_del(&timer->list);
 
         rte_free(sched->hashs[l]);
         sched->cursors[l] = 0;
@@ -407,10 +525,13 @@ static int timer_term_schedler(struct timer_scheduler *sched)
 
 static int timer_lcore_init(void *arg)
 {
+    uint32_t ntimers = *(uint32_t *)arg;
+
     if (!rte_lcore_is_enabled(rte_lcore_id()))
         return EDPVS_DISABLED;
 
-    return timer_init_schedler(&RTE_PER_LCORE(timer_sched), rte_lcore_id());
+    return timer_init_schedler(&RTE_PER_LCORE(timer_sched), rte_lcore_id(),
+                               ntimers);
 }
 
 static int timer_lcore_term(void *arg)
@@ -421,13 +542,24 @@ static int timer_lcore_term(void *arg)
     return timer_term_schedler(&RTE_PER_LCORE(timer_sched));
 }
 
+void dpvs_timer_size_register(dpvs_timer_size_cb_t cb)
+{
+    timer_size_cb = cb;
+}
+
 int dpvs_timer_init(void)
 {
     lcoreid_t cid;
     int err;
+    uint32_t nworkers, total, ntimers;
+
+    /* the timers (conns) are spread over workers */
+    total = timer_size_cb ? timer_size_cb() : 0;
+    nworkers = RTE_MAX(rte_lcore_count() - 1, 1U);
+    ntimers = total / nworkers;
 
     /* per-lcore timer */
-    rte_eal_mp_remote_launch(timer_lcore_init, NULL, SKIP_MAIN);
+    rte_eal_mp_remote_launch(timer_lcore_init, &ntimers, SKIP_MAIN);
     RTE_LCORE_FOREACH_WORKER(cid) {
         err = rte_eal_wait_lcore(cid);
         if (err < 0) {
@@ -438,7 +570,7 @@ int dpvs_timer_init(void)
     }
 
     /* global timer */
-    return timer_init_schedler(&g_timer_sched, rte_get_main_lcore());
+    return timer_init_schedler(&g_timer_sched, rte_get_main_lcore(), total);
 }
 
 int dpvs_timer_term(void)
@@ -701,6 +833,32 @@ int dpvs_time_now(struct timeval *now, bool global)
     return EDPVS_OK;
 }
 
+dpvs_tick_t dpvs_timer_ticks(bool global)
+{
+    struct timer_scheduler *sched = this_lcore_sched(global);
+    if (unlikely(!sched))
+        return 0;
+
+    return (dpvs_tick_t)sched->ticks;
+}
+
+int dpvs_timer_stats_get(lcoreid_t cid, struct dpvs_timer_stats *stats)
+{
+    struct timer_scheduler *sched;
+
+    if (cid >= DPVS_MAX_LCORE || !stats)
+        return EDPVS_INVAL;
+
+    sched = timer_scheds[cid];
+    if (!sched)
+        return EDPVS_NOTEXIST;
+
+    /* counters are written by the owner lcore only, a racy copy is fine */
+    memcpy(stats, &sched->stats, sizeof(*stats));
+
+    return EDPVS_OK;
+}
+
 void dpvs_time_rand_delay(struct timeval *tv, long delay_us)
 {
     assert(delay_us > 0);
@@ -753,9 +911,30 @@ static void timer_sched_interval_handler(vector_t tokens)
     rte_atomic32_set(&g_sched_interval, sched_interval);
 }
 
+static void timer_expire_budget_handler(vector_t tokens)
+{
+    char *str = set_value(tokens);
+    int budget;
+
+    if (!str)
+        return;
+
+    budget = atoi(str);
+    FREE_PTR(str);
+
+    if (budget < TIMER_EXPIRE_BUDGET_MIN) {
+        RTE_LOG(WARNING, DTIMER, "invalid expire_budget config %d, "
+                "using default %d\n", budget, TIMER_EXPIRE_BUDGET_DEF);
+        budget = TIMER_EXPIRE_BUDGET_DEF;
+    }
+    RTE_LOG(INFO, DTIMER, "expire_budget = %d\n", budget);
+    timer_expire_budget = budget;
+}
+
 void timer_keyword_value_init(void)
 {
     rte_atomic32_set(&g_sched_interval, TIMER_SCHED_INTERVAL_DEF);
+    timer_expire_budget = TIMER_EXPIRE_BUDGET_DEF;
 }
 
 void install_timer_keywords(void)
@@ -763,4 +942,6 @@ void install_timer_keywords(void)
     install_keyword_root("timer_defs", NULL);
     install_keyword("schedule_interval", timer_sched_interval_handler,
                     KW_TYPE_NORMAL);
+    install_keyword("expire_budget", timer_expire_budget_handler,
+                    KW_TYPE_NORMAL);
 }
@@ -0,0 +1,221 @@
+/*
+ * Functional test of the blklst/whtlst ACL engine (src/ipvs/ip_vs_acl.c):
+ * host, prefix and /0 rules of IPv4 and IPv6 VIPs, idempotent add, delete
+ * and flush, a rule allocation failing on a new VIP, and that terminating
+ * a list frees every table even though the slaves were never synchronized.
+ *
+ * The engine is static in ip_vs_acl.c, so the source is included here; link
+ * with the dpvs objects except main.o and ip_vs_acl.o. The msg framework is
+ * not initialized, so every commit defers freeing the old tables, and the
+ * "slaves not synchronized" warnings are expected.
+ *
+ * usage: acl_test [EAL options]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "dpdk.h"
+
+static const char *acl_fail_type;   /* rte_zmalloc() of this type fails */
+
+static void *acl_test_zmalloc(const char *type, size_t size, unsigned align)
+{
+    if (acl_fail_type && type && !strcmp(type, acl_fail_type))
+        return NULL;
+    return rte_zmalloc(type, size, align);
+}
+
+#define rte_zmalloc acl_test_zmalloc
+#include "../../src/ipvs/ip_vs_acl.c"
+#undef rte_zmalloc
+
+#define ACL_CHECK(cond) do {                                            \
+    if (!(cond))                                                        \
+        rte_exit(EXIT_FAILURE, "%s:%d: check `%s' failed\n",           \
+                 __func__, __LINE__, #cond);                            \
+} while (0)
+
+#define VPORT           htons(80)
+
+static void acl_addr(int af, const char *str, union inet_addr *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    if (inet_pton(af, str, addr) != 1)
+        rte_exit(EXIT_FAILURE, "bad address %s\n", str);
+}
+
+static int acl_set(struct dp_vs_acl_list *list, bool add, int af,
+                   const char *vaddr, const char *addr, uint8_t plen)
+{
+    struct dp_vs_acl_rule rule;
+
+    memset(&rule, 0, sizeof(rule));
+    rule.af = af;
+    rule.proto = IPPROTO_TCP;
+    rule.vport = VPORT;
+    acl_addr(af, vaddr, &rule.vaddr);
+    acl_addr(af, addr, &rule.addr);
+    rule.plen = plen;
+
+    return dp_vs_acl_update(list, add, &rule, 1);
+}
+
+/* -1 if the VIP has no ACL, else whether the client matches */
+static int acl_check(const struct dp_vs_acl_list *list, int af,
+                     const char *vaddr, const char *addr)
+{
+    union inet_addr va, ca;
+    const struct dp_vs_acl *acl;
+
+    acl_addr(af, vaddr, &va);
+    acl_addr(af, addr, &ca);
+
+    acl = dp_vs_acl_get(list, af, IPPROTO_TCP, &va, VPORT);
+    if (!acl)
+        return -1;
+    return dp_vs_acl_match(acl, &ca);
+}
+
+static int acl_count_cb(const struct dp_vs_acl_rule *rule, void *arg)
+{
+    (*(uint32_t *)arg)++;
+    return EDPVS_OK;
+}
+
+static uint32_t acl_count(const struct dp_vs_acl_list *list)
+{
+    uint32_t n = 0;
+
+    ACL_CHECK(dp_vs_acl_walk(list, acl_count_cb, &n) == EDPVS_OK);
+    return n;
+}
+
+static void acl_test_ipv4(struct dp_vs_acl_list *list)
+{
+    struct dp_vs_acl_rule rules[3];
+    int i;
+
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.1", "192.168.1.1", 32) == EDPVS_OK);
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.1", "172.16.5.9", 12) == EDPVS_OK);
+    /* adding is idempotent, the prefix above is masked to 172.16.0.0/12 */
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.1", "172.16.0.0", 12) == EDPVS_OK);
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.1", "10.1.1.1", 33) == EDPVS_INVAL);
+    ACL_CHECK(list->nvips == 1 && list->nrules == 2);
+
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "192.168.1.1") == 1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "192.168.1.2") == 0);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "172.16.0.0") == 1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "172.31.255.255") == 1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "172.32.0.0") == 0);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.2", "192.168.1.1") == -1);
+
+    /* /0 covers every client, and is not taken for a host */
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.2", "1.2.3.4", 0) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.2", "192.168.1.1") == 1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.2", "255.255.255.255") == 1);
+    ACL_CHECK(acl_set(list, false, AF_INET, "10.0.0.2", "1.2.3.4", 32) == EDPVS_NOTEXIST);
+    ACL_CHECK(acl_set(list, false, AF_INET, "10.0.0.2", "0.0.0.0", 0) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.2", "192.168.1.1") == -1);
+
+    ACL_CHECK(acl_set(list, false, AF_INET, "10.0.0.1", "172.16.0.0", 12) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "172.16.0.1") == 0);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "192.168.1.1") == 1);
+
+    /* a bulk update is published at once */
+    memset(rules, 0, sizeof(rules));
+    for (i = 0; i < NELEMS(rules); i++) {
+        rules[i].af = AF_INET;
+        rules[i].proto = IPPROTO_TCP;
+        rules[i].vport = VPORT;
+        acl_addr(AF_INET, "10.0.0.3", &rules[i].vaddr);
+        rules[i].addr.in.s_addr = htonl(0xc0000200 + (i << 6));
+        rules[i].plen = 26;
+    }
+    ACL_CHECK(dp_vs_acl_update(list, true, rules, NELEMS(rules)) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.3", "192.0.2.127") == 1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.3", "192.0.2.191") == 1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.3", "192.0.2.192") == 0);
+    ACL_CHECK(acl_count(list) == 4);
+}
+
+static void acl_test_ipv6(struct dp_vs_acl_list *list)
+{
+    union inet_addr vaddr;
+
+    ACL_CHECK(acl_set(list, true, AF_INET6, "2001:db8::1", "2001:db8:1::1", 128) == EDPVS_OK);
+    ACL_CHECK(acl_set(list, true, AF_INET6, "2001:db8::1", "fd00:1:2::", 48) == EDPVS_OK);
+    ACL_CHECK(acl_set(list, true, AF_INET6, "2001:db8::1", "fd00::", 129) == EDPVS_INVAL);
+
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::1", "2001:db8:1::1") == 1);
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::1", "2001:db8:1::2") == 0);
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::1", "fd00:1:2:ffff::1") == 1);
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::1", "fd00:1:3::1") == 0);
+
+    ACL_CHECK(acl_set(list, true, AF_INET6, "2001:db8::2", "::", 0) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::2", "fe80::1") == 1);
+    acl_addr(AF_INET6, "2001:db8::2", &vaddr);
+    ACL_CHECK(dp_vs_acl_flush_vip(list, AF_INET6, IPPROTO_TCP, &vaddr, VPORT) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::2", "fe80::1") == -1);
+    ACL_CHECK(acl_check(list, AF_INET6, "2001:db8::1", "2001:db8:1::1") == 1);
+}
+
+/* a new VIP doesn't stay behind if its first rule can't be allocated */
+static void acl_test_nomem(struct dp_vs_acl_list *list)
+{
+    union inet_addr vaddr;
+    uint32_t nvips = list->nvips, nrules = list->nrules;
+
+    acl_fail_type = "acl_rule";
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.9", "192.168.1.1", 32) == EDPVS_NOMEM);
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.1", "192.168.9.0", 24) == EDPVS_NOMEM);
+    acl_fail_type = NULL;
+
+    ACL_CHECK(list->nvips == nvips && list->nrules == nrules);
+    acl_addr(AF_INET, "10.0.0.9", &vaddr);
+    ACL_CHECK(!acl_vip_find(list, AF_INET, IPPROTO_TCP, &vaddr, VPORT));
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.9", "192.168.1.1") == -1);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.1", "192.168.1.1") == 1);
+
+    ACL_CHECK(acl_set(list, true, AF_INET, "10.0.0.9", "192.168.1.1", 32) == EDPVS_OK);
+    ACL_CHECK(acl_check(list, AF_INET, "10.0.0.9", "192.168.1.1") == 1);
+}
+
+static unsigned acl_alloc_count(void)
+{
+    struct rte_malloc_socket_stats stats;
+
+    if (rte_malloc_get_socket_stats(rte_socket_id(), &stats) < 0)
+        rte_exit(EXIT_FAILURE, "fail to get malloc stats\n");
+    return stats.alloc_count;
+}
+
+int main(int argc, char *argv[])
+{
+    int err;
+    unsigned nallocs;
+    struct dp_vs_acl_list list;
+
+    err = rte_eal_init(argc, argv);
+    if (err < 0)
+        rte_exit(EXIT_FAILURE, "Fail to init eal!\n");
+
+    acl_hash_rnd = (uint32_t)rte_rand();
+    nallocs = acl_alloc_count();
+
+    ACL_CHECK(dp_vs_acl_list_init(&list, "acl_test") == EDPVS_OK);
+    acl_test_ipv4(&list);
+    acl_test_ipv6(&list);
+    acl_test_nomem(&list);
+
+    ACL_CHECK(dp_vs_acl_flush(&list) == EDPVS_OK);
+    ACL_CHECK(!list.tbl && !list.nvips && !list.nrules);
+    ACL_CHECK(acl_check(&list, AF_INET, "10.0.0.1", "192.168.1.1") == -1);
+
+    /* leave rules and tables behind for term */
+    acl_test_ipv4(&list);
+    ACL_CHECK(!list_empty(&list.gc));
+    dp_vs_acl_list_term(&list);
+    ACL_CHECK(acl_alloc_count() == nallocs);
+
+    printf("acl test passed\n");
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Micro-benchmark of the per-lcore connection table: cycles per lookup of
+ * the bucketized cuckoo table (ipvs/conn_tbl.h) versus the chained list
+ * table it replaced.
+ *
+ * usage: conn_tbl_bench [EAL options] -- [nconns]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "dpdk.h"
+#include "list.h"
+#include "ipvs/conn_tbl.h"
+
+#define LIST_TBL_BITS   20
+#define LIST_TBL_SIZE   (1 << LIST_TBL_BITS)
+#define LIST_TBL_MASK   (LIST_TBL_SIZE - 1)
+
+#define BKT_SIZE        (1 << 18)
+#define OVF_SIZE        (1 << 14)
+
+#define NCONNS_DEF      1000000
+#define NLOOKUPS        (1 << 24)
+
+static uint32_t g_rnd;
+
+static inline uint32_t tuple_hash(const struct conn_tuple_hash *t)
+{
+    return rte_jhash_3words(t->saddr.in.s_addr, t->daddr.in.s_addr,
+                            ((uint32_t)t->sport) << 16 | t->dport, g_rnd);
+}
+
+static struct conn_tuple_hash *
+list_tbl_lookup(struct list_head *tbl, const struct conn_tuple_hash *key,
+                uint32_t hash)
+{
+    struct conn_tuple_hash *t;
+
+    list_for_each_entry(t, &tbl[hash & LIST_TBL_MASK], list) {
+        if (t->sport == key->sport && t->dport == key->dport
+                && t->saddr.in.s_addr == key->saddr.in.s_addr
+                && t->daddr.in.s_addr == key->daddr.in.s_addr
+                && t->proto == key->proto && t->af == key->af)
+            return t;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int err;
+    uint32_t i, n, hit, nconns = NCONNS_DEF;
+    uint32_t *order;
+    uint64_t start, cycles;
+    struct conn_tuple_hash *tuples, *keys, *t;
+    struct list_head *list_tbl;
+    struct dp_vs_conn_tbl *tbl;
+
+    err = rte_eal_init(argc, argv);
+    if (err < 0)
+        rte_exit(EXIT_FAILURE, "Fail to init eal!\n");
+    argc -= err;
+    argv += err;
+    if (argc > 1)
+        nconns = atoi(argv[1]);
+
+    g_rnd = (uint32_t)random();
+
+    /* tuples live in conn-sized strides to mimic cache footprint of dp_vs_conn */
+    tuples = rte_zmalloc("bench_tuples", sizeof(struct dp_vs_conn) * nconns,
+                         RTE_CACHE_LINE_SIZE);
+    keys = rte_zmalloc("bench_keys", sizeof(*keys) * nconns, RTE_CACHE_LINE_SIZE);
+    order = rte_malloc("bench_order", sizeof(uint32_t) * NLOOKUPS, 0);
+    list_tbl = rte_malloc("bench_list", sizeof(struct list_head) * LIST_TBL_SIZE,
+                          RTE_CACHE_LINE_SIZE);
+    tbl = dp_vs_conn_tbl_create(BKT_SIZE, OVF_SIZE, rte_socket_id());
+    if (!tuples || !keys || !order || !list_tbl || !tbl)
+        rte_exit(EXIT_FAILURE, "no memory\n");
+
+    for (i = 0; i < LIST_TBL_SIZE; i++)
+        INIT_LIST_HEAD(&list_tbl[i]);
+
+    for (i = 0; i < nconns; i++) {
+        t = (struct conn_tuple_hash *)((char *)tuples + i * sizeof(struct dp_vs_conn));
+        t->af = AF_INET;
+        t->proto = IPPROTO_TCP;
+        t->saddr.in.s_addr = rte_rand();
+        t->daddr.in.s_addr = htonl(0xc0a80001);
+        t->sport = rte_rand();
+        t->dport = htons(80);
+        INIT_LIST_HEAD(&t->list);
+        keys[i] = *t;
+    }
+    for (i = 0; i < NLOOKUPS; i++)
+        order[i] = rte_rand() % nconns;
+
+    /* chained list table */
+    for (i = 0; i < nconns; i++) {
+        t = (struct conn_tuple_hash *)((char *)tuples + i * sizeof(struct dp_vs_conn));
+        list_add(&t->list, &list_tbl[tuple_hash(t) & LIST_TBL_MASK]);
+    }
+    hit = 0;
+    start = rte_rdtsc();
+    for (i = 0; i < NLOOKUPS; i++) {
+        n = order[i];
+        if (list_tbl_lookup(list_tbl, &keys[n], tuple_hash(&keys[n])))
+            hit++;
+    }
+    cycles = rte_rdtsc() - start;
+    printf("list table:   %u conns, %u/%u hits, %.1f cycles/lookup\n",
+           nconns, hit, NLOOKUPS, (double)cycles / NLOOKUPS);
+
+    /* cuckoo table */
+    for (i = 0; i < nconns; i++) {
+        t = (struct conn_tuple_hash *)((char *)tuples + i * sizeof(struct dp_vs_conn));
+        INIT_LIST_HEAD(&t->list);
+        dp_vs_conn_tbl_add(tbl, t, tuple_hash(t));
+    }
+    hit = 0;
+    start = rte_rdtsc();
+    for (i = 0; i < NLOOKUPS; i++) {
+        n = order[i];
+        if (dp_vs_conn_tbl_lookup(tbl, tuple_hash(&keys[n]), AF_INET, IPPROTO_TCP,
+                    &keys[n].saddr, &keys[n].daddr, keys[n].sport, keys[n].dport))
+            hit++;
+    }
+    cycles = rte_rdtsc() - start;
+    printf("cuckoo table: %u conns, %u/%u hits, %.1f cycles/lookup, "
+           "%u in buckets, %u overflowed\n", nconns, hit, NLOOKUPS,
+           (double)cycles / NLOOKUPS, tbl->count, tbl->ovf_count);
+
+    dp_vs_conn_tbl_destroy(tbl);
+    rte_free(list_tbl);
+    rte_free(order);
+    rte_free(keys);
+    rte_free(tuples);
+
+    return 0;
+}
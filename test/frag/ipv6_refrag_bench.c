@@ -0,0 +1,204 @@
+/*
+ * Micro-benchmark of IPv6 fragments through IPVS: cycles to reassemble a
+ * datagram (ipv6_reassamble() of src/ipv4_frag.c) and to fragment it again
+ * on output (ip6_fragment() of src/ipv6/ipv6.c) for a mix of datagram and
+ * fragment sizes, and the fragment rate one lcore sustains from that.
+ *
+ * ip6_fragment() and the reassembly tables are static, so both sources are
+ * included here; link with the dpvs objects except main.o, ipv6.o and
+ * ipv4_frag.o.
+ *
+ * usage: ipv6_refrag_bench [EAL options] -- [ndatagrams] [mtu]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../src/ipv4_frag.c"
+#include "../../src/ipv6/ipv6.c"
+
+#define NDGRAMS_DEF     1000000
+#define MTU_DEF         1500
+#define NFRAGS_MAX      64
+#define JUMBO_ROOM      (9216 + RTE_PKTMBUF_HEADROOM)
+
+/* datagram size, size of the fragments it came in, share in % */
+static const struct {
+    uint16_t    size;
+    uint16_t    frag_size;
+    uint32_t    pct;
+} frag_mix[] = {
+    { 1600, 1280, 35 },     /* EDNS answers over IPv6 minimum MTU paths */
+    { 2900, 1500, 30 },     /* two-fragment UDP */
+    { 4096, 1500, 20 },     /* EDNS 4K answers */
+    { 8192, 1500, 10 },     /* NFS/RPC over UDP */
+    { 8952, 9000,  5 },     /* jumbo UDP leaving on a smaller MTU */
+};
+
+static struct rte_mbuf *frags[NFRAGS_MAX];
+static uint32_t nfrags;
+static uint64_t nfrags_out;
+
+static int frag_collect(struct rte_mbuf *mbuf)
+{
+    route6_put(MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE));
+    if (nfrags >= NFRAGS_MAX) {
+        rte_pktmbuf_free(mbuf);
+        return EDPVS_NOROOM;
+    }
+    frags[nfrags++] = mbuf;
+    return EDPVS_OK;
+}
+
+static int frag_drop(struct rte_mbuf *mbuf)
+{
+    route6_put(MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE));
+    rte_pktmbuf_free(mbuf);
+    nfrags_out++;
+    return EDPVS_OK;
+}
+
+static struct rte_mbuf *dgram_build(struct rte_mempool *pool, uint32_t seq,
+                                    uint16_t size, struct route6 *rt)
+{
+    struct rte_mbuf *mbuf;
+    struct ip6_hdr *ip6h;
+    struct rte_udp_hdr *uh;
+
+    mbuf = rte_pktmbuf_alloc(pool);
+    if (!mbuf || !rte_pktmbuf_append(mbuf, size))
+        rte_exit(EXIT_FAILURE, "no mbuf\n");
+    mbuf_userdata_reset(mbuf);
+    mbuf->l2_len = sizeof(struct rte_ether_hdr);
+    mbuf->l3_len = sizeof(struct ip6_hdr);
+
+    ip6h = ip6_hdr(mbuf);
+    memset(ip6h, 0, sizeof(*ip6h) + sizeof(*uh));
+    ip6h->ip6_flow = htonl(6 << 28);
+    ip6h->ip6_plen = htons(size - sizeof(*ip6h));
+    ip6h->ip6_nxt = IPPROTO_UDP;
+    ip6h->ip6_hlim = 64;
+    ip6h->ip6_src.s6_addr32[0] = htonl(0x20010db8);
+    ip6h->ip6_src.s6_addr32[3] = htonl(seq);
+    ip6h->ip6_dst.s6_addr32[0] = htonl(0x20010db8);
+    ip6h->ip6_dst.s6_addr32[3] = htonl(1);
+
+    uh = (struct rte_udp_hdr *)(ip6h + 1);
+    uh->src_port = htons(1024 + seq % 60000);
+    uh->dst_port = htons(53);
+    uh->dgram_len = ip6h->ip6_plen;
+
+    route6_get(rt);
+    MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE) = rt;
+    return mbuf;
+}
+
+int main(int argc, char *argv[])
+{
+    int err;
+    uint32_t i, j, k, n, pick, ndgrams = NDGRAMS_DEF, mtu = MTU_DEF;
+    uint64_t start, reasm_cycles, refrag_cycles, nfrags_in;
+    uint64_t max_cycles, c_reasm, c_refrag, c_in, c_out;
+    uint16_t frag_size;
+    struct rte_mempool *pool;
+    struct rte_mbuf *mbuf;
+    struct route6 rt;
+
+    err = rte_eal_init(argc, argv);
+    if (err < 0)
+        rte_exit(EXIT_FAILURE, "Fail to init eal!\n");
+    argc -= err;
+    argv += err;
+    if (argc > 1)
+        ndgrams = atoi(argv[1]);
+    if (argc > 2)
+        mtu = atoi(argv[2]);
+    if (!ndgrams || mtu < IPV6_MIN_MTU)
+        rte_exit(EXIT_FAILURE, "bad arguments\n");
+
+    if (mbuf_init() != EDPVS_OK)
+        rte_exit(EXIT_FAILURE, "fail to register mbuf dynfields\n");
+
+    /* fragments are allocated from the pool of the datagram */
+    pool = rte_pktmbuf_pool_create("refrag_pool", 1023, 32, 0,
+                                   JUMBO_ROOM, rte_socket_id());
+    max_cycles = rte_get_tsc_hz();
+    this_ip4_frag.reasm_tbl = rte_ip_frag_table_create(IP4_FRAG_BUCKETS_DEF,
+            IP4_FRAG_BUCKET_ENTRIES_DEF, IP4_FRAG_BUCKETS_DEF, max_cycles,
+            rte_socket_id());
+    if (!pool || !this_ip4_frag.reasm_tbl)
+        rte_exit(EXIT_FAILURE, "no memory\n");
+
+    memset(&rt, 0, sizeof(rt));
+    rte_atomic32_set(&rt.refcnt, 1);
+    rt.rt6_mtu = mtu;
+
+    printf("%-8s %-6s %-6s %-10s %-10s %-12s %-12s\n", "size", "frags",
+           "mtu", "frags-in", "frags-out", "reasm/dgram", "refrag/dgram");
+
+    reasm_cycles = refrag_cycles = nfrags_in = 0;
+    for (k = 0; k < NELEMS(frag_mix); k++) {
+        n = (uint64_t)ndgrams * frag_mix[k].pct / 100;
+        c_reasm = c_refrag = c_in = c_out = 0;
+        nfrags_out = 0;
+
+        for (i = 0; i < n; i++) {
+            /* fragments as they come from the client, in random order */
+            mbuf = dgram_build(pool, i, frag_mix[k].size, &rt);
+            nfrags = 0;
+            if (ip6_fragment(mbuf, frag_mix[k].frag_size, frag_collect) != EDPVS_OK)
+                rte_exit(EXIT_FAILURE, "fail to make client fragments\n");
+            for (j = nfrags - 1; j > 0; j--) {
+                pick = rte_rand() % (j + 1);
+                mbuf = frags[j];
+                frags[j] = frags[pick];
+                frags[pick] = mbuf;
+            }
+            c_in += nfrags;
+
+            start = rte_rdtsc();
+            for (j = 0; j < nfrags; j++) {
+                mbuf = frags[j];
+                err = ipv6_reassamble(mbuf);
+                if (err != EDPVS_INPROGRESS)
+                    break;
+            }
+            c_reasm += rte_rdtsc() - start;
+            if (err != EDPVS_OK || j != nfrags - 1)
+                rte_exit(EXIT_FAILURE, "fail to reassemble\n");
+
+            /* as ip6_output_fin() */
+            frag_size = mbuf_frag_size(mbuf);
+            if (!frag_size || frag_size > frag_mix[k].frag_size)
+                rte_exit(EXIT_FAILURE, "frag size %u, expect up to %u\n",
+                         frag_size, frag_mix[k].frag_size);
+            route6_get(&rt);
+            MBUF_USERDATA(mbuf, struct route6 *, MBUF_FIELD_ROUTE) = &rt;
+            start = rte_rdtsc();
+            err = ip6_fragment(mbuf, RTE_MIN(frag_size, mtu), frag_drop);
+            c_refrag += rte_rdtsc() - start;
+            if (err != EDPVS_OK)
+                rte_exit(EXIT_FAILURE, "fail to refragment\n");
+
+            rte_ip_frag_free_death_row(&this_ip4_frag.death_tbl, 0);
+        }
+        c_out = nfrags_out;
+
+        printf("%-8u %-6u %-6u %-10lu %-10lu %-12.1f %-12.1f\n",
+               frag_mix[k].size, frag_mix[k].frag_size, mtu, c_in, c_out,
+               n ? (double)c_reasm / n : 0, n ? (double)c_refrag / n : 0);
+        reasm_cycles += c_reasm;
+        refrag_cycles += c_refrag;
+        nfrags_in += c_in;
+    }
+
+    if (rte_atomic32_read(&rt.refcnt) != 1)
+        rte_exit(EXIT_FAILURE, "route refcnt leaked: %d\n",
+                 rte_atomic32_read(&rt.refcnt));
+
+    printf("mix: %.1f cycles/fragment, %.2f Mfragments/s per lcore at %lu MHz\n",
+           (double)(reasm_cycles + refrag_cycles) / nfrags_in,
+           (double)nfrags_in * rte_get_tsc_hz() / (reasm_cycles + refrag_cycles) / 1e6,
+           rte_get_tsc_hz() / 1000000);
+
+    rte_ip_frag_table_destroy(this_ip4_frag.reasm_tbl);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Accuracy test of the iftraf top talker sketch (src/iftraf.c): feed one
+ * flow sketch a stream where a share of the packets goes to a few heavy
+ * flows among many light ones, then check every heavy flow is still in the
+ * sketch and report how far its bytes are from the exact count.
+ *
+ * The sketch is static in iftraf.c, so the source is included here; link
+ * with the dpvs objects except main.o.
+ *
+ * usage: iftraf_sketch_test [EAL options] -- [npkts] [nflows] [nheavy] [heavy%]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../src/iftraf.c"
+
+#define NPKTS_DEF       20000000
+#define NFLOWS_DEF      200000
+#define NHEAVY_DEF      50
+#define HEAVY_PCT_DEF   30
+
+static uint32_t nheavy;
+static uint64_t *heavy_bytes;       /* exact */
+static uint64_t *heavy_found;       /* from the sketch */
+static bool *heavy_seen;
+
+static void flow_key(struct iftraf_key *key, uint32_t flow)
+{
+    memset(key, 0, sizeof(*key));
+    key->af = AF_INET;
+    key->proto = IPPROTO_TCP;
+    key->saddr.in.s_addr = htonl(0x0a000000 | flow);
+    key->daddr.in.s_addr = htonl(0xc0a80001);
+    key->sport = htons(1024 + flow % 60000);
+    key->dport = htons(80);
+}
+
+static void heavy_collect(lcoreid_t cid, const struct iftraf_key *key,
+                          uint64_t recv, uint64_t sent)
+{
+    uint32_t flow = ntohl(key->saddr.in.s_addr) & 0xffffff;
+
+    if (flow < nheavy) {
+        heavy_found[flow] = recv + sent;
+        heavy_seen[flow] = true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int err;
+    uint32_t i, flow, len, kept, exact;
+    uint32_t npkts = NPKTS_DEF, nflows = NFLOWS_DEF, heavy_pct = HEAVY_PCT_DEF;
+    uint64_t start, cycles, diff, max_diff = 0;
+    struct iftraf_key key;
+    struct iftraf_sketch sk;
+
+    err = rte_eal_init(argc, argv);
+    if (err < 0)
+        rte_exit(EXIT_FAILURE, "Fail to init eal!\n");
+    argc -= err;
+    argv += err;
+    nheavy = NHEAVY_DEF;
+    if (argc > 1)
+        npkts = atoi(argv[1]);
+    if (argc > 2)
+        nflows = atoi(argv[2]);
+    if (argc > 3)
+        nheavy = atoi(argv[3]);
+    if (argc > 4)
+        heavy_pct = atoi(argv[4]);
+    if (!nheavy || nheavy >= nflows || heavy_pct > 100)
+        rte_exit(EXIT_FAILURE, "bad arguments\n");
+
+    iftraf_tlb_rnd = (uint32_t)rte_rand();
+    heavy_bytes = calloc(nheavy, sizeof(uint64_t));
+    heavy_found = calloc(nheavy, sizeof(uint64_t));
+    heavy_seen = calloc(nheavy, sizeof(bool));
+    if (!heavy_bytes || !heavy_found || !heavy_seen ||
+            iftraf_sketch_alloc(&sk, IFTRAF_SK_FLOW_BUCKETS, rte_socket_id()))
+        rte_exit(EXIT_FAILURE, "no memory\n");
+
+    cycles = 0;
+    for (i = 0; i < npkts; i++) {
+        if (rte_rand() % 100 < heavy_pct)
+            flow = rte_rand() % nheavy;
+        else
+            flow = nheavy + rte_rand() % (nflows - nheavy);
+        len = 64 + rte_rand() % 1437;
+        if (flow < nheavy)
+            heavy_bytes[flow] += len;
+
+        flow_key(&key, flow);
+        start = rte_rdtsc();
+        iftraf_sketch_update(&sk, &key, len, IFTRAF_PKT_DIR_IN);
+        cycles += rte_rdtsc() - start;
+    }
+
+    iftraf_sketch_merge(0, &sk, heavy_collect);
+
+    kept = exact = 0;
+    for (i = 0; i < nheavy; i++) {
+        if (!heavy_seen[i])
+            continue;
+        kept++;
+        diff = heavy_bytes[i] - heavy_found[i];
+        if (!diff)
+            exact++;
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+
+    printf("%u pkts, %u flows, %u heavy with %u%% of pkts: %.1f cycles/update\n",
+           npkts, nflows, nheavy, heavy_pct, (double)cycles / npkts);
+    printf("heavy flows kept %u/%u, exact %u, max bytes missed %lu\n",
+           kept, nheavy, exact, max_diff);
+
+    iftraf_sketch_free(&sk);
+    free(heavy_seen);
+    free(heavy_found);
+    free(heavy_bytes);
+
+    return kept == nheavy ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+/*
+ * Micro-benchmark of IPv4 net route lookup: cycles per lookup of the
+ * rte_lpm (DIR-24-8) FIB with its route_entry index array (src/route.c)
+ * versus the netmask-sorted list scan it replaced.
+ *
+ * usage: route_lpm_bench [EAL options] -- [nroutes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <rte_lpm.h>
+#include "dpdk.h"
+#include "list.h"
+#include "route.h"
+
+#define NROUTES_DEF     4096
+#define NLOOKUPS        (1 << 22)
+
+static struct route_entry *
+list_lookup(struct list_head *table, uint32_t dest)
+{
+    struct route_entry *route;
+
+    list_for_each_entry(route, table, list) {
+        if (ip_addr_netcmp(dest, route->netmask, route))
+            return route;
+    }
+
+    return NULL;
+}
+
+/* keep the list sorted by netmask, longest first, as route_net_add() does */
+static void list_insert(struct list_head *table, struct route_entry *route)
+{
+    struct route_entry *node;
+
+    list_for_each_entry(node, table, list) {
+        if (node->netmask < route->netmask) {
+            list_add_tail(&route->list, &node->list);
+            return;
+        }
+    }
+    list_add_tail(&route->list, table);
+}
+
+int main(int argc, char *argv[])
+{
+    int err;
+    uint32_t i, nh, hit, installed, nroutes = NROUTES_DEF;
+    uint32_t *dests;
+    uint64_t start, cycles;
+    struct route_entry *routes, **entries, *route;
+    struct list_head table;
+    struct rte_lpm *lpm;
+    struct rte_lpm_config config = { .flags = 0 };
+
+    err = rte_eal_init(argc, argv);
+    if (err < 0)
+        rte_exit(EXIT_FAILURE, "Fail to init eal!\n");
+    argc -= err;
+    argv += err;
+    if (argc > 1)
+        nroutes = atoi(argv[1]);
+
+    config.max_rules = nroutes;
+    config.number_tbl8s = nroutes;
+
+    routes = rte_zmalloc("bench_routes", sizeof(*routes) * nroutes, 0);
+    entries = rte_zmalloc("bench_entries", sizeof(*entries) * nroutes, 0);
+    dests = rte_malloc("bench_dests", sizeof(uint32_t) * NLOOKUPS, 0);
+    lpm = rte_lpm_create("bench_lpm", rte_socket_id(), &config);
+    if (!routes || !entries || !dests || !lpm)
+        rte_exit(EXIT_FAILURE, "no memory\n");
+
+    /* a mix of /8 - /32 prefixes, mostly /16 - /24 like real outwall tables */
+    INIT_LIST_HEAD(&table);
+    installed = 0;
+    for (i = 0; i < nroutes; i++) {
+        route = &routes[i];
+        route->netmask = (i & 7) ? 16 + rte_rand() % 9 : 8 + rte_rand() % 25;
+        route->dest.s_addr = htonl((uint32_t)rte_rand()
+                                   & depth_to_mask(route->netmask));
+
+        if (rte_lpm_is_rule_present(lpm, ntohl(route->dest.s_addr),
+                                    route->netmask, &nh) == 1)
+            continue;   /* duplicated prefix */
+        list_insert(&table, route);
+        if (rte_lpm_add(lpm, ntohl(route->dest.s_addr), route->netmask,
+                        installed) < 0)
+            rte_exit(EXIT_FAILURE, "fail to add route %u\n", i);
+        entries[installed++] = route;
+    }
+
+    /* half of the lookups hit a configured prefix, the others are random */
+    for (i = 0; i < NLOOKUPS; i++) {
+        route = entries[rte_rand() % installed];
+        if (i & 1)
+            dests[i] = (uint32_t)rte_rand();
+        else
+            dests[i] = htonl(ntohl(route->dest.s_addr)
+                             | ((uint32_t)rte_rand() & ~depth_to_mask(route->netmask)));
+    }
+
+    /* netmask-sorted list */
+    hit = 0;
+    start = rte_rdtsc();
+    for (i = 0; i < NLOOKUPS; i++) {
+        if (list_lookup(&table, dests[i]))
+            hit++;
+    }
+    cycles = rte_rdtsc() - start;
+    printf("list: %u routes, %u/%u hits, %.1f cycles/lookup\n",
+           installed, hit, NLOOKUPS, (double)cycles / NLOOKUPS);
+
+    /* lpm + index array */
+    hit = 0;
+    start = rte_rdtsc();
+    for (i = 0; i < NLOOKUPS; i++) {
+        if (rte_lpm_lookup(lpm, rte_be_to_cpu_32(dests[i]), &nh) == 0
+                && entries[nh])
+            hit++;
+    }
+    cycles = rte_rdtsc() - start;
+    printf("lpm:  %u routes, %u/%u hits, %.1f cycles/lookup\n",
+           installed, hit, NLOOKUPS, (double)cycles / NLOOKUPS);
+
+    /* both must agree on the longest match */
+    for (i = 0; i < NLOOKUPS; i += 64) {
+        route = list_lookup(&table, dests[i]);
+        if (rte_lpm_lookup(lpm, rte_be_to_cpu_32(dests[i]), &nh) != 0)
+            nh = UINT32_MAX;
+        if (route != (nh == UINT32_MAX ? NULL : entries[nh]))
+            rte_exit(EXIT_FAILURE, "lookup mismatch for %08x\n", ntohl(dests[i]));
+    }
+
+    rte_lpm_free(lpm);
+    rte_free(dests);
+    rte_free(entries);
+    rte_free(routes);
+
+    return 0;
+}
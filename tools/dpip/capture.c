@@ -0,0 +1,459 @@
+/*
+ * DPVS is a software load balancer (Virtual Server) based on DPDK.
+ *
+ * Copyright (C) 2021 iQIYI (www.iqiyi.com).
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "conf/common.h"
+#include "dpip.h"
+#include "conf/capture.h"
+#include "sockopt.h"
+
+#define PCAP_MAGIC_NSEC     0xa1b23c4d
+#define PCAP_LINKTYPE_ETHER 1
+
+struct pcap_file_hdr {
+    uint32_t    magic;
+    uint16_t    version_major;
+    uint16_t    version_minor;
+    int32_t     thiszone;
+    uint32_t    sigfigs;
+    uint32_t    snaplen;
+    uint32_t    linktype;
+};
+
+struct pcap_rec_hdr {
+    uint32_t    ts_sec;
+    uint32_t    ts_nsec;
+    uint32_t    caplen;
+    uint32_t    len;
+};
+
+static volatile bool capture_stop;
+
+static void capture_help(void)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    dpip capture { add | set } dev NAME [ dir { rx | tx | both } ]\n"
+            "                 [ proto PROTO ] [ src ADDR[/PLEN] ] [ dst ADDR[/PLEN] ]\n"
+            "                 [ sport PORT ] [ dport PORT ] [ sample N ] [ snaplen BYTES ]\n"
+            "    dpip capture del dev NAME\n"
+            "    dpip capture flush\n"
+            "    dpip capture show [ dev NAME ]\n"
+            "    dpip capture show write { FILE | - } [ count N ]\n"
+            "Parameters:\n"
+            "    PROTO   := { tcp | udp | sctp | icmp | icmp6 | NUMBER }\n"
+            "    sample  := capture one of every N matched packets\n"
+            "    snaplen := bytes saved per packet, %d by default, %lu at most\n"
+            "Examples:\n"
+            "    dpip capture add dev dpdk0 proto tcp dst 192.168.88.100 dport 80\n"
+            "    dpip capture show write /tmp/dpdk0.pcap\n",
+            CAPTURE_SNAPLEN_DEF, CAPTURE_SNAPLEN_MAX
+           );
+}
+
+static const struct {
+    uint8_t     proto;
+    const char  *name;
+} capture_protos[] = {
+    { IPPROTO_TCP,      "tcp" },
+    { IPPROTO_UDP,      "udp" },
+    { IPPROTO_SCTP,     "sctp" },
+    { IPPROTO_ICMP,     "icmp" },
+    { IPPROTO_ICMPV6,   "icmp6" },
+};
+
+static int capture_parse_proto(const char *str, uint8_t *proto)
+{
+    int i;
+    char *end;
+    unsigned long val;
+
+    for (i = 0; i < NELEMS(capture_protos); i++) {
+        if (strcmp(str, capture_protos[i].name) == 0) {
+            *proto = capture_protos[i].proto;
+            return 0;
+        }
+    }
+
+    val = strtoul(str, &end, 10);
+    if (*end || !val || val > 255) {
+        fprintf(stderr, "invalid proto: %s\n", str);
+        return -1;
+    }
+    *proto = (uint8_t)val;
+    return 0;
+}
+
+static int capture_parse_prefix(int *af, char *str, union inet_addr *addr,
+                                uint8_t *plen)
+{
+    char *p;
+    int maxlen;
+
+    if ((p = strchr(str, '/')) != NULL)
+        *p++ = '\0';
+    if (inet_pton_try(af, str, addr) <= 0)
+        return -1;
+
+    maxlen = (*af == AF_INET) ? 32 : 128;
+    *plen = p ? atoi(p) : maxlen;
+    if (!*plen || *plen > maxlen) {
+        fprintf(stderr, "invalid prefix length: %s\n", p);
+        return -1;
+    }
+    return 0;
+}
+
+static int capture_parse_port(const char *str, uint16_t *port)
+{
+    int val = atoi(str);
+
+    if (val <= 0 || val > 65535) {
+        fprintf(stderr, "invalid port: %s\n", str);
+        return -1;
+    }
+    *port = htons(val);
+    return 0;
+}
+
+static int capture_parse_args(struct dpip_conf *conf, struct capture_conf *cf,
+                              char **file, int *count)
+{
+    int af = conf->af;
+
+    memset(cf, 0, sizeof(*cf));
+    *file = NULL;
+    *count = 0;
+
+    while (conf->argc > 0) {
+        if (strcmp(CURRARG(conf), "dev") == 0) {
+            NEXTARG_CHECK(conf, "dev");
+            snprintf(cf->ifname, sizeof(cf->ifname), "%s", CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "dir") == 0) {
+            NEXTARG_CHECK(conf, "dir");
+            if (strcmp(CURRARG(conf), "rx") == 0)
+                cf->dir = CAPTURE_DIR_RX;
+            else if (strcmp(CURRARG(conf), "tx") == 0)
+                cf->dir = CAPTURE_DIR_TX;
+            else if (strcmp(CURRARG(conf), "both") == 0)
+                cf->dir = CAPTURE_DIR_RX | CAPTURE_DIR_TX;
+            else {
+                fprintf(stderr, "invalid dir: %s\n", CURRARG(conf));
+                return -1;
+            }
+        } else if (strcmp(CURRARG(conf), "proto") == 0) {
+            NEXTARG_CHECK(conf, "proto");
+            if (capture_parse_proto(CURRARG(conf), &cf->proto) != 0)
+                return -1;
+        } else if (strcmp(CURRARG(conf), "src") == 0) {
+            NEXTARG_CHECK(conf, "src");
+            if (capture_parse_prefix(&af, CURRARG(conf), &cf->saddr,
+                                     &cf->splen) != 0)
+                return -1;
+        } else if (strcmp(CURRARG(conf), "dst") == 0) {
+            NEXTARG_CHECK(conf, "dst");
+            if (capture_parse_prefix(&af, CURRARG(conf), &cf->daddr,
+                                     &cf->dplen) != 0)
+                return -1;
+        } else if (strcmp(CURRARG(conf), "sport") == 0) {
+            NEXTARG_CHECK(conf, "sport");
+            if (capture_parse_port(CURRARG(conf), &cf->sport) != 0)
+                return -1;
+        } else if (strcmp(CURRARG(conf), "dport") == 0) {
+            NEXTARG_CHECK(conf, "dport");
+            if (capture_parse_port(CURRARG(conf), &cf->dport) != 0)
+                return -1;
+        } else if (strcmp(CURRARG(conf), "sample") == 0) {
+            NEXTARG_CHECK(conf, "sample");
+            cf->sample = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "snaplen") == 0) {
+            NEXTARG_CHECK(conf, "snaplen");
+            cf->snaplen = atoi(CURRARG(conf));
+        } else if (strcmp(CURRARG(conf), "write") == 0) {
+            NEXTARG_CHECK(conf, "write");
+            *file = CURRARG(conf);
+        } else if (strcmp(CURRARG(conf), "count") == 0) {
+            NEXTARG_CHECK(conf, "count");
+            *count = atoi(CURRARG(conf));
+        } else {
+            fprintf(stderr, "unknown argument: %s\n", CURRARG(conf));
+            return -1;
+        }
+        NEXTARG(conf);
+    }
+
+    cf->af = af;
+
+    if ((cf->sport || cf->dport) && cf->proto != IPPROTO_TCP
+            && cf->proto != IPPROTO_UDP && cf->proto != IPPROTO_SCTP) {
+        fprintf(stderr, "ports need proto tcp, udp or sctp\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void capture_dump_prefix(int af, const union inet_addr *addr, uint8_t plen)
+{
+    char buf[INET6_ADDRSTRLEN];
+
+    if (!plen) {
+        printf(" any");
+        return;
+    }
+    inet_ntop(af, addr, buf, sizeof(buf));
+    printf(" %s/%u", buf, plen);
+}
+
+static void capture_dump(const struct capture_conf *cf)
+{
+    int i;
+
+    printf("%s: dir %s%s%s", cf->ifname,
+           (cf->dir & CAPTURE_DIR_RX) ? "rx" : "",
+           cf->dir == (CAPTURE_DIR_RX | CAPTURE_DIR_TX) ? "," : "",
+           (cf->dir & CAPTURE_DIR_TX) ? "tx" : "");
+
+    if (cf->af)
+        printf(" %s", af_itoa(cf->af));
+
+    printf(" proto");
+    if (!cf->proto) {
+        printf(" any");
+    } else {
+        for (i = 0; i < NELEMS(capture_protos); i++) {
+            if (cf->proto == capture_protos[i].proto)
+                break;
+        }
+        if (i < NELEMS(capture_protos))
+            printf(" %s", capture_protos[i].name);
+        else
+            printf(" %u", cf->proto);
+    }
+
+    printf(" src");
+    capture_dump_prefix(cf->af, &cf->saddr, cf->splen);
+    if (cf->sport)
+        printf(" sport %u", ntohs(cf->sport));
+    printf(" dst");
+    capture_dump_prefix(cf->af, &cf->daddr, cf->dplen);
+    if (cf->dport)
+        printf(" dport %u", ntohs(cf->dport));
+
+    printf(" sample %u snaplen %u\n", cf->sample > 1 ? cf->sample : 1,
+           cf->snaplen);
+    printf("    matched %lu captured %lu dropped %lu\n",
+           cf->matched, cf->captured, cf->dropped);
+}
+
+static void capture_sig_handler(int sig)
+{
+    capture_stop = true;
+}
+
+static int capture_write_rec(FILE *fp, const struct capture_shm *shm,
+                             const struct capture_rec *rec)
+{
+    uint64_t delta, ns;
+    struct pcap_rec_hdr hdr;
+
+    /* tsc_hz * 1e9 doesn't overflow for any tsc_hz below 18 GHz */
+    delta = rec->tsc - shm->tsc_base;
+    ns = shm->ns_base + delta / shm->tsc_hz * 1000000000ULL
+         + delta % shm->tsc_hz * 1000000000ULL / shm->tsc_hz;
+
+    hdr.ts_sec = ns / 1000000000ULL;
+    hdr.ts_nsec = ns % 1000000000ULL;
+    hdr.caplen = rec->caplen;
+    if (hdr.caplen > shm->slot_size - sizeof(*rec))
+        hdr.caplen = shm->slot_size - sizeof(*rec);
+    hdr.len = rec->len;
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            fwrite(rec->data, hdr.caplen, 1, fp) != 1)
+        return -1;
+    return 0;
+}
+
+/*
+ * drain the capture rings into a pcap file, packets are in order per lcore
+ * but not across lcores. only one reader should be running at a time.
+ */
+static int capture_write(const char *file, int count)
+{
+    int fd, err = EDPVS_OK;
+    uint32_t i, head, tail, got;
+    uint64_t npkts = 0;
+    struct stat st;
+    FILE *fp;
+    struct capture_shm *shm;
+    struct capture_ring *ring;
+    struct pcap_file_hdr hdr;
+
+    fd = open(CAPTURE_SHM_PATH, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "fail to open %s: %s, no capture configured?\n",
+                CAPTURE_SHM_PATH, strerror(errno));
+        return EDPVS_NOTEXIST;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < sizeof(*shm)) {
+        close(fd);
+        return EDPVS_INVAL;
+    }
+    shm = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED)
+        return EDPVS_NOMEM;
+
+    if (shm->magic != CAPTURE_SHM_MAGIC || shm->version != CAPTURE_SHM_VERSION
+            || !shm->tsc_hz || capture_shm_size(shm) > st.st_size) {
+        fprintf(stderr, "bad capture memory %s\n", CAPTURE_SHM_PATH);
+        err = EDPVS_INVAL;
+        goto unmap;
+    }
+
+    fp = strcmp(file, "-") ? fopen(file, "w") : stdout;
+    if (!fp) {
+        fprintf(stderr, "fail to open %s: %s\n", file, strerror(errno));
+        err = EDPVS_IO;
+        goto unmap;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = PCAP_MAGIC_NSEC;
+    hdr.version_major = 2;
+    hdr.version_minor = 4;
+    hdr.snaplen = shm->slot_size - sizeof(struct capture_rec);
+    hdr.linktype = PCAP_LINKTYPE_ETHER;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        err = EDPVS_IO;
+        goto close;
+    }
+
+    signal(SIGINT, capture_sig_handler);
+    signal(SIGTERM, capture_sig_handler);
+
+    while (!capture_stop && (!count || npkts < count)) {
+        got = 0;
+        for (i = 0; i < shm->nrings; i++) {
+            ring = capture_ring_get(shm, i);
+            tail = ring->tail;
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            for (; tail != head && (!count || npkts < count); tail++) {
+                if (capture_write_rec(fp, shm,
+                                      capture_slot(shm, ring, tail)) != 0) {
+                    err = EDPVS_IO;
+                    goto close;
+                }
+                npkts++;
+                got++;
+            }
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+        if (!got) {
+            fflush(fp);
+            usleep(1000);
+        }
+    }
+
+close:
+    if (fp != stdout)
+        fclose(fp);
+    else
+        fflush(fp);
+    fprintf(stderr, "%lu packets captured\n", npkts);
+unmap:
+    munmap(shm, st.st_size);
+    return err;
+}
+
+static int capture_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
+                          struct dpip_conf *conf)
+{
+    int i, err, count;
+    char *file;
+    size_t size;
+    struct capture_conf cf;
+    struct capture_conf_array *array;
+
+    if (capture_parse_args(conf, &cf, &file, &count) != 0)
+        return EDPVS_INVAL;
+
+    switch (conf->cmd) {
+    case DPIP_CMD_ADD:
+    case DPIP_CMD_SET:
+    case DPIP_CMD_REPLACE:
+        if (!strlen(cf.ifname)) {
+            fprintf(stderr, "missing device\n");
+            return EDPVS_INVAL;
+        }
+        return dpvs_setsockopt(SOCKOPT_SET_CAPTURE_ADD, &cf, sizeof(cf));
+    case DPIP_CMD_DEL:
+        if (!strlen(cf.ifname)) {
+            fprintf(stderr, "missing device\n");
+            return EDPVS_INVAL;
+        }
+        return dpvs_setsockopt(SOCKOPT_SET_CAPTURE_DEL, &cf, sizeof(cf));
+    case DPIP_CMD_FLUSH:
+        return dpvs_setsockopt(SOCKOPT_SET_CAPTURE_FLUSH, NULL, 0);
+    case DPIP_CMD_SHOW:
+        if (file)
+            return capture_write(file, count);
+
+        err = dpvs_getsockopt(SOCKOPT_GET_CAPTURE_SHOW, &cf, sizeof(cf),
+                              (void **)&array, &size);
+        if (err != 0)
+            return err;
+        if (size < sizeof(*array) || size != sizeof(*array) +
+                array->nconf * sizeof(struct capture_conf)) {
+            fprintf(stderr, "corrupted response.\n");
+            dpvs_sockopt_msg_free(array);
+            return EDPVS_INVAL;
+        }
+        for (i = 0; i < array->nconf; i++)
+            capture_dump(&array->confs[i]);
+        dpvs_sockopt_msg_free(array);
+        return EDPVS_OK;
+    default:
+        return EDPVS_NOTSUPP;
+    }
+}
+
+struct dpip_obj dpip_capture = {
+    .name   = "capture",
+    .help   = capture_help,
+    .do_cmd = capture_do_cmd,
+};
+
+static void __init capture_init(void)
+{
+    dpip_register_obj(&dpip_capture);
+}
+
+static void __exit capture_exit(void)
+{
+    dpip_unregister_obj(&dpip_capture);
+}
@@ -27,7 +27,7 @@ static void eal_mem_help(void)
 {
     fprintf(stderr,
             "Usage:\n"
-            "    dpip eal-mem show [seg | ring | zone | pool] \n"
+            "    dpip eal-mem show [seg | ring | zone | pool | conn] \n"
            );
 }
 
@@ -106,6 +106,37 @@ static void list_eal_mem_ring_info(eal_all_mem_ring_ret_t *all_eal_mem_ring_ret)
     }
 }
 
+static void list_eal_mem_conn_info(eal_mem_conn_ret_t *conn_ret)
+{
+    uint64_t mem;
+    double per_conn = 0;
+
+    printf("%-12s %10s %10s %10s %10s %10s\n",
+            "part", "obj_size", "elt_size", "size", "used", "Mem(MB)");
+
+    mem = 1ULL * conn_ret->conn_elt_size * conn_ret->conn_pool_size;
+    printf("%-12s %10u %10u %10u %10u %10llu\n", "conn",
+            conn_ret->conn_size, conn_ret->conn_elt_size,
+            conn_ret->conn_pool_size, conn_ret->conn_pool_used,
+            (unsigned long long)(mem / 1024 / 1024));
+
+    mem = 1ULL * conn_ret->synproxy_elt_size * conn_ret->synproxy_pool_size;
+    printf("%-12s %10u %10u %10u %10u %10llu\n", "synproxy",
+            conn_ret->synproxy_size, conn_ret->synproxy_elt_size,
+            conn_ret->synproxy_pool_size, conn_ret->synproxy_pool_used,
+            (unsigned long long)(mem / 1024 / 1024));
+
+    /* average bytes a live session takes, extensions counted by usage */
+    if (conn_ret->conn_pool_used) {
+        per_conn = conn_ret->conn_elt_size +
+                   (double)conn_ret->synproxy_elt_size *
+                   conn_ret->synproxy_pool_used / conn_ret->conn_pool_used;
+    }
+    printf("\nbytes per session: %.1f (conn %u%s)\n", per_conn,
+            conn_ret->conn_elt_size,
+            conn_ret->synproxy_pool_used ? " + synproxy by usage" : "");
+}
+
 static int eal_mem_parse_cmd_type(struct dpip_conf *conf,
                             sockoptid_t *cmd_type)
 {
@@ -131,6 +162,9 @@ static int eal_mem_parse_cmd_type(struct dpip_conf *conf,
     else if (0 == strcmp(conf->argv[0], "pool")) {
         *cmd_type = SOCKOPT_GET_EAL_MEM_POOL;
     }
+    else if (0 == strcmp(conf->argv[0], "conn")) {
+        *cmd_type = SOCKOPT_GET_EAL_MEM_CONN;
+    }
     else {
         fprintf(stderr, "eal mem parameter invalid!\n");
         eal_mem_help();
@@ -172,6 +206,10 @@ static int eal_mem_do_cmd(struct dpip_obj *obj, dpip_cmd_t cmd,
         case SOCKOPT_GET_EAL_MEM_RING:
             list_eal_mem_ring_info((eal_all_mem_ring_ret_t *)reply);
             break;
+
+        case SOCKOPT_GET_EAL_MEM_CONN:
+            list_eal_mem_conn_info((eal_mem_conn_ret_t *)reply);
+            break;
     }
     dpvs_sockopt_msg_free(reply);
 
@@ -40,7 +40,7 @@ static void iftraf_dump(const struct iftraf_param *param)
     if (AF_INET == param->af) {
         printf("%s, [%s, %u -> ",
             param->ifname, inet_ntoa(param->saddr.in), ntohs(param->sport));
-        printf("%s, %u | %u], [%u, %u]",
+        printf("%s, %u | %u], [%lu, %lu]",
             inet_ntoa(param->daddr.in), ntohs(param->dport), param->proto, param->total_recv, param->total_sent);
 
     } else if (AF_INET6 == param->af) {
@@ -50,7 +50,7 @@ static void iftraf_dump(const struct iftraf_param *param)
         inet_ntop(AF_INET6, &param->saddr.in6, src_addr, INET6_ADDRSTRLEN);
         inet_ntop(AF_INET6, &param->daddr.in6, dst_addr, INET6_ADDRSTRLEN);
 
-        printf("%s, [%s, %u -> %s, %u | %u], [%u, %u]",
+        printf("%s, [%s, %u -> %s, %u | %u], [%lu, %lu]",
             param->ifname, src_addr, ntohs(param->sport), dst_addr, ntohs(param->dport), param->proto, param->total_recv, param->total_sent);
 
     } else {
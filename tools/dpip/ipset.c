@@ -27,7 +27,7 @@ static void ipset_help(void)
 {
 	fprintf(stderr,
                     "Usage:\n"
-                    "    dpip gfwip { add | del } IPs\n"
+                    "    dpip gfwip { add | del } { IP | PREFIX/PLEN }...\n"
                     "    dpip gfwip show\n"
                     "    dpip gfwip flush\n"
     );
@@ -35,7 +35,7 @@ static void ipset_help(void)
 
 static int ipset_parse_args(struct dpip_conf *conf, struct dp_vs_multi_ipset_conf **ips_conf, int *ips_size)
 {
-    char *ipaddr = NULL;
+    char *ipaddr = NULL, *plen;
     int ipset_size;
     int index = 0;
     struct dp_vs_multi_ipset_conf *ips;
@@ -64,13 +64,23 @@ static int ipset_parse_args(struct dpip_conf *conf, struct dp_vs_multi_ipset_con
     ips->num = conf->argc;
     while (conf->argc > 0) {
         ipaddr = conf->argv[0];
-        ips->ipset_conf[index].af = AF_INET;
+        plen = strchr(ipaddr, '/');
+        if (plen) {
+            *plen++ = '\0';
+            ips->ipset_conf[index].plen = atoi(plen);
+            if (ips->ipset_conf[index].plen == 0) {
+                fprintf(stderr, "bad prefix length\n");
+                free(ips);
+                return -1;
+            }
+        }
         if (inet_pton_try(&conf->af, ipaddr, &ips->ipset_conf[index].addr) <= 0)
         {
             fprintf(stderr, "bad IP\n");
             free(ips);
             return -1;
         }
+        ips->ipset_conf[index].af = conf->af;
         index++;
         NEXTARG(conf);
     }
@@ -87,7 +97,13 @@ static int ipset_parse_args(struct dpip_conf *conf, struct dp_vs_multi_ipset_con
 static int ipset_dump(const struct dp_vs_ipset_conf *ipconf)
 {
     char ip[64];
-    printf("%s\n", inet_ntop(ipconf->af, &ipconf->addr, ip, sizeof(ip))? ip: "");
+    uint8_t host_plen = ipconf->af == AF_INET ? 32 : 128;
+
+    if (ipconf->plen && ipconf->plen != host_plen)
+        printf("%s/%u\n", inet_ntop(ipconf->af, &ipconf->addr, ip, sizeof(ip))? ip: "",
+               ipconf->plen);
+    else
+        printf("%s\n", inet_ntop(ipconf->af, &ipconf->addr, ip, sizeof(ip))? ip: "");
     return 0;
 }
 
@@ -540,6 +540,15 @@ static int dump_cpu_stats(lcoreid_t cid)
     printf("    %-20lu%-20lu%-20lu%-20lu\n",
             get.ipackets, get.ibytes, get.opackets, get.obytes);
 
+    printf("    %-20s%-20s%-20s%-20s\n",
+            "timer_expired", "timer_cascaded", "timer_deferred", "timer_backlog");
+    printf("    %-20lu%-20lu%-20lu%-20u\n",
+            get.timer_expired, get.timer_cascaded, get.timer_deferred,
+            get.timer_backlog);
+
+    printf("    %-20s\n", "timer_max_latency");
+    printf("    %-20u\n", get.timer_max_latency);
+
     return EDPVS_OK;
 }
 
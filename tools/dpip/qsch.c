@@ -39,11 +39,13 @@ static void qsch_help(void)
         "              [ QSCH_KIND [ QOPTIONS ] ]\n"
         "\n"
         "Parameters:\n"
-        "    QSCH_KIND := { [b|p]fifo | pfifo_fast | tbf }\n"
-        "    QOPTIONS  := { FIFO_OPTS | TBF_OPTS }\n"
+        "    QSCH_KIND := { [b|p]fifo | pfifo_fast | tbf | htb }\n"
+        "    QOPTIONS  := { FIFO_OPTS | TBF_OPTS | HTB_OPTS }\n"
         "    FIFO_OPTS := [ limit NUMBER ]\n"
         "    TBF_OPTS  := rate RATE burst BYTES { latency MS | limit BYTES }\n"
         "                 [ peakrate RATE mtu BYTES ]\n"
+        "    HTB_OPTS  := rate RATE burst BYTES [ ceil RATE ] [ cburst BYTES ]\n"
+        "                 [ latency MS | limit BYTES ]\n"
         "    RATE      := raw bits per-second, and possible followed by\n"
         "                 a SI unit (k, m, g).\n"
         "    MS        := milliseconds.\n"
@@ -145,7 +147,8 @@ static int qsch_parse(struct dpip_obj *obj, struct dpip_conf *cf)
         } else if (strcmp(CURRARG(cf), "bfifo") == 0 ||
                    strcmp(CURRARG(cf), "pfifo") == 0 ||
                    strcmp(CURRARG(cf), "pfifo_fast") == 0 ||
-                   strcmp(CURRARG(cf), "tbf") == 0) {
+                   strcmp(CURRARG(cf), "tbf") == 0 ||
+                   strcmp(CURRARG(cf), "htb") == 0) {
             snprintf(param->kind, TCNAMESIZ, "%s", CURRARG(cf));
         } else { /* kind must be set ahead then QOPTIONS */
             if (strcmp(&param->kind[1], "fifo") == 0) {
@@ -198,6 +201,46 @@ static int qsch_parse(struct dpip_obj *obj, struct dpip_conf *cf)
                             param->kind, CURRARG(cf));
                     return EDPVS_INVAL;
                 }
+            } else if (strcmp(param->kind, "htb") == 0) {
+                if (strcmp(CURRARG(cf), "rate") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.htb.rate.rate = rate_atoi(CURRARG(cf));
+                    if (!param->qopt.htb.rate.rate) {
+                        fprintf(stderr, "invalid rate: '%s'\n", CURRARG(cf));
+                        return EDPVS_INVAL;
+                    }
+                } else if (strcmp(CURRARG(cf), "ceil") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.htb.ceil.rate = rate_atoi(CURRARG(cf));
+                    if (!param->qopt.htb.ceil.rate) {
+                        fprintf(stderr, "invalid ceil: '%s'\n", CURRARG(cf));
+                        return EDPVS_INVAL;
+                    }
+                } else if (strcmp(CURRARG(cf), "burst") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.htb.buffer = atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "cburst") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.htb.cbuffer = atoi(CURRARG(cf));
+                } else if (strcmp(CURRARG(cf), "latency") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+
+                    if (!param->qopt.htb.rate.rate) {
+                        fprintf(stderr, "latency set before rate ?\n");
+                        return EDPVS_INVAL;
+                    }
+
+                    param->qopt.htb.limit = \
+                        latency_to_limit(CURRARG(cf),
+                                         param->qopt.htb.rate.rate);
+                } else if (strcmp(CURRARG(cf), "limit") == 0) {
+                    NEXTARG_CHECK(cf, CURRARG(cf));
+                    param->qopt.htb.limit = atoi(CURRARG(cf));
+                } else {
+                    fprintf(stderr, "invalid option for %s: '%s'\n",
+                            param->kind, CURRARG(cf));
+                    return EDPVS_INVAL;
+                }
             } else if (strcmp(param->kind, "pfifo_fast") == 0) {
                 ; // pfifo_fast doesn't have any param
             } else {
@@ -242,6 +285,20 @@ static int qsch_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
                 fprintf(stderr, "missing buffer for tbf.\n");
                 return EDPVS_INVAL;
             }
+        } else if (strcmp(param->kind, "htb") == 0) {
+            if (!param->qopt.htb.rate.rate) {
+                fprintf(stderr, "missing rate for htb.\n");
+                return EDPVS_INVAL;
+            }
+            if (!param->qopt.htb.buffer) {
+                fprintf(stderr, "missing buffer for htb.\n");
+                return EDPVS_INVAL;
+            }
+            if (param->qopt.htb.ceil.rate &&
+                param->qopt.htb.ceil.rate < param->qopt.htb.rate.rate) {
+                fprintf(stderr, "ceil lower than rate for htb.\n");
+                return EDPVS_INVAL;
+            }
         } else if (strcmp(param->kind, "pfifo_fast") == 0) {
             ;
         } else {
@@ -261,7 +318,8 @@ static int qsch_check(const struct dpip_obj *obj, dpip_cmd_t cmd)
 
         if (strcmp(param->kind, "pfifo") != 0 &&
             strcmp(param->kind, "bfifo") != 0 &&
-            strcmp(param->kind, "tbf") != 0) {
+            strcmp(param->kind, "tbf") != 0 &&
+            strcmp(param->kind, "htb") != 0) {
             fprintf(stderr, "qsch kind '%s' doesn't support SET.\n", param->kind);
             return EDPVS_INVAL;
         }
@@ -324,6 +382,15 @@ static void qsch_dump_param(const char *ifname, const union tc_param *param,
                    rate_itoa(tbf->peakrate.rate, rate, sizeof(rate)), tbf->mtu);
 
         printf(" limit %uB", tbf->limit);
+    } else if (strcmp(qsch->kind, "htb") == 0) {
+        const struct tc_htb_qopt *htb = &qsch->qopt.htb;
+
+        printf(" rate %s burst %uB",
+               rate_itoa(htb->rate.rate, rate, sizeof(rate)), htb->buffer);
+        printf(" ceil %s cburst %uB",
+               rate_itoa(htb->ceil.rate, rate, sizeof(rate)), htb->cbuffer);
+
+        printf(" limit %uB", htb->limit);
     }
     printf("\n");
 
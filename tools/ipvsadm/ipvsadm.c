@@ -209,6 +209,10 @@ static const char* optnames[] = {
 	"cpu",
 	"expire-quiescent",
 	"whtlst-address",
+	"conn-limit",
+	"bps-limit",
+	"conn-state",
+	"conn-client",
 };
 
 /*
@@ -221,53 +225,53 @@ static const char* optnames[] = {
  */
 static const char commands_v_options[NUMBER_OF_CMD][NUMBER_OF_OPT] =
 {
-/*   -n   -c   svc  -s   -p   -M   -r   fwd  -w   -x   -y   -mc  tot  dmn  -st  -rt  thr  -pc  srt  sid  -ex  ops  pe laddr blst syn ifname sockpair hashtag cpu expire-quiescent wlst*/
+/*   -n   -c   svc  -s   -p   -M   -r   fwd  -w   -x   -y   -mc  tot  dmn  -st  -rt  thr  -pc  srt  sid  -ex  ops  pe laddr blst syn ifname sockpair hashtag cpu expire-quiescent wlst climit blimit cstate cclient*/
 /*ADD*/
-    {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', ' ', 'x' ,'x' ,' ', 'x', ' ', 'x'},
+    {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', ' ', 'x' ,'x' ,' ', 'x', ' ', 'x', 'x', 'x', 'x', 'x'},
 /*EDIT*/
-    {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', ' ', 'x' ,'x' ,' ', 'x', ' ', 'x'},
+    {'x', 'x', '+', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', ' ', 'x' ,'x' ,' ', 'x', ' ', 'x', 'x', 'x', 'x', 'x'},
 /*DEL*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*FLUSH*/
-    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*LIST*/
-    {' ', '1', '1', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '1', '1', ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x' ,' ' ,'x', ' ', 'x', 'x'},
+    {' ', '1', ' ', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', '1', '1', ' ', ' ', ' ', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x' ,' ' ,'x', ' ', 'x', 'x', 'x', 'x', ' ', ' '},
 /*ADDSRV*/
-    {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', ' ', ' ', 'x', 'x'},
 /*DELSRV*/
-    {'x', 'x', '+', 'x', 'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*EDITSRV*/
-    {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', '+', ' ', ' ', ' ', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', ' ', ' ', 'x', 'x'},
 /*TIMEOUT*/
-    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*STARTD*/
-    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*STOPD*/
-    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*RESTORE*/
-    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*SAVE*/
-    {' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*ZERO*/
-    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*ADDLADDR*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x', '+' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x', '+' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*DELLADDR*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x', '+' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x', '+' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*GETLADDR*/
-    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', ' ', 'x', 'x'},
+    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*ADDBLKLST*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*DELBLKLST*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', '+', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*GETBLKLST*/
-    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 /*ADDWHTLST*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', '+'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', '+', 'x', 'x', 'x', 'x'},
 /*DELWHTLST*/
-    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', '+'},
+    {'x', 'x', '+', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', '+', 'x', 'x', 'x', 'x'},
 /*GETWHTLST*/
-    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x'},
+    {'x', 'x', ' ', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x' ,'x' ,'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x'},
 };
 
 /* printing format flags */
@@ -300,7 +304,9 @@ struct ipvs_command_entry {
 	ipvs_laddr_t		laddr;
 	ipvs_blklst_t		blklst;
 	ipvs_whtlst_t		whtlst;
+	char			*acl_file;	/* bulk blklst/whtlst addresses */
 	ipvs_sockpair_t		sockpair;
+	struct ip_vs_conn_filter conn_filter;	/* conns to list */
 	lcoreid_t		cid;
 };
 
@@ -324,6 +330,10 @@ enum {
 	TAG_SOCKPAIR,
 	TAG_CPU,
 	TAG_CONN_EXPIRE_QUIESCENT,
+	TAG_CONN_LIMIT,
+	TAG_BPS_LIMIT,
+	TAG_CONN_STATE,
+	TAG_CONN_CLIENT,
 };
 
 /* various parsing helpers & parsing functions */
@@ -338,6 +348,9 @@ static char * port_to_anyname(unsigned short port, unsigned short proto);
 static char * addrport_to_anyname(int af, const void *addr, unsigned short port,
 				  unsigned short proto, unsigned int format);
 static int parse_service(char *buf, ipvs_service_t *svc);
+static int parse_acl_address(char *buf, u_int16_t *af,
+			     union nf_inet_addr *addr, u_int8_t *plen);
+static int set_acls_from_file(struct ipvs_command_entry *ce);
 static int parse_netmask(char *buf, u_int32_t *addr);
 static int parse_timeout(char *buf, int min, int max);
 static unsigned int parse_fwmark(char *buf);
@@ -345,9 +358,10 @@ static int parse_sockpair(char *buf, ipvs_sockpair_t *sockpair);
 static int parse_match_snat(const char *buf, ipvs_service_t *svc);
 
 /* check the options based on the commands_v_options table */
-static void generic_opt_check(int command, unsigned int options);
+static void generic_opt_check(int command, unsigned long long options);
 static void set_command(int *cmd, const int newcmd);
-static void set_option(unsigned int *options, unsigned int option);
+static void set_option(unsigned long long *options,
+		       unsigned long long option);
 
 static void tryhelp_exit(const char *program, const int exit_status);
 static void usage_exit(const char *program, const int exit_status);
@@ -356,7 +370,8 @@ static void version(FILE *stream);
 static void fail(int err, char *msg, ...);
 
 /* various listing functions */
-static void list_conn(int is_template, unsigned int format);
+static void list_conn(int is_template, const struct ip_vs_conn_filter *filter,
+		      unsigned int format);
 static void list_conn_sockpair(int is_template,
 		ipvs_sockpair_t *sockpair, unsigned int format);
 static void list_service(ipvs_service_t *svc, unsigned int format, lcoreid_t cid);
@@ -405,7 +420,7 @@ int main(int argc, char **argv)
 
 static int
 parse_options(int argc, char **argv, struct ipvs_command_entry *ce,
-	      unsigned int *options, unsigned int *format)
+	      unsigned long long *options, unsigned int *format)
 {
 	int c, parse;
 	poptContext context;
@@ -498,6 +513,10 @@ parse_options(int argc, char **argv, struct ipvs_command_entry *ce,
 		{ "hash-target", 'Y', POPT_ARG_STRING, &optarg, 'Y', NULL, NULL },
 		{ "cpu", '\0', POPT_ARG_STRING, &optarg, TAG_CPU, NULL, NULL },
 		{ "expire-quiescent", '\0', POPT_ARG_NONE, NULL, TAG_CONN_EXPIRE_QUIESCENT, NULL, NULL },
+		{ "conn-limit", '\0', POPT_ARG_STRING, &optarg, TAG_CONN_LIMIT, NULL, NULL },
+		{ "bps-limit", '\0', POPT_ARG_STRING, &optarg, TAG_BPS_LIMIT, NULL, NULL },
+		{ "conn-state", '\0', POPT_ARG_STRING, &optarg, TAG_CONN_STATE, NULL, NULL },
+		{ "conn-client", '\0', POPT_ARG_STRING, &optarg, TAG_CONN_CLIENT, NULL, NULL },
 		{ NULL, 0, 0, NULL, 0, NULL, NULL }
 	};
 
@@ -801,27 +820,29 @@ parse_options(int argc, char **argv, struct ipvs_command_entry *ce,
 			}
 		case 'k':
 			{
-			ipvs_service_t		nsvc;
 			set_option(options,OPT_BLKLST_ADDRESS);
-			parse = parse_service(optarg, &nsvc);
-			if (!(parse & SERVICE_ADDR))
+			if (optarg[0] == '@') {
+				ce->acl_file = optarg + 1;
+				break;
+			}
+			if (parse_acl_address(optarg, &ce->blklst.af,
+					      &ce->blklst.addr, &ce->blklst.plen) < 0)
 				fail(2, "illegal blacklist address");
-			ce->blklst.af = nsvc.af;
-			ce->blklst.addr = nsvc.nf_addr;
-			ce->blklst.__addr_v4 = nsvc.nf_addr.ip;
+			ce->blklst.__addr_v4 = ce->blklst.addr.ip;
 			break;
 
 			}
 		case '2':
 			{
-			ipvs_service_t		nsvc;
 			set_option(options,OPT_WHTLST_ADDRESS);
-			parse = parse_service(optarg, &nsvc);
-			if (!(parse & SERVICE_ADDR))
+			if (optarg[0] == '@') {
+				ce->acl_file = optarg + 1;
+				break;
+			}
+			if (parse_acl_address(optarg, &ce->whtlst.af,
+					      &ce->whtlst.addr, &ce->whtlst.plen) < 0)
 				fail(2, "illegal whitelist address");
-			ce->whtlst.af = nsvc.af;
-			ce->whtlst.addr = nsvc.nf_addr;
-			ce->whtlst.__addr_v4 = nsvc.nf_addr.ip;
+			ce->whtlst.__addr_v4 = ce->whtlst.addr.ip;
 			break;
 
 			}
@@ -874,6 +895,43 @@ parse_options(int argc, char **argv, struct ipvs_command_entry *ce,
 			ce->svc.user.flags = ce->svc.user.flags | IP_VS_CONN_F_EXPIRE_QUIESCENT;
 			break;
 			}
+		case TAG_CONN_LIMIT:
+			set_option(options, OPT_CONN_LIMIT);
+			if ((ce->dest.user.max_cps =
+			     string_to_number(optarg, 0, INT_MAX)) == -1)
+				fail(2, "illegal conn-limit specified");
+			break;
+		case TAG_BPS_LIMIT:
+		{
+			char *end;
+
+			set_option(options, OPT_BPS_LIMIT);
+			errno = 0;
+			ce->dest.user.max_bps = strtoull(optarg, &end, 10);
+			if (!str_is_digit(optarg) || errno || *end != '\0')
+				fail(2, "illegal bps-limit specified");
+			break;
+		}
+		case TAG_CONN_STATE:
+			set_option(options, OPT_CONN_STATE);
+			if (strlen(optarg) >= sizeof(ce->conn_filter.state))
+				fail(2, "illegal conn-state specified");
+			strcpy(ce->conn_filter.state, optarg);
+			break;
+		case TAG_CONN_CLIENT:
+		{
+			u_int16_t af;
+			u_int8_t plen;
+			union nf_inet_addr addr;
+
+			set_option(options, OPT_CONN_CLIENT);
+			if (parse_acl_address(optarg, &af, &addr, &plen) != 0)
+				fail(2, "illegal conn-client address[/plen] specified");
+			ce->conn_filter.caf = af;
+			ce->conn_filter.cplen = plen;
+			memcpy(&ce->conn_filter.caddr, &addr, sizeof(ce->conn_filter.caddr));
+			break;
+		}
 		default:
 			fail(2, "invalid option `%s'",
 			     poptBadOption(context, POPT_BADOPTION_NOALIAS));
@@ -938,7 +996,7 @@ static int restore_table(int argc, char **argv, int reading_stdin)
 static int process_options(int argc, char **argv, int reading_stdin)
 {
 	struct ipvs_command_entry ce;
-	unsigned int options = OPT_NONE;
+	unsigned long long options = OPT_NONE;
 	unsigned int format = FMT_NONE;
 	int result = 0;
 
@@ -1000,12 +1058,30 @@ static int process_options(int argc, char **argv, int reading_stdin)
 		     options & OPT_PERSISTENTCONN))
 			fail(2, "options conflicts in the list command");
 
+		if (!(options & OPT_CONNECTION) &&
+		    options & (OPT_SERVER|OPT_CONN_STATE|OPT_CONN_CLIENT))
+			fail(2, "connection filters are only for the -c option");
+
 		if (options & OPT_CONNECTION)
             if (options & OPT_SOCKPAIR)
                 list_conn_sockpair(options & OPT_PERSISTENTCONN,
 						&ce.sockpair, format);
-            else
-                list_conn(options & OPT_PERSISTENTCONN, format);
+            else {
+                if (options & OPT_SERVICE) {
+                    ce.conn_filter.proto = ce.svc.user.protocol;
+                    ce.conn_filter.vaf = ce.svc.af;
+                    memcpy(&ce.conn_filter.vaddr, &ce.svc.nf_addr,
+                           sizeof(ce.conn_filter.vaddr));
+                    ce.conn_filter.vport = ce.svc.user.port;
+                }
+                if (options & OPT_SERVER) {
+                    ce.conn_filter.daf = ce.dest.af;
+                    memcpy(&ce.conn_filter.daddr, &ce.dest.nf_addr,
+                           sizeof(ce.conn_filter.daddr));
+                    ce.conn_filter.dport = ce.dest.user.port;
+                }
+                list_conn(options & OPT_PERSISTENTCONN, &ce.conn_filter, format);
+            }
 		else if (options & OPT_SERVICE)
 			list_service(&ce.svc, format, ce.cid);
 		else if (options & OPT_TIMEOUT)
@@ -1084,11 +1160,17 @@ static int process_options(int argc, char **argv, int reading_stdin)
 		break;
 
 	case CMD_ADDBLKLST:
-		result = ipvs_add_blklst(&ce.svc , &ce.blklst);
+		if (ce.acl_file)
+			result = set_acls_from_file(&ce);
+		else
+			result = ipvs_add_blklst(&ce.svc , &ce.blklst);
 		break;
 
 	case CMD_DELBLKLST:
-		result = ipvs_del_blklst(&ce.svc , &ce.blklst);
+		if (ce.acl_file)
+			result = set_acls_from_file(&ce);
+		else
+			result = ipvs_del_blklst(&ce.svc , &ce.blklst);
 		break;
 
 	case CMD_GETBLKLST:
@@ -1101,11 +1183,17 @@ static int process_options(int argc, char **argv, int reading_stdin)
 		break;
 
 	case CMD_ADDWHTLST:
-		result = ipvs_add_whtlst(&ce.svc , &ce.whtlst);
+		if (ce.acl_file)
+			result = set_acls_from_file(&ce);
+		else
+			result = ipvs_add_whtlst(&ce.svc , &ce.whtlst);
 		break;
 
 	case CMD_DELWHTLST:
-		result = ipvs_del_whtlst(&ce.svc , &ce.whtlst);
+		if (ce.acl_file)
+			result = set_acls_from_file(&ce);
+		else
+			result = ipvs_del_whtlst(&ce.svc , &ce.whtlst);
 		break;
 
 	case CMD_GETWHTLST:
@@ -1263,6 +1351,117 @@ parse_service(char *buf, ipvs_service_t *svc)
 
 	return result;
 }
+/*
+ * Get a blacklist/whitelist address from the argument.
+ * address := ip address or ip/plen prefix
+ */
+static int
+parse_acl_address(char *buf, u_int16_t *af, union nf_inet_addr *addr,
+		  u_int8_t *plen)
+{
+	ipvs_service_t svc;
+	char *p;
+	long n = -1;
+
+	p = strchr(buf, '/');
+	if (p != NULL) {
+		*p++ = '\0';
+		if ((n = string_to_number(p, 0, 128)) == -1)
+			return -1;
+	}
+
+	memset(&svc, 0, sizeof(svc));
+	if (!(parse_service(buf, &svc) & SERVICE_ADDR))
+		return -1;
+	if (n == -1)
+		n = (svc.af == AF_INET) ? 32 : 128;
+	else if (svc.af == AF_INET && n > 32)
+		return -1;
+
+	*af = svc.af;
+	*addr = svc.nf_addr;
+	*plen = n;
+	return 0;
+}
+
+/* one address per line, '#' starts a comment */
+static int
+load_acl_file(const char *path, ipvs_blklst_t **entries)
+{
+	FILE *fp;
+	char line[256];
+	int n = 0, size = 0, lineno = 0;
+	ipvs_blklst_t *array = NULL, *tmp;
+
+	if (!(fp = fopen(path, "r")))
+		fail(2, "fail to open %s: %s", path, strerror(errno));
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		line[strcspn(line, "# \t\r\n")] = '\0';
+		if (line[0] == '\0')
+			continue;
+
+		if (n == size) {
+			size = size ? size * 2 : 256;
+			if (!(tmp = realloc(array, size * sizeof(*array))))
+				fail(2, "no memory");
+			array = tmp;
+		}
+
+		memset(&array[n], 0, sizeof(*array));
+		if (parse_acl_address(line, &array[n].af, &array[n].addr,
+				      &array[n].plen) < 0)
+			fail(2, "%s:%d: illegal address %s", path, lineno, line);
+		array[n].__addr_v4 = array[n].addr.ip;
+		n++;
+	}
+	fclose(fp);
+
+	*entries = array;
+	return n;
+}
+
+/* all addresses of the file are set in one request */
+static int
+set_acls_from_file(struct ipvs_command_entry *ce)
+{
+	ipvs_blklst_t *blklsts;
+	ipvs_whtlst_t *whtlsts;
+	int i, n, result;
+
+	n = load_acl_file(ce->acl_file, &blklsts);
+	if (n == 0)
+		return 0;
+
+	switch (ce->cmd) {
+	case CMD_ADDBLKLST:
+		result = ipvs_add_blklsts(&ce->svc, blklsts, n);
+		break;
+	case CMD_DELBLKLST:
+		result = ipvs_del_blklsts(&ce->svc, blklsts, n);
+		break;
+	default:
+		if (!(whtlsts = calloc(n, sizeof(*whtlsts))))
+			fail(2, "no memory");
+		for (i = 0; i < n; i++) {
+			whtlsts[i].__addr_v4 = blklsts[i].__addr_v4;
+			whtlsts[i].af = blklsts[i].af;
+			whtlsts[i].addr = blklsts[i].addr;
+			whtlsts[i].plen = blklsts[i].plen;
+		}
+		if (ce->cmd == CMD_ADDWHTLST)
+			result = ipvs_add_whtlsts(&ce->svc, whtlsts, n);
+		else
+			result = ipvs_del_whtlsts(&ce->svc, whtlsts, n);
+		free(whtlsts);
+		break;
+	}
+
+	free(blklsts);
+	return result;
+}
+
 /*
  * Get sockpair from the arguments.
  * sockpair := PROTO:SIP:SPORT:TIP:TPORT
@@ -1432,7 +1631,7 @@ static int parse_match_snat(const char *buf, ipvs_service_t *svc)
 }
 
 static void
-generic_opt_check(int command, unsigned int options)
+generic_opt_check(int command, unsigned long long options)
 {
 	int i, j;
 	int last = 0, count = 0;
@@ -1441,7 +1640,7 @@ generic_opt_check(int command, unsigned int options)
 	i = command - CMD_NONE -1;
 
 	for (j = 0; j < NUMBER_OF_OPT; j++) {
-		if (!(options & (1<<j))) {
+		if (!(options & (1ULL<<j))) {
 			if (commands_v_options[i][j] == '+')
 				fail(2, "You need to supply the '%s' "
 				     "option for the '%s' command",
@@ -1466,7 +1665,7 @@ generic_opt_check(int command, unsigned int options)
 }
 
 static inline const char *
-opt2name(int option)
+opt2name(unsigned long long option)
 {
 	const char **ptr;
 	for (ptr = optnames; option > 1; option >>= 1, ptr++);
@@ -1483,7 +1682,7 @@ set_command(int *cmd, const int newcmd)
 }
 
 static void
-set_option(unsigned int *options, unsigned int option)
+set_option(unsigned long long *options, unsigned long long option)
 {
 	if (*options & option)
 		fail(2, "multiple '%s' options specified", opt2name(option));
@@ -1585,6 +1784,12 @@ static void usage_exit(const char *program, const int exit_status)
 		"  --weight       -w weight            capacity of real server\n"
 		"  --u-threshold  -x uthreshold        upper threshold of connections\n"
 		"  --l-threshold  -y lthreshold        lower threshold of connections\n"
+		"  --conn-limit cps                    limit of new connections per second to real server\n"
+		"  --bps-limit bytes                   limit of bytes per second to real server\n"
+		"  --blklst       -k address[/plen]    blacklist address or prefix,\n"
+		"                                      @file to load one per line\n"
+		"  --whtlst       -2 address[/plen]    whitelist address or prefix,\n"
+		"                                      @file to load one per line\n"
 		"  --mcast-interface interface         multicast interface for connection sync\n"
 		"  --syncid sid                        syncid for connection sync (default=255)\n"
 		"  --connection   -c                   output of current IPVS connections\n"
@@ -1596,6 +1801,8 @@ static void usage_exit(const char *program, const int exit_status)
 		"  --thresholds                        output of thresholds information\n"
 		"  --persistent-conn                   output of persistent connection info\n"
 		"  --sockpair                          output connection info of specified socket pair (proto:sip:sport:tip:tport)\n"
+		"  --conn-state   state                list connections in state (e.g. TCP_EST), with -c\n"
+		"  --conn-client  address[/plen]       list connections from client address or prefix, with -c\n"
 		"  --nosort                            disable sorting output of service/server entries\n"
 		"  --sort                              does nothing, for backwards compatibility\n"
 		"  --ops          -o                   one-packet scheduling\n"
@@ -1694,7 +1901,8 @@ exit:
 		free(dname);
 }
 
-static void list_conn(int is_template, unsigned int format)
+static void list_conn(int is_template, const struct ip_vs_conn_filter *filter,
+		      unsigned int format)
 {
     struct ip_vs_conn_array *conn_array;
     struct ip_vs_conn_req req;
@@ -1704,12 +1912,16 @@ static void list_conn(int is_template, unsigned int format)
     if (is_template)
         req.flag |= GET_IPVS_CONN_FLAG_TEMPLATE;
     req.flag |= GET_IPVS_CONN_FLAG_ALL;
+    req.filter = *filter;
 
+    /* pages are printed as they come, a page may be empty */
     while((conn_array = ip_vs_get_conns(&req)) != NULL) {
 		for (i = 0; i < conn_array->nconns; i++)
 			print_conn_entry(&conn_array->array[i], format);
         req.whence = conn_array->curcid;
-        more = conn_array->resl & GET_IPVS_CONN_FLAG_MORE;
+        req.cursor = conn_array->cursor;
+        req.skip = conn_array->skip;
+        more = conn_array->resl & GET_IPVS_CONN_RESL_MORE;
         free(conn_array);
         if (!more)
             break;
@@ -1836,10 +2048,11 @@ static void print_title(unsigned int format)
 		       "Prot LocalAddress:Port",
 		       "CPS", "InPPS", "OutPPS", "InBPS", "OutBPS");
 	else if (format & FMT_THRESHOLDS)
-		printf("%-33s %-10s %-10s %-10s %-10s\n"
+		printf("%-33s %-10s %-10s %-10s %-10s %-10s %-12s %-10s\n"
 		       "  -> RemoteAddress:Port\n",
 		       "Prot LocalAddress:Port",
-		       "Uthreshold", "Lthreshold", "ActiveConn", "InActConn");
+		       "Uthreshold", "Lthreshold", "ActiveConn", "InActConn",
+		       "ConnLimit", "BpsLimit", "LimitDrops");
 	else if (format & FMT_PERSISTENTCONN)
 		printf("%-33s %-9s %-11s %-10s %-10s\n"
 		       "  -> RemoteAddress:Port\n",
@@ -2038,8 +2251,14 @@ print_service_entry(ipvs_service_entry_t *se, unsigned int format, lcoreid_t cid
 			dname[28] = '\0';
 
 		if (format & FMT_RULE) {
-			printf("-a %s -r %s %s -w %d\n", svc_name, dname,
+			printf("-a %s -r %s %s -w %d", svc_name, dname,
 			       fwd_switch(e->user.conn_flags), e->user.weight);
+			if (e->user.max_cps)
+				printf(" --conn-limit %u", e->user.max_cps);
+			if (e->user.max_bps)
+				printf(" --bps-limit %llu",
+				       (unsigned long long)e->user.max_bps);
+			printf("\n");
 		} else if (format & FMT_STATS) {
 			printf("  -> %-28s", dname);
 			print_largenum(e->stats.conns, format);
@@ -2057,9 +2276,12 @@ print_service_entry(ipvs_service_entry_t *se, unsigned int format, lcoreid_t cid
 			print_largenum(e->stats.outbps, format);
 			printf("\n");
 		} else if (format & FMT_THRESHOLDS) {
-			printf("  -> %-28s %-10u %-10u %-10u %-10u\n", dname,
-			       e->user.u_threshold, e->user.l_threshold,
-			       e->user.activeconns, e->user.inactconns);
+			printf("  -> %-28s %-10u %-10u %-10u %-10u %-10u %-12llu %-10llu\n",
+			       dname, e->user.u_threshold, e->user.l_threshold,
+			       e->user.activeconns, e->user.inactconns,
+			       e->user.max_cps,
+			       (unsigned long long)e->user.max_bps,
+			       (unsigned long long)e->user.limit_drops);
 		} else if (format & FMT_PERSISTENTCONN) {
 			printf("  -> %-28s %-9u %-11u %-10u %-10u\n", dname,
 			       e->user.weight, e->user.persistconns,
@@ -2213,8 +2435,12 @@ static void print_service_and_blklsts(struct dp_vs_blklst_conf *blklst)
 
 	snprintf(port, sizeof(port), "%u", ntohs(blklst->vport));
 
+	inet_ntop(blklst->af, (const void *)&blklst->blklst, bip, sizeof(bip));
+	if (blklst->plen != (blklst->af == AF_INET ? 32 : 128))
+		snprintf(bip + strlen(bip), sizeof(bip) - strlen(bip), "/%u", blklst->plen);
+
 	printf(pattern, inet_ntop(blklst->af, (const void *)&blklst->vaddr, vip, sizeof(vip)),
-			port, proto, inet_ntop(blklst->af, (const void *)&blklst->blklst, bip, sizeof(bip)));
+			port, proto, bip);
 }
 
 static bool inet_addr_equal(int af, const union nf_inet_addr *a1, const union nf_inet_addr *a2)
@@ -2301,8 +2527,12 @@ static void print_service_and_whtlsts(struct dp_vs_whtlst_conf *whtlst)
 
 	snprintf(port, sizeof(port), "%u", ntohs(whtlst->vport));
 
+	inet_ntop(whtlst->af, (const void *)&whtlst->whtlst, bip, sizeof(bip));
+	if (whtlst->plen != (whtlst->af == AF_INET ? 32 : 128))
+		snprintf(bip + strlen(bip), sizeof(bip) - strlen(bip), "/%u", whtlst->plen);
+
 	printf(pattern, inet_ntop(whtlst->af, (const void *)&whtlst->vaddr, vip, sizeof(vip)),
-			port, proto, inet_ntop(whtlst->af, (const void *)&whtlst->whtlst, bip, sizeof(bip)));
+			port, proto, bip);
 }
 static int list_whtlst(int af, const union nf_inet_addr *addr, uint16_t port, uint16_t protocol)
 {
@@ -2359,6 +2589,33 @@ static void list_service(ipvs_service_t *svc, unsigned int format, lcoreid_t cid
 }
 
 
+/* the sum of all services */
+static void print_total(unsigned int format)
+{
+	struct ip_vs_stats_user st;
+
+	if (ipvs_get_stats(&st)) {
+		fprintf(stderr, "%s\n", ipvs_strerror(errno));
+		return;
+	}
+
+	printf("%-33s", "TOTAL");
+	if (format & FMT_STATS) {
+		print_largenum(st.conns, format);
+		print_largenum(st.inpkts, format);
+		print_largenum(st.outpkts, format);
+		print_largenum(st.inbytes, format);
+		print_largenum(st.outbytes, format);
+	} else {
+		print_largenum(st.cps, format);
+		print_largenum(st.inpps, format);
+		print_largenum(st.outpps, format);
+		print_largenum(st.inbps, format);
+		print_largenum(st.outbps, format);
+	}
+	printf("\n");
+}
+
 static void list_all(unsigned int format, lcoreid_t cid)
 {
 	struct ip_vs_get_services_app *get;
@@ -2380,6 +2637,9 @@ static void list_all(unsigned int format, lcoreid_t cid)
 	for (i = 0; i < get->user.num_services; i++)
 		print_service_entry(&get->user.entrytable[i], format, cid);
 	free(get);
+
+	if (!(format & FMT_RULE) && (format & (FMT_STATS | FMT_RATE)))
+		print_total(format);
 }
 
 
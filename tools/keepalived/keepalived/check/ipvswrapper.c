@@ -43,6 +43,20 @@
 static bool no_ipvs = false;
 
 static void ipvs_set_srule(int cmd, ipvs_service_t *srule, virtual_server_t *vs);
+
+/* dests of one service collected between ipvs_dest_batch_begin/end */
+#define IPVS_DEST_BATCH_MAX	256
+
+static struct {
+	int		depth;
+	int		cmd;
+	int		num;
+	ipvs_service_t	srule;
+	ipvs_dest_t	drules[IPVS_DEST_BATCH_MAX];
+} dest_batch;
+
+static int ipvs_dest_batch_flush(void);
+static bool ipvs_dest_batch_add(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule);
 /*
  *  * Utility functions coming from Wensong code
  *   */
@@ -158,6 +172,13 @@ ipvs_talk(int cmd,
 	if (no_ipvs)
 		return result;
 
+	if (dest_batch.depth) {
+		if (ipvs_dest_batch_add(cmd, srule, drule))
+			return 0;
+		/* keep the order of requests */
+		ipvs_dest_batch_flush();
+	}
+
 	switch (cmd) {
 		case IP_VS_SO_SET_STARTDAEMON:
 			result = ipvs_start_daemon(daemonrule);
@@ -243,6 +264,79 @@ ipvs_talk(int cmd,
 	return result;
 }
 
+static int
+ipvs_dest_batch_flush(void)
+{
+	int i, n = dest_batch.num, depth = dest_batch.depth;
+	int result = -1;
+
+	if (!n)
+		return 0;
+	dest_batch.num = 0;
+
+	switch (dest_batch.cmd) {
+		case IP_VS_SO_SET_ADDDEST:
+			result = ipvs_add_dests(&dest_batch.srule, dest_batch.drules, n);
+			break;
+		case IP_VS_SO_SET_DELDEST:
+			result = ipvs_del_dests(&dest_batch.srule, dest_batch.drules, n);
+			break;
+		case IP_VS_SO_SET_EDITDEST:
+			result = ipvs_update_dests(&dest_batch.srule, dest_batch.drules, n);
+			break;
+	}
+
+	if (!result)
+		return 0;
+
+	/* dpvs applies none of a failing batch, so replay it one dest at a
+	 * time to get the per-dest error handling of ipvs_talk */
+	dest_batch.depth = 0;
+	result = 0;
+	for (i = 0; i < n; i++)
+		result |= ipvs_talk(dest_batch.cmd, &dest_batch.srule, &dest_batch.drules[i],
+				    NULL, NULL, NULL, NULL, NULL, false);
+	dest_batch.depth = depth;
+
+	return result;
+}
+
+static bool
+ipvs_dest_batch_add(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule)
+{
+	if (cmd != IP_VS_SO_SET_ADDDEST && cmd != IP_VS_SO_SET_DELDEST &&
+	    cmd != IP_VS_SO_SET_EDITDEST)
+		return false;
+
+	if (dest_batch.num &&
+	    (dest_batch.cmd != cmd || dest_batch.num == IPVS_DEST_BATCH_MAX ||
+	     memcmp(&dest_batch.srule, srule, sizeof(*srule))))
+		ipvs_dest_batch_flush();
+
+	if (!dest_batch.num) {
+		dest_batch.cmd = cmd;
+		dest_batch.srule = *srule;
+	}
+	dest_batch.drules[dest_batch.num++] = *drule;
+
+	return true;
+}
+
+/* Collect the dests set until the matching ipvs_dest_batch_end() and send
+ * those of the same service and command in one request. Can be nested. */
+void
+ipvs_dest_batch_begin(void)
+{
+	dest_batch.depth++;
+}
+
+void
+ipvs_dest_batch_end(void)
+{
+	if (dest_batch.depth && !--dest_batch.depth)
+		ipvs_dest_batch_flush();
+}
+
 #ifdef _WITH_VRRP_
 /* Note: This function is called in the context of the vrrp child process, not the checker process */
 void
@@ -605,6 +699,7 @@ ipvs_blklst_range_cmd(int cmd, blklst_addr_entry *blklst_entry, ipvs_service_t *
 
 	memset(&blklst_rule, 0, sizeof(ipvs_blklst_t));
 	blklst_rule.af = blklst_entry->addr.ss_family;
+	blklst_rule.plen = (blklst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 	if (blklst_entry->addr.ss_family == AF_INET6) {
 		inet_sockaddrip6(&blklst_entry->addr, &blklst_rule.addr.in6);
 		ip = blklst_rule.addr.in6.s6_addr32[3];
@@ -639,6 +734,7 @@ ipvs_blklst_group_cmd(int cmd, blklst_addr_group *blklst_group, ipvs_service_t *
 	LIST_FOREACH(l, blklst_entry, e) {
 		memset(&blklst_rule, 0, sizeof(ipvs_blklst_t));
 		blklst_rule.af = blklst_entry->addr.ss_family;
+		blklst_rule.plen = (blklst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 		if (blklst_entry->addr.ss_family == AF_INET6)
 			inet_sockaddrip6(&blklst_entry->addr, &blklst_rule.addr.in6);
 		else
@@ -838,6 +934,7 @@ ipvs_whtlst_range_cmd(int cmd, whtlst_addr_entry *whtlst_entry, ipvs_service_t *
 
     memset(&whtlst_rule, 0, sizeof(ipvs_whtlst_t));
     whtlst_rule.af = whtlst_entry->addr.ss_family;
+    whtlst_rule.plen = (whtlst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
     if (whtlst_entry->addr.ss_family == AF_INET6) {
         inet_sockaddrip6(&whtlst_entry->addr, &whtlst_rule.addr.in6);
         ip = whtlst_rule.addr.in6.s6_addr32[3];
@@ -871,6 +968,7 @@ ipvs_whtlst_group_cmd(int cmd, whtlst_addr_group *whtlst_group, ipvs_service_t *
     LIST_FOREACH(l, whtlst_entry, e) {
         memset(&whtlst_rule, 0, sizeof(ipvs_whtlst_t));
         whtlst_rule.af = whtlst_entry->addr.ss_family;
+        whtlst_rule.plen = (whtlst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
         if (whtlst_entry->addr.ss_family == AF_INET6)
             inet_sockaddrip6(&whtlst_entry->addr, &whtlst_rule.addr.in6);
         else
@@ -1264,6 +1362,7 @@ ipvs_rm_bentry_from_vsg(blklst_addr_entry *blklst_entry, whtlst_addr_entry *whtl
 			    else {
 				    memset(&blklst_rule, 0, sizeof(ipvs_blklst_t));
 				    blklst_rule.af = blklst_entry->addr.ss_family;
+				    blklst_rule.plen = (blklst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 				    if (blklst_entry->addr.ss_family == AF_INET6)
 					    inet_sockaddrip6(&blklst_entry->addr, &blklst_rule.addr.in6);
 				    else
@@ -1277,6 +1376,7 @@ ipvs_rm_bentry_from_vsg(blklst_addr_entry *blklst_entry, whtlst_addr_entry *whtl
 			    else {
                     memset(&whtlst_rule, 0, sizeof(ipvs_whtlst_t));
                     whtlst_rule.af = whtlst_entry->addr.ss_family;
+                    whtlst_rule.plen = (whtlst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
                     if (whtlst_entry->addr.ss_family == AF_INET6)
                         inet_sockaddrip6(&whtlst_entry->addr, &whtlst_rule.addr.in6);
                     else
@@ -1302,6 +1402,7 @@ ipvs_rm_bentry_from_vsg(blklst_addr_entry *blklst_entry, whtlst_addr_entry *whtl
 			    else {
 			    	memset(&blklst_rule, 0, sizeof(ipvs_blklst_t));
 			    	blklst_rule.af = blklst_entry->addr.ss_family;
+			    	blklst_rule.plen = (blklst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 			    	if (blklst_entry->addr.ss_family == AF_INET6)
 			    		inet_sockaddrip6(&blklst_entry->addr, &blklst_rule.addr.in6);
 			    	else
@@ -1317,6 +1418,7 @@ ipvs_rm_bentry_from_vsg(blklst_addr_entry *blklst_entry, whtlst_addr_entry *whtl
 			    else {
 			    	memset(&whtlst_rule, 0, sizeof(ipvs_whtlst_t));
 			    	whtlst_rule.af = whtlst_entry->addr.ss_family;
+			    	whtlst_rule.plen = (whtlst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 			    	if (whtlst_entry->addr.ss_family == AF_INET6)
 			    		inet_sockaddrip6(&whtlst_entry->addr, &whtlst_rule.addr.in6);
 			    	else
@@ -1356,6 +1458,7 @@ ipvs_blklst_remove_entry(virtual_server_t *vs, blklst_addr_entry *blklst_entry)
 		} else {
 			memset(&blklst_rule, 0, sizeof(ipvs_blklst_t));
 			blklst_rule.af = blklst_entry->addr.ss_family;
+			blklst_rule.plen = (blklst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 			if (blklst_entry->addr.ss_family == AF_INET6)
 				inet_sockaddrip6(&blklst_entry->addr, &blklst_rule.addr.in6);
 			else
@@ -1395,6 +1498,7 @@ ipvs_whtlst_remove_entry(virtual_server_t *vs, whtlst_addr_entry *whtlst_entry)
 		} else {
 			memset(&whtlst_rule, 0, sizeof(ipvs_whtlst_t));
 			whtlst_rule.af = whtlst_entry->addr.ss_family;
+			whtlst_rule.plen = (whtlst_entry->addr.ss_family == AF_INET6) ? 128 : 32;
 			if (whtlst_entry->addr.ss_family == AF_INET6)
 				inet_sockaddrip6(&whtlst_entry->addr, &whtlst_rule.addr.in6);
 			else
@@ -210,6 +210,7 @@ clear_service_rs(virtual_server_t * vs, list l, bool stopping)
 	bool sav_inhibit;
 	smtp_rs rs_info = { .vs = vs };
 
+	ipvs_dest_batch_begin();
 	LIST_FOREACH(l, rs, e) {
 		if (rs->set || stopping)
 			log_message(LOG_INFO, "%s %sservice %s (%s,%s) from VS %s",
@@ -255,6 +256,7 @@ clear_service_rs(virtual_server_t * vs, list l, bool stopping)
 			smtp_alert(SMTP_MSG_RS_SHUT, &rs_info, "DOWN", stopping ? "=> Shutting down <=" : "=> Removing <=");
 		}
 	}
+	ipvs_dest_batch_end();
 
 	/* Sooner or later VS will lose the quorum (if any). However,
 	 * we don't push in a sorry server then, hence the regression
@@ -350,6 +352,7 @@ init_service_rs(virtual_server_t * vs)
 	element e;
 	real_server_t *rs;
 
+	ipvs_dest_batch_begin();
 	LIST_FOREACH(vs->rs, rs, e) {
 		if (rs->reloaded) {
 			if (rs->iweight != rs->pweight)
@@ -372,6 +375,7 @@ init_service_rs(virtual_server_t * vs)
 			}
 		}
 	}
+	ipvs_dest_batch_end();
 
 	return true;
 }
@@ -458,6 +462,7 @@ perform_quorum_state(virtual_server_t *vs, bool add)
 	log_message(LOG_INFO, "%s the pool for VS %s"
 			    , add?"Adding alive servers to":"Removing alive servers from"
 			    , FMT_VS(vs));
+	ipvs_dest_batch_begin();
 	LIST_FOREACH(vs->rs, rs, e) {
 		if (!ISALIVE(rs)) /* We only handle alive servers */
 			continue;
@@ -467,6 +472,7 @@ perform_quorum_state(virtual_server_t *vs, bool add)
 		ipvs_cmd(add?LVS_CMD_ADD_DEST:LVS_CMD_DEL_DEST, vs, rs);
 		rs->alive = true;
 	}
+	ipvs_dest_batch_end();
 }
 
 void
@@ -99,7 +99,9 @@ typedef struct dp_vs_service_entry_app {
 	X->conn_flags       = Y->user.conn_flags; 		\
 	X->weight           = Y->user.weight; 			\
 	X->max_conn         = Y->user.u_threshold; 		\
-	X->min_conn         = Y->user.l_threshold;}
+	X->min_conn         = Y->user.l_threshold; 		\
+	X->max_cps          = Y->user.max_cps; 			\
+	X->max_bps          = Y->user.max_bps;}
 
 // DPRS_2_IPRS(ip_vs_dest_entry_app, dp_vs_dest_entry)
 #define DPRS_2_IPRS(X, Y) {					\
@@ -113,6 +115,9 @@ typedef struct dp_vs_service_entry_app {
 	X->user.activeconns      = Y->actconns;			\
 	X->user.inactconns       = Y->inactconns;			\
 	X->user.persistconns     = Y->persistconns;			\
+	X->user.max_cps          = Y->max_cps;				\
+	X->user.max_bps          = Y->max_bps;				\
+	X->user.limit_drops      = Y->limit_drops;			\
 	memcpy(&X->stats, &Y->stats, sizeof(X->stats));}
 
 static void ipvs_service_entry_2_user(const ipvs_service_entry_t *entry, ipvs_service_t *rule)
@@ -335,6 +340,54 @@ int ipvs_del_dest(ipvs_service_t *svc, ipvs_dest_t *dest)
 	return dpvs_setsockopt(DPVS_SO_SET_DELDEST, &svcdest, sizeof(svcdest));
 }
 
+/* all dests of a service are set in one request */
+static int ipvs_set_dests(sockoptid_t opt, ipvs_service_t *svc,
+                          ipvs_dest_t *dests, int n)
+{
+	char *buf;
+	struct dp_vs_service_user *dpvs_svc_ptr;
+	struct dp_vs_dest_user dpvs_dest, *dpvs_dest_ptr = &dpvs_dest;
+	int i, ret;
+
+	if (n <= 0)
+		return ESOCKOPT_INVAL;
+	if (!(buf = calloc(1, DP_VS_SVCDEST_LEN(n))))
+		return ESOCKOPT_NOMEM;
+
+	dpvs_svc_ptr = (struct dp_vs_service_user *)buf;
+	IPVS_2_DPVS(dpvs_svc_ptr, svc);
+	for (i = 0; i < n; i++) {
+		memset(dpvs_dest_ptr, 0, sizeof(*dpvs_dest_ptr));
+		IPRS_2_DPRS(dpvs_dest_ptr, (&dests[i]));
+		memcpy(buf + DP_VS_SVCDEST_LEN(i), dpvs_dest_ptr, sizeof(*dpvs_dest_ptr));
+	}
+
+	ret = dpvs_setsockopt(opt, buf, DP_VS_SVCDEST_LEN(n));
+	free(buf);
+	return ret;
+}
+
+int ipvs_add_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n)
+{
+	ipvs_func = ipvs_add_dests;
+
+	return ipvs_set_dests(DPVS_SO_SET_ADDDEST, svc, dests, n);
+}
+
+int ipvs_update_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n)
+{
+	ipvs_func = ipvs_update_dests;
+
+	return ipvs_set_dests(DPVS_SO_SET_EDITDEST, svc, dests, n);
+}
+
+int ipvs_del_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n)
+{
+	ipvs_func = ipvs_del_dests;
+
+	return ipvs_set_dests(DPVS_SO_SET_DELDEST, svc, dests, n);
+}
+
 static void ipvs_fill_laddr_conf(ipvs_service_t *svc, ipvs_laddr_t *laddr,
                                  struct dp_vs_laddr_conf *conf)
 {
@@ -422,6 +475,7 @@ static void ipvs_fill_blklst_conf(ipvs_service_t *svc, ipvs_blklst_t *blklst,
 	conf->proto     = svc->user.protocol;
 	conf->vport     = svc->user.port;
 	conf->fwmark    = svc->user.fwmark;
+	conf->plen      = blklst->plen;
 	if (svc->af == AF_INET) {
 		conf->vaddr.in = svc->nf_addr.in;
 		conf->blklst.in = blklst->addr.in;
@@ -432,26 +486,53 @@ static void ipvs_fill_blklst_conf(ipvs_service_t *svc, ipvs_blklst_t *blklst,
 
 	return;
 }
-int ipvs_add_blklst(ipvs_service_t *svc, ipvs_blklst_t *blklst)
+
+/* all addresses are set in one request */
+static int ipvs_set_blklsts(sockoptid_t opt, ipvs_service_t *svc,
+                            ipvs_blklst_t *blklsts, int n)
 {
-	struct dp_vs_blklst_conf conf;
+	struct dp_vs_blklst_conf *conf;
+	int i, ret;
 
-	ipvs_func = ipvs_add_blklst;
+	if (n <= 0)
+		return ESOCKOPT_INVAL;
+	if (!(conf = calloc(n, sizeof(*conf))))
+		return ESOCKOPT_NOMEM;
 
-	ipvs_fill_blklst_conf(svc, blklst, &conf);
+	for (i = 0; i < n; i++)
+		ipvs_fill_blklst_conf(svc, &blklsts[i], &conf[i]);
 
-	return dpvs_setsockopt(SOCKOPT_SET_BLKLST_ADD, &conf, sizeof(conf));
+	ret = dpvs_setsockopt(opt, conf, n * sizeof(*conf));
+	free(conf);
+	return ret;
 }
 
-int ipvs_del_blklst(ipvs_service_t *svc, ipvs_blklst_t *blklst)
+int ipvs_add_blklsts(ipvs_service_t *svc, ipvs_blklst_t *blklsts, int n)
 {
-	struct dp_vs_blklst_conf conf;
+	ipvs_func = ipvs_add_blklsts;
 
-	ipvs_func = ipvs_del_blklst;
+	return ipvs_set_blklsts(SOCKOPT_SET_BLKLST_ADD, svc, blklsts, n);
+}
+
+int ipvs_del_blklsts(ipvs_service_t *svc, ipvs_blklst_t *blklsts, int n)
+{
+	ipvs_func = ipvs_del_blklsts;
+
+	return ipvs_set_blklsts(SOCKOPT_SET_BLKLST_DEL, svc, blklsts, n);
+}
+
+int ipvs_add_blklst(ipvs_service_t *svc, ipvs_blklst_t *blklst)
+{
+	ipvs_func = ipvs_add_blklst;
 
-	ipvs_fill_blklst_conf(svc, blklst, &conf);
+	return ipvs_set_blklsts(SOCKOPT_SET_BLKLST_ADD, svc, blklst, 1);
+}
+
+int ipvs_del_blklst(ipvs_service_t *svc, ipvs_blklst_t *blklst)
+{
+	ipvs_func = ipvs_del_blklst;
 
-	return dpvs_setsockopt(SOCKOPT_SET_BLKLST_DEL, &conf, sizeof(conf));
+	return ipvs_set_blklsts(SOCKOPT_SET_BLKLST_DEL, svc, blklst, 1);
 }
 
 /*for white list*/
@@ -463,6 +544,7 @@ static void ipvs_fill_whtlst_conf(ipvs_service_t *svc, ipvs_whtlst_t *whtlst,
 	conf->proto     = svc->user.protocol;
 	conf->vport     = svc->user.port;
 	conf->fwmark    = svc->user.fwmark;
+	conf->plen      = whtlst->plen;
 	if (svc->af == AF_INET) {
 		conf->vaddr.in = svc->nf_addr.in;
 		conf->whtlst.in = whtlst->addr.in;
@@ -474,26 +556,52 @@ static void ipvs_fill_whtlst_conf(ipvs_service_t *svc, ipvs_whtlst_t *whtlst,
 	return;
 }
 
-int ipvs_add_whtlst(ipvs_service_t *svc, ipvs_whtlst_t *whtlst)
+/* all addresses are set in one request */
+static int ipvs_set_whtlsts(sockoptid_t opt, ipvs_service_t *svc,
+                            ipvs_whtlst_t *whtlsts, int n)
 {
-	struct dp_vs_whtlst_conf conf;
+	struct dp_vs_whtlst_conf *conf;
+	int i, ret;
 
-	ipvs_func = ipvs_add_whtlst;
+	if (n <= 0)
+		return ESOCKOPT_INVAL;
+	if (!(conf = calloc(n, sizeof(*conf))))
+		return ESOCKOPT_NOMEM;
 
-	ipvs_fill_whtlst_conf(svc, whtlst, &conf);
+	for (i = 0; i < n; i++)
+		ipvs_fill_whtlst_conf(svc, &whtlsts[i], &conf[i]);
 
-	return dpvs_setsockopt(SOCKOPT_SET_WHTLST_ADD, &conf, sizeof(conf));
+	ret = dpvs_setsockopt(opt, conf, n * sizeof(*conf));
+	free(conf);
+	return ret;
 }
 
-int ipvs_del_whtlst(ipvs_service_t *svc, ipvs_whtlst_t *whtlst)
+int ipvs_add_whtlsts(ipvs_service_t *svc, ipvs_whtlst_t *whtlsts, int n)
 {
-	struct dp_vs_whtlst_conf conf;
+	ipvs_func = ipvs_add_whtlsts;
 
-	ipvs_func = ipvs_del_whtlst;
+	return ipvs_set_whtlsts(SOCKOPT_SET_WHTLST_ADD, svc, whtlsts, n);
+}
+
+int ipvs_del_whtlsts(ipvs_service_t *svc, ipvs_whtlst_t *whtlsts, int n)
+{
+	ipvs_func = ipvs_del_whtlsts;
+
+	return ipvs_set_whtlsts(SOCKOPT_SET_WHTLST_DEL, svc, whtlsts, n);
+}
+
+int ipvs_add_whtlst(ipvs_service_t *svc, ipvs_whtlst_t *whtlst)
+{
+	ipvs_func = ipvs_add_whtlst;
 
-	ipvs_fill_whtlst_conf(svc, whtlst, &conf);
+	return ipvs_set_whtlsts(SOCKOPT_SET_WHTLST_ADD, svc, whtlst, 1);
+}
 
-	return dpvs_setsockopt(SOCKOPT_SET_WHTLST_DEL, &conf, sizeof(conf));
+int ipvs_del_whtlst(ipvs_service_t *svc, ipvs_whtlst_t *whtlst)
+{
+	ipvs_func = ipvs_del_whtlst;
+
+	return ipvs_set_whtlsts(SOCKOPT_SET_WHTLST_DEL, svc, whtlst, 1);
 }
 
 /* for tunnel entry */
@@ -843,6 +951,29 @@ int ipvs_send_gratuitous_arp(struct in_addr *in)
 	return dpvs_setsockopt(DPVS_SO_SET_GRATARP, in, sizeof(in));
 }
 
+int ipvs_get_stats(struct ip_vs_stats_user *stats)
+{
+	struct dp_vs_getinfo *info;
+	size_t len_rcv;
+
+	ipvs_func = ipvs_get_stats;
+
+	if (dpvs_getsockopt(DPVS_SO_GET_INFO, (const void*)&g_ipvs_info,
+			    sizeof(g_ipvs_info), (void **)&info, &len_rcv))
+		return -1;
+
+	if (len_rcv < sizeof(*info)) {
+		dpvs_sockopt_msg_free(info);
+		errno = EINVAL;
+		return -1;
+	}
+
+	memcpy(stats, &info->stats, sizeof(*stats));
+	dpvs_sockopt_msg_free(info);
+
+	return 0;
+}
+
 ipvs_timeout_t *ipvs_get_timeout(void)
 {
 #if 0
@@ -1087,6 +1218,12 @@ const char *ipvs_strerror(int err)
 		{ ipvs_update_dest, ENOENT, "No such destination" },
 		{ ipvs_del_dest, ESRCH, "Service not defined" },
 		{ ipvs_del_dest, ENOENT, "No such destination" },
+		{ ipvs_add_dests, ESRCH, "Service not defined" },
+		{ ipvs_add_dests, EEXIST, "Destination already exists" },
+		{ ipvs_update_dests, ESRCH, "Service not defined" },
+		{ ipvs_update_dests, ENOENT, "No such destination" },
+		{ ipvs_del_dests, ESRCH, "Service not defined" },
+		{ ipvs_del_dests, ENOENT, "No such destination" },
 		{ ipvs_start_daemon, EEXIST, "Daemon has already run" },
 		{ ipvs_stop_daemon, ESRCH, "No daemon is running" },
 		{ ipvs_add_laddr, ESRCH, "Service not defined" },
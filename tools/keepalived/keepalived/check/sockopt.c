@@ -156,130 +156,118 @@ static inline int sockopt_msg_recv(int clt_fd, struct dpvs_sock_msg_reply *reply
     return ESOCKOPT_OK;
 }
 
-int dpvs_setsockopt(sockoptid_t cmd, const void *in, size_t in_len)
+/*
+ * the connection to dpvs is kept open and reused by all requests, dpvs
+ * serves requests of one connection in order. it's reopened lazily after
+ * an I/O error, or in a forked child which must not share it with parent.
+ */
+static int sockopt_fd = -1;
+static pid_t sockopt_pid;
+static pthread_mutex_t sockopt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void sockopt_disconnect(void)
+{
+    if (sockopt_fd >= 0 && sockopt_pid == getpid())
+        close(sockopt_fd);
+    sockopt_fd = -1;
+}
+
+static int sockopt_connect(void)
 {
-    struct dpvs_sock_msg *msg;
-    struct dpvs_sock_msg_reply reply_hdr;
     struct sockaddr_un clt_addr;
     int clt_fd;
-    int res;
-    size_t msg_len;
+
+    if (sockopt_fd >= 0 && sockopt_pid == getpid())
+        return ESOCKOPT_OK;
+    sockopt_fd = -1;
 
     memset(&clt_addr, 0, sizeof(struct sockaddr_un));
     clt_addr.sun_family = AF_UNIX;
     strncpy(clt_addr.sun_path, UNIX_DOMAIN, sizeof(clt_addr.sun_path) - 1);
 
-    msg_len = sizeof(struct dpvs_sock_msg);
-    msg = malloc(msg_len);
-    if (NULL == msg) {
-        fprintf(stderr, "[%s] no memory\n", __func__);
-        return -ESOCKOPT_INVAL;
+    clt_fd = socket(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (clt_fd < 0) {
+        fprintf(stderr, "[%s] socket create error: %s\n", __func__, strerror(errno));
+        return -ESOCKOPT_IO;
     }
 
-    clt_fd = socket(PF_UNIX, SOCK_STREAM, 0);
-    res = connect(clt_fd, (struct sockaddr *)&clt_addr, sizeof(clt_addr));
-    if (-1 == res) {
+    if (-1 == connect(clt_fd, (struct sockaddr *)&clt_addr, sizeof(clt_addr))) {
         fprintf(stderr, "[%s] scoket msg connection error: %s\n",
                 __func__, strerror(errno));
-        free(msg);
+        close(clt_fd);
         return -ESOCKOPT_IO;
     }
 
-    memset(msg, 0, msg_len);
-    msg->version = SOCKOPT_VERSION;
-    msg->id = cmd;
-    msg->type = SOCKOPT_SET;
-    msg->len = in_len;
-    res = sockopt_msg_send(clt_fd, msg, in, in_len);
-
-    free(msg);
-    msg = NULL;
+    sockopt_fd = clt_fd;
+    sockopt_pid = getpid();
+    return ESOCKOPT_OK;
+}
 
-    if (res) {
-        close(clt_fd);
-        return res;
+static int sockopt_request(enum sockopt_type type, sockoptid_t cmd,
+        const void *in, size_t in_len, void **out, size_t *out_len)
+{
+    struct dpvs_sock_msg msg;
+    struct dpvs_sock_msg_reply reply_hdr;
+    int res, retry;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.version = SOCKOPT_VERSION;
+    msg.id = cmd;
+    msg.type = type;
+    msg.len = in_len;
+
+    pthread_mutex_lock(&sockopt_lock);
+
+    /*
+     * a kept connection may have been closed by dpvs (e.g. restarted), retry
+     * once on a fresh one. don't retry once the request is sent, it may have
+     * been applied.
+     */
+    for (retry = 0; ; retry++) {
+        res = sockopt_connect();
+        if (res)
+            goto out;
+
+        res = sockopt_msg_send(sockopt_fd, &msg, in, in_len);
+        if (!res)
+            break;
+
+        sockopt_disconnect();
+        if (retry)
+            goto out;
     }
 
-    res = sockopt_msg_recv(clt_fd, &reply_hdr, NULL, NULL);
-    if (res) {
-        close(clt_fd);
-        return res;
+    res = sockopt_msg_recv(sockopt_fd, &reply_hdr, out, out_len);
+    if (res > 0) {
+        /* local failure, the stream is out of sync */
+        sockopt_disconnect();
+        goto out;
     }
-
-    if (reply_hdr.errcode) {
+    if (res) {
         fprintf(stderr, "[%s] Server error: %s\n", __func__, reply_hdr.errstr);
-        close(clt_fd);
-        return reply_hdr.errcode;
+        goto out;
     }
 
-    close(clt_fd);
-    return ESOCKOPT_OK;
+    res = ESOCKOPT_OK;
+out:
+    pthread_mutex_unlock(&sockopt_lock);
+    return res;
+}
+
+int dpvs_setsockopt(sockoptid_t cmd, const void *in, size_t in_len)
+{
+    return sockopt_request(SOCKOPT_SET, cmd, in, in_len, NULL, NULL);
 }
 
 int dpvs_getsockopt(sockoptid_t cmd, const void *in, size_t in_len,
         void **out, size_t *out_len)
 {
-    struct dpvs_sock_msg *msg;
-    struct dpvs_sock_msg_reply reply_hdr;
-    struct sockaddr_un clt_addr;
-    int clt_fd;
-    int res;
-    size_t msg_len;
-
     if (NULL == out || NULL == out_len) {
         fprintf(stderr, "[%s] no pointer for info return\n", __func__);
         return -1;
     }
-    *out = NULL; // struct ip_vs_getinfo *ipvs_info_rcv ; out = &ipvs_info_rcv; *out = ipvs_info_rcv = NULL;
+    *out = NULL;
     *out_len = 0;
 
-    memset(&clt_addr, 0, sizeof(struct sockaddr_un));
-    clt_addr.sun_family = AF_UNIX;
-    strncpy(clt_addr.sun_path, UNIX_DOMAIN, sizeof(clt_addr.sun_path) - 1);
-
-    msg_len = sizeof(struct dpvs_sock_msg);
-    msg = malloc(msg_len);
-    if (NULL == msg) {
-        fprintf(stderr, "[%s] no memory\n", __func__);
-        return -ESOCKOPT_NOMEM;
-    }
-
-    clt_fd = socket(PF_UNIX, SOCK_STREAM, 0);
-    res = connect(clt_fd, (struct sockaddr*)&clt_addr, sizeof(clt_addr));
-    if (-1 == res) {
-        fprintf(stderr, "[%s] scoket msg connection error: %s\n",
-                __func__, strerror(errno));
-        free(msg);
-        return -ESOCKOPT_IO;
-    }
-
-    memset(msg, 0, msg_len);
-    msg->version = SOCKOPT_VERSION;
-    msg->id = cmd;
-    msg->type = SOCKOPT_GET;
-    msg->len = in_len;
-    res = sockopt_msg_send(clt_fd, msg, in, in_len);
-
-    free(msg);
-    msg = NULL;
-
-    if (res) {
-        close(clt_fd);
-        return res;
-    }
-
-    res = sockopt_msg_recv(clt_fd, &reply_hdr, out, out_len);
-    if (res) {
-        close(clt_fd);
-        return res;
-    }
-
-    if (reply_hdr.errcode) {
-        fprintf(stderr, "[%s] Server error: %s\n", __func__, reply_hdr.errstr);
-        close(clt_fd);
-        return reply_hdr.errcode;
-    }
-
-    close(clt_fd);
-    return ESOCKOPT_OK;
+    return sockopt_request(SOCKOPT_GET, cmd, in, in_len, out, out_len);
 }
@@ -123,6 +123,10 @@ struct ip_vs_dest_user {
     /* thresholds for active connections */
     __u32           u_threshold;    /* upper threshold */
     __u32           l_threshold;    /* lower threshold */
+
+    /* rate limits, 0 for unlimited */
+    __u32           max_cps;        /* new connections per second */
+    __u64           max_bps;        /* bytes per second */
 };
 
 struct ip_vs_laddr_user {
@@ -136,12 +140,14 @@ struct ip_vs_blklst_user {
     __be32                  __addr_v4;
     u_int16_t               af;
     union nf_inet_addr      addr;
+    u_int8_t                plen;   /* 32/128 for a host address */
 };
 
 struct ip_vs_whtlst_user {
     __be32                  __addr_v4;
     u_int16_t               af;
     union nf_inet_addr      addr;
+    u_int8_t                plen;   /* 32/128 for a host address */
 };
 
 struct ip_vs_tunnel_user {
@@ -224,6 +230,10 @@ struct ip_vs_dest_entry {
     __u32               inactconns;     /* inactive connections */
     __u32               persistconns;   /* persistent connections */
 
+    __u32               max_cps;        /* connections rate limit */
+    __u64               max_bps;        /* bytes rate limit */
+    __u64               limit_drops;    /* connections refused by limits */
+
     /* statistics */
     struct              ip_vs_stats_user stats;
 };
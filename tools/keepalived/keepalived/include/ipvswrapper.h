@@ -76,6 +76,8 @@ extern virtual_server_group_t *ipvs_get_group_by_name(const char *, list) __attr
 extern void ipvs_group_sync_entry(virtual_server_t *vs, virtual_server_group_entry_t *vsge);
 extern void ipvs_group_remove_entry(virtual_server_t *, virtual_server_group_entry_t *);
 extern int ipvs_cmd(int, virtual_server_t *, real_server_t *);
+extern void ipvs_dest_batch_begin(void);
+extern void ipvs_dest_batch_end(void);
 #ifdef _WITH_VRRP_
 extern void ipvs_syncd_cmd(int, const struct lvs_syncd_config *, int, bool, bool);
 extern void ipvs_syncd_master(const struct lvs_syncd_config *);
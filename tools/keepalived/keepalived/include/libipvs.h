@@ -44,7 +44,11 @@
 #define OPT_CPU                    0x20000000
 #define OPT_EXPIRE_QUIESCENT_CONN  0x40000000
 #define OPT_WHTLST_ADDRESS         0x80000000
-#define NUMBER_OF_OPT                   33
+#define OPT_CONN_LIMIT            0x100000000ULL
+#define OPT_BPS_LIMIT             0x200000000ULL
+#define OPT_CONN_STATE            0x400000000ULL
+#define OPT_CONN_CLIENT           0x800000000ULL
+#define NUMBER_OF_OPT                   36
 
 #define MINIMUM_IPVS_VERSION_MAJOR      1
 #define MINIMUM_IPVS_VERSION_MINOR      1
@@ -117,6 +121,11 @@ extern int ipvs_update_dest(ipvs_service_t *svc, ipvs_dest_t *dest);
 /* remove a destination server from a service */
 extern int ipvs_del_dest(ipvs_service_t *svc, ipvs_dest_t *dest);
 
+/* add, update or remove a batch of destination servers in one request */
+extern int ipvs_add_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n);
+extern int ipvs_update_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n);
+extern int ipvs_del_dests(ipvs_service_t *svc, ipvs_dest_t *dests, int n);
+
 extern struct ip_vs_conn_array *ip_vs_get_conns(const struct ip_vs_conn_req *req);
 
 extern int ipvs_add_laddr(ipvs_service_t *svc, ipvs_laddr_t * laddr);
@@ -126,10 +135,14 @@ extern struct ip_vs_get_laddrs *ipvs_get_laddrs(ipvs_service_entry_t *svc, lcore
 /*for add/delete a blacklist ip*/
 extern int ipvs_add_blklst(ipvs_service_t *svc, ipvs_blklst_t * blklst);
 extern int ipvs_del_blklst(ipvs_service_t *svc, ipvs_blklst_t * blklst);
+extern int ipvs_add_blklsts(ipvs_service_t *svc, ipvs_blklst_t *blklsts, int n);
+extern int ipvs_del_blklsts(ipvs_service_t *svc, ipvs_blklst_t *blklsts, int n);
 
 /*for add/delete a whitelist ip*/
 extern int ipvs_add_whtlst(ipvs_service_t *svc, ipvs_whtlst_t * whtlst);
 extern int ipvs_del_whtlst(ipvs_service_t *svc, ipvs_whtlst_t * whtlst);
+extern int ipvs_add_whtlsts(ipvs_service_t *svc, ipvs_whtlst_t *whtlsts, int n);
+extern int ipvs_del_whtlsts(ipvs_service_t *svc, ipvs_whtlst_t *whtlsts, int n);
 
 /*for add/delete a tunnel*/
 extern int ipvs_add_tunnel(ipvs_tunnel_t * tunnel_entry);
@@ -150,6 +163,9 @@ extern struct ip_vs_get_dests_app *ipvs_get_dests(ipvs_service_entry_t *svc, lco
 /* get an ipvs service entry */
 extern ipvs_service_entry_t *ipvs_get_service(struct ip_vs_service_app *hint, lcoreid_t cid);
 
+/* get the statistics of all services, rates included */
+extern int ipvs_get_stats(struct ip_vs_stats_user *stats);
+
 /* get ipvs timeout */
 extern ipvs_timeout_t *ipvs_get_timeout(void);
 